@@ -8,12 +8,14 @@ OMAP3_CAMERA_HAL_SRC := \
 	CameraHal.cpp \
 	CameraHalUtilClasses.cpp \
 	AppCallbackNotifier.cpp \
+	PreviewSlotPool.cpp \
 	ANativeWindowDisplayAdapter.cpp \
 	CameraProperties.cpp \
 	MemoryManager.cpp \
 	Encoder_libjpeg.cpp \
 	SensorListener.cpp  \
 	NV12_resize.c \
+	NV12_convert.c \
 	CameraHal_Utils.cpp
 
 OMAP3_CAMERA_COMMON_SRC:= \
@@ -23,6 +25,7 @@ OMAP3_CAMERA_COMMON_SRC:= \
 
 OMAP3_CAMERA_USB_SRC:= \
 	BaseCameraAdapter.cpp \
+	FrameDescriptorTable.cpp \
 	V4LCameraAdapter/V4LCameraAdapter.cpp
 
 #
@@ -129,5 +132,105 @@ LOCAL_MODULE:= camera.$(TARGET_BOARD_PLATFORM)
 LOCAL_MODULE_TAGS:= optional
 
 include $(BUILD_HEAPTRACKED_SHARED_LIBRARY)
+
+#
+# NV12 resize bit-exactness test
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	NV12_resize.c \
+	NV12_resize_test.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/inc
+
+LOCAL_SHARED_LIBRARIES:= \
+    liblog \
+    libcutils
+
+LOCAL_MODULE:= nv12resizetest
+LOCAL_MODULE_TAGS:= optional tests
+
+include $(BUILD_HEAPTRACKED_EXECUTABLE)
+
+#
+# NV12 preview conversion bit-exactness test
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	NV12_convert.c \
+	NV12_convert_test.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/inc
+
+LOCAL_SHARED_LIBRARIES:= \
+    liblog \
+    libcutils
+
+LOCAL_MODULE:= nv12converttest
+LOCAL_MODULE_TAGS:= optional tests
+
+include $(BUILD_HEAPTRACKED_EXECUTABLE)
+
+#
+# Frame descriptor table concurrency test
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	FrameDescriptorTable.cpp \
+	FrameDescriptorTable_test.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/inc
+
+LOCAL_SHARED_LIBRARIES:= \
+    libutils \
+    liblog \
+    libcutils
+
+LOCAL_MODULE:= framedescriptortest
+LOCAL_MODULE_TAGS:= optional tests
+
+include $(BUILD_HEAPTRACKED_EXECUTABLE)
+
+#
+# Preview callback slice pool test
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	PreviewSlotPool.cpp \
+	PreviewSlotPool_test.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/inc
+
+LOCAL_SHARED_LIBRARIES:= \
+    libutils \
+    liblog \
+    libcutils
+
+LOCAL_MODULE:= previewslotpooltest
+LOCAL_MODULE_TAGS:= optional tests
+
+include $(BUILD_HEAPTRACKED_EXECUTABLE)
+
+#
+# DMABUF preview import test, run against vivid
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	V4L2_dmabuf_test.c
+
+LOCAL_MODULE:= v4l2dmabuftest
+LOCAL_MODULE_TAGS:= optional tests
+
+include $(BUILD_HEAPTRACKED_EXECUTABLE)
 endif
 endif
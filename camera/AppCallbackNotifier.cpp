@@ -27,6 +27,8 @@
 #include <ui/GraphicBuffer.h>
 #include <ui/GraphicBufferMapper.h>
 #include "NV12_resize.h"
+#include "NV12_convert.h"
+#include <cutils/atomic.h>
 
 namespace android {
 
@@ -50,8 +52,8 @@ void AppCallbackNotifierEncoderCallback(void* main_jpeg,
 
 void AppCallbackNotifier::EncoderDoneCb(void* main_jpeg, void* thumb_jpeg, CameraFrame::FrameType type, void* cookie1, void* cookie2)
 {
-    camera_memory_t* encoded_mem = NULL;
-    Encoder_libjpeg::params *main_param = NULL, *thumb_param = NULL;
+    MemoryHeapBase* encoded_heap = NULL;
+    Encoder_libjpeg::params *main_param = NULL;
     size_t jpeg_size;
     uint8_t* src = NULL;
     sp<Encoder_libjpeg> encoder = NULL;
@@ -63,44 +65,20 @@ void AppCallbackNotifier::EncoderDoneCb(void* main_jpeg, void* thumb_jpeg, Camer
     {
     Mutex::Autolock lock(mLock);
 
+    encoded_heap = (MemoryHeapBase*) cookie1;
+
     if (!main_jpeg) {
         goto exit;
     }
 
-    encoded_mem = (camera_memory_t*) cookie1;
     main_param = (Encoder_libjpeg::params *) main_jpeg;
     jpeg_size = main_param->jpeg_size;
     src = main_param->src;
 
-    if(encoded_mem && encoded_mem->data && (jpeg_size > 0)) {
-        if (cookie2) {
-            ExifElementsTable* exif = (ExifElementsTable*) cookie2;
-            Section_t* exif_section = NULL;
-
-            exif->insertExifToJpeg((unsigned char*) encoded_mem->data, jpeg_size);
-
-            if(thumb_jpeg) {
-                thumb_param = (Encoder_libjpeg::params *) thumb_jpeg;
-                exif->insertExifThumbnailImage((const char*)thumb_param->dst,
-                                               (int)thumb_param->jpeg_size);
-            }
-
-            exif_section = FindSection(M_EXIF);
-
-            if (exif_section) {
-                picture = mRequestMemory(-1, jpeg_size + exif_section->Size, 1, NULL);
-                if (picture && picture->data) {
-                    exif->saveJpeg((unsigned char*) picture->data, jpeg_size + exif_section->Size);
-                }
-            }
-            delete exif;
-            cookie2 = NULL;
-        } else {
-            picture = mRequestMemory(-1, jpeg_size, 1, NULL);
-            if (picture && picture->data) {
-                memcpy(picture->data, encoded_mem->data, jpeg_size);
-            }
-        }
+    if(encoded_heap && (encoded_heap->getHeapID() >= 0) && (jpeg_size > 0)) {
+        // EXIF and thumbnail were already written in front of the scan by the
+        // encoder, map exactly the encoded bytes for the application
+        picture = mRequestMemory(encoded_heap->getHeapID(), jpeg_size, 1, NULL);
     }
     } // scope for mutex lock
 
@@ -134,14 +112,17 @@ void AppCallbackNotifier::EncoderDoneCb(void* main_jpeg, void* thumb_jpeg, Camer
     }
 
     if (thumb_jpeg) {
+       if (((Encoder_libjpeg::params *) thumb_jpeg)->src) {
+           free(((Encoder_libjpeg::params *) thumb_jpeg)->src);
+       }
        if (((Encoder_libjpeg::params *) thumb_jpeg)->dst) {
            free(((Encoder_libjpeg::params *) thumb_jpeg)->dst);
        }
        free(thumb_jpeg);
     }
 
-    if (encoded_mem) {
-        encoded_mem->release(encoded_mem);
+    if (encoded_heap) {
+        encoded_heap->decStrong(encoded_heap);
     }
 
     if (picture) {
@@ -442,8 +423,6 @@ static void copy2Dto1D(void *dst,
 {
     unsigned int alignedRow, row;
     unsigned char *bufferDst, *bufferSrc;
-    unsigned char *bufferDstEnd, *bufferSrcEnd;
-    uint16_t *bufferSrc_UV;
 
     unsigned int *y_uv = (unsigned int *)src;
 
@@ -456,132 +435,29 @@ static void copy2Dto1D(void *dst,
         } else if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0 ||
                    strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420P) == 0) {
             bytesPerPixel = 1;
-            bufferDst = ( unsigned char * ) dst;
-            bufferDstEnd = ( unsigned char * ) dst + width*height*bytesPerPixel;
-            bufferSrc = ( unsigned char * ) y_uv[0] + offset;
-            bufferSrcEnd = ( unsigned char * ) ( ( size_t ) y_uv[0] + length + offset);
-            row = width*bytesPerPixel;
-            alignedRow = stride-width;
-            int stride_bytes = stride / 8;
             uint32_t xOff = offset % stride;
             uint32_t yOff = offset / stride;
-
-            // going to convert from NV12 here and return
-            // Step 1: Y plane: iterate through each row and copy
-            for ( int i = 0 ; i < height ; i++) {
-                memcpy(bufferDst, bufferSrc, row);
-                bufferSrc += stride;
-                bufferDst += row;
-                if ( ( bufferSrc > bufferSrcEnd ) || ( bufferDst > bufferDstEnd ) ) {
-                    break;
-                }
+            unsigned char *srcY = ( unsigned char * ) y_uv[0] + offset;
+            unsigned char *srcUV = ( unsigned char * ) y_uv[1] + (stride/2)*yOff + xOff;
+            int rows = height;
+
+            // never read past the end of the source luma plane; the output
+            // keeps the layout of the full frame and is only truncated
+            if ( ( size_t ) height * stride > length ) {
+                rows = length / stride;
             }
 
-            bufferSrc_UV = ( uint16_t * ) ((uint8_t*)y_uv[1] + (stride/2)*yOff + xOff);
-
+            // Convert from NV12 here and return. Luma and chroma rows are
+            // handled in the same pass by the runtime selected kernels.
             if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0) {
-                 uint16_t *bufferDst_UV;
-
-                // Step 2: UV plane: convert NV12 to NV21 by swapping U & V
-                bufferDst_UV = (uint16_t *) (((uint8_t*)dst)+row*height);
-
-                for (int i = 0 ; i < height/2 ; i++, bufferSrc_UV += alignedRow/2) {
-                    int n = width;
-                    asm volatile (
-                    "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   blt 1f                                                      \n\t"
-                    "0: @ 32 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #32                                         \n\t"
-                    "   vld2.8  {q0, q1} , [%[src]]!                                \n\t"
-                    "   vswp q0, q1                                                 \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   vst2.8  {q0,q1},[%[dst]]!                                   \n\t"
-                    "   bge 0b                                                      \n\t"
-                    "1: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   blt 3f                                                      \n\t"
-                    "2: @ 16 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #16                                         \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   vswp d0, d1                                                 \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   vst2.8  {d0,d1},[%[dst]]!                                   \n\t"
-                    "   bge 2b                                                      \n\t"
-                    "3: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   blt 5f                                                      \n\t"
-                    "4: @ 8 byte swap                                               \n\t"
-                    "   sub %[n], %[n], #8                                          \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   vswp d0, d1                                                 \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   vst2.8  {d0[0],d1[0]},[%[dst]]!                             \n\t"
-                    "   bge 4b                                                      \n\t"
-                    "5: @ end                                                       \n\t"
-#ifdef NEEDS_ARM_ERRATA_754319_754320
-                    "   vmov s0,s0  @ add noop for errata item                      \n\t"
-#endif
-                    : [dst] "+r" (bufferDst_UV), [src] "+r" (bufferSrc_UV), [n] "+r" (n)
-                    : [src_stride] "r" (stride_bytes)
-                    : "cc", "memory", "q0", "q1"
-                    );
-                }
-            } else if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420P) == 0) {
-                 uint16_t *bufferDst_U;
-                 uint16_t *bufferDst_V;
-
-                // Step 2: UV plane: convert NV12 to YV12 by de-interleaving U & V
+                // NV12 to NV21 by swapping U & V
+                NV12_to_NV21(( uint8_t * ) dst, srcY, srcUV, width, height, rows, stride);
+            } else {
+                // NV12 to YV12 by de-interleaving U & V
                 // TODO(XXX): This version of CameraHal assumes NV12 format it set at
                 //            camera adapter to support YV12. Need to address for
                 //            USBCamera
-
-                bufferDst_V = (uint16_t *) (((uint8_t*)dst)+row*height);
-                bufferDst_U = (uint16_t *) (((uint8_t*)dst)+row*height+row*height/4);
-
-                for (int i = 0 ; i < height/2 ; i++, bufferSrc_UV += alignedRow/2) {
-                    int n = width;
-                    asm volatile (
-                    "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   blt 1f                                                      \n\t"
-                    "0: @ 32 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #32                                         \n\t"
-                    "   vld2.8  {q0, q1} , [%[src]]!                                \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   vst1.8  {q1},[%[dst_v]]!                                    \n\t"
-                    "   vst1.8  {q0},[%[dst_u]]!                                    \n\t"
-                    "   bge 0b                                                      \n\t"
-                    "1: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   blt 3f                                                      \n\t"
-                    "2: @ 16 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #16                                         \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   vst1.8  {d1},[%[dst_v]]!                                    \n\t"
-                    "   vst1.8  {d0},[%[dst_u]]!                                    \n\t"
-                    "   bge 2b                                                      \n\t"
-                    "3: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   blt 5f                                                      \n\t"
-                    "4: @ 8 byte swap                                               \n\t"
-                    "   sub %[n], %[n], #8                                          \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   vst1.8  {d1[0]},[%[dst_v]]!                                 \n\t"
-                    "   vst1.8  {d0[0]},[%[dst_u]]!                                 \n\t"
-                    "   bge 4b                                                      \n\t"
-                    "5: @ end                                                       \n\t"
-#ifdef NEEDS_ARM_ERRATA_754319_754320
-                    "   vmov s0,s0  @ add noop for errata item                      \n\t"
-#endif
-                    : [dst_u] "+r" (bufferDst_U), [dst_v] "+r" (bufferDst_V),
-                      [src] "+r" (bufferSrc_UV), [n] "+r" (n)
-                    : [src_stride] "r" (stride_bytes)
-                    : "cc", "memory", "q0", "q1"
-                    );
-                }
+                NV12_to_YV12(( uint8_t * ) dst, srcY, srcUV, width, height, rows, stride);
             }
             return ;
 
@@ -639,8 +515,8 @@ void AppCallbackNotifier::copyAndSendPictureFrame(CameraFrame* frame, int32_t ms
 
 void AppCallbackNotifier::copyAndSendPreviewFrame(CameraFrame* frame, int32_t msgType)
 {
-    camera_memory_t* picture = NULL;
     void* dest = NULL;
+    int slot = -1;
 
     // scope for lock
     {
@@ -655,8 +531,18 @@ void AppCallbackNotifier::copyAndSendPreviewFrame(CameraFrame* frame, int32_t ms
             goto exit;
         }
 
+        // Never refill a slice the application may still read from, drop the
+        // frame instead
+        slot = mPreviewSlots.acquire(systemTime());
+        if ( 0 > slot ) {
+            if ( 1 == ( mPreviewSlots.dropped() % 30 ) ) {
+                CAMHAL_LOGDB("No free preview callback buffer, %u frames dropped",
+                             mPreviewSlots.dropped());
+            }
+            goto exit;
+        }
 
-        dest = (void*) mPreviewBufs[mPreviewBufCount];
+        dest = (void*) mPreviewBufs[slot];
 
         /*CAMHAL_LOGVB("%d:copy2Dto1D(%p, %p, %d, %d, %d, %d, %d,%s)",
                      __LINE__,
@@ -680,6 +566,7 @@ void AppCallbackNotifier::copyAndSendPreviewFrame(CameraFrame* frame, int32_t ms
             } else {
               if ((NULL == frame->mYuv[0]) || (NULL == frame->mYuv[1])){
                 CAMHAL_LOGEA("Error! One of the YUV Pointer is NULL");
+                dest = NULL;
                 goto exit;
               }
               else{
@@ -695,6 +582,10 @@ void AppCallbackNotifier::copyAndSendPreviewFrame(CameraFrame* frame, int32_t ms
               }
             }
         }
+
+        if ( NULL != dest ) {
+            mLastPreviewSlot = slot;
+        }
     }
 
  exit:
@@ -703,11 +594,16 @@ void AppCallbackNotifier::copyAndSendPreviewFrame(CameraFrame* frame, int32_t ms
     if((mNotifierState == AppCallbackNotifier::NOTIFIER_STARTED) &&
        mCameraHal->msgTypeEnabled(msgType) &&
        (dest != NULL)) {
-        mDataCb(msgType, mPreviewMemory, mPreviewBufCount, NULL, mCallbackCookie);
+        mDataCb(msgType, mPreviewMemory, slot, NULL, mCallbackCookie);
+
+        Mutex::Autolock lock(mLock);
+        if ( mPreviewing ) {
+            mPreviewSlots.hold(slot, systemTime());
+            slot = -1;
+        }
     }
 
-    // increment for next buffer
-    mPreviewBufCount = (mPreviewBufCount + 1) % AppCallbackNotifier::MAX_BUFFERS;
+    mPreviewSlots.release(slot);
 }
 
 status_t AppCallbackNotifier::dummyRaw()
@@ -814,10 +710,12 @@ void AppCallbackNotifier::notifyFrame()
                     unsigned int current_snapshot = 0;
                     Encoder_libjpeg::params *main_jpeg = NULL, *tn_jpeg = NULL;
                     void* exif_data = NULL;
-                    camera_memory_t* raw_picture = mRequestMemory(-1, frame->mLength, 1, NULL);
+                    // ashmem backed, so the result can be handed out without a copy
+                    MemoryHeapBase* raw_picture = new MemoryHeapBase(frame->mLength, 0, "camera-jpeg");
 
-                    if(raw_picture) {
-                        buf = raw_picture->data;
+                    raw_picture->incStrong(raw_picture);
+                    if (raw_picture->getHeapID() >= 0) {
+                        buf = raw_picture->getBase();
                     }
 
                     encode_quality = mParameters.getInt(CameraParameters::KEY_JPEG_QUALITY);
@@ -847,6 +745,8 @@ void AppCallbackNotifier::notifyFrame()
                         main_jpeg->out_width = frame->mWidth;
                         main_jpeg->out_height = frame->mHeight;
                         main_jpeg->format = CameraParameters::PIXEL_FORMAT_YUV422I;
+                        main_jpeg->threads = 0;
+                        main_jpeg->exif = (ExifElementsTable*) exif_data;
                     }
 
                     tn_width = mParameters.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH);
@@ -861,12 +761,29 @@ void AppCallbackNotifier::notifyFrame()
                         }
                     }
 
+                    if (tn_jpeg) {
+                        // the encoder gets its own copy of the last slice sent to the
+                        // application, preview may be stopped and its memory released
+                        // before EncoderDoneCb
+                        Mutex::Autolock lock(mLock);
+                        tn_jpeg->src = NULL;
+                        if ( mPreviewing && mPreviewMemory ) {
+                            current_snapshot = ( 0 <= mLastPreviewSlot ) ? mLastPreviewSlot : 0;
+                            tn_jpeg->src_size = mPreviewMemory->size / MAX_BUFFERS;
+                            tn_jpeg->src = (uint8_t*) malloc(tn_jpeg->src_size);
+                        }
+                        if ( tn_jpeg->src ) {
+                            memcpy(tn_jpeg->src, mPreviewBufs[current_snapshot], tn_jpeg->src_size);
+                        } else {
+                            // no preview data, encode the main jpeg only
+                            free(tn_jpeg);
+                            tn_jpeg = NULL;
+                        }
+                    }
+
                     if (tn_jpeg) {
                         int width, height;
                         mParameters.getPreviewSize(&width,&height);
-                        current_snapshot = (mPreviewBufCount + MAX_BUFFERS - 1) % MAX_BUFFERS;
-                        tn_jpeg->src = (uint8_t*) mPreviewBufs[current_snapshot];
-                        tn_jpeg->src_size = mPreviewMemory->size / MAX_BUFFERS;
                         tn_jpeg->dst = (uint8_t*) malloc(tn_jpeg->src_size);
                         tn_jpeg->dst_size = tn_jpeg->src_size;
                         tn_jpeg->quality = tn_quality;
@@ -875,6 +792,8 @@ void AppCallbackNotifier::notifyFrame()
                         tn_jpeg->out_width = tn_width;
                         tn_jpeg->out_height = tn_height;
                         tn_jpeg->format = CameraParameters::PIXEL_FORMAT_YUV420SP;;
+                        tn_jpeg->threads = 1;
+                        tn_jpeg->exif = NULL;
                     }
 
                     sp<Encoder_libjpeg> encoder = new Encoder_libjpeg(main_jpeg,
@@ -1010,6 +929,13 @@ void AppCallbackNotifier::notifyFrame()
                                 videoMetadataBuffer->handle = (void *)vBuf;
                                 videoMetadataBuffer->offset = 0;
                               }
+                            else if ( frame->mQuirks & CameraFrame::DMABUF_BACKED )
+                              {
+                                //Hand the encoder the gralloc handle, it imports the same fd
+                                videoMetadataBuffer->metadataBufferType = (int) kMetadataBufferTypeGrallocSource;
+                                videoMetadataBuffer->handle = frame->mBuffer;
+                                videoMetadataBuffer->offset = frame->mOffset;
+                              }
                             else
                               {
                                 videoMetadataBuffer->metadataBufferType = (int) kMetadataBufferTypeCameraSource;
@@ -1420,7 +1346,15 @@ status_t AppCallbackNotifier::startPreviewCallbacks(CameraParameters &params, vo
          mFrameProvider->enableFrameNotification(CameraFrame::PREVIEW_FRAME_SYNC);
     }
 
-    mPreviewBufCount = 0;
+    // The application gets MAX_BUFFERS - 1 frame intervals to read a slice,
+    // the window the plain round-robin gave it at the nominal frame rate
+    int fps = params.getPreviewFrameRate();
+    if ( 0 >= fps ) {
+        fps = 30;
+    }
+    mPreviewSlots.reset(AppCallbackNotifier::MAX_BUFFERS,
+                        ( AppCallbackNotifier::MAX_BUFFERS - 1 ) * seconds_to_nanoseconds(1) / fps);
+    mLastPreviewSlot = -1;
 
     mPreviewing = true;
 
@@ -1496,7 +1430,13 @@ status_t AppCallbackNotifier::stopPreviewCallbacks()
 
     {
     Mutex::Autolock lock(mLock);
+    mPreviewSlots.releaseHeld();
     mPreviewMemory->release(mPreviewMemory);
+    mPreviewMemory = NULL;
+    }
+
+    if ( 0 < mPreviewSlots.dropped() ) {
+        CAMHAL_LOGDB("%u preview callback frames dropped", mPreviewSlots.dropped());
     }
 
     mPreviewing = false;
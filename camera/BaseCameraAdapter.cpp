@@ -20,6 +20,8 @@
 
 #include "BaseCameraAdapter.h"
 
+#include <cutils/atomic.h>
+
 namespace android {
 
 /*--------------------Camera Adapter Class STARTS here-----------------------------*/
@@ -49,6 +51,10 @@ BaseCameraAdapter::BaseCameraAdapter()
     mPreviewDataBuffersCount = 0;
     mPreviewDataBuffersLength = 0;
 
+    mFramesWithDucati = 0;
+    mFramesWithDisplay = 0;
+    mFramesWithEncoder = 0;
+
     mAdapterState = INTIALIZED_STATE;
 
 #if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
@@ -254,11 +260,10 @@ void BaseCameraAdapter::removeFramePointers()
 
 void BaseCameraAdapter::returnFrame(void* frameBuf, CameraFrame::FrameType frameType)
 {
-    status_t res = NO_ERROR;
-    size_t subscriberCount = 0;
-    int refCount = -1;
-
-    Mutex::Autolock lock(mReturnFrameLock);
+    FrameDescriptorTable *table;
+    FrameDescriptorTable::Descriptor *desc = NULL;
+    FrameDescriptorTable::RefSlot slot;
+    bool lastRef = false;
 
     if ( NULL == frameBuf )
         {
@@ -266,61 +271,48 @@ void BaseCameraAdapter::returnFrame(void* frameBuf, CameraFrame::FrameType frame
         return;
         }
 
-    if ( NO_ERROR == res)
+    table = getFrameTable(frameType, slot);
+    if ( NULL != table )
         {
+        desc = table->find(frameBuf);
+        }
 
-        refCount = getFrameRefCount(frameBuf,  frameType);
-
-        if(frameType == CameraFrame::PREVIEW_FRAME_SYNC)
-            {
-            mFramesWithDisplay--;
-            }
-        else if(frameType == CameraFrame::VIDEO_FRAME_SYNC)
-            {
-            mFramesWithEncoder--;
-            }
-
-        if ( 0 < refCount )
-            {
-
-            refCount--;
-            setFrameRefCount(frameBuf, frameType, refCount);
-
-
-            if ( mRecording && (CameraFrame::VIDEO_FRAME_SYNC == frameType) ) {
-                refCount += getFrameRefCount(frameBuf, CameraFrame::PREVIEW_FRAME_SYNC);
-            } else if ( mRecording && (CameraFrame::PREVIEW_FRAME_SYNC == frameType) ) {
-                refCount += getFrameRefCount(frameBuf, CameraFrame::VIDEO_FRAME_SYNC);
-            } else if ( mRecording && (CameraFrame::SNAPSHOT_FRAME == frameType) ) {
-                refCount += getFrameRefCount(frameBuf, CameraFrame::VIDEO_FRAME_SYNC);
-            }
+    if ( NULL == desc )
+        {
+        CAMHAL_LOGEB("Unknown frame 0x%x returned, type 0x%x", ( uint32_t ) frameBuf, frameType);
+        return;
+        }
 
+    if(frameType == CameraFrame::PREVIEW_FRAME_SYNC)
+        {
+        android_atomic_dec(&mFramesWithDisplay);
+        }
+    else if(frameType == CameraFrame::VIDEO_FRAME_SYNC)
+        {
+        android_atomic_dec(&mFramesWithEncoder);
+        }
 
-            }
-        else
-            {
-            CAMHAL_LOGEA("Frame returned when ref count is already zero!!");
-            return;
-            }
+    if ( !FrameDescriptorTable::releaseRef(desc, slot, lastRef) )
+        {
+        CAMHAL_LOGEA("Frame returned when ref count is already zero!!");
+        return;
         }
 
-    CAMHAL_LOGVB("REFCOUNT 0x%x %d", frameBuf, refCount);
+    CAMHAL_LOGVB("REFCOUNT 0x%x %d", frameBuf, FrameDescriptorTable::getRef(desc, slot));
 
-    if ( NO_ERROR == res )
+    //check if someone is holding this buffer
+    if ( lastRef )
         {
-        //check if someone is holding this buffer
-        if ( 0 == refCount )
-            {
+        Mutex::Autolock lock(mReturnFrameLock);
 #ifdef DEBUG_LOG
-            if(mBuffersWithDucati.indexOfKey((int)frameBuf)>=0)
-                {
-                ALOGE("Buffer already with Ducati!! 0x%x", frameBuf);
-                for(int i=0;i<mBuffersWithDucati.size();i++) ALOGE("0x%x", mBuffersWithDucati.keyAt(i));
-                }
-            mBuffersWithDucati.add((int)frameBuf,1);
-#endif
-            res = fillThisBuffer(frameBuf, frameType);
+        if(mBuffersWithDucati.indexOfKey((int)frameBuf)>=0)
+            {
+            ALOGE("Buffer already with Ducati!! 0x%x", frameBuf);
+            for(int i=0;i<mBuffersWithDucati.size();i++) ALOGE("0x%x", mBuffersWithDucati.keyAt(i));
             }
+        mBuffersWithDucati.add((int)frameBuf,1);
+#endif
+        fillThisBuffer(frameBuf, frameType);
         }
 
 }
@@ -352,20 +344,9 @@ status_t BaseCameraAdapter::sendCommand(CameraCommands operation, int value1, in
 
                 if ( ret == NO_ERROR )
                     {
-                    Mutex::Autolock lock(mPreviewBufferLock);
                     mPreviewBuffers = (int *) desc->mBuffers;
                     mPreviewBuffersLength = desc->mLength;
-                    mPreviewBuffersAvailable.clear();
-                    for ( uint32_t i = 0 ; i < desc->mMaxQueueable ; i++ )
-                        {
-                        mPreviewBuffersAvailable.add(mPreviewBuffers[i], 0);
-                        }
-                    // initial ref count for undeqeueued buffers is 1 since buffer provider
-                    // is still holding on to it
-                    for ( uint32_t i = desc->mMaxQueueable ; i < desc->mCount ; i++ )
-                        {
-                        mPreviewBuffersAvailable.add(mPreviewBuffers[i], 1);
-                        }
+                    ret = mPreviewFrames.init(mPreviewBuffers, desc->mCount, desc->mMaxQueueable);
                     }
 
                 if ( NULL != desc )
@@ -405,20 +386,9 @@ status_t BaseCameraAdapter::sendCommand(CameraCommands operation, int value1, in
 
                     if ( ret == NO_ERROR )
                         {
-                        Mutex::Autolock lock(mPreviewDataBufferLock);
                         mPreviewDataBuffers = (int *) desc->mBuffers;
                         mPreviewDataBuffersLength = desc->mLength;
-                        mPreviewDataBuffersAvailable.clear();
-                        for ( uint32_t i = 0 ; i < desc->mMaxQueueable ; i++ )
-                            {
-                            mPreviewDataBuffersAvailable.add(mPreviewDataBuffers[i], 0);
-                            }
-                        // initial ref count for undeqeueued buffers is 1 since buffer provider
-                        // is still holding on to it
-                        for ( uint32_t i = desc->mMaxQueueable ; i < desc->mCount ; i++ )
-                            {
-                            mPreviewDataBuffersAvailable.add(mPreviewDataBuffers[i], 1);
-                            }
+                        ret = mPreviewDataFrames.init(mPreviewDataBuffers, desc->mCount, desc->mMaxQueueable);
                         }
 
                     if ( NULL != desc )
@@ -458,20 +428,9 @@ status_t BaseCameraAdapter::sendCommand(CameraCommands operation, int value1, in
 
                 if ( ret == NO_ERROR )
                     {
-                    Mutex::Autolock lock(mCaptureBufferLock);
                     mCaptureBuffers = (int *) desc->mBuffers;
                     mCaptureBuffersLength = desc->mLength;
-                    mCaptureBuffersAvailable.clear();
-                    for ( uint32_t i = 0 ; i < desc->mMaxQueueable ; i++ )
-                        {
-                        mCaptureBuffersAvailable.add(mCaptureBuffers[i], 0);
-                        }
-                    // initial ref count for undeqeueued buffers is 1 since buffer provider
-                    // is still holding on to it
-                    for ( uint32_t i = desc->mMaxQueueable ; i < desc->mCount ; i++ )
-                        {
-                        mCaptureBuffersAvailable.add(mCaptureBuffers[i], 1);
-                        }
+                    ret = mCaptureFrames.init(mCaptureBuffers, desc->mCount, desc->mMaxQueueable);
                     }
 
                 if ( NULL != desc )
@@ -1174,10 +1133,36 @@ status_t BaseCameraAdapter::notifyFaceSubscribers(sp<CameraFDResult> &faces)
     return ret;
 }
 
+FrameDescriptorTable* BaseCameraAdapter::getFrameTable(CameraFrame::FrameType frameType,
+                                                      FrameDescriptorTable::RefSlot &slot)
+{
+    slot = FrameDescriptorTable::REF_FRAME;
+
+    switch ( frameType )
+        {
+        case CameraFrame::IMAGE_FRAME:
+        case CameraFrame::RAW_FRAME:
+            return &mCaptureFrames;
+        case CameraFrame::PREVIEW_FRAME_SYNC:
+        case CameraFrame::SNAPSHOT_FRAME:
+            return &mPreviewFrames;
+        case CameraFrame::FRAME_DATA_SYNC:
+            return &mPreviewDataFrames;
+        case CameraFrame::VIDEO_FRAME_SYNC:
+            slot = FrameDescriptorTable::REF_VIDEO;
+            return &mPreviewFrames;
+        default:
+            return NULL;
+        };
+}
+
 status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
 {
     status_t ret = NO_ERROR;
     unsigned int mask;
+    FrameDescriptorTable *table, *lastTable = NULL;
+    FrameDescriptorTable::Descriptor *desc = NULL;
+    FrameDescriptorTable::RefSlot slot;
 
     if ( NULL == frame )
         {
@@ -1185,8 +1170,17 @@ status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
         return -EINVAL;
         }
 
-    for( mask = 1; mask < CameraFrame::ALL_FRAMES; mask <<= 1){
-      if( mask & frame->mFrameMask ){
+    //Visit only the bits that are set. Frame types sharing a buffer table
+    //(preview, snapshot and video) reuse the descriptor found for the first one.
+    while ( 0 != ( frame->mFrameMask & CameraFrame::ALL_FRAMES ) ) {
+        mask = 1 << __builtin_ctz(frame->mFrameMask);
+
+        table = getFrameTable(( CameraFrame::FrameType ) mask, slot);
+        if ( table != lastTable ) {
+            desc = ( NULL != table ) ? table->find(frame->mBuffer, frame->mIndex) : NULL;
+            lastTable = table;
+        }
+
         switch( mask ){
 
         case CameraFrame::IMAGE_FRAME:
@@ -1194,32 +1188,32 @@ status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
 #if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
             CameraHal::PPM("Shot to Jpeg: ", &mStartCapture);
 #endif
-            ret = __sendFrameToSubscribers(frame, &mImageSubscribers, CameraFrame::IMAGE_FRAME);
+            ret = __sendFrameToSubscribers(frame, &mImageSubscribers, CameraFrame::IMAGE_FRAME, desc);
           }
           break;
         case CameraFrame::RAW_FRAME:
           {
-            ret = __sendFrameToSubscribers(frame, &mRawSubscribers, CameraFrame::RAW_FRAME);
+            ret = __sendFrameToSubscribers(frame, &mRawSubscribers, CameraFrame::RAW_FRAME, desc);
           }
           break;
         case CameraFrame::PREVIEW_FRAME_SYNC:
           {
-            ret = __sendFrameToSubscribers(frame, &mFrameSubscribers, CameraFrame::PREVIEW_FRAME_SYNC);
+            ret = __sendFrameToSubscribers(frame, &mFrameSubscribers, CameraFrame::PREVIEW_FRAME_SYNC, desc);
           }
           break;
         case CameraFrame::SNAPSHOT_FRAME:
           {
-            ret = __sendFrameToSubscribers(frame, &mFrameSubscribers, CameraFrame::SNAPSHOT_FRAME);
+            ret = __sendFrameToSubscribers(frame, &mFrameSubscribers, CameraFrame::SNAPSHOT_FRAME, desc);
           }
           break;
         case CameraFrame::VIDEO_FRAME_SYNC:
           {
-            ret = __sendFrameToSubscribers(frame, &mVideoSubscribers, CameraFrame::VIDEO_FRAME_SYNC);
+            ret = __sendFrameToSubscribers(frame, &mVideoSubscribers, CameraFrame::VIDEO_FRAME_SYNC, desc);
           }
           break;
         case CameraFrame::FRAME_DATA_SYNC:
           {
-            ret = __sendFrameToSubscribers(frame, &mFrameDataSubscribers, CameraFrame::FRAME_DATA_SYNC);
+            ret = __sendFrameToSubscribers(frame, &mFrameDataSubscribers, CameraFrame::FRAME_DATA_SYNC, desc);
           }
           break;
         default:
@@ -1231,8 +1225,7 @@ status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
         if (ret != NO_ERROR) {
             goto EXIT;
         }
-      }//IF
-    }//FOR
+    }//WHILE
 
  EXIT:
     return ret;
@@ -1240,14 +1233,14 @@ status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
 
 status_t BaseCameraAdapter::__sendFrameToSubscribers(CameraFrame* frame,
                                                      KeyedVector<int, frame_callback> *subscribers,
-                                                     CameraFrame::FrameType frameType)
+                                                     CameraFrame::FrameType frameType,
+                                                     FrameDescriptorTable::Descriptor *desc)
 {
     size_t refCount = 0;
     status_t ret = NO_ERROR;
     frame_callback callback = NULL;
+    FrameDescriptorTable::RefSlot slot;
 
-   
-    
     if(frame == NULL)
     {
       ALOGE(" BaseCameraAdapter::__sendFrameToSubscribers :: frame is NULL");
@@ -1271,7 +1264,10 @@ status_t BaseCameraAdapter::__sendFrameToSubscribers(CameraFrame* frame,
       }
 
     if (NULL != subscribers) {
-        refCount = getFrameRefCount(frame->mBuffer, frameType);
+        if (NULL != desc) {
+            getFrameTable(frameType, slot);
+            refCount = FrameDescriptorTable::getRef(desc, slot);
+        }
 
         if (refCount == 0) {
             CAMHAL_LOGDA("Invalid ref count of 0");
@@ -1311,6 +1307,10 @@ int BaseCameraAdapter::setInitFrameRefCount(void* buf, unsigned int mask)
 {
   int ret = NO_ERROR;
   unsigned int lmask;
+  int refCount;
+  FrameDescriptorTable *table;
+  FrameDescriptorTable::Descriptor *desc = NULL;
+  FrameDescriptorTable::RefSlot slot;
 
   LOG_FUNCTION_NAME;
 
@@ -1319,47 +1319,42 @@ int BaseCameraAdapter::setInitFrameRefCount(void* buf, unsigned int mask)
       return -EINVAL;
     }
 
-  for( lmask = 1; lmask < CameraFrame::ALL_FRAMES; lmask <<= 1){
-    if( lmask & mask ){
-      switch( lmask ){
+  mask &= CameraFrame::ALL_FRAMES;
+  while ( 0 != mask ) {
+    lmask = 1 << __builtin_ctz(mask);
+    mask &= ~lmask;
+
+    switch( lmask ){
+
+    case CameraFrame::IMAGE_FRAME:
+      refCount = mImageSubscribers.size();
+      break;
+    case CameraFrame::RAW_FRAME:
+      refCount = mRawSubscribers.size();
+      break;
+    case CameraFrame::PREVIEW_FRAME_SYNC:
+    case CameraFrame::SNAPSHOT_FRAME:
+      refCount = mFrameSubscribers.size();
+      break;
+    case CameraFrame::VIDEO_FRAME_SYNC:
+      refCount = mVideoSubscribers.size();
+      break;
+    case CameraFrame::FRAME_DATA_SYNC:
+      refCount = mFrameDataSubscribers.size();
+      break;
+    default:
+      CAMHAL_LOGEB("FRAMETYPE NOT SUPPORTED 0x%x", lmask);
+      continue;
+    }//SWITCH
+
+    table = getFrameTable(( CameraFrame::FrameType ) lmask, slot);
+    desc = table->findOrAdd(buf, slot, refCount);
+
+    if ( NULL == desc ) {
+      ret = -ENOMEM;
+    }
+  }//WHILE
 
-      case CameraFrame::IMAGE_FRAME:
-        {
-          setFrameRefCount(buf, CameraFrame::IMAGE_FRAME, (int) mImageSubscribers.size());
-        }
-        break;
-      case CameraFrame::RAW_FRAME:
-        {
-          setFrameRefCount(buf, CameraFrame::RAW_FRAME, mRawSubscribers.size());
-        }
-        break;
-      case CameraFrame::PREVIEW_FRAME_SYNC:
-        {
-          setFrameRefCount(buf, CameraFrame::PREVIEW_FRAME_SYNC, mFrameSubscribers.size());
-        }
-        break;
-      case CameraFrame::SNAPSHOT_FRAME:
-        {
-          setFrameRefCount(buf, CameraFrame::SNAPSHOT_FRAME, mFrameSubscribers.size());
-        }
-        break;
-      case CameraFrame::VIDEO_FRAME_SYNC:
-        {
-          setFrameRefCount(buf,CameraFrame::VIDEO_FRAME_SYNC, mVideoSubscribers.size());
-        }
-        break;
-      case CameraFrame::FRAME_DATA_SYNC:
-        {
-          setFrameRefCount(buf, CameraFrame::FRAME_DATA_SYNC, mFrameDataSubscribers.size());
-        }
-        break;
-      default:
-        CAMHAL_LOGEB("FRAMETYPE NOT SUPPORTED 0x%x", lmask);
-        break;
-      }//SWITCH
-      mask &= ~lmask;
-    }//IF
-  }//FOR
   LOG_FUNCTION_NAME_EXIT;
   return ret;
 }
@@ -1367,40 +1362,22 @@ int BaseCameraAdapter::setInitFrameRefCount(void* buf, unsigned int mask)
 int BaseCameraAdapter::getFrameRefCount(void* frameBuf, CameraFrame::FrameType frameType)
 {
     int res = -1;
+    FrameDescriptorTable *table;
+    FrameDescriptorTable::Descriptor *desc = NULL;
+    FrameDescriptorTable::RefSlot slot;
 
     LOG_FUNCTION_NAME;
 
-    switch ( frameType )
+    table = getFrameTable(frameType, slot);
+    if ( NULL != table )
         {
-        case CameraFrame::IMAGE_FRAME:
-        case CameraFrame::RAW_FRAME:
-                {
-                Mutex::Autolock lock(mCaptureBufferLock);
-                res = mCaptureBuffersAvailable.valueFor( ( unsigned int ) frameBuf );
-                }
-            break;
-        case CameraFrame::PREVIEW_FRAME_SYNC:
-        case CameraFrame::SNAPSHOT_FRAME:
-                {
-                Mutex::Autolock lock(mPreviewBufferLock);
-                res = mPreviewBuffersAvailable.valueFor( ( unsigned int ) frameBuf );
-                }
-            break;
-        case CameraFrame::FRAME_DATA_SYNC:
-                {
-                Mutex::Autolock lock(mPreviewDataBufferLock);
-                res = mPreviewDataBuffersAvailable.valueFor( ( unsigned int ) frameBuf );
-                }
-            break;
-        case CameraFrame::VIDEO_FRAME_SYNC:
-                {
-                Mutex::Autolock lock(mVideoBufferLock);
-                res = mVideoBuffersAvailable.valueFor( ( unsigned int ) frameBuf );
-                }
-            break;
-        default:
-            break;
-        };
+        desc = table->find(frameBuf);
+        }
+
+    if ( NULL != desc )
+        {
+        res = FrameDescriptorTable::getRef(desc, slot);
+        }
 
     LOG_FUNCTION_NAME_EXIT;
 
@@ -1409,40 +1386,17 @@ int BaseCameraAdapter::getFrameRefCount(void* frameBuf, CameraFrame::FrameType f
 
 void BaseCameraAdapter::setFrameRefCount(void* frameBuf, CameraFrame::FrameType frameType, int refCount)
 {
+    FrameDescriptorTable *table;
+    FrameDescriptorTable::Descriptor *desc = NULL;
+    FrameDescriptorTable::RefSlot slot;
 
     LOG_FUNCTION_NAME;
 
-    switch ( frameType )
+    table = getFrameTable(frameType, slot);
+    if ( NULL != table )
         {
-        case CameraFrame::IMAGE_FRAME:
-        case CameraFrame::RAW_FRAME:
-                {
-                Mutex::Autolock lock(mCaptureBufferLock);
-                mCaptureBuffersAvailable.replaceValueFor(  ( unsigned int ) frameBuf, refCount);
-                }
-            break;
-        case CameraFrame::PREVIEW_FRAME_SYNC:
-        case CameraFrame::SNAPSHOT_FRAME:
-                {
-                Mutex::Autolock lock(mPreviewBufferLock);
-                mPreviewBuffersAvailable.replaceValueFor(  ( unsigned int ) frameBuf, refCount);
-                }
-            break;
-        case CameraFrame::FRAME_DATA_SYNC:
-                {
-                Mutex::Autolock lock(mPreviewDataBufferLock);
-                mPreviewDataBuffersAvailable.replaceValueFor(  ( unsigned int ) frameBuf, refCount);
-                }
-            break;
-        case CameraFrame::VIDEO_FRAME_SYNC:
-                {
-                Mutex::Autolock lock(mVideoBufferLock);
-                mVideoBuffersAvailable.replaceValueFor(  ( unsigned int ) frameBuf, refCount);
-                }
-            break;
-        default:
-            break;
-        };
+        table->findOrAdd(frameBuf, slot, refCount);
+        }
 
     LOG_FUNCTION_NAME_EXIT;
 
@@ -1466,9 +1420,9 @@ status_t BaseCameraAdapter::startVideoCapture()
     if ( NO_ERROR == ret )
         {
 
-        for ( unsigned int i = 0 ; i < mPreviewBuffersAvailable.size() ; i++ )
+        for ( uint32_t i = 0 ; i < mPreviewFrames.size() ; i++ )
             {
-            mVideoBuffersAvailable.add(mPreviewBuffersAvailable.keyAt(i), 0);
+            FrameDescriptorTable::setRef(mPreviewFrames.at(i), FrameDescriptorTable::REF_VIDEO, 0);
             }
 
         mRecording = true;
@@ -1492,17 +1446,16 @@ status_t BaseCameraAdapter::stopVideoCapture()
 
     if ( NO_ERROR == ret )
         {
-        for ( unsigned int i = 0 ; i < mVideoBuffersAvailable.size() ; i++ )
+        for ( uint32_t i = 0 ; i < mPreviewFrames.size() ; i++ )
             {
-            void *frameBuf = ( void * ) mVideoBuffersAvailable.keyAt(i);
-            if( getFrameRefCount(frameBuf,  CameraFrame::VIDEO_FRAME_SYNC) > 0)
+            FrameDescriptorTable::Descriptor *desc = mPreviewFrames.at(i);
+            if( FrameDescriptorTable::getRef(desc, FrameDescriptorTable::REF_VIDEO) > 0)
                 {
-                returnFrame(frameBuf, CameraFrame::VIDEO_FRAME_SYNC);
+                returnFrame(( void * ) desc->mBuffer, CameraFrame::VIDEO_FRAME_SYNC);
                 }
+            FrameDescriptorTable::setRef(desc, FrameDescriptorTable::REF_VIDEO, 0);
             }
 
-        mVideoBuffersAvailable.clear();
-
         mRecording = false;
         }
 
@@ -711,7 +711,10 @@ void CameraHal::previewThread()
     int err;
     int flg_AF = 0;
     int flg_CAF = 0;
-    struct pollfd pfd[2];
+    int frameIndex[PREVIEW_FRAMES_PER_WAKEUP];
+    char *frameBuf[PREVIEW_FRAMES_PER_WAKEUP];
+    int frameCount;
+    bool recording;
 
     LOG_FUNCTION_NAME
 
@@ -721,21 +724,29 @@ void CameraHal::previewThread()
 
         if( mPreviewRunning )
         {
-             pfd[0].fd = previewThreadCommandQ.getInFd();
-             pfd[0].events = POLLIN;
-             //pfd[1].fd = camera_device;
-             //pfd[1].events = POLLIN;
-
-             poll(pfd, 1, 20);
-
-             if (pfd[0].revents & POLLIN) {
+             //Sleep until the camera has frames or a command arrives, whichever
+             //comes first, and take every frame that is ready in one go
+             frameCount = mCameraAdapter->GetFrames(previewThreadCommandQ.getInFd(),
+                                                    PREVIEW_WAIT_TIMEOUT,
+                                                    frameIndex,
+                                                    frameBuf,
+                                                    PREVIEW_FRAMES_PER_WAKEUP);
+
+             if ( !previewThreadCommandQ.isEmpty() ) {
                  previewThreadCommandQ.get(&msg);
                  has_message = true;
              }
 
-             if(mPreviewRunning)
+             if ( mPreviewRunning && ( 0 < frameCount ) )
              {
-                  nextPreview();
+                  mRecordingLock.lock();
+                  recording = mRecordingEnabled;
+                  mRecordingLock.unlock();
+
+                  for ( int i = 0 ; i < frameCount ; i++ )
+                  {
+                      nextPreview(frameIndex[i], frameBuf[i], recording);
+                  }
              }
 
 #ifdef FW3A
@@ -1973,7 +1984,7 @@ int CameraHal::dequeueFromOverlay()
 return 0;
 } 
 
-void CameraHal::nextPreview()
+void CameraHal::nextPreview(int index, char *fp, bool recording)
 {
     static int frame_count = 0;
     int zoom_inc, err;
@@ -2061,14 +2072,9 @@ void CameraHal::nextPreview()
     }
 #endif
 
-    int index = 0;
-    char *fp = mCameraAdapter->GetFrame(index);
-
-    mRecordingLock.lock();
-
     mCameraAdapter->queueToGralloc(index,fp, CameraFrame::PREVIEW_FRAME_SYNC);
 
-    if(mRecordingEnabled)
+    if(recording)
     {
     mCameraAdapter->queueToGralloc(index,fp, CameraFrame::VIDEO_FRAME_SYNC);
     }
@@ -2083,8 +2089,6 @@ void CameraHal::nextPreview()
         mCameraAdapter->queueToCamera(index);*/
 
 exit:
-    mRecordingLock.unlock();
-
     if (UNLIKELY(mDebugFps)) {
         debugShowFPS();
     }
@@ -37,6 +37,8 @@
 #include <stdio.h>
 #include <errno.h>
 #include <math.h>
+#include <setjmp.h>
+#include <cutils/atomic.h>
 
 extern "C" {
     #include "jpeglib.h"
@@ -45,6 +47,12 @@ extern "C" {
 
 #define ARRAY_SIZE(array) (sizeof((array)) / sizeof((array)[0]))
 
+#define STRIPES_PER_THREAD 2
+// below this the thread setup costs more than it saves
+#define STRIPE_MIN_PIXELS (1024 * 1024)
+// largest APP1 payload, the marker length field is 16 bits and counts itself
+#define MAX_EXIF_SIZE (0xFFFF - 2)
+
 namespace android {
 struct string_pair {
     const char* string1;
@@ -58,6 +66,21 @@ static string_pair degress_to_exif_lut [] = {
     {"180", "3"},
     {"270", "8"},
 };
+// Returns to encodeRows on a libjpeg error, jpeg_std_error would exit()
+// the process, e.g. when a stripe buffer cannot grow
+struct libjpeg_error_mgr : jpeg_error_mgr {
+    jmp_buf env;
+};
+
+static void libjpeg_error_exit(j_common_ptr cinfo) {
+    libjpeg_error_mgr* err = (libjpeg_error_mgr*)cinfo->err;
+    char msg[JMSG_LENGTH_MAX];
+
+    err->format_message(cinfo, msg);
+    CAMHAL_LOGEB("Encoder: libjpeg error: %s", msg);
+    longjmp(err->env, 1);
+}
+
 struct libjpeg_destination_mgr : jpeg_destination_mgr {
     libjpeg_destination_mgr(uint8_t* input, int size);
 
@@ -98,78 +121,257 @@ libjpeg_destination_mgr::libjpeg_destination_mgr(uint8_t* input, int size) {
     jpegsize = 0;
 }
 
+// Grows on demand, used for the per stripe bitstreams whose
+// size is not known up front
+struct libjpeg_stripe_destination_mgr : jpeg_destination_mgr {
+    libjpeg_stripe_destination_mgr(size_t size);
+    ~libjpeg_stripe_destination_mgr();
+
+    uint8_t* buf;
+    size_t bufsize;
+    size_t jpegsize;
+};
+
+static void libjpeg_stripe_init_destination (j_compress_ptr cinfo) {
+    libjpeg_stripe_destination_mgr* dest = (libjpeg_stripe_destination_mgr*)cinfo->dest;
+
+    dest->next_output_byte = dest->buf;
+    dest->free_in_buffer = dest->buf ? dest->bufsize : 0;
+    dest->jpegsize = 0;
+}
+
+static boolean libjpeg_stripe_empty_output_buffer(j_compress_ptr cinfo) {
+    libjpeg_stripe_destination_mgr* dest = (libjpeg_stripe_destination_mgr*)cinfo->dest;
+    size_t used = dest->bufsize - dest->free_in_buffer;
+    uint8_t* grown = (uint8_t*) realloc(dest->buf, dest->bufsize * 2);
+
+    if (!grown) {
+        ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
+    }
+
+    dest->buf = grown;
+    dest->next_output_byte = dest->buf + used;
+    dest->free_in_buffer = dest->bufsize * 2 - used;
+    dest->bufsize *= 2;
+    return TRUE;
+}
+
+static void libjpeg_stripe_term_destination (j_compress_ptr cinfo) {
+    libjpeg_stripe_destination_mgr* dest = (libjpeg_stripe_destination_mgr*)cinfo->dest;
+    dest->jpegsize = dest->bufsize - dest->free_in_buffer;
+}
+
+libjpeg_stripe_destination_mgr::libjpeg_stripe_destination_mgr(size_t size) {
+    this->init_destination = libjpeg_stripe_init_destination;
+    this->empty_output_buffer = libjpeg_stripe_empty_output_buffer;
+    this->term_destination = libjpeg_stripe_term_destination;
+
+    // headers alone need a few hundred bytes
+    this->bufsize = (size < 4096) ? 4096 : size;
+    this->buf = (uint8_t*) malloc(this->bufsize);
+
+    jpegsize = 0;
+}
+
+libjpeg_stripe_destination_mgr::~libjpeg_stripe_destination_mgr() {
+    if (buf) free(buf);
+}
+
+/* Returns offset of the first byte after the SOS header, 0 if not found.
+ * If frame_height is set, the SOF height field is patched on the way. */
+static size_t jpeg_find_scan_data(uint8_t* jpeg, size_t size, int frame_height) {
+    size_t pos = 2; // skip SOI
+
+    while (pos + 4 <= size) {
+        uint8_t marker;
+        size_t len;
+
+        if (jpeg[pos] != 0xFF) {
+            return 0;
+        }
+
+        marker = jpeg[pos + 1];
+        len = (jpeg[pos + 2] << 8) | jpeg[pos + 3];
+
+        if ((marker == M_SOF0) && frame_height && (pos + 7 <= size)) {
+            jpeg[pos + 5] = (frame_height >> 8) & 0xFF;
+            jpeg[pos + 6] = frame_height & 0xFF;
+        }
+
+        pos += 2 + len;
+
+        if (marker == M_SOS) {
+            return (pos <= size) ? pos : 0;
+        }
+    }
+
+    return 0;
+}
+
+/* Concatenates the entropy coded data of each stripe, separated by RSTn
+ * markers, behind the headers of the first stripe. Every stripe except the
+ * last spans exactly one restart interval, so the result is identical to
+ * a single pass encode with the same restart interval. */
+static size_t join_stripes(uint8_t* dst, size_t dst_size, int height,
+                           Encoder_libjpeg::stripe* stripes, int num_stripes) {
+    size_t pos = 0;
+
+    for (int i = 0; i < num_stripes; i++) {
+        uint8_t* jpeg = stripes[i].buf;
+        size_t size = stripes[i].size;
+        size_t data = 0;
+
+        if (!stripes[i].done || (size < 4) ||
+            (jpeg[size - 2] != 0xFF) || (jpeg[size - 1] != M_EOI)) {
+            CAMHAL_LOGEB("Encoder: stripe %d is incomplete", i);
+            return 0;
+        }
+
+        data = jpeg_find_scan_data(jpeg, size, (i == 0) ? height : 0);
+        if (!data) {
+            CAMHAL_LOGEB("Encoder: no scan found in stripe %d", i);
+            return 0;
+        }
+
+        // headers are only taken from the first stripe
+        if (i == 0) {
+            data = 0;
+        }
+
+        if (pos + (size - 2 - data) + 2 > dst_size) {
+            CAMHAL_LOGEA("Encoder: output buffer too small for striped jpeg");
+            return 0;
+        }
+
+        memcpy(dst + pos, jpeg + data, size - 2 - data);
+        pos += size - 2 - data;
+
+        dst[pos++] = 0xFF;
+        dst[pos++] = (i == num_stripes - 1) ? M_EOI : (0xD0 + (i & 7));
+    }
+
+    return pos;
+}
+
 /* private static functions */
-static void nv21_to_yuv(uint8_t* dst, uint8_t* y, uint8_t* uv, int width) {
-    if (!dst || !y || !uv) {
-        return;
+// Component rows handed to jpeg_write_raw_data for one MCU row. Luma rows
+// point straight into the source buffer whenever its layout allows it.
+struct raw_planes {
+    JSAMPROW y[2 * DCTSIZE];
+    JSAMPROW cb[DCTSIZE];
+    JSAMPROW cr[DCTSIZE];
+    JSAMPARRAY planes[3];
+    uint8_t* buf;       // backing store for the rows that are converted
+    int luma_width;     // row widths padded to whole DCT blocks
+    int chroma_width;
+    bool direct_luma;
+};
+
+typedef void (*fill_mcu_row_t)(raw_planes* p, uint8_t* src, int width, int height, int first_row);
+
+struct yuv_format {
+    const char* name;
+    int bpp;            // bytes per pixel of the luma plane, or packed pixels
+    int v_samp;         // luma rows per chroma row
+    fill_mcu_row_t fill;
+};
+
+static inline int clamp_row(int row, int rows) {
+    return (row < rows) ? row : rows - 1;
+}
+
+// replicate the last sample into the padding of a row, this also covers
+// the chroma column the source lacks when the width is odd
+static inline void pad_row(uint8_t* row, int width, int padded_width) {
+    if (padded_width > width) {
+        memset(row + width, row[width - 1], padded_width - width);
+    }
+}
+
+static void nv21_fill_mcu_row(raw_planes* p, uint8_t* src, int width, int height, int first_row) {
+    uint8_t* uv_plane = src + width * height;
+    // the source holds whole chroma rows and pairs only, an odd last
+    // luma row or column reuses the chroma before it
+    int chroma_height = height / 2;
+    int chroma_width = width / 2;
+    uint8_t* y_buf = p->buf;
+    uint8_t* c_buf = p->buf + 2 * DCTSIZE * p->luma_width;
+
+    for (int r = 0; r < 2 * DCTSIZE; r++) {
+        uint8_t* y = src + clamp_row(first_row + r, height) * width;
+
+        if (p->direct_luma) {
+            p->y[r] = y;
+        } else {
+            p->y[r] = y_buf + r * p->luma_width;
+            memcpy(p->y[r], y, width);
+            pad_row(p->y[r], width, p->luma_width);
+        }
     }
 
-    while ((width--) >= 0) {
-        uint8_t y0 = y[0];
-        uint8_t v0 = uv[0];
-        uint8_t u0 = *(uv+1);
-        dst[0] = y0;
-        dst[1] = u0;
-        dst[2] = v0;
-        dst += 3;
-        y++;
-        if(!(width % 2)) uv+=2;
+    for (int r = 0; r < DCTSIZE; r++) {
+        uint8_t* uv = uv_plane + clamp_row(first_row / 2 + r, chroma_height) * width;
+        uint8_t* cb = c_buf + (2 * r) * p->chroma_width;
+        uint8_t* cr = c_buf + (2 * r + 1) * p->chroma_width;
+
+        for (int i = 0; i < chroma_width; i++) {
+            cr[i] = uv[2 * i];
+            cb[i] = uv[2 * i + 1];
+        }
+        pad_row(cb, chroma_width, p->chroma_width);
+        pad_row(cr, chroma_width, p->chroma_width);
+
+        p->cb[r] = cb;
+        p->cr[r] = cr;
     }
 }
 
-static void uyvy_to_yuv(uint8_t* dst, uint32_t* src, int width) {
-    if (!dst || !src) {
-        return;
+static void uyvy_fill_mcu_row(raw_planes* p, uint8_t* src, int width, int height, int first_row) {
+    int chroma_width = width / 2;
+    uint8_t* y_buf = p->buf;
+    uint8_t* c_buf = p->buf + 2 * DCTSIZE * p->luma_width;
+
+    for (int r = 0; r < DCTSIZE; r++) {
+        uint8_t* uyvy = src + clamp_row(first_row + r, height) * width * 2;
+        uint8_t* y = y_buf + r * p->luma_width;
+        uint8_t* cb = c_buf + (2 * r) * p->chroma_width;
+        uint8_t* cr = c_buf + (2 * r + 1) * p->chroma_width;
+
+        for (int i = 0; i < chroma_width; i++) {
+            cb[i] = uyvy[0];
+            y[2 * i] = uyvy[1];
+            cr[i] = uyvy[2];
+            y[2 * i + 1] = uyvy[3];
+            uyvy += 4;
+        }
+        if (width % 2) {
+            // an odd row ends on a lone UY pair
+            y[width - 1] = uyvy[1];
+        }
+        pad_row(y, width, p->luma_width);
+        pad_row(cb, chroma_width, p->chroma_width);
+        pad_row(cr, chroma_width, p->chroma_width);
+
+        p->y[r] = y;
+        p->cb[r] = cb;
+        p->cr[r] = cr;
     }
+}
+
+static const yuv_format yuv_formats[] = {
+    // 4:2:0, luma plane followed by interleaved CrCb
+    { CameraParameters::PIXEL_FORMAT_YUV420SP, 1, 2, nv21_fill_mcu_row },
+    // 4:2:2, packed UYVY
+    { CameraParameters::PIXEL_FORMAT_YUV422I, 2, 1, uyvy_fill_mcu_row },
+};
 
-    if (width % 2) {
-        return; // not supporting odd widths
-    }
-
-    // currently, neon routine only supports multiple of 16 width
-    if (width % 16) {
-        while ((width-=2) >= 0) {
-            uint8_t u0 = (src[0] >> 0) & 0xFF;
-            uint8_t y0 = (src[0] >> 8) & 0xFF;
-            uint8_t v0 = (src[0] >> 16) & 0xFF;
-            uint8_t y1 = (src[0] >> 24) & 0xFF;
-            dst[0] = y0;
-            dst[1] = u0;
-            dst[2] = v0;
-            dst[3] = y1;
-            dst[4] = u0;
-            dst[5] = v0;
-            dst += 6;
-            src++;
+static const yuv_format* find_yuv_format(const char* name) {
+    for (unsigned int i = 0; i < ARRAY_SIZE(yuv_formats); i++) {
+        if (!strcmp(name, yuv_formats[i].name)) {
+            return &yuv_formats[i];
         }
-    } else {
-        int n = width;
-        asm volatile (
-        "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
-        "   cmp %[n], #16                                               \n\t"
-        "   blt 5f                                                      \n\t"
-        "0: @ 16 pixel swap                                             \n\t"
-        "   vld2.8  {q0, q1} , [%[src]]! @ q0 = uv q1 = y               \n\t"
-        "   vuzp.8 q0, q2                @ d1 = u d5 = v                \n\t"
-        "   vmov d1, d0                  @ q0 = u0u1u2..u0u1u2...       \n\t"
-        "   vmov d5, d4                  @ q2 = v0v1v2..v0v1v2...       \n\t"
-        "   vzip.8 d0, d1                @ q0 = u0u0u1u1u2u2...         \n\t"
-        "   vzip.8 d4, d5                @ q2 = v0v0v1v1v2v2...         \n\t"
-        "   vswp q0, q1                  @ now q0 = y q1 = u q2 = v     \n\t"
-        "   vst3.8  {d0,d2,d4},[%[dst]]!                                \n\t"
-        "   vst3.8  {d1,d3,d5},[%[dst]]!                                \n\t"
-        "   sub %[n], %[n], #16                                         \n\t"
-        "   cmp %[n], #16                                               \n\t"
-        "   bge 0b                                                      \n\t"
-        "5: @ end                                                       \n\t"
-#ifdef NEEDS_ARM_ERRATA_754319_754320
-        "   vmov s0,s0  @ add noop for errata item                      \n\t"
-#endif
-        : [dst] "+r" (dst), [src] "+r" (src), [n] "+r" (n)
-        : [src_stride] "r" (width)
-        : "cc", "memory", "q0", "q1", "q2"
-        );
     }
+    return NULL;
 }
 
 static void resize_nv12(Encoder_libjpeg::params* params, uint8_t* dst_buffer) {
@@ -198,6 +400,8 @@ static void resize_nv12(Encoder_libjpeg::params* params, uint8_t* dst_buffer) {
     VT_resizeFrame_Video_opt2_lp(&i_img_ptr, &o_img_ptr, NULL, 0);
 }
 
+Mutex ExifElementsTable::sJheadLock;
+
 /* public static functions */
 const char* ExifElementsTable::degreesToExifOrientation(const char* degrees) {
     for (unsigned int i = 0; i < ARRAY_SIZE(degress_to_exif_lut); i++) {
@@ -260,33 +464,56 @@ bool ExifElementsTable::isAsciiTag(const char* tag) {
     return (strcmp(tag, TAG_GPS_PROCESSING_METHOD) == 0);
 }
 
-void ExifElementsTable::insertExifToJpeg(unsigned char* jpeg, size_t jpeg_size) {
-    ReadMode_t read_mode = (ReadMode_t)(READ_METADATA | READ_IMAGE);
+status_t ExifElementsTable::createExifSection(const char* thumb, int thumb_len) {
+    Mutex::Autolock lock(sJheadLock);
+    Section_t* exif_section = NULL;
+    status_t ret = NO_ERROR;
 
+    // build the section on its own, there is no jpeg to parse
     ResetJpgfile();
-    if (ReadJpegSectionsFromBuffer(jpeg, jpeg_size, read_mode)) {
-        jpeg_opened = true;
-        create_EXIF(table, exif_tag_count, gps_tag_count);
-    }
-}
+    create_EXIF(table, exif_tag_count, gps_tag_count);
 
-status_t ExifElementsTable::insertExifThumbnailImage(const char* thumb, int len) {
-    status_t ret = NO_ERROR;
+    if (thumb && (thumb_len > 0)) {
+        if (!ReplaceThumbnailFromBuffer(thumb, thumb_len)) {
+            CAMHAL_LOGEB("createExifSection. ReplaceThumbnail() failed, len=%d", thumb_len);
+        }
+    }
 
-    if ((len > 0) && jpeg_opened) {
-        ret = ReplaceThumbnailFromBuffer(thumb, len);
-        CAMHAL_LOGDB("insertExifThumbnailImage. ReplaceThumbnail(). ret=%d", ret);
+    exif_section = FindSection(M_EXIF);
+    if (exif_section && (exif_section->Size > MAX_EXIF_SIZE + 2) && thumb) {
+        // the thumbnail doesn't fit in one APP1 segment, keep the tags without it
+        CAMHAL_LOGEB("createExifSection. thumbnail too large, len=%d", thumb_len);
+        DiscardData();
+        ResetJpgfile();
+        create_EXIF(table, exif_tag_count, gps_tag_count);
+        exif_section = FindSection(M_EXIF);
     }
+    if (exif_section && (exif_section->Size > 2)) {
+        if (exif_data) {
+            free(exif_data);
+        }
+        exif_size = exif_section->Size - 2;
+        exif_data = (unsigned char*) malloc(exif_size);
+        if (exif_data) {
+            memcpy(exif_data, exif_section->Data + 2, exif_size);
+        } else {
+            exif_size = 0;
+            ret = NO_MEMORY;
+        }
+    } else {
+        ret = NO_INIT;
+    }
+
+    DiscardData();
 
     return ret;
 }
 
-void ExifElementsTable::saveJpeg(unsigned char* jpeg, size_t jpeg_size) {
-    if (jpeg_opened) {
-       WriteJpegToBuffer(jpeg, jpeg_size);
-       DiscardData();
-       jpeg_opened = false;
+const unsigned char* ExifElementsTable::getExifSection(size_t* size) const {
+    if (size) {
+        *size = exif_size;
     }
+    return exif_data;
 }
 
 /* public functions */
@@ -299,8 +526,8 @@ ExifElementsTable::~ExifElementsTable() {
         }
     }
 
-    if (jpeg_opened) {
-        DiscardData();
+    if (exif_data) {
+        free(exif_data);
     }
 }
 
@@ -346,17 +573,199 @@ status_t ExifElementsTable::insertElement(const char* tag, const char* value) {
 }
 
 /* private member functions */
-size_t Encoder_libjpeg::encode(params* input) {
+bool Encoder_libjpeg::encodeRows(params* input, uint8_t* src, const yuv_format* format,
+                                 int first_row, int num_rows,
+                                 jpeg_destination_mgr* dest,
+                                 unsigned int restart_interval) {
     jpeg_compress_struct    cinfo;
-    jpeg_error_mgr jerr;
+    libjpeg_error_mgr jerr;
+    raw_planes planes;
+    const unsigned char* exif = NULL;
+    size_t exif_size = 0;
+    int out_width = input->out_width;
+    int out_height = input->out_height;
+    int mcu_height = DCTSIZE * format->v_samp;
+
+    planes.luma_width = (out_width + DCTSIZE - 1) & ~(DCTSIZE - 1);
+    planes.chroma_width = ((out_width + 1) / 2 + DCTSIZE - 1) & ~(DCTSIZE - 1);
+    planes.direct_luma = (format->bpp == 1) && (planes.luma_width == out_width);
+    planes.planes[0] = planes.y;
+    planes.planes[1] = planes.cb;
+    planes.planes[2] = planes.cr;
+    planes.buf = (uint8_t*) malloc(2 * DCTSIZE * (planes.luma_width + planes.chroma_width));
+    if (!planes.buf) {
+        CAMHAL_LOGEA("Encoder: failed to allocate raw row buffers");
+        return false;
+    }
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = libjpeg_error_exit;
+    if (setjmp(jerr.env)) {
+        jpeg_destroy_compress(&cinfo);
+        free(planes.buf);
+        return false;
+    }
+
+    jpeg_create_compress(&cinfo);
+
+    cinfo.dest = dest;
+    cinfo.image_width = out_width;
+    cinfo.image_height = num_rows;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    cinfo.input_gamma = 1;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, input->quality, TRUE);
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.restart_interval = restart_interval;
+
+    // only the first stripe contributes headers to the final image
+    if (input->exif && (first_row == 0)) {
+        exif = input->exif->getExifSection(&exif_size);
+    }
+    if (exif && (exif_size > MAX_EXIF_SIZE)) {
+        // libjpeg would exit() on an oversized marker, write the jpeg without exif
+        CAMHAL_LOGEB("Encoder: dropping %u byte exif, too large for APP1", (unsigned int) exif_size);
+        exif = NULL;
+    }
+    if (exif) {
+        // exif APP1 replaces the JFIF APP0 right behind SOI
+        cinfo.write_JFIF_header = FALSE;
+    }
+
+    // hand the source chroma to libjpeg as is, no upsample/downsample round trip
+    cinfo.raw_data_in = TRUE;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = format->v_samp;
+    cinfo.comp_info[1].h_samp_factor = 1;
+    cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = 1;
+    cinfo.comp_info[2].v_samp_factor = 1;
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    if (exif) {
+        jpeg_write_marker(&cinfo, JPEG_APP0 + 1, exif, exif_size);
+    }
+
+    while ((cinfo.next_scanline < cinfo.image_height) && !mCancelEncoding) {
+        format->fill(&planes, src, out_width, out_height, first_row + cinfo.next_scanline);
+        jpeg_write_raw_data(&cinfo, planes.planes, mcu_height);
+    }
+
+    // no need to finish encoding routine if we are prematurely stopping
+    // we will end up crashing in dest_mgr since data is incomplete
+    if (!mCancelEncoding)
+        jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    free(planes.buf);
+
+    return !mCancelEncoding;
+}
+
+void Encoder_libjpeg::encodeStripes(stripe_job* job) {
+    int idx;
+
+    while ((idx = android_atomic_inc(&job->next)) < job->num_stripes) {
+        stripe* s = &job->stripes[idx];
+        libjpeg_stripe_destination_mgr dest_mgr(s->num_rows * job->input->out_width * job->format->bpp);
+
+        s->done = job->encoder->encodeRows(job->input, job->src, job->format,
+                                           s->first_row, s->num_rows,
+                                           &dest_mgr, job->restart_interval) &&
+                  dest_mgr.buf;
+        s->buf = dest_mgr.buf;
+        s->size = dest_mgr.jpegsize;
+        dest_mgr.buf = NULL;
+    }
+}
+
+size_t Encoder_libjpeg::encodeStriped(params* input, uint8_t* src, const yuv_format* format,
+                                      int threads) {
+    int out_width = input->out_width;
+    int out_height = input->out_height;
+    int mcu_height = DCTSIZE * format->v_samp;
+    int mcus_per_row = (out_width + 2 * DCTSIZE - 1) / (2 * DCTSIZE);
+    int mcu_rows = (out_height + mcu_height - 1) / mcu_height;
+    int stripe_mcu_rows;
+    int num_stripes;
+    size_t size = 0;
+    stripe_job job;
+    sp<StripeWorker> workers[MAX_ENCODER_THREADS];
+
+    // a couple of stripes per thread evens out the entropy coding cost,
+    // the restart interval has to fit the 16 bit DRI field
+    stripe_mcu_rows = (mcu_rows + threads * STRIPES_PER_THREAD - 1) / (threads * STRIPES_PER_THREAD);
+    while ((stripe_mcu_rows > 1) && (stripe_mcu_rows * mcus_per_row > 0xFFFF)) {
+        stripe_mcu_rows--;
+    }
+    if (stripe_mcu_rows * mcus_per_row > 0xFFFF) {
+        return 0;
+    }
+    num_stripes = (mcu_rows + stripe_mcu_rows - 1) / stripe_mcu_rows;
+
+    job.encoder = this;
+    job.input = input;
+    job.src = src;
+    job.format = format;
+    job.restart_interval = stripe_mcu_rows * mcus_per_row;
+    job.num_stripes = num_stripes;
+    job.next = 0;
+    job.stripes = (stripe*) calloc(num_stripes, sizeof(stripe));
+    if (!job.stripes) {
+        return 0;
+    }
+
+    for (int i = 0; i < num_stripes; i++) {
+        job.stripes[i].first_row = i * stripe_mcu_rows * mcu_height;
+        job.stripes[i].num_rows = stripe_mcu_rows * mcu_height;
+        if (job.stripes[i].first_row + job.stripes[i].num_rows > out_height) {
+            job.stripes[i].num_rows = out_height - job.stripes[i].first_row;
+        }
+    }
+
+    CAMHAL_LOGDB("Encoder: %d stripes of %d rows on %d threads, restart interval %u",
+                 num_stripes, stripe_mcu_rows * mcu_height, threads, job.restart_interval);
+
+    // this thread encodes stripes as well
+    for (int i = 0; i < threads - 1; i++) {
+        workers[i] = new StripeWorker(&job);
+        if (workers[i]->run("JpegStripeWorker") != NO_ERROR) {
+            workers[i].clear();
+        }
+    }
+
+    encodeStripes(&job);
+
+    for (int i = 0; i < threads - 1; i++) {
+        if (workers[i].get()) {
+            workers[i]->join();
+            workers[i].clear();
+        }
+    }
+
+    if (!mCancelEncoding) {
+        size = join_stripes(input->dst, input->dst_size, out_height,
+                            job.stripes, num_stripes);
+    }
+
+    for (int i = 0; i < num_stripes; i++) {
+        if (job.stripes[i].buf) free(job.stripes[i].buf);
+    }
+    free(job.stripes);
+
+    return size;
+}
+
+size_t Encoder_libjpeg::encode(params* input) {
     jpeg_destination_mgr jdest;
     uint8_t* src = NULL, *resize_src = NULL;
-    uint8_t* row_tmp = NULL;
-    uint8_t* row_src = NULL;
-    uint8_t* row_uv = NULL; // used only for NV12
     int out_width = 0, in_width = 0;
     int out_height = 0, in_height = 0;
-    int bpp = 2; // for uyvy
+    const yuv_format* format = NULL;
+    int threads = 1;
 
     if (!input) {
         return 0;
@@ -378,25 +787,22 @@ size_t Encoder_libjpeg::encode(params* input) {
         goto exit;
     }
 
-    if (strcmp(input->format, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0) {
-        bpp = 1;
-        if ((in_width != out_width) || (in_height != out_height)) {
-            resize_src = (uint8_t*) malloc(input->dst_size);
-            resize_nv12(input, resize_src);
-            if (resize_src) src = resize_src;
-        }
-    } else if ((in_width != out_width) || (in_height != out_height)) {
-        CAMHAL_LOGEB("Encoder: resizing is not supported for this format: %s", input->format);
-        goto exit;
-    } else if (strcmp(input->format, CameraParameters::PIXEL_FORMAT_YUV422I)) {
-        // we currently only support yuv422i and yuv420sp
+    // we currently only support yuv422i and yuv420sp
+    format = find_yuv_format(input->format);
+    if (!format) {
         CAMHAL_LOGEB("Encoder: format not supported: %s", input->format);
         goto exit;
     }
 
-    cinfo.err = jpeg_std_error(&jerr);
-
-    jpeg_create_compress(&cinfo);
+    if ((in_width != out_width) || (in_height != out_height)) {
+        if (format->bpp != 1) {
+            CAMHAL_LOGEB("Encoder: resizing is not supported for this format: %s", input->format);
+            goto exit;
+        }
+        resize_src = (uint8_t*) malloc(input->dst_size);
+        resize_nv12(input, resize_src);
+        if (resize_src) src = resize_src;
+    }
 
     CAMHAL_LOGDB("encoding...  \n\t"
                  "width: %d    \n\t"
@@ -407,49 +813,26 @@ size_t Encoder_libjpeg::encode(params* input) {
                  out_width, out_height, input->dst,
                  input->dst_size, src);
 
-    cinfo.dest = &dest_mgr;
-    cinfo.image_width = out_width;
-    cinfo.image_height = out_height;
-    cinfo.input_components = 3;
-    cinfo.in_color_space = JCS_YCbCr;
-    cinfo.input_gamma = 1;
-
-    jpeg_set_defaults(&cinfo);
-    jpeg_set_quality(&cinfo, input->quality, TRUE);
-    cinfo.dct_method = JDCT_IFAST;
-
-    jpeg_start_compress(&cinfo, TRUE);
-
-    row_tmp = (uint8_t*)malloc(out_width * 3);
-    row_src = src;
-    row_uv = src + out_width * out_height * bpp;
-
-    while ((cinfo.next_scanline < cinfo.image_height) && !mCancelEncoding) {
-        JSAMPROW row[1];    /* pointer to JSAMPLE row[s] */
-
-        // convert input yuv format to yuv444
-        if (strcmp(input->format, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0) {
-            nv21_to_yuv(row_tmp, row_src, row_uv, out_width);
-        } else {
-            uyvy_to_yuv(row_tmp, (uint32_t*)row_src, out_width);
-        }
-
-        row[0] = row_tmp;
-        jpeg_write_scanlines(&cinfo, row, 1);
-        row_src = row_src + out_width*bpp;
+    threads = input->threads;
+    if (threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads > MAX_ENCODER_THREADS) {
+        threads = MAX_ENCODER_THREADS;
+    }
 
-        // move uv row if input format needs it
-        if (strcmp(input->format, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0) {
-            if (!(cinfo.next_scanline % 2))
-                row_uv = row_uv +  out_width * bpp;
+    if ((threads > 1) && (out_width * out_height >= STRIPE_MIN_PIXELS)) {
+        dest_mgr.jpegsize = encodeStriped(input, src, format, threads);
+        if (dest_mgr.jpegsize || mCancelEncoding) {
+            if (resize_src) free(resize_src);
+            goto exit;
         }
+        CAMHAL_LOGEA("Encoder: striped encoding failed, falling back to single pass");
     }
 
-    // no need to finish encoding routine if we are prematurely stopping
-    // we will end up crashing in dest_mgr since data is incomplete
-    if (!mCancelEncoding)
-        jpeg_finish_compress(&cinfo);
-    jpeg_destroy_compress(&cinfo);
+    if (!encodeRows(input, src, format, 0, out_height, &dest_mgr, 0)) {
+        dest_mgr.jpegsize = 0;
+    }
 
     if (resize_src) free(resize_src);
 
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#define LOG_TAG "BaseAdapter"
+
+#include "FrameDescriptorTable.h"
+
+#include <string.h>
+#include <utils/Log.h>
+#include <cutils/atomic.h>
+
+namespace android {
+
+static inline uint32_t hashFrameBuffer(int buffer)
+{
+    uint32_t h = ( uint32_t ) buffer;
+
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+
+    return h;
+}
+
+FrameDescriptorTable::FrameDescriptorTable()
+{
+    memset(( void * ) mDescriptors, 0, sizeof(mDescriptors));
+    memset(( void * ) mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mSpareCount = 0;
+}
+
+FrameDescriptorTable::~FrameDescriptorTable()
+{
+}
+
+status_t FrameDescriptorTable::init(const int *buffers, uint32_t count, uint32_t queueable)
+{
+    Descriptor *desc;
+    uint32_t bucket;
+
+    if ( count > MAX_FRAME_BUFFERS )
+        {
+        ALOGE("%u buffers, frame descriptors only cover %u", count, MAX_FRAME_BUFFERS);
+        return BAD_VALUE;
+        }
+
+    Mutex::Autolock lock(mLock);
+
+    memset(( void * ) mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mSpareCount = 0;
+
+    for ( uint32_t i = 0 ; i < count ; i++ )
+        {
+        desc = &mDescriptors[mCount];
+        desc->mBuffer = buffers[i];
+        // initial ref count for undeqeueued buffers is 1 since buffer provider
+        // is still holding on to it
+        desc->mRefs = ( i < queueable ) ? 0 : 1 << ( REF_FRAME * REF_BITS );
+
+        bucket = hashFrameBuffer(buffers[i]) & ( BUCKETS - 1 );
+        while ( 0 != mBuckets[bucket] )
+            {
+            bucket = ( bucket + 1 ) & ( BUCKETS - 1 );
+            }
+        mBuckets[bucket] = ++mCount;
+        }
+
+    android_memory_barrier();
+
+    return NO_ERROR;
+}
+
+FrameDescriptorTable::Descriptor* FrameDescriptorTable::find(void *frameBuf) const
+{
+    int buffer = ( int ) frameBuf;
+    uint32_t bucket;
+    int32_t index, spares;
+
+    if ( 0 == buffer )
+        {
+        return NULL;
+        }
+
+    bucket = hashFrameBuffer(buffer) & ( BUCKETS - 1 );
+    while ( 0 != ( index = mBuckets[bucket] ) )
+        {
+        if ( buffer == mDescriptors[index - 1].mBuffer )
+            {
+            return &mDescriptors[index - 1];
+            }
+
+        bucket = ( bucket + 1 ) & ( BUCKETS - 1 );
+        }
+
+    spares = android_atomic_acquire_load(&mSpareCount);
+    for ( int32_t i = 0 ; i < spares ; i++ )
+        {
+        if ( buffer == android_atomic_acquire_load(&mDescriptors[mCount + i].mBuffer) )
+            {
+            return &mDescriptors[mCount + i];
+            }
+        }
+
+    return NULL;
+}
+
+FrameDescriptorTable::Descriptor* FrameDescriptorTable::find(void *frameBuf, int index) const
+{
+    if ( ( 0 <= index ) && ( ( uint32_t ) index < mCount ) &&
+         ( ( int ) frameBuf == mDescriptors[index].mBuffer ) )
+        {
+        return &mDescriptors[index];
+        }
+
+    return find(frameBuf);
+}
+
+FrameDescriptorTable::Descriptor* FrameDescriptorTable::findOrAdd(void *frameBuf, RefSlot slot, int refCount)
+{
+    Descriptor *desc = find(frameBuf);
+    int32_t spares;
+
+    if ( NULL == frameBuf )
+        {
+        return NULL;
+        }
+
+    //Announced buffers keep their descriptor until the next init()
+    if ( ( NULL != desc ) && ( desc < &mDescriptors[mCount] ) )
+        {
+        setRef(desc, slot, refCount);
+        return desc;
+        }
+
+    //An idle spare may be recycled by another caller until it holds a
+    //reference, so spares are only looked up and set under the lock
+    Mutex::Autolock lock(mLock);
+
+    desc = find(frameBuf);
+    if ( NULL != desc )
+        {
+        setRef(desc, slot, refCount);
+        return desc;
+        }
+
+    spares = mSpareCount;
+    if ( spares < SPARE_DESCRIPTORS )
+        {
+        desc = &mDescriptors[mCount + spares];
+        }
+    else
+        {
+        //Recycle a spare nobody holds a reference on anymore
+        for ( int32_t i = 0 ; i < spares ; i++ )
+            {
+            if ( 0 == android_atomic_acquire_load(&mDescriptors[mCount + i].mRefs) )
+                {
+                desc = &mDescriptors[mCount + i];
+                break;
+                }
+            }
+        }
+
+    if ( NULL == desc )
+        {
+        ALOGE("No frame descriptor left for 0x%x", ( uint32_t ) frameBuf);
+        return NULL;
+        }
+
+    //Idle, so no releaseRef() can touch it, and it carries its first
+    //reference before the new buffer becomes visible to lookups
+    desc->mRefs = ( uint32_t ) ( refCount & REF_MASK ) << ( slot * REF_BITS );
+    android_atomic_release_store(( int32_t ) frameBuf, &desc->mBuffer);
+
+    if ( spares < SPARE_DESCRIPTORS )
+        {
+        android_atomic_release_store(spares + 1, &mSpareCount);
+        }
+
+    return desc;
+}
+
+uint32_t FrameDescriptorTable::size() const
+{
+    return mCount + android_atomic_acquire_load(&mSpareCount);
+}
+
+FrameDescriptorTable::Descriptor* FrameDescriptorTable::at(uint32_t index) const
+{
+    return &mDescriptors[index];
+}
+
+int FrameDescriptorTable::getRef(Descriptor *desc, RefSlot slot)
+{
+    uint32_t refs = android_atomic_acquire_load(&desc->mRefs);
+
+    return ( refs >> ( slot * REF_BITS ) ) & REF_MASK;
+}
+
+void FrameDescriptorTable::setRef(Descriptor *desc, RefSlot slot, int refCount)
+{
+    uint32_t shift = slot * REF_BITS;
+    uint32_t old, refs;
+
+    do
+        {
+        old = desc->mRefs;
+        refs = ( old & ~( ( uint32_t ) REF_MASK << shift ) ) |
+               ( ( uint32_t ) ( refCount & REF_MASK ) << shift );
+        } while ( android_atomic_release_cas(old, refs, &desc->mRefs) );
+}
+
+bool FrameDescriptorTable::releaseRef(Descriptor *desc, RefSlot slot, bool &lastRef)
+{
+    uint32_t shift = slot * REF_BITS;
+    uint32_t old;
+
+    do
+        {
+        old = android_atomic_acquire_load(&desc->mRefs);
+        if ( 0 == ( ( old >> shift ) & REF_MASK ) )
+            {
+            return false;
+            }
+        } while ( android_atomic_release_cas(old, old - ( 1U << shift ), &desc->mRefs) );
+
+    lastRef = ( ( 1U << shift ) == old );
+
+    return true;
+}
+
+};
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Concurrency test for FrameDescriptorTable.
+ *
+ * Several threads dispatch and return frames the way BaseCameraAdapter
+ * does: setInitFrameRefCount() sets the REF_FRAME and REF_VIDEO counts
+ * through findOrAdd(), then returnFrame() drops them one by one through
+ * find(). Most buffers were never announced to init(), and there are more
+ * of them than spare descriptors, so spares are claimed and recycled while
+ * other threads hold theirs. A descriptor must keep its buffer and counts
+ * until its last reference is dropped, and exactly that drop is the last.
+ * On every other frame a second thread drops a REF_FRAME reference while
+ * the REF_VIDEO count of the same descriptor is being set.
+ *
+ * usage: framedescriptortest [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cutils/atomic.h>
+
+#include "FrameDescriptorTable.h"
+
+using namespace android;
+
+#define THREADS 4
+#define ANNOUNCED 4
+#define BUFFERS_PER_THREAD 6        /* unannounced, 24 against 8 spares */
+#define FRAME_REFS 2
+#define VIDEO_REFS 1
+
+static FrameDescriptorTable table;
+static int announced[ANNOUNCED];
+static int iterations = 100000;
+static volatile int32_t failures;
+
+typedef struct
+{
+  int id;
+  int lastRefs;
+  /* the frame the returner drops a REF_FRAME reference of, 0 if none */
+  volatile int32_t pending;
+  pthread_t returner;
+} worker_t;
+
+static void fail(const char *what, int buffer)
+{
+  if (android_atomic_inc(&failures) < 10)
+    printf("FAIL %s, buffer 0x%x\n", what, buffer);
+}
+
+static void returnRef(int buffer, FrameDescriptorTable::RefSlot slot, int *lastRefs)
+{
+  FrameDescriptorTable::Descriptor *desc = table.find((void *) buffer);
+  bool lastRef = false;
+
+  if (desc == NULL || desc->mBuffer != buffer) {
+    fail("returned frame lost its descriptor", buffer);
+    return;
+  }
+
+  if (!FrameDescriptorTable::releaseRef(desc, slot, lastRef)) {
+    fail("reference already dropped", buffer);
+    return;
+  }
+
+  if (lastRef)
+    (*lastRefs)++;
+}
+
+static void *returner(void *arg)
+{
+  worker_t *w = (worker_t *) arg;
+  int lastRefs = 0, buffer;
+
+  for (;;) {
+    while ((buffer = android_atomic_acquire_load(&w->pending)) == 0)
+      sched_yield();
+    if (buffer == -1)
+      break;
+
+    returnRef(buffer, FrameDescriptorTable::REF_FRAME, &lastRefs);
+
+    android_atomic_release_store(0, &w->pending);
+  }
+
+  w->lastRefs += lastRefs;
+  return NULL;
+}
+
+static void *dispatcher(void *arg)
+{
+  worker_t *w = (worker_t *) arg;
+  FrameDescriptorTable::Descriptor *desc;
+  int buffer, lastRefs = 0;
+
+  for (int n = 0; n < iterations; n++) {
+    if (n % 3 == 0)
+      buffer = announced[w->id];
+    else
+      buffer = 0x10000 * (w->id + 1) + 0x100 * (n % BUFFERS_PER_THREAD);
+
+    desc = table.findOrAdd((void *) buffer, FrameDescriptorTable::REF_FRAME, FRAME_REFS);
+    if (desc == NULL) {
+      fail("no descriptor", buffer);
+      continue;
+    }
+
+    /* on odd frames the returner drops one REF_FRAME meanwhile */
+    if (n & 1)
+      android_atomic_release_store(buffer, &w->pending);
+
+    if (table.findOrAdd((void *) buffer, FrameDescriptorTable::REF_VIDEO, VIDEO_REFS) != desc)
+      fail("second slot got another descriptor", buffer);
+
+    while (android_atomic_acquire_load(&w->pending) != 0)
+      sched_yield();
+
+    if (desc->mBuffer != buffer)
+      fail("descriptor handed to another buffer", buffer);
+
+    if (FrameDescriptorTable::getRef(desc, FrameDescriptorTable::REF_FRAME) != FRAME_REFS - (n & 1) ||
+        FrameDescriptorTable::getRef(desc, FrameDescriptorTable::REF_VIDEO) != VIDEO_REFS)
+      fail("refcounts changed under their owner", buffer);
+
+    for (int i = FRAME_REFS - (n & 1); i > 0; i--)
+      returnRef(buffer, FrameDescriptorTable::REF_FRAME, &lastRefs);
+
+    for (int i = 0; i < VIDEO_REFS; i++)
+      returnRef(buffer, FrameDescriptorTable::REF_VIDEO, &lastRefs);
+  }
+
+  w->lastRefs += lastRefs;
+  return NULL;
+}
+
+int main(int argc, char **argv)
+{
+  worker_t workers[THREADS];
+  pthread_t threads[THREADS];
+  int lastRefs = 0;
+
+  if (argc > 1)
+    iterations = atoi(argv[1]);
+
+  for (int i = 0; i < ANNOUNCED; i++)
+    announced[i] = 0x1000 * (i + 1);
+
+  if (table.init(announced, ANNOUNCED, ANNOUNCED) != NO_ERROR) {
+    printf("FAIL init\n");
+    return 1;
+  }
+
+  for (int t = 0; t < THREADS; t++) {
+    workers[t].id = t;
+    workers[t].lastRefs = 0;
+    workers[t].pending = 0;
+    pthread_create(&workers[t].returner, NULL, returner, &workers[t]);
+    pthread_create(&threads[t], NULL, dispatcher, &workers[t]);
+  }
+
+  for (int t = 0; t < THREADS; t++) {
+    pthread_join(threads[t], NULL);
+    android_atomic_release_store(-1, &workers[t].pending);
+    pthread_join(workers[t].returner, NULL);
+    lastRefs += workers[t].lastRefs;
+  }
+
+  /* every frame was handed back to the camera exactly once */
+  if (lastRefs != THREADS * iterations) {
+    printf("FAIL %d last references for %d frames\n", lastRefs, THREADS * iterations);
+    failures++;
+  }
+
+  for (uint32_t i = 0; i < table.size(); i++) {
+    if (table.at(i)->mRefs != 0) {
+      printf("FAIL descriptor %u left with references 0x%x\n", i, table.at(i)->mRefs);
+      failures++;
+    }
+  }
+
+  printf("%d frames on %d threads, %u descriptors\n", THREADS * iterations,
+         THREADS, table.size());
+  printf("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
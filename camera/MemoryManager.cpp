@@ -21,6 +21,7 @@
 
 #include "CameraHal.h"
 #include "TICameraParameters.h"
+#include <cutils/properties.h>
 
 extern "C" {
 
@@ -40,13 +41,102 @@ namespace android {
 
 #define ALLOCATION_2D 2
 
+///Default byte budget of the ION buffer cache, overridden by camera.ion.cache_kb
+#define ION_CACHE_DEFAULT_KB "24576"
+
 ///Utility Macro Declarations
+#define ION_PAGE_ALIGN(x) ( ( ( x ) + 4095 ) & ~4095 )
 
 /*--------------------MemoryManager Class STARTS here-----------------------------*/
+MemoryManager::MemoryManager()
+    : mIonFd(0),
+      mCacheBytes(0),
+      mCacheHits(0),
+      mCacheMisses(0)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    ///Buffers freed on a mode switch stay mapped up to this many bytes, so
+    ///preview -> capture -> preview doesn't fault the carveout in again
+    property_get("camera.ion.cache_kb", value, ION_CACHE_DEFAULT_KB);
+    mCacheBudget = (size_t) atoi(value) * 1024;
+}
+
+MemoryManager::~MemoryManager()
+{
+    Mutex::Autolock lock(mLock);
+
+    trimCacheLocked(0);
+
+    if ( mIonBuffers.size() )
+        {
+        CAMHAL_LOGEB("%d buffers still allocated", (int) mIonBuffers.size());
+        }
+
+    if ( mIonFd && ( 0 == mIonBuffers.size() ) )
+        {
+        ion_close(mIonFd);
+        mIonFd = 0;
+        }
+}
+
+bool MemoryManager::takeCachedBuffer(size_t length, IonBuffer &buffer)
+{
+    ///Most recently freed first, that one is the most likely to still be hot
+    for ( int i = mIonCache.size() - 1 ; i >= 0 ; i-- )
+        {
+        if ( mIonCache[i].mLength == length )
+            {
+            buffer = mIonCache[i];
+            mIonCache.removeAt(i);
+            mCacheBytes -= length;
+            return true;
+            }
+        }
+
+    return false;
+}
+
+void MemoryManager::releaseIonBuffer(const IonBuffer &buffer)
+{
+    munmap((void *) buffer.mAddress, buffer.mLength);
+    close(buffer.mFd);
+    ion_free(mIonFd, (ion_handle *) buffer.mHandle);
+}
+
+void MemoryManager::trimCache(size_t budget)
+{
+    Mutex::Autolock lock(mLock);
+
+    trimCacheLocked(budget);
+}
+
+void MemoryManager::trimCacheLocked(size_t budget)
+{
+    while ( ( mCacheBytes > budget ) && mIonCache.size() )
+        {
+        releaseIonBuffer(mIonCache[0]);
+        mCacheBytes -= mIonCache[0].mLength;
+        mIonCache.removeAt(0);
+        }
+}
+
+void MemoryManager::getCacheStats(CacheStats &stats)
+{
+    Mutex::Autolock lock(mLock);
+
+    stats.mHits = mCacheHits;
+    stats.mMisses = mCacheMisses;
+    stats.mResidentBytes = mCacheBytes;
+    stats.mBudgetBytes = mCacheBudget;
+}
+
 void* MemoryManager::allocateBuffer(int width, int height, const char* format, int &bytes, int numBufs)
 {
     LOG_FUNCTION_NAME;
 
+    Mutex::Autolock lock(mLock);
+
     if(mIonFd == 0)
         {
         mIonFd = ion_open();
@@ -77,21 +167,43 @@ void* MemoryManager::allocateBuffer(int width, int height, const char* format, i
     //2D Allocations are not supported currently
     if(bytes != 0)
         {
+        ///Size class of the request, cached buffers are matched on it
+        size_t length = ION_PAGE_ALIGN((size_t) bytes);
+        IonBuffer buffer;
         struct ion_handle *handle;
         int mmap_fd;
 
         ///1D buffers
         for (int i = 0; i < numBufs; i++)
             {
-            int ret = ion_alloc(mIonFd, bytes, 0, 1 << ION_HEAP_TYPE_CARVEOUT, &handle);
+            if ( takeCachedBuffer(length, buffer) )
+                {
+                mCacheHits++;
+                bufsArr[i] = buffer.mAddress;
+                mIonBuffers.add(bufsArr[i], buffer);
+                continue;
+                }
+
+            mCacheMisses++;
+
+            int ret = ion_alloc(mIonFd, length, 0, 1 << ION_HEAP_TYPE_CARVEOUT, &handle);
             if(ret < 0)
                 {
-                CAMHAL_LOGEB("ion_alloc resulted in error %d", ret);
-                goto error;
+                ///The carveout may just be held by the cache, give it back and retry
+                if ( mIonCache.size() )
+                    {
+                    trimCacheLocked(0);
+                    ret = ion_alloc(mIonFd, length, 0, 1 << ION_HEAP_TYPE_CARVEOUT, &handle);
+                    }
+                if(ret < 0)
+                    {
+                    CAMHAL_LOGEB("ion_alloc resulted in error %d", ret);
+                    goto error;
+                    }
                 }
 
-            CAMHAL_LOGDB("Before mapping, handle = %x, nSize = %d", handle, bytes);
-            if ((ret = ion_map(mIonFd, handle, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, 0,
+            CAMHAL_LOGDB("Before mapping, handle = %x, nSize = %d", handle, length);
+            if ((ret = ion_map(mIonFd, handle, length, PROT_READ | PROT_WRITE, MAP_SHARED, 0,
                           (unsigned char**)&bufsArr[i], &mmap_fd)) < 0)
                 {
                 CAMHAL_LOGEB("Userspace mapping of ION buffers returned error %d", ret);
@@ -99,11 +211,15 @@ void* MemoryManager::allocateBuffer(int width, int height, const char* format, i
                 goto error;
                 }
 
-            mIonHandleMap.add(bufsArr[i], (unsigned int)handle);
-            mIonFdMap.add(bufsArr[i], (unsigned int) mmap_fd);
-            mIonBufLength.add(bufsArr[i], (unsigned int) bytes);
+            buffer.mAddress = bufsArr[i];
+            buffer.mHandle = (unsigned int) handle;
+            buffer.mFd = mmap_fd;
+            buffer.mLength = length;
+            mIonBuffers.add(bufsArr[i], buffer);
             }
 
+        CAMHAL_LOGDB("ION cache: %u hits, %u misses, %u bytes resident",
+                     mCacheHits, mCacheMisses, (unsigned int) mCacheBytes);
         }
     else // If bytes is not zero, then it is a 2-D tiler buffer request
         {
@@ -115,7 +231,13 @@ void* MemoryManager::allocateBuffer(int width, int height, const char* format, i
 
 error:
     ALOGE("Freeing buffers already allocated after error occurred");
-    freeBuffer(bufsArr);
+    ///Memory is short, don't park these in the cache
+    for ( int i = 0 ; ( i < numBufs ) && bufsArr[i] ; i++ )
+        {
+        releaseIonBuffer(mIonBuffers.valueFor(bufsArr[i]));
+        mIonBuffers.removeItem(bufsArr[i]);
+        }
+    delete [] bufsArr;
 
     if ( NULL != mErrorNotifier.get() )
         {
@@ -160,17 +282,18 @@ int MemoryManager::freeBuffer(void* buf)
         return BAD_VALUE;
         }
 
+    Mutex::Autolock lock(mLock);
+
     while(*bufEntry)
         {
         unsigned int ptr = (unsigned int) *bufEntry++;
-        if(mIonBufLength.valueFor(ptr))
+        ssize_t index = mIonBuffers.indexOfKey(ptr);
+        if(index >= 0)
             {
-            munmap((void *)ptr, mIonBufLength.valueFor(ptr));
-            close(mIonFdMap.valueFor(ptr));
-            ion_free(mIonFd, (ion_handle*)mIonHandleMap.valueFor(ptr));
-            mIonHandleMap.removeItem(ptr);
-            mIonBufLength.removeItem(ptr);
-            mIonFdMap.removeItem(ptr);
+            ///Park the buffer mapped, the next allocation of this size reuses it
+            mIonCache.push(mIonBuffers.valueAt(index));
+            mCacheBytes += mIonBuffers.valueAt(index).mLength;
+            mIonBuffers.removeItemsAt(index);
             }
         else
             {
@@ -178,11 +301,13 @@ int MemoryManager::freeBuffer(void* buf)
             }
         }
 
+    trimCacheLocked(mCacheBudget);
+
     ///@todo Check if this way of deleting array is correct, else use malloc/free
     uint32_t * bufArr = (uint32_t*)buf;
     delete [] bufArr;
 
-    if(mIonBufLength.size() == 0)
+    if( ( mIonBuffers.size() == 0 ) && ( mIonCache.size() == 0 ) )
         {
         if(mIonFd)
             {
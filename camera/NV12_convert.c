@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NV12_convert.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define LOG_TAG "NV12_convert"
+#include <utils/Log.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define NV12_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__SSE2__) || defined(__x86_64__)
+#define NV12_CONVERT_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define NV12_CONVERT_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+/* Prefetch distance used by the vector kernels, in bytes */
+#define PREFETCH_AHEAD 256
+
+/*----------------------------------------------------------------------------
+    Scalar kernels. These define the reference output; the vector kernels
+    only handle the bulk of the row and hand the tail back to them.
+----------------------------------------------------------------------------*/
+
+static void swapUV_c(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i + 1 < n; i += 2) {
+        dst[i] = src[i + 1];
+        dst[i + 1] = src[i];
+    }
+}
+
+static void splitUV_c(uint8_t *dstU, uint8_t *dstV, const uint8_t *src, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i + 1 < n; i += 2) {
+        *dstU++ = src[i];
+        *dstV++ = src[i + 1];
+    }
+}
+
+#ifdef NV12_CONVERT_SSE2
+
+static void swapUV_sse2(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *) (dst + i), v);
+    }
+
+    swapUV_c(dst + i, src + i, n - i);
+}
+
+static void splitUV_sse2(uint8_t *dstU, uint8_t *dstV, const uint8_t *src, size_t n)
+{
+    const __m128i lo = _mm_set1_epi16(0x00FF);
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 16));
+        __m128i u = _mm_packus_epi16(_mm_and_si128(a, lo), _mm_and_si128(b, lo));
+        __m128i v = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i *) (dstU + i / 2), u);
+        _mm_storeu_si128((__m128i *) (dstV + i / 2), v);
+    }
+
+    splitUV_c(dstU + i / 2, dstV + i / 2, src + i, n - i);
+}
+
+#endif
+
+#ifdef NV12_CONVERT_AVX2
+
+__attribute__((target("avx2")))
+static void swapUV_avx2(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+        v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+        _mm256_storeu_si256((__m256i *) (dst + i), v);
+    }
+
+    swapUV_sse2(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void splitUV_avx2(uint8_t *dstU, uint8_t *dstV, const uint8_t *src, size_t n)
+{
+    const __m256i lo = _mm256_set1_epi16(0x00FF);
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src + i + 32));
+        __m256i u = _mm256_packus_epi16(_mm256_and_si256(a, lo), _mm256_and_si256(b, lo));
+        __m256i v = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+        /* packus works per 128-bit lane, restore the linear order */
+        u = _mm256_permute4x64_epi64(u, 0xD8);
+        v = _mm256_permute4x64_epi64(v, 0xD8);
+        _mm256_storeu_si256((__m256i *) (dstU + i / 2), u);
+        _mm256_storeu_si256((__m256i *) (dstV + i / 2), v);
+    }
+
+    splitUV_sse2(dstU + i / 2, dstV + i / 2, src + i, n - i);
+}
+
+#endif
+
+#ifdef NV12_CONVERT_NEON
+
+static void swapUV_neon(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        uint8x16x2_t uv, vu;
+        __builtin_prefetch(src + i + PREFETCH_AHEAD);
+        uv = vld2q_u8(src + i);
+        vu.val[0] = uv.val[1];
+        vu.val[1] = uv.val[0];
+        vst2q_u8(dst + i, vu);
+    }
+
+    for (; i + 16 <= n; i += 16) {
+        uint8x8x2_t uv, vu;
+        uv = vld2_u8(src + i);
+        vu.val[0] = uv.val[1];
+        vu.val[1] = uv.val[0];
+        vst2_u8(dst + i, vu);
+    }
+
+    swapUV_c(dst + i, src + i, n - i);
+}
+
+static void splitUV_neon(uint8_t *dstU, uint8_t *dstV, const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        uint8x16x2_t uv;
+        __builtin_prefetch(src + i + PREFETCH_AHEAD);
+        uv = vld2q_u8(src + i);
+        vst1q_u8(dstU + i / 2, uv.val[0]);
+        vst1q_u8(dstV + i / 2, uv.val[1]);
+    }
+
+    for (; i + 16 <= n; i += 16) {
+        uint8x8x2_t uv;
+        uv = vld2_u8(src + i);
+        vst1_u8(dstU + i / 2, uv.val[0]);
+        vst1_u8(dstV + i / 2, uv.val[1]);
+    }
+
+    splitUV_c(dstU + i / 2, dstV + i / 2, src + i, n - i);
+}
+
+#endif
+
+/*----------------------------------------------------------------------------
+    Runtime dispatch
+----------------------------------------------------------------------------*/
+
+static const NV12_convert_kernels_t gKernelsC = { "scalar", swapUV_c, splitUV_c };
+#ifdef NV12_CONVERT_SSE2
+static const NV12_convert_kernels_t gKernelsSSE2 = { "sse2", swapUV_sse2, splitUV_sse2 };
+#endif
+#ifdef NV12_CONVERT_AVX2
+static const NV12_convert_kernels_t gKernelsAVX2 = { "avx2", swapUV_avx2, splitUV_avx2 };
+#endif
+#ifdef NV12_CONVERT_NEON
+static const NV12_convert_kernels_t gKernelsNEON = { "neon", swapUV_neon, splitUV_neon };
+#endif
+
+/* Every kernel set built into this binary, in order of preference */
+static const NV12_convert_kernels_t *const gKernelSets[] = {
+    &gKernelsC,
+#ifdef NV12_CONVERT_SSE2
+    &gKernelsSSE2,
+#endif
+#ifdef NV12_CONVERT_AVX2
+    &gKernelsAVX2,
+#endif
+#ifdef NV12_CONVERT_NEON
+    &gKernelsNEON,
+#endif
+};
+
+#define KERNEL_SET_COUNT ((int) (sizeof(gKernelSets) / sizeof(gKernelSets[0])))
+
+static const NV12_convert_kernels_t *gKernels = &gKernelsC;
+static pthread_once_t gKernelsOnce = PTHREAD_ONCE_INIT;
+
+static int kernelsUsable(const NV12_convert_kernels_t *k)
+{
+#ifdef NV12_CONVERT_AVX2
+    if (k == &gKernelsAVX2) {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    // NEON is part of the target ABI whenever the compiler emits it, and
+    // SSE2 whenever it is enabled at all
+    return 1;
+}
+
+static void selectKernels(void)
+{
+    int i;
+
+    for (i = KERNEL_SET_COUNT - 1; i > 0 && !kernelsUsable(gKernelSets[i]); i--)
+        ;
+    gKernels = gKernelSets[i];
+
+    ALOGD("Using %s NV12 conversion kernels", gKernels->name);
+}
+
+const NV12_convert_kernels_t *NV12_convert_kernels(void)
+{
+    pthread_once(&gKernelsOnce, selectKernels);
+    return gKernels;
+}
+
+int NV12_convertKernelCount(void)
+{
+    return KERNEL_SET_COUNT;
+}
+
+const NV12_convert_kernels_t *NV12_convertKernelSet(int kernel)
+{
+    if (kernel < 0 || kernel >= KERNEL_SET_COUNT || !kernelsUsable(gKernelSets[kernel])) {
+        return NULL;
+    }
+
+    return gKernelSets[kernel];
+}
+
+/*----------------------------------------------------------------------------
+    Frame conversions
+----------------------------------------------------------------------------*/
+
+void NV12_to_NV21_ex(const NV12_convert_kernels_t *k, uint8_t *dst,
+                     const uint8_t *srcY, const uint8_t *srcUV,
+                     int width, int height, int rows, size_t stride)
+{
+    uint8_t *dstY = dst;
+    uint8_t *dstUV = dst + width * height;
+    int row;
+
+    if (rows > height) {
+        rows = height;
+    }
+
+    for (row = 0; row + 1 < rows; row += 2) {
+        memcpy(dstY, srcY, width);
+        memcpy(dstY + width, srcY + stride, width);
+        k->swapUV(dstUV, srcUV, width);
+
+        dstY += 2 * width;
+        srcY += 2 * stride;
+        dstUV += width;
+        srcUV += stride;
+    }
+
+    if (rows & 1) {
+        memcpy(dstY, srcY, width);
+    }
+}
+
+void NV12_to_YV12_ex(const NV12_convert_kernels_t *k, uint8_t *dst,
+                     const uint8_t *srcY, const uint8_t *srcUV,
+                     int width, int height, int rows, size_t stride)
+{
+    uint8_t *dstY = dst;
+    uint8_t *dstV = dst + width * height;
+    uint8_t *dstU = dstV + (width * height) / 4;
+    int row;
+
+    if (rows > height) {
+        rows = height;
+    }
+
+    for (row = 0; row + 1 < rows; row += 2) {
+        memcpy(dstY, srcY, width);
+        memcpy(dstY + width, srcY + stride, width);
+        k->splitUV(dstU, dstV, srcUV, width);
+
+        dstY += 2 * width;
+        srcY += 2 * stride;
+        dstU += width / 2;
+        dstV += width / 2;
+        srcUV += stride;
+    }
+
+    if (rows & 1) {
+        memcpy(dstY, srcY, width);
+    }
+}
+
+void NV12_to_NV21(uint8_t *dst, const uint8_t *srcY, const uint8_t *srcUV,
+                  int width, int height, int rows, size_t stride)
+{
+    NV12_to_NV21_ex(NV12_convert_kernels(), dst, srcY, srcUV, width, height, rows, stride);
+}
+
+void NV12_to_YV12(uint8_t *dst, const uint8_t *srcY, const uint8_t *srcUV,
+                  int width, int height, int rows, size_t stride)
+{
+    NV12_to_YV12_ex(NV12_convert_kernels(), dst, srcY, srcUV, width, height, rows, stride);
+}
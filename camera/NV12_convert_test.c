@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Bit-exactness test for NV12_to_NV21 and NV12_to_YV12.
+ *
+ * Every kernel set usable on this cpu is checked against a plain per-sample
+ * conversion on a range of sizes and strides, including sources that hold
+ * fewer rows than the frame, and odd heights. Bytes the conversion must not
+ * write are checked too. Also reports the time per frame.
+ *
+ * usage: nv12converttest [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "NV12_convert.h"
+
+typedef struct
+{
+  int width, height, stride;
+  int rows;                         /* luma rows in the source */
+} test_case_t;
+
+static const test_case_t cases[] = {
+  /* preview sizes */
+  {  176,  144,  192,  144 },
+  {  320,  240,  320,  240 },
+  {  640,  480, 4096,  480 },
+  { 1280,  720, 1280,  720 },
+  /* widths that leave a tail for every vector width */
+  {   18,   10,   32,   10 },
+  {  102,   64,  128,   64 },
+  {  854,  480,  864,  480 },
+  /* odd heights */
+  {   64,   33,   64,   33 },
+  /* short source, the output is truncated but keeps its layout */
+  {  640,  480,  640,  300 },
+  {  320,  240,  384,  151 },
+  {   96,   64,   96,    1 },
+};
+
+/* Guard bytes placed after the output, and filling what is not written */
+#define GUARD 64
+#define FILL  0x5a
+
+static void convert_reference(int yv12, unsigned char *dst,
+                              const unsigned char *srcY, const unsigned char *srcUV,
+                              int width, int height, int rows, int stride)
+{
+  unsigned char *dstV = dst + width * height;
+  unsigned char *dstU = dstV + (width * height) / 4;
+  int row, col;
+
+  for (row = 0; row < rows; row++)
+    memcpy(dst + row * width, srcY + row * stride, width);
+
+  for (row = 0; row < rows / 2; row++)
+  {
+    const unsigned char *uv = srcUV + row * stride;
+
+    for (col = 0; col + 1 < width; col += 2)
+    {
+      if (yv12)
+      {
+        dstU[row * (width / 2) + col / 2] = uv[col];
+        dstV[row * (width / 2) + col / 2] = uv[col + 1];
+      }
+      else
+      {
+        dstV[row * width + col] = uv[col + 1];
+        dstV[row * width + col + 1] = uv[col];
+      }
+    }
+  }
+}
+
+static double now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+  static const char *formats[] = { "nv21", "yv12" };
+  int iterations = (argc > 1) ? atoi(argv[1]) : 10;
+  int failures = 0;
+  unsigned int c;
+  int k, f, it;
+
+  srand(1);
+
+  for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+  {
+    const test_case_t *tc = &cases[c];
+    size_t inSize = (size_t) tc->stride * tc->height * 3 / 2;
+    size_t outSize = (size_t) tc->width * tc->height * 3 / 2 + GUARD;
+    unsigned char *in = malloc(inSize);
+    unsigned char *ref = malloc(outSize);
+    unsigned char *out = malloc(outSize);
+    const unsigned char *srcY = in;
+    const unsigned char *srcUV = in + tc->stride * tc->height;
+    size_t i;
+
+    for (i = 0; i < inSize; i++)
+      in[i] = rand();
+
+    for (f = 0; f < 2; f++)
+    {
+      memset(ref, FILL, outSize);
+      convert_reference(f, ref, srcY, srcUV, tc->width, tc->height, tc->rows, tc->stride);
+
+      for (k = 0; k < NV12_convertKernelCount(); k++)
+      {
+        const NV12_convert_kernels_t *kernels = NV12_convertKernelSet(k);
+        double start, elapsed;
+
+        if (!kernels)
+          continue;
+
+        memset(out, FILL, outSize);
+        if (f)
+          NV12_to_YV12_ex(kernels, out, srcY, srcUV, tc->width, tc->height, tc->rows, tc->stride);
+        else
+          NV12_to_NV21_ex(kernels, out, srcY, srcUV, tc->width, tc->height, tc->rows, tc->stride);
+
+        if (memcmp(ref, out, outSize))
+        {
+          printf("FAIL %dx%d/%d %d rows %s %s\n", tc->width, tc->height,
+                 tc->stride, tc->rows, formats[f], kernels->name);
+          failures++;
+          continue;
+        }
+
+        start = now_ms();
+        for (it = 0; it < iterations; it++)
+        {
+          if (f)
+            NV12_to_YV12_ex(kernels, out, srcY, srcUV, tc->width, tc->height, tc->rows, tc->stride);
+          else
+            NV12_to_NV21_ex(kernels, out, srcY, srcUV, tc->width, tc->height, tc->rows, tc->stride);
+        }
+        elapsed = (now_ms() - start) / (iterations ? iterations : 1);
+
+        printf("ok   %dx%d %4d rows %s %-6s %8.3f ms\n", tc->width, tc->height,
+               tc->rows, formats[f], kernels->name, elapsed);
+      }
+    }
+
+    free(in);
+    free(ref);
+    free(out);
+  }
+
+  printf("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -1,13 +1,418 @@
 #include "NV12_resize.h"
 
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
 //#define LOG_NDEBUG 0
 #define LOG_NIDEBUG 0
 #define LOG_NDDEBUG 0
 
 #define LOG_TAG "NV12_resize"
-#define STRIDE 4096
 #include <utils/Log.h>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define NV12_RESIZE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__SSE2__) || defined(__x86_64__)
+#define NV12_RESIZE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define NV12_RESIZE_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+/* Row bands are only split across threads above this many output pixels each */
+#define RESIZE_MAX_THREADS 4
+#define RESIZE_MIN_PIXELS_PER_THREAD (320 * 240)
+
+/*----------------------------------------------------------------------------
+    The bilinear weights of bWeights are separable: for the fractional
+    positions xf, yf they are (8-xf)(8-yf), xf(8-yf), xf*yf and (8-xf)yf.
+    Each output pixel is therefore computed as a vertical blend of two input
+    rows into 16 bit sums, followed by a horizontal blend of two neighbours
+    of that intermediate row. No rounding happens in between, so the result
+    is bit-exact with the direct 4 tap evaluation.
+
+    The horizontal weights of one output column are packed as two 16 bit
+    values (8-xf, xf), matching two neighbouring 16 bit samples read as one
+    32 bit word.
+----------------------------------------------------------------------------*/
+
+typedef struct
+{
+  const char *name;
+  mmBool (*supported)(void);
+
+  /* v[i] = (8-yf) * r1[i] + yf * r2[i], r2 is not read when yf is 0 */
+  void (*vblend)(mmUint16 *v, const mmUchar *r1, const mmUchar *r2, mmInt32 yf, mmInt32 n);
+
+  /* dst[i] = ((8-xf) * v[x] + xf * v[x+1]) >> 6 */
+  void (*hblendY)(mmUchar *dst, const mmUint16 *v, const mmInt32 *xIdx,
+                  const mmUint32 *xW, mmInt32 n);
+
+  /* same as hblendY on interleaved CbCr, x indexes the Cb sample */
+  void (*hblendUV)(mmUchar *dst, const mmUint16 *v, const mmInt32 *xIdx,
+                   const mmUint32 *xW, mmInt32 n);
+} resize_kernels_t;
+
+static mmBool always(void)
+{
+  return TRUE;
+}
+
+static inline mmUint32 load32(const mmUint16 *p)
+{
+  mmUint32 w;
+  memcpy(&w, p, sizeof(w));
+  return w;
+}
+
+/*----------------------------------------------------------------------------
+    Scalar kernels
+----------------------------------------------------------------------------*/
+
+static void vblend_c(mmUint16 *v, const mmUchar *r1, const mmUchar *r2, mmInt32 yf, mmInt32 n)
+{
+  mmInt32 i;
+
+  if (yf == 0)
+  {
+    for (i = 0; i < n; i++)
+      v[i] = r1[i] << 3;
+    return;
+  }
+
+  for (i = 0; i < n; i++)
+    v[i] = (8 - yf) * r1[i] + yf * r2[i];
+}
+
+static void hblendY_c(mmUchar *dst, const mmUint16 *v, const mmInt32 *xIdx,
+                      const mmUint32 *xW, mmInt32 n)
+{
+  mmInt32 i;
+
+  for (i = 0; i < n; i++)
+  {
+    const mmUint16 *p = v + xIdx[i];
+    mmUint32 w = xW[i];
+    dst[i] = (mmUchar) (((w & 0xFFFF) * p[0] + (w >> 16) * p[1]) >> 6);
+  }
+}
+
+static void hblendUV_c(mmUchar *dst, const mmUint16 *v, const mmInt32 *xIdx,
+                       const mmUint32 *xW, mmInt32 n)
+{
+  mmInt32 i;
+
+  for (i = 0; i < n; i++)
+  {
+    const mmUint16 *p = v + xIdx[i];
+    mmUint32 w0 = xW[i] & 0xFFFF;
+    mmUint32 w1 = xW[i] >> 16;
+    dst[2*i]   = (mmUchar) ((w0 * p[0] + w1 * p[2]) >> 6);
+    dst[2*i+1] = (mmUchar) ((w0 * p[1] + w1 * p[3]) >> 6);
+  }
+}
+
+#ifdef NV12_RESIZE_SSE2
+
+static void vblend_sse2(mmUint16 *v, const mmUchar *r1, const mmUchar *r2, mmInt32 yf, mmInt32 n)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i w1 = _mm_set1_epi16(8 - yf);
+  const __m128i w2 = _mm_set1_epi16(yf);
+  mmInt32 i = 0;
+
+  if (yf == 0)
+  {
+    vblend_c(v, r1, r2, yf, n);
+    return;
+  }
+
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i *) (r1 + i));
+    __m128i b = _mm_loadu_si128((const __m128i *) (r2 + i));
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w1),
+                               _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w2));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w1),
+                               _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w2));
+    _mm_storeu_si128((__m128i *) (v + i), lo);
+    _mm_storeu_si128((__m128i *) (v + i + 8), hi);
+  }
+
+  vblend_c(v + i, r1 + i, r2 + i, yf, n - i);
+}
+
+static void hblendY_sse2(mmUchar *dst, const mmUint16 *v, const mmInt32 *xIdx,
+                         const mmUint32 *xW, mmInt32 n)
+{
+  mmInt32 i = 0;
+  mmUint32 out;
+
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128i g = _mm_set_epi32(load32(v + xIdx[i+3]), load32(v + xIdx[i+2]),
+                              load32(v + xIdx[i+1]), load32(v + xIdx[i]));
+    __m128i w = _mm_loadu_si128((const __m128i *) (xW + i));
+    __m128i r = _mm_srli_epi32(_mm_madd_epi16(g, w), 6);
+    r = _mm_packs_epi32(r, r);
+    r = _mm_packus_epi16(r, r);
+    out = (mmUint32) _mm_cvtsi128_si32(r);
+    memcpy(dst + i, &out, sizeof(out));   /* dst is unaligned at odd cropX */
+  }
+
+  hblendY_c(dst + i, v, xIdx + i, xW + i, n - i);
+}
+
+static mmBool has_sse2(void)
+{
+  return TRUE;
+}
+
+#endif
+
+#ifdef NV12_RESIZE_AVX2
+
+__attribute__((target("avx2")))
+static void vblend_avx2(mmUint16 *v, const mmUchar *r1, const mmUchar *r2, mmInt32 yf, mmInt32 n)
+{
+  const __m256i w1 = _mm256_set1_epi16(8 - yf);
+  const __m256i w2 = _mm256_set1_epi16(yf);
+  mmInt32 i = 0;
+
+  if (yf == 0)
+  {
+    vblend_c(v, r1, r2, yf, n);
+    return;
+  }
+
+  for (; i + 16 <= n; i += 16)
+  {
+    __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (r1 + i)));
+    __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (r2 + i)));
+    __m256i r = _mm256_add_epi16(_mm256_mullo_epi16(a, w1), _mm256_mullo_epi16(b, w2));
+    _mm256_storeu_si256((__m256i *) (v + i), r);
+  }
+
+  vblend_sse2(v + i, r1 + i, r2 + i, yf, n - i);
+}
+
+__attribute__((target("avx2")))
+static void hblendY_avx2(mmUchar *dst, const mmUint16 *v, const mmInt32 *xIdx,
+                         const mmUint32 *xW, mmInt32 n)
+{
+  mmInt32 i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    /* one 32 bit gather fetches both neighbours v[x] and v[x+1] */
+    __m256i idx = _mm256_loadu_si256((const __m256i *) (xIdx + i));
+    __m256i g = _mm256_i32gather_epi32((const int *) v, idx, 2);
+    __m256i w = _mm256_loadu_si256((const __m256i *) (xW + i));
+    __m256i r = _mm256_srli_epi32(_mm256_madd_epi16(g, w), 6);
+    __m128i r16;
+    r = _mm256_packus_epi32(r, r);
+    r = _mm256_permute4x64_epi64(r, 0x08);
+    r16 = _mm256_castsi256_si128(r);
+    _mm_storel_epi64((__m128i *) (dst + i), _mm_packus_epi16(r16, r16));
+  }
+
+  hblendY_sse2(dst + i, v, xIdx + i, xW + i, n - i);
+}
+
+static mmBool has_avx2(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? TRUE : FALSE;
+}
+
+#endif
+
+#ifdef NV12_RESIZE_NEON
+
+static void vblend_neon(mmUint16 *v, const mmUchar *r1, const mmUchar *r2, mmInt32 yf, mmInt32 n)
+{
+  const uint8x8_t w1 = vdup_n_u8(8 - yf);
+  const uint8x8_t w2 = vdup_n_u8(yf);
+  mmInt32 i = 0;
+
+  if (yf == 0)
+  {
+    vblend_c(v, r1, r2, yf, n);
+    return;
+  }
+
+  for (; i + 16 <= n; i += 16)
+  {
+    uint8x16_t a = vld1q_u8(r1 + i);
+    uint8x16_t b = vld1q_u8(r2 + i);
+    uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(a), w1), vget_low_u8(b), w2);
+    uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(a), w1), vget_high_u8(b), w2);
+    vst1q_u16(v + i, lo);
+    vst1q_u16(v + i + 8, hi);
+  }
+
+  vblend_c(v + i, r1 + i, r2 + i, yf, n - i);
+}
+
+static void hblendY_neon(mmUchar *dst, const mmUint16 *v, const mmInt32 *xIdx,
+                         const mmUint32 *xW, mmInt32 n)
+{
+  mmInt32 i = 0;
+
+  for (; i + 4 <= n; i += 4)
+  {
+    uint32x4_t g = vdupq_n_u32(0);
+    uint16x8_t p;
+    uint32x4_t s;
+    uint8x8_t r;
+    g = vsetq_lane_u32(load32(v + xIdx[i]), g, 0);
+    g = vsetq_lane_u32(load32(v + xIdx[i+1]), g, 1);
+    g = vsetq_lane_u32(load32(v + xIdx[i+2]), g, 2);
+    g = vsetq_lane_u32(load32(v + xIdx[i+3]), g, 3);
+    /* 8*8*255 still fits 16 bits, add the pairs once multiplied */
+    p = vmulq_u16(vreinterpretq_u16_u32(g), vreinterpretq_u16_u32(vld1q_u32(xW + i)));
+    s = vpaddlq_u16(p);
+    r = vqmovn_u16(vcombine_u16(vshrn_n_u32(s, 6), vdup_n_u16(0)));
+    vst1_lane_u32((uint32_t *) (dst + i), vreinterpret_u32_u8(r), 0);
+  }
+
+  hblendY_c(dst + i, v, xIdx + i, xW + i, n - i);
+}
+
+#endif
+
+static const resize_kernels_t gKernels[] = {
+#ifdef NV12_RESIZE_NEON
+  { "neon", always, vblend_neon, hblendY_neon, hblendUV_c },
+#endif
+#ifdef NV12_RESIZE_AVX2
+  { "avx2", has_avx2, vblend_avx2, hblendY_avx2, hblendUV_c },
+#endif
+#ifdef NV12_RESIZE_SSE2
+  { "sse2", has_sse2, vblend_sse2, hblendY_sse2, hblendUV_c },
+#endif
+  { "scalar", always, vblend_c, hblendY_c, hblendUV_c },
+};
+
+#define KERNEL_SETS ((mmInt32) (sizeof(gKernels) / sizeof(gKernels[0])))
+
+static mmBool gKernelUsable[KERNEL_SETS];
+static mmInt32 gBestKernel = KERNEL_SETS - 1;
+static pthread_once_t gKernelOnce = PTHREAD_ONCE_INIT;
+
+static void probeKernels(void)
+{
+  mmInt32 i;
+
+  /* sets are listed fastest first */
+  for (i = KERNEL_SETS - 1; i >= 0; i--)
+  {
+    gKernelUsable[i] = gKernels[i].supported();
+    if (gKernelUsable[i])
+      gBestKernel = i;
+  }
+
+  ALOGV("Using %s resize kernels", gKernels[gBestKernel].name);
+}
+
+mmInt32 VT_resizeKernelCount(void)
+{
+  return KERNEL_SETS;
+}
+
+const char* VT_resizeKernelName(mmInt32 kernel)
+{
+  pthread_once(&gKernelOnce, probeKernels);
+
+  if (kernel < 0 || kernel >= KERNEL_SETS || !gKernelUsable[kernel])
+    return NULL;
+
+  return gKernels[kernel].name;
+}
+
+/*----------------------------------------------------------------------------
+    Row band processing
+----------------------------------------------------------------------------*/
+
+typedef struct
+{
+  const resize_kernels_t *k;
+
+  const mmUchar *inY;
+  const mmUchar *inUV;
+  mmInt32 inStride;
+
+  mmUchar *outY;
+  mmUchar *outUV;
+  mmInt32 outStride;
+
+  mmInt32 codx;
+  mmUint32 resizeFactorY;
+
+  /* per output column source index and packed weights */
+  const mmInt32 *xIdxY;
+  const mmUint32 *xWY;
+  const mmInt32 *xIdxUV;
+  const mmUint32 *xWUV;
+
+  /* samples of the intermediate rows read by the horizontal blend */
+  mmInt32 vLenY;
+  mmInt32 vLenUV;
+} resize_job_t;
+
+typedef struct
+{
+  const resize_job_t *job;
+  mmInt32 rowY, rowsY;
+  mmInt32 rowUV, rowsUV;
+  mmUint16 *v;
+  pthread_t thread;
+} resize_band_t;
+
+static void resizeBand(resize_band_t *band)
+{
+  const resize_job_t *job = band->job;
+  const resize_kernels_t *k = job->k;
+  mmInt32 row;
+
+  for (row = band->rowY; row < band->rowY + band->rowsY; row++)
+  {
+    mmUint32 pos = (mmUint32) row * job->resizeFactorY;
+    mmInt32 y  = pos >> 9;
+    mmInt32 yf = (pos >> 6) & 0x7;
+    const mmUchar *r1 = job->inY + y * job->inStride;
+
+    k->vblend(band->v, r1, r1 + job->inStride, yf, job->vLenY);
+    k->hblendY(job->outY + row * job->outStride, band->v,
+               job->xIdxY, job->xWY, job->codx);
+  }
+
+  for (row = band->rowUV; row < band->rowUV + band->rowsUV; row++)
+  {
+    mmUint32 pos = (mmUint32) row * job->resizeFactorY;
+    mmInt32 y  = pos >> 9;
+    mmInt32 yf = (pos >> 6) & 0x7;
+    const mmUchar *r1 = job->inUV + y * job->inStride;
+
+    k->vblend(band->v, r1, r1 + job->inStride, yf, job->vLenUV);
+    k->hblendUV(job->outUV + row * job->outStride, band->v,
+                job->xIdxUV, job->xWUV, job->codx >> 1);
+  }
+}
+
+static void* resizeBandThread(void *arg)
+{
+  resizeBand((resize_band_t *) arg);
+  return NULL;
+}
+
 /*==========================================================================
 * Function Name  : VT_resizeFrame_Video_opt2_lp
 *
@@ -31,37 +436,32 @@ VT_resizeFrame_Video_opt2_lp
  mmUint16 dummy                         /* Transparent pixel value              */
  )
 {
-  ALOGV("VT_resizeFrame_Video_opt2_lp+");
+  return VT_resizeFrame_Video_opt2_lp_ex(i_img_ptr, o_img_ptr, cropout, -1, 0);
+}
 
-  mmUint16 row,col;
+mmBool
+VT_resizeFrame_Video_opt2_lp_ex
+(
+ structConvImage* i_img_ptr,
+ structConvImage* o_img_ptr,
+ IC_rect_type*  cropout,
+ mmInt32 kernel,
+ mmInt32 threads
+ )
+{
+  resize_job_t job;
+  resize_band_t bands[RESIZE_MAX_THREADS];
   mmUint32 resizeFactorX;
-  mmUint32 resizeFactorY;
-
-
-  mmUint16 x, y;
-
-  mmUchar* ptr8;
-  mmUchar *ptr8Cb, *ptr8Cr;
-
-
-  mmUint16 xf, yf;
-  mmUchar* inImgPtrY;
-  mmUchar* inImgPtrU;
-  mmUchar* inImgPtrV;
-  mmUint32 cox, coy, codx, cody;
-  mmUint16 idx,idy, idxC;
+  mmInt32 cox, coy, codx, cody;
+  mmInt32 idx, idy;
+  mmInt32 col, i;
+  mmInt32 *xIdx = NULL;
+  mmUint32 *xW = NULL;
+  mmUint16 *scratch = NULL;
+  mmInt32 vLen;
+  mmBool ret = FALSE;
 
-  if(i_img_ptr->uWidth == o_img_ptr->uWidth)
-	{
-		if(i_img_ptr->uHeight == o_img_ptr->uHeight)
-			{
-				ALOGV("************************f(i_img_ptr->uHeight == o_img_ptr->uHeight) are same *********************\n");
-				ALOGV("************************(i_img_ptr->width == %d" , i_img_ptr->uWidth );
-				ALOGV("************************(i_img_ptr->uHeight == %d" , i_img_ptr->uHeight );
-				ALOGV("************************(o_img_ptr->width == %d" ,o_img_ptr->uWidth );
-				ALOGV("************************(o_img_ptr->uHeight == %d" , o_img_ptr->uHeight );
-			}
-	}
+  ALOGV("VT_resizeFrame_Video_opt2_lp+");
 
   if (!i_img_ptr || !i_img_ptr->imgPtr ||
     !o_img_ptr || !o_img_ptr->imgPtr)
@@ -71,9 +471,24 @@ VT_resizeFrame_Video_opt2_lp
 	return FALSE;
   }
 
-  inImgPtrY = (mmUchar *) i_img_ptr->imgPtr + i_img_ptr->uOffset;
-  inImgPtrU = (mmUchar *) i_img_ptr->clrPtr + i_img_ptr->uOffset/2;
-  inImgPtrV = (mmUchar*)inImgPtrU + 1;
+  if (i_img_ptr->eFormat != IC_FORMAT_YCbCr420_lp ||
+    o_img_ptr->eFormat != IC_FORMAT_YCbCr420_lp)
+  {
+	ALOGE("eFormat not supported");
+	ALOGV("VT_resizeFrame_Video_opt2_lp-");
+	return FALSE;
+  }
+
+  pthread_once(&gKernelOnce, probeKernels);
+
+  if (kernel < 0)
+    kernel = gBestKernel;
+
+  if (kernel >= KERNEL_SETS || !gKernelUsable[kernel])
+  {
+	ALOGE("Resize kernel %d not available", kernel);
+	return FALSE;
+  }
 
   if (cropout == NULL)
   {
@@ -100,208 +515,115 @@ VT_resizeFrame_Video_opt2_lp
 	return FALSE;
 	}
 
+  if (codx < 1 || cody < 1)
+	{
+	ALOGE("codx or cody less then 1 codx = %d cody = %d", codx, cody);
+	ALOGV("VT_resizeFrame_Video_opt2_lp-");
+	return FALSE;
+	}
+
   resizeFactorX = ((idx-1)<<9) / codx;
-  resizeFactorY = ((idy-1)<<9) / cody;
 
-  if(i_img_ptr->eFormat == IC_FORMAT_YCbCr420_lp &&
-    o_img_ptr->eFormat == IC_FORMAT_YCbCr420_lp)
+  job.k = &gKernels[kernel];
+  job.inY = (mmUchar *) i_img_ptr->imgPtr + i_img_ptr->uOffset;
+  job.inUV = (mmUchar *) i_img_ptr->clrPtr + i_img_ptr->uOffset/2;
+  job.inStride = i_img_ptr->uStride;
+  job.outY = (mmUchar *) o_img_ptr->imgPtr + cox + coy * o_img_ptr->uStride;
+  job.outUV = (mmUchar *) o_img_ptr->clrPtr + (cox & ~1) + (coy >> 1) * o_img_ptr->uStride;
+  job.outStride = o_img_ptr->uStride;
+  job.codx = codx;
+  job.resizeFactorY = ((idy-1)<<9) / cody;
+
+  /* column tables, luma first then chroma */
+  xIdx = (mmInt32 *) malloc((codx + (codx >> 1)) * sizeof(mmInt32));
+  xW = (mmUint32 *) malloc((codx + (codx >> 1)) * sizeof(mmUint32));
+  if (!xIdx || !xW)
   {
-    ptr8 = (mmUchar*)o_img_ptr->imgPtr + cox + coy*o_img_ptr->uWidth;
+	ALOGE("Failed to allocate column tables");
+	goto exit;
+  }
 
+  for (col = 0; col < codx; col++)
+  {
+    mmUint32 pos = (mmUint32) col * resizeFactorX;
+    mmInt32 xf = (pos >> 6) & 0x7;
 
-    ////////////////////////////for Y//////////////////////////
-    for (row=0; row < cody; row++)
+    xIdx[col] = pos >> 9;
+    xW[col] = (bWeights[xf][0][0] >> 3) | ((bWeights[xf][0][1] >> 3) << 16);
+    if (col < (codx >> 1))
     {
-        mmUchar *pu8Yrow1 = NULL;
-        mmUchar *pu8Yrow2 = NULL;
-        y  = (mmUint16) ((mmUint32) (row*resizeFactorY) >> 9);
-        yf = (mmUchar)  ((mmUint32)((row*resizeFactorY) >> 6) & 0x7);
-        pu8Yrow1 = inImgPtrY + (y) * i_img_ptr->uStride;
-        pu8Yrow2 = pu8Yrow1 + i_img_ptr->uStride;
-
-        for (col=0; col < codx; col++)
-        {
-            mmUchar in11, in12, in21, in22;
-            mmUchar *pu8ptr1 = NULL;
-            mmUchar *pu8ptr2 = NULL;
-            mmUchar w;
-            mmUint16 accum_1;
-            //mmUint32 accum_W;
-
-
-
-            x  = (mmUint16) ((mmUint32)  (col*resizeFactorX) >> 9);
-            xf = (mmUchar)  ((mmUint32) ((col*resizeFactorX) >> 6) & 0x7);
-
-
-            //accum_W = 0;
-            accum_1 =  0;
-
-            pu8ptr1 = pu8Yrow1 + (x);
-            pu8ptr2 = pu8Yrow2 + (x);
-
-            /* A pixel */
-            //in = *(inImgPtrY + (y)*idx + (x));
-            in11 = *(pu8ptr1);
-
-            w = bWeights[xf][yf][0];
-            accum_1 = (w * in11);
-            //accum_W += (w);
-
-            /* B pixel */
-            //in = *(inImgPtrY + (y)*idx + (x+1));
-            in12 = *(pu8ptr1+1);
-            w = bWeights[xf][yf][1];
-            accum_1 += (w * in12);
-            //accum_W += (w);
-
-            /* C pixel */
-            //in = *(inImgPtrY + (y+1)*idx + (x));
-            in21 = *(pu8ptr2);
-            w = bWeights[xf][yf][3];
-            accum_1 += (w * in21);
-            //accum_W += (w);
-
-            /* D pixel */
-            //in = *(inImgPtrY + (y+1)*idx + (x+1));
-            in22 = *(pu8ptr2+1);
-            w = bWeights[xf][yf][2];
-            accum_1 += (w * in22);
-            //accum_W += (w);
-
-            /* divide by sum of the weights */
-            //accum_1 /= (accum_W);
-            //accum_1 = (accum_1/64);
-            accum_1 = (accum_1>>6);
-            *ptr8 = (mmUchar)accum_1 ;
-
-
-            ptr8++;
-        }
-        ptr8 = ptr8 + (o_img_ptr->uStride - codx);
+      xIdx[codx + col] = 2 * xIdx[col];
+      xW[codx + col] = xW[col];
     }
-    ////////////////////////////for Y//////////////////////////
-
-    ///////////////////////////////for Cb-Cr//////////////////////
-
-    ptr8Cb = (mmUchar*)o_img_ptr->clrPtr + cox + coy*o_img_ptr->uWidth;
-
-    ptr8Cr = (mmUchar*)(ptr8Cb+1);
-
-    idxC = (idx>>1);
-    for (row=0; row < (((cody)>>1)); row++)
-    {
-        mmUchar *pu8Cbr1 = NULL;
-        mmUchar *pu8Cbr2 = NULL;
-        mmUchar *pu8Crr1 = NULL;
-        mmUchar *pu8Crr2 = NULL;
-
-        y  = (mmUint16) ((mmUint32) (row*resizeFactorY) >> 9);
-        yf = (mmUchar)  ((mmUint32)((row*resizeFactorY) >> 6) & 0x7);
-
-        pu8Cbr1 = inImgPtrU + (y) * i_img_ptr->uStride;
-        pu8Cbr2 = pu8Cbr1 + i_img_ptr->uStride;
-        pu8Crr1 = inImgPtrV + (y) * i_img_ptr->uStride;
-        pu8Crr2 = pu8Crr1 + i_img_ptr->uStride;
-
-        for (col=0; col < (((codx)>>1)); col++)
-        {
-            mmUchar in11, in12, in21, in22;
-            mmUchar *pu8Cbc1 = NULL;
-            mmUchar *pu8Cbc2 = NULL;
-            mmUchar *pu8Crc1 = NULL;
-            mmUchar *pu8Crc2 = NULL;
-
-            mmUchar w;
-            mmUint16 accum_1Cb, accum_1Cr;
-            //mmUint32 accum_WCb, accum_WCr;
-
-
-            x  = (mmUint16) ((mmUint32)  (col*resizeFactorX) >> 9);
-            xf = (mmUchar)  ((mmUint32) ((col*resizeFactorX) >> 6) & 0x7);
-
-
-            //accum_WCb = accum_WCr =  0;
-            accum_1Cb = accum_1Cr =  0;
-
-            pu8Cbc1 = pu8Cbr1 + (x*2);
-            pu8Cbc2 = pu8Cbr2 + (x*2);
-	    pu8Crc1 = pu8Crr1 + (x*2);
-            pu8Crc2 = pu8Crr2 + (x*2);
-
-
-
-            /* A pixel */
-            w = bWeights[xf][yf][0];
-
-            in11 = *(pu8Cbc1);
-            accum_1Cb = (w * in11);
-            //    accum_WCb += (w);
-
-			in11 = *(pu8Crc1);
-            accum_1Cr = (w * in11);
-            //accum_WCr += (w);
-
-            /* B pixel */
-            w = bWeights[xf][yf][1];
-
-            in12 = *(pu8Cbc1+2);
-            accum_1Cb += (w * in12);
-            //accum_WCb += (w);
-
-            in12 = *(pu8Crc1+2);
-            accum_1Cr += (w * in12);
-            //accum_WCr += (w);
-
-            /* C pixel */
-            w = bWeights[xf][yf][3];
-
-            in21 = *(pu8Cbc2);
-            accum_1Cb += (w * in21);
-            //accum_WCb += (w);
-
-			in21 = *(pu8Crc2);
-            accum_1Cr += (w * in21);
-            //accum_WCr += (w);
-
-            /* D pixel */
-            w = bWeights[xf][yf][2];
-
-            in22 = *(pu8Cbc2+2);
-            accum_1Cb += (w * in22);
-            //accum_WCb += (w);
-
-            in22 = *(pu8Crc2+2);
-            accum_1Cr += (w * in22);
-            //accum_WCr += (w);
+  }
 
-            /* divide by sum of the weights */
-            //accum_1Cb /= (accum_WCb);
-            accum_1Cb = (accum_1Cb>>6);
-            *ptr8Cb = (mmUchar)accum_1Cb ;
+  job.xIdxY = xIdx;
+  job.xWY = xW;
+  job.xIdxUV = xIdx + codx;
+  job.xWUV = xW + codx;
 
+  /* positions are monotonic, the last column reads furthest */
+  job.vLenY = xIdx[codx - 1] + 2;
+  job.vLenUV = (codx >> 1) ? xIdx[codx + (codx >> 1) - 1] + 4 : 0;
+  vLen = (job.vLenY > job.vLenUV) ? job.vLenY : job.vLenUV;
 
-            accum_1Cr = (accum_1Cr >> 6);
-            *ptr8Cr = (mmUchar)accum_1Cr ;
+  if (threads <= 0)
+  {
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > (codx * cody) / RESIZE_MIN_PIXELS_PER_THREAD)
+      threads = (codx * cody) / RESIZE_MIN_PIXELS_PER_THREAD;
+  }
+  if (threads > RESIZE_MAX_THREADS)
+    threads = RESIZE_MAX_THREADS;
+  if (threads > cody)
+    threads = cody;
+  if (threads < 1)
+    threads = 1;
+
+  /* gathers may touch one 32 bit word past the last sample */
+  scratch = (mmUint16 *) malloc(threads * (vLen + 2) * sizeof(mmUint16));
+  if (!scratch)
+  {
+	ALOGE("Failed to allocate row buffers");
+	goto exit;
+  }
 
-            ptr8Cb++;
-            ptr8Cr++;
+  for (i = 0; i < threads; i++)
+  {
+    bands[i].job = &job;
+    bands[i].rowY = (cody * i) / threads;
+    bands[i].rowsY = (cody * (i + 1)) / threads - bands[i].rowY;
+    bands[i].rowUV = ((cody >> 1) * i) / threads;
+    bands[i].rowsUV = ((cody >> 1) * (i + 1)) / threads - bands[i].rowUV;
+    bands[i].v = scratch + i * (vLen + 2);
+  }
 
-            ptr8Cb++;
-            ptr8Cr++;
-        }
-        ptr8Cb = ptr8Cb + (o_img_ptr->uStride-codx);
-        ptr8Cr = ptr8Cr + (o_img_ptr->uStride-codx);
+  /* the calling thread takes the first band */
+  for (i = 1; i < threads; i++)
+  {
+    if (pthread_create(&bands[i].thread, NULL, resizeBandThread, &bands[i]))
+    {
+      ALOGE("Failed to start resize thread, running band %d inline", i);
+      resizeBand(&bands[i]);
+      bands[i].rowsY = -1;
     }
-    ///////////////////For Cb- Cr////////////////////////////////////////
   }
-  else
+
+  resizeBand(&bands[0]);
+
+  for (i = 1; i < threads; i++)
   {
-	ALOGE("eFormat not supported");
-	ALOGV("VT_resizeFrame_Video_opt2_lp-");
-	return FALSE;
+    if (bands[i].rowsY >= 0)
+      pthread_join(bands[i].thread, NULL);
   }
+
   ALOGV("success");
+  ret = TRUE;
+
+exit:
+  free(xIdx);
+  free(xW);
+  free(scratch);
   ALOGV("VT_resizeFrame_Video_opt2_lp-");
-  return TRUE;
+  return ret;
 }
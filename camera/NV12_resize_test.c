@@ -0,0 +1,479 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Bit-exactness test for VT_resizeFrame_Video_opt2_lp.
+ *
+ * Every kernel set usable on this cpu, with 1 to 4 row bands, is checked
+ * against a copy of the original scalar implementation on a range of sizes,
+ * strides and output windows. The copy is verbatim except for where it
+ * places an output window, see resize_reference. Output windows are also
+ * checked against a plain resize to the window size. Also reports the time
+ * per frame.
+ *
+ * usage: nv12resizetest [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "NV12_resize.h"
+
+typedef struct
+{
+  int inWidth, inHeight, inStride;
+  int outWidth, outHeight, outStride;
+  int cropX, cropY, cropWidth, cropHeight; /* cropWidth 0: no crop */
+} test_case_t;
+
+static const test_case_t cases[] = {
+  /* thumbnails from preview and capture sizes */
+  {  640,  480,  640,  160,  120,  160, 0, 0,   0,   0 },
+  {  640,  480, 4096,  320,  240,  320, 0, 0,   0,   0 },
+  { 2592, 1944, 2592,  512,  384,  512, 0, 0,   0,   0 },
+  { 2592, 1944, 2624, 1280,  960, 1280, 0, 0,   0,   0 },
+  /* upscale, odd ratios and padded output */
+  {  176,  144,  192,  640,  480,  704, 0, 0,   0,   0 },
+  {  854,  480,  864,  202,  114,  256, 0, 0,   0,   0 },
+  {   18,   10,   32,    6,    4,    8, 0, 0,   0,   0 },
+  /* output window inside a larger frame */
+  { 1280,  720, 1280,  640,  480,  640, 16, 0, 320, 240 },
+  /* output window at odd and even rows of a padded output frame */
+  { 1280,  720, 1280,  640,  480,  768, 16, 37, 320, 240 },
+  {  640,  480,  704,  352,  288,  384, 33, 20, 176, 144 },
+};
+
+static mmBool
+resize_reference
+(
+ structConvImage* i_img_ptr,        /* Points to the input image           */
+ structConvImage* o_img_ptr,        /* Points to the output image          */
+ IC_rect_type*  cropout           /* how much to resize to in final image */
+ )
+{
+
+  mmUint16 row,col;
+  mmUint32 resizeFactorX;
+  mmUint32 resizeFactorY;
+
+
+  mmUint16 x, y;
+
+  mmUchar* ptr8;
+  mmUchar *ptr8Cb, *ptr8Cr;
+
+
+  mmUint16 xf, yf;
+  mmUchar* inImgPtrY;
+  mmUchar* inImgPtrU;
+  mmUchar* inImgPtrV;
+  mmUint32 cox, coy, codx, cody;
+  mmUint16 idx,idy;
+
+  if(i_img_ptr->uWidth == o_img_ptr->uWidth)
+	{
+		if(i_img_ptr->uHeight == o_img_ptr->uHeight)
+			{
+			}
+	}
+
+  if (!i_img_ptr || !i_img_ptr->imgPtr ||
+    !o_img_ptr || !o_img_ptr->imgPtr)
+  {
+	return FALSE;
+  }
+
+  inImgPtrY = (mmUchar *) i_img_ptr->imgPtr + i_img_ptr->uOffset;
+  inImgPtrU = (mmUchar *) i_img_ptr->clrPtr + i_img_ptr->uOffset/2;
+  inImgPtrV = (mmUchar*)inImgPtrU + 1;
+
+  if (cropout == NULL)
+  {
+    cox = 0;
+    coy = 0;
+    codx = o_img_ptr->uWidth;
+    cody = o_img_ptr->uHeight;
+  }
+  else
+  {
+    cox = cropout->x;
+    coy = cropout->y;
+    codx = cropout->uWidth;
+    cody = cropout->uHeight;
+  }
+  idx = i_img_ptr->uWidth;
+  idy = i_img_ptr->uHeight;
+
+  /* make sure valid input size */
+  if (idx < 1 || idy < 1 || i_img_ptr->uStride < 1)
+	{
+	return FALSE;
+	}
+
+  resizeFactorX = ((idx-1)<<9) / codx;
+  resizeFactorY = ((idy-1)<<9) / cody;
+
+  if(i_img_ptr->eFormat == IC_FORMAT_YCbCr420_lp &&
+    o_img_ptr->eFormat == IC_FORMAT_YCbCr420_lp)
+  {
+    /* The original placed the window at cox + coy*uWidth in both planes.
+     * Rows are uStride apart and chroma rows cover two luma rows, so the
+     * window starts coy rows down in luma, coy/2 rows down in chroma, on
+     * a CbCr pair boundary. */
+    ptr8 = (mmUchar*)o_img_ptr->imgPtr + cox + coy*o_img_ptr->uStride;
+
+
+    ////////////////////////////for Y//////////////////////////
+    for (row=0; row < cody; row++)
+    {
+        mmUchar *pu8Yrow1 = NULL;
+        mmUchar *pu8Yrow2 = NULL;
+        y  = (mmUint16) ((mmUint32) (row*resizeFactorY) >> 9);
+        yf = (mmUchar)  ((mmUint32)((row*resizeFactorY) >> 6) & 0x7);
+        pu8Yrow1 = inImgPtrY + (y) * i_img_ptr->uStride;
+        pu8Yrow2 = pu8Yrow1 + i_img_ptr->uStride;
+
+        for (col=0; col < codx; col++)
+        {
+            mmUchar in11, in12, in21, in22;
+            mmUchar *pu8ptr1 = NULL;
+            mmUchar *pu8ptr2 = NULL;
+            mmUchar w;
+            mmUint16 accum_1;
+            //mmUint32 accum_W;
+
+
+
+            x  = (mmUint16) ((mmUint32)  (col*resizeFactorX) >> 9);
+            xf = (mmUchar)  ((mmUint32) ((col*resizeFactorX) >> 6) & 0x7);
+
+
+            //accum_W = 0;
+            accum_1 =  0;
+
+            pu8ptr1 = pu8Yrow1 + (x);
+            pu8ptr2 = pu8Yrow2 + (x);
+
+            /* A pixel */
+            //in = *(inImgPtrY + (y)*idx + (x));
+            in11 = *(pu8ptr1);
+
+            w = bWeights[xf][yf][0];
+            accum_1 = (w * in11);
+            //accum_W += (w);
+
+            /* B pixel */
+            //in = *(inImgPtrY + (y)*idx + (x+1));
+            in12 = *(pu8ptr1+1);
+            w = bWeights[xf][yf][1];
+            accum_1 += (w * in12);
+            //accum_W += (w);
+
+            /* C pixel */
+            //in = *(inImgPtrY + (y+1)*idx + (x));
+            in21 = *(pu8ptr2);
+            w = bWeights[xf][yf][3];
+            accum_1 += (w * in21);
+            //accum_W += (w);
+
+            /* D pixel */
+            //in = *(inImgPtrY + (y+1)*idx + (x+1));
+            in22 = *(pu8ptr2+1);
+            w = bWeights[xf][yf][2];
+            accum_1 += (w * in22);
+            //accum_W += (w);
+
+            /* divide by sum of the weights */
+            //accum_1 /= (accum_W);
+            //accum_1 = (accum_1/64);
+            accum_1 = (accum_1>>6);
+            *ptr8 = (mmUchar)accum_1 ;
+
+
+            ptr8++;
+        }
+        ptr8 = ptr8 + (o_img_ptr->uStride - codx);
+    }
+    ////////////////////////////for Y//////////////////////////
+
+    ///////////////////////////////for Cb-Cr//////////////////////
+
+    ptr8Cb = (mmUchar*)o_img_ptr->clrPtr + (cox & ~1) + (coy>>1)*o_img_ptr->uStride;
+
+    ptr8Cr = (mmUchar*)(ptr8Cb+1);
+
+    for (row=0; row < (((cody)>>1)); row++)
+    {
+        mmUchar *pu8Cbr1 = NULL;
+        mmUchar *pu8Cbr2 = NULL;
+        mmUchar *pu8Crr1 = NULL;
+        mmUchar *pu8Crr2 = NULL;
+
+        y  = (mmUint16) ((mmUint32) (row*resizeFactorY) >> 9);
+        yf = (mmUchar)  ((mmUint32)((row*resizeFactorY) >> 6) & 0x7);
+
+        pu8Cbr1 = inImgPtrU + (y) * i_img_ptr->uStride;
+        pu8Cbr2 = pu8Cbr1 + i_img_ptr->uStride;
+        pu8Crr1 = inImgPtrV + (y) * i_img_ptr->uStride;
+        pu8Crr2 = pu8Crr1 + i_img_ptr->uStride;
+
+        for (col=0; col < (((codx)>>1)); col++)
+        {
+            mmUchar in11, in12, in21, in22;
+            mmUchar *pu8Cbc1 = NULL;
+            mmUchar *pu8Cbc2 = NULL;
+            mmUchar *pu8Crc1 = NULL;
+            mmUchar *pu8Crc2 = NULL;
+
+            mmUchar w;
+            mmUint16 accum_1Cb, accum_1Cr;
+            //mmUint32 accum_WCb, accum_WCr;
+
+
+            x  = (mmUint16) ((mmUint32)  (col*resizeFactorX) >> 9);
+            xf = (mmUchar)  ((mmUint32) ((col*resizeFactorX) >> 6) & 0x7);
+
+
+            //accum_WCb = accum_WCr =  0;
+            accum_1Cb = accum_1Cr =  0;
+
+            pu8Cbc1 = pu8Cbr1 + (x*2);
+            pu8Cbc2 = pu8Cbr2 + (x*2);
+	    pu8Crc1 = pu8Crr1 + (x*2);
+            pu8Crc2 = pu8Crr2 + (x*2);
+
+
+
+            /* A pixel */
+            w = bWeights[xf][yf][0];
+
+            in11 = *(pu8Cbc1);
+            accum_1Cb = (w * in11);
+            //    accum_WCb += (w);
+
+			in11 = *(pu8Crc1);
+            accum_1Cr = (w * in11);
+            //accum_WCr += (w);
+
+            /* B pixel */
+            w = bWeights[xf][yf][1];
+
+            in12 = *(pu8Cbc1+2);
+            accum_1Cb += (w * in12);
+            //accum_WCb += (w);
+
+            in12 = *(pu8Crc1+2);
+            accum_1Cr += (w * in12);
+            //accum_WCr += (w);
+
+            /* C pixel */
+            w = bWeights[xf][yf][3];
+
+            in21 = *(pu8Cbc2);
+            accum_1Cb += (w * in21);
+            //accum_WCb += (w);
+
+			in21 = *(pu8Crc2);
+            accum_1Cr += (w * in21);
+            //accum_WCr += (w);
+
+            /* D pixel */
+            w = bWeights[xf][yf][2];
+
+            in22 = *(pu8Cbc2+2);
+            accum_1Cb += (w * in22);
+            //accum_WCb += (w);
+
+            in22 = *(pu8Crc2+2);
+            accum_1Cr += (w * in22);
+            //accum_WCr += (w);
+
+            /* divide by sum of the weights */
+            //accum_1Cb /= (accum_WCb);
+            accum_1Cb = (accum_1Cb>>6);
+            *ptr8Cb = (mmUchar)accum_1Cb ;
+
+
+            accum_1Cr = (accum_1Cr >> 6);
+            *ptr8Cr = (mmUchar)accum_1Cr ;
+
+            ptr8Cb++;
+            ptr8Cr++;
+
+            ptr8Cb++;
+            ptr8Cr++;
+        }
+        ptr8Cb = ptr8Cb + (o_img_ptr->uStride-codx);
+        ptr8Cr = ptr8Cr + (o_img_ptr->uStride-codx);
+    }
+    ///////////////////For Cb- Cr////////////////////////////////////////
+  }
+  else
+  {
+	return FALSE;
+  }
+  return TRUE;
+}
+
+static double now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void setup(structConvImage *img, mmByte *buf, int width, int height, int stride)
+{
+  img->uWidth = width;
+  img->uHeight = height;
+  img->uStride = stride;
+  img->eFormat = IC_FORMAT_YCbCr420_lp;
+  img->imgPtr = buf;
+  img->clrPtr = buf + stride * height;
+  img->uOffset = 0;
+}
+
+/* input buffers are over-allocated by a few rows, the resize reads up to
+ * one row and one sample past the edge of each plane */
+static size_t frame_size(int stride, int height)
+{
+  return (size_t) stride * (height + 2) * 3 / 2 + 64;
+}
+
+/* The window written by a crop must be a plain resize to the window size,
+ * placed cropY rows and cropX columns into the luma plane and cropY/2 rows
+ * and the CbCr pair holding cropX into the chroma plane */
+static int check_window(const test_case_t *tc, structConvImage *iImg,
+                        const structConvImage *oImg)
+{
+  size_t plainSize = frame_size(tc->cropWidth, tc->cropHeight);
+  mmByte *plain = malloc(plainSize);
+  structConvImage pImg;
+  const mmByte *win, *ref;
+  int row, ok = 1;
+
+  setup(&pImg, plain, tc->cropWidth, tc->cropHeight, tc->cropWidth);
+  resize_reference(iImg, &pImg, NULL);
+
+  for (row = 0; row < tc->cropHeight && ok; row++)
+  {
+    win = (const mmByte *) oImg->imgPtr + tc->cropX + (tc->cropY + row) * tc->outStride;
+    ref = (const mmByte *) pImg.imgPtr + row * tc->cropWidth;
+    ok = !memcmp(win, ref, tc->cropWidth);
+  }
+  for (row = 0; row < tc->cropHeight / 2 && ok; row++)
+  {
+    win = (const mmByte *) oImg->clrPtr + (tc->cropX & ~1) + (tc->cropY / 2 + row) * tc->outStride;
+    ref = (const mmByte *) pImg.clrPtr + row * tc->cropWidth;
+    ok = !memcmp(win, ref, tc->cropWidth);
+  }
+
+  free(plain);
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = (argc > 1) ? atoi(argv[1]) : 10;
+  int failures = 0;
+  unsigned int c;
+  int k, t, it;
+
+  srand(1);
+
+  for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+  {
+    const test_case_t *tc = &cases[c];
+    size_t inSize = frame_size(tc->inStride, tc->inHeight);
+    size_t outSize = frame_size(tc->outStride, tc->outHeight);
+    mmByte *in = malloc(inSize);
+    mmByte *ref = malloc(outSize);
+    mmByte *out = malloc(outSize);
+    structConvImage iImg, oImg;
+    IC_rect_type crop, *cropPtr = NULL;
+    size_t i;
+
+    for (i = 0; i < inSize; i++)
+      in[i] = rand();
+
+    if (tc->cropWidth)
+    {
+      crop.x = tc->cropX;
+      crop.y = tc->cropY;
+      crop.uWidth = tc->cropWidth;
+      crop.uHeight = tc->cropHeight;
+      cropPtr = &crop;
+    }
+
+    setup(&iImg, in, tc->inWidth, tc->inHeight, tc->inStride);
+    memset(ref, 0x5a, outSize);
+    setup(&oImg, ref, tc->outWidth, tc->outHeight, tc->outStride);
+    resize_reference(&iImg, &oImg, cropPtr);
+
+    if (cropPtr && !check_window(tc, &iImg, &oImg))
+    {
+      printf("FAIL %dx%d/%d -> %dx%d/%d window %d,%d %dx%d misplaced\n",
+             tc->inWidth, tc->inHeight, tc->inStride,
+             tc->outWidth, tc->outHeight, tc->outStride,
+             tc->cropX, tc->cropY, tc->cropWidth, tc->cropHeight);
+      failures++;
+    }
+
+    for (k = 0; k < VT_resizeKernelCount(); k++)
+    {
+      const char *name = VT_resizeKernelName(k);
+
+      if (!name)
+        continue;
+
+      for (t = 1; t <= 4; t++)
+      {
+        double start, elapsed;
+
+        memset(out, 0x5a, outSize);
+        setup(&oImg, out, tc->outWidth, tc->outHeight, tc->outStride);
+
+        if (!VT_resizeFrame_Video_opt2_lp_ex(&iImg, &oImg, cropPtr, k, t) ||
+            memcmp(ref, out, outSize))
+        {
+          printf("FAIL %dx%d/%d -> %dx%d/%d %s, %d threads\n",
+                 tc->inWidth, tc->inHeight, tc->inStride,
+                 tc->outWidth, tc->outHeight, tc->outStride, name, t);
+          failures++;
+          continue;
+        }
+
+        start = now_ms();
+        for (it = 0; it < iterations; it++)
+          VT_resizeFrame_Video_opt2_lp_ex(&iImg, &oImg, cropPtr, k, t);
+        elapsed = (now_ms() - start) / (iterations ? iterations : 1);
+
+        printf("ok   %dx%d -> %dx%d %-6s %d threads %8.3f ms\n",
+               tc->inWidth, tc->inHeight, tc->outWidth, tc->outHeight,
+               name, t, elapsed);
+      }
+    }
+
+    free(in);
+    free(ref);
+    free(out);
+  }
+
+  printf("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
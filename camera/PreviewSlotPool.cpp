@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#define LOG_TAG "CameraHAL"
+
+#include "PreviewSlotPool.h"
+
+#include <utils/Log.h>
+#include <cutils/atomic.h>
+
+namespace android {
+
+PreviewSlotPool::PreviewSlotPool()
+{
+    for ( int i = 0 ; i < MAX_SLOTS ; i++ ) {
+        mRefs[i] = 0;
+    }
+
+    mCount = MAX_SLOTS;
+    mNext = 0;
+    mHoldTime = 0;
+    mHeldFirst = 0;
+    mHeldCount = 0;
+    mDropped = 0;
+}
+
+void PreviewSlotPool::reset(int count, nsecs_t holdTime)
+{
+    mCount = ( ( 0 < count ) && ( count <= MAX_SLOTS ) ) ? count : MAX_SLOTS;
+    mNext = 0;
+    mHoldTime = holdTime;
+    mDropped = 0;
+}
+
+void PreviewSlotPool::expire(nsecs_t now)
+{
+    while ( ( 0 < mHeldCount ) && ( ( now - mHeld[mHeldFirst].mSent ) >= mHoldTime ) ) {
+        release(mHeld[mHeldFirst].mSlot);
+        mHeldFirst = ( mHeldFirst + 1 ) % MAX_SLOTS;
+        mHeldCount--;
+    }
+}
+
+int PreviewSlotPool::acquire(nsecs_t now)
+{
+    expire(now);
+
+    for ( int i = 0 ; i < mCount ; i++ ) {
+        int slot = ( mNext + i ) % mCount;
+
+        if ( 0 == android_atomic_acquire_load(&mRefs[slot]) ) {
+            android_atomic_inc(&mRefs[slot]);
+            mNext = ( slot + 1 ) % mCount;
+            return slot;
+        }
+    }
+
+    mDropped++;
+
+    return -1;
+}
+
+void PreviewSlotPool::release(int slot)
+{
+    int32_t refs;
+
+    if ( ( slot < 0 ) || ( slot >= MAX_SLOTS ) ) {
+        return;
+    }
+
+    // Never below 0, a slice with a negative count would never be refilled
+    do {
+        refs = android_atomic_acquire_load(&mRefs[slot]);
+        if ( 0 >= refs ) {
+            ALOGE("Preview slice %d released more often than acquired", slot);
+            return;
+        }
+    } while ( 0 != android_atomic_release_cas(refs, refs - 1, &mRefs[slot]) );
+}
+
+void PreviewSlotPool::hold(int slot, nsecs_t now)
+{
+    // Every held slice has a reference, so there is always room for one
+    // more while a slice was free to be acquired
+    if ( MAX_SLOTS <= mHeldCount ) {
+        ALOGE("Preview slice %d held with no room left", slot);
+        release(slot);
+        return;
+    }
+
+    mHeld[( mHeldFirst + mHeldCount ) % MAX_SLOTS].mSlot = slot;
+    mHeld[( mHeldFirst + mHeldCount ) % MAX_SLOTS].mSent = now;
+    mHeldCount++;
+}
+
+void PreviewSlotPool::releaseHeld()
+{
+    while ( 0 < mHeldCount ) {
+        release(mHeld[mHeldFirst].mSlot);
+        mHeldFirst = ( mHeldFirst + 1 ) % MAX_SLOTS;
+        mHeldCount--;
+    }
+}
+
+int PreviewSlotPool::refs(int slot) const
+{
+    return android_atomic_acquire_load(( volatile int32_t * ) &mRefs[slot]);
+}
+
+uint32_t PreviewSlotPool::dropped() const
+{
+    return mDropped;
+}
+
+};
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test for PreviewSlotPool, the preview callback slices of
+ * AppCallbackNotifier.
+ *
+ * Frames are fed on a simulated clock the way copyAndSendPreviewFrame
+ * does: acquire a slice, send it, hold it. With the hold time the notifier
+ * uses, MAX_SLOTS - 1 frame intervals, a camera at the nominal rate or
+ * with an occasional early frame drops nothing. A camera faster than the
+ * slices come free drops frames and counts them. In every case a slice is
+ * never handed out again before the hold time since it was sent, and no
+ * reference is left once the held slices are released.
+ *
+ * usage: previewslotpooltest
+ */
+
+#include <stdio.h>
+
+#include "PreviewSlotPool.h"
+
+using namespace android;
+
+#define FRAMES 3000
+#define INTERVAL 33333333LL         /* ns, 30 fps */
+#define HOLD_TIME ((PreviewSlotPool::MAX_SLOTS - 1) * INTERVAL)
+
+typedef struct
+{
+  const char *name;
+  nsecs_t interval;
+  int earlyEvery;                   /* every nth frame is early, 0 never */
+  nsecs_t early;
+  bool drops;                       /* frames are expected to be dropped */
+} test_case_t;
+
+static const test_case_t cases[] = {
+  { "nominal rate",          INTERVAL,             0, 0,                false },
+  { "early frame",           INTERVAL,             5, INTERVAL * 9 / 10, false },
+  { "slightly fast",         INTERVAL * 99 / 100,  0, 0,                false },
+  { "twice the rate",        INTERVAL / 2,         0, 0,                true  },
+  { "burst",                 INTERVAL / 10,        0, 0,                true  },
+};
+
+static int run(PreviewSlotPool &pool, const test_case_t *tc)
+{
+  nsecs_t sent[PreviewSlotPool::MAX_SLOTS];
+  nsecs_t now;
+  int failures = 0, slot;
+  uint32_t dropped = 0;
+
+  for (int i = 0; i < PreviewSlotPool::MAX_SLOTS; i++)
+    sent[i] = -HOLD_TIME;
+
+  pool.reset(PreviewSlotPool::MAX_SLOTS, HOLD_TIME);
+
+  for (int n = 0; n < FRAMES; n++) {
+    now = (n + 1) * tc->interval;
+    if (tc->earlyEvery && n % tc->earlyEvery == 0)
+      now -= tc->early;
+
+    slot = pool.acquire(now);
+    if (slot < 0) {
+      dropped++;
+      continue;
+    }
+
+    if (now - sent[slot] < HOLD_TIME) {
+      if (failures++ < 5)
+        printf("FAIL %s: slice %d refilled %lld ns after it was sent\n",
+               tc->name, slot, (long long) (now - sent[slot]));
+    }
+
+    if (pool.refs(slot) != 1) {
+      if (failures++ < 5)
+        printf("FAIL %s: slice %d acquired with %d references\n", tc->name,
+               slot, pool.refs(slot));
+    }
+
+    /* copy, mDataCb, then keep the slice for the application */
+    sent[slot] = now;
+    pool.hold(slot, now);
+  }
+
+  if (pool.dropped() != dropped) {
+    printf("FAIL %s: %u drops counted, %u frames dropped\n", tc->name,
+           pool.dropped(), dropped);
+    failures++;
+  }
+
+  if (tc->drops != (dropped > 0)) {
+    printf("FAIL %s: %u frames dropped\n", tc->name, dropped);
+    failures++;
+  }
+
+  /* preview callbacks stop */
+  pool.releaseHeld();
+  for (int i = 0; i < PreviewSlotPool::MAX_SLOTS; i++) {
+    if (pool.refs(i) != 0) {
+      printf("FAIL %s: slice %d left with %d references\n", tc->name, i,
+             pool.refs(i));
+      failures++;
+    }
+  }
+
+  printf("%s %-15s %4u of %d frames dropped\n", failures ? "FAIL" : "ok  ",
+         tc->name, dropped, FRAMES);
+
+  return failures;
+}
+
+int main()
+{
+  PreviewSlotPool pool;
+  int failures = 0, slot;
+
+  for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    failures += run(pool, &cases[i]);
+
+  /* a slice not sent while preview stops goes straight back */
+  pool.reset(PreviewSlotPool::MAX_SLOTS, HOLD_TIME);
+  slot = pool.acquire(0);
+  pool.release(slot);
+  if (slot < 0 || pool.refs(slot) != 0 || pool.dropped() != 0) {
+    printf("FAIL unsent slice %d kept %d references\n", slot,
+           slot < 0 ? -1 : pool.refs(slot));
+    failures++;
+  }
+
+  printf("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
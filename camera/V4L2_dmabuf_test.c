@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * DMABUF preview import test, meant to be run against vivid.
+ *
+ * Follows what V4LCameraAdapter does in DMABUF mode: every slot gets a
+ * dma-buf fd and a CPU mapping of the same pages, the fd is queued with the
+ * buffer length taken from the dma-buf itself and frames are read back
+ * through the mapping of the dequeued slot. The mappings are created in
+ * reverse slot order so their addresses do not sort like the slots. Each
+ * buffer is filled with a sentinel before it is queued, the frame
+ * dequeued from slot i must have overwritten slot i's mapping.
+ *
+ * The buffers come from /dev/udmabuf, which like gralloc hands out a
+ * dma-buf over pages the process can map. Without a capture device or
+ * udmabuf the test is skipped.
+ *
+ * usage: v4l2dmabuftest [device] [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/videodev2.h>
+
+#ifndef UDMABUF_CREATE
+struct udmabuf_create
+{
+  unsigned int memfd;
+  unsigned int flags;
+  unsigned long long offset;
+  unsigned long long size;
+};
+#define UDMABUF_CREATE _IOW('u', 0x42, struct udmabuf_create)
+#endif
+
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_SEAL_SHRINK 0x0002
+#endif
+
+#define BUFFER_COUNT 6
+#define SENTINEL 0xa5
+#define FRAME_TIMEOUT 2000 /* ms */
+
+typedef struct
+{
+  int fd;                           /* dma-buf queued to the driver */
+  unsigned char *virt;              /* CPU mapping of the same pages */
+  size_t length;
+} slot_t;
+
+static slot_t slots[BUFFER_COUNT];
+
+static int skip(const char *what)
+{
+  printf("SKIPPED: %s: %s\n", what, strerror(errno));
+  return 0;
+}
+
+static int alloc_slot(int udmabuf, slot_t *slot, size_t size)
+{
+  struct udmabuf_create create;
+  int memfd;
+
+  memfd = syscall(__NR_memfd_create, "v4l2dmabuftest", MFD_ALLOW_SEALING);
+  if (memfd < 0)
+    return -1;
+
+  if (ftruncate(memfd, size) < 0 ||
+      fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) < 0) {
+    close(memfd);
+    return -1;
+  }
+
+  slot->virt = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+  if (slot->virt == MAP_FAILED) {
+    close(memfd);
+    return -1;
+  }
+
+  memset(&create, 0, sizeof(create));
+  create.memfd = memfd;
+  create.size = size;
+  slot->fd = ioctl(udmabuf, UDMABUF_CREATE, &create);
+  close(memfd);
+  if (slot->fd < 0) {
+    munmap(slot->virt, size);
+    return -1;
+  }
+
+  /* as in UseBuffersPreview: the dma-buf's own size, not the driver's */
+  slot->length = lseek(slot->fd, 0, SEEK_END);
+  return 0;
+}
+
+static int queue_slot(int cam, int index)
+{
+  struct v4l2_buffer buf;
+
+  memset(slots[index].virt, SENTINEL, slots[index].length);
+
+  memset(&buf, 0, sizeof(buf));
+  buf.index = index;
+  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buf.memory = V4L2_MEMORY_DMABUF;
+  buf.m.fd = slots[index].fd;
+  buf.length = slots[index].length;
+  return ioctl(cam, VIDIOC_QBUF, &buf);
+}
+
+static int written(const slot_t *slot, size_t bytes)
+{
+  size_t i;
+
+  for (i = 0; i < bytes; i++)
+    if (slot->virt[i] != SENTINEL)
+      return 1;
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *device = argc > 1 ? argv[1] : "/dev/video0";
+  int frames = argc > 2 ? atoi(argv[2]) : 60;
+  struct v4l2_requestbuffers rb;
+  struct v4l2_buffer buf;
+  struct v4l2_format fmt;
+  enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  struct pollfd pfd;
+  size_t size, page = sysconf(_SC_PAGESIZE);
+  int cam, udmabuf, i, n, failures = 0;
+
+  cam = open(device, O_RDWR | O_NONBLOCK);
+  if (cam < 0)
+    return skip(device);
+
+  udmabuf = open("/dev/udmabuf", O_RDWR);
+  if (udmabuf < 0)
+    return skip("/dev/udmabuf");
+
+  memset(&fmt, 0, sizeof(fmt));
+  fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  fmt.fmt.pix.width = 640;
+  fmt.fmt.pix.height = 480;
+  fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_NV12;
+  if (ioctl(cam, VIDIOC_S_FMT, &fmt) < 0 && ioctl(cam, VIDIOC_G_FMT, &fmt) < 0)
+    return skip("VIDIOC_G_FMT");
+
+  memset(&rb, 0, sizeof(rb));
+  rb.count = BUFFER_COUNT;
+  rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  rb.memory = V4L2_MEMORY_DMABUF;
+  if (ioctl(cam, VIDIOC_REQBUFS, &rb) < 0)
+    return skip("DMABUF import");
+  if (rb.count > BUFFER_COUNT)
+    rb.count = BUFFER_COUNT;
+
+  /* like gralloc, allocate more than the driver asks for, page rounded */
+  size = (fmt.fmt.pix.sizeimage + page + page - 1) & ~(page - 1);
+
+  /* reverse order, so mapping addresses do not follow the slots */
+  for (i = rb.count - 1; i >= 0; i--) {
+    memset(&buf, 0, sizeof(buf));
+    buf.index = i;
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_DMABUF;
+    if (ioctl(cam, VIDIOC_QUERYBUF, &buf) < 0)
+      return skip("VIDIOC_QUERYBUF");
+
+    if (alloc_slot(udmabuf, &slots[i], size) < 0)
+      return skip("udmabuf allocation");
+
+    if (slots[i].length < buf.length || slots[i].length != size) {
+      printf("FAIL slot %d: dma-buf length %zu, driver needs %u, allocated %zu\n",
+             i, slots[i].length, buf.length, size);
+      failures++;
+    }
+  }
+
+  for (i = 0; i < (int) rb.count; i++) {
+    if (queue_slot(cam, i) < 0) {
+      printf("FAIL slot %d: VIDIOC_QBUF: %s\n", i, strerror(errno));
+      return 1;
+    }
+  }
+
+  if (ioctl(cam, VIDIOC_STREAMON, &type) < 0) {
+    printf("FAIL VIDIOC_STREAMON: %s\n", strerror(errno));
+    return 1;
+  }
+
+  pfd.fd = cam;
+  pfd.events = POLLIN;
+
+  for (n = 0; n < frames; n++) {
+    pfd.revents = 0;
+    if (poll(&pfd, 1, FRAME_TIMEOUT) <= 0 || (pfd.revents & POLLERR)) {
+      printf("FAIL frame %d: no frame within %d ms\n", n, FRAME_TIMEOUT);
+      failures++;
+      break;
+    }
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_DMABUF;
+    if (ioctl(cam, VIDIOC_DQBUF, &buf) < 0) {
+      if (errno == EAGAIN)
+        continue;
+      printf("FAIL frame %d: VIDIOC_DQBUF: %s\n", n, strerror(errno));
+      failures++;
+      break;
+    }
+
+    if (buf.index >= rb.count || buf.m.fd != slots[buf.index].fd) {
+      printf("FAIL frame %d: slot %u came back with fd %d\n", n, buf.index,
+             buf.m.fd);
+      failures++;
+      break;
+    }
+
+    /* the pixels of slot i must be read through slot i's mapping */
+    if (!written(&slots[buf.index], buf.bytesused)) {
+      printf("FAIL frame %d: slot %u mapping not written\n", n, buf.index);
+      failures++;
+    }
+
+    if (queue_slot(cam, buf.index) < 0) {
+      printf("FAIL frame %d: VIDIOC_QBUF: %s\n", n, strerror(errno));
+      failures++;
+      break;
+    }
+  }
+
+  ioctl(cam, VIDIOC_STREAMOFF, &type);
+
+  for (i = 0; i < (int) rb.count; i++) {
+    munmap(slots[i].virt, size);
+    close(slots[i].fd);
+  }
+  close(udmabuf);
+  close(cam);
+
+  printf("%d frames through %u slots\n", n, rb.count);
+  printf("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -35,6 +35,8 @@
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/select.h>
+#include <sys/epoll.h>
+#include <poll.h>
 #include <linux/videodev.h>
 
 #include <cutils/properties.h>
@@ -73,6 +75,10 @@ status_t V4LCameraAdapter::initialize(int CameraHandle)
     property_get("debug.camera.showfps", value, "0");
     mDebugFps = atoi(value);
 
+    //Queue the gralloc buffers to the driver by fd instead of by mapping
+    property_get("camera.v4l2.dmabuf", value, "0");
+    mUseDmaBuf = ( 0 != atoi(value) );
+
     int ret = NO_ERROR;
 
     // Allocate memory for video info structure
@@ -103,6 +109,43 @@ status_t V4LCameraAdapter::initialize(int CameraHandle)
         return -EINVAL;
         }
 
+    // Frames are dequeued from GetFrames() once epoll reports them ready
+    ret = fcntl(mCameraHandle, F_GETFL);
+    if ( ( ret < 0 ) || ( fcntl(mCameraHandle, F_SETFL, ret | O_NONBLOCK) < 0 ) )
+        {
+        CAMHAL_LOGEB("Unable to make the camera non-blocking: %s", strerror(errno));
+        return -errno;
+        }
+
+    // a previous initialization watched the old camera handle
+    if ( -1 != mEpollFd )
+        {
+        close(mEpollFd);
+        mEpollFd = -1;
+        mEpollWakeFd = -1;
+        }
+
+    mEpollFd = epoll_create(2);
+    if ( mEpollFd < 0 )
+        {
+        CAMHAL_LOGEB("epoll_create failed: %s", strerror(errno));
+        return -errno;
+        }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = mCameraHandle;
+    if ( epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mCameraHandle, &ev) < 0 )
+        {
+        ret = -errno;
+        CAMHAL_LOGEB("Unable to watch the camera: %s", strerror(errno));
+        close(mEpollFd);
+        mEpollFd = -1;
+        return ret;
+        }
+
+    ret = NO_ERROR;
+
     // Initialize flags
     mPreviewing = false;
     mVideoInfo->isStreaming = false;
@@ -140,10 +183,7 @@ status_t V4LCameraAdapter::fillThisBuffer(void* frameBuf, CameraFrame::FrameType
         return BAD_VALUE;
     }
 
-    mVideoInfo->buf.index = i;
-    mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    mVideoInfo->buf.memory = V4L2_MEMORY_USERPTR;
-    mVideoInfo->buf.m.userptr = (unsigned long)mIonHandle.keyAt(i);
+    setPreviewBuffer(mVideoInfo->buf, i);
 
     ret = ioctl(mCameraHandle, VIDIOC_QBUF, &mVideoInfo->buf);
     if (ret < 0) {
@@ -214,11 +254,12 @@ status_t V4LCameraAdapter::useBuffers(CameraMode mode, void* bufArr, int num, si
 
 char** V4LCameraAdapter:: getVirtualAddress(int count)
 {
-    char** buf = new char*[6];
+    char** buf = new char*[count];
 
+    //By buffer slot, mIonHandle is sorted by address
     for(int i = 0; i < count; i ++)
     {
-        buf[i] = (char *)mIonHandle.keyAt(i);
+        buf[i] = ( i < MAX_NO_BUFFERS ) ? mPreviewVirt[i] : NULL;
     }
     return buf;
 }
@@ -230,20 +271,40 @@ status_t V4LCameraAdapter::UseBuffersPreview(void* bufArr, int num)
     int ret = NO_ERROR;
     int width, height;
 
-    if(NULL == bufArr)
+    if( ( NULL == bufArr ) || ( num > MAX_NO_BUFFERS ) )
     {
         return BAD_VALUE;
     }
 
     /* Check if camera can handle NB_BUFFER buffers */
     mVideoInfo->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    mVideoInfo->rb.memory = V4L2_MEMORY_USERPTR;
     mVideoInfo->rb.count = num;
+    mPreviewMemory = V4L2_MEMORY_USERPTR;
 
-    ret = ioctl(mCameraHandle, VIDIOC_REQBUFS, &mVideoInfo->rb);
-    if (ret < 0) {
-        CAMHAL_LOGEB("VIDIOC_REQBUFS failed: %s", strerror(errno));
-        return ret;
+#ifdef VIDIOC_EXPBUF
+    if ( mUseDmaBuf )
+    {
+        mVideoInfo->rb.memory = V4L2_MEMORY_DMABUF;
+        if ( 0 == ioctl(mCameraHandle, VIDIOC_REQBUFS, &mVideoInfo->rb) )
+        {
+            mPreviewMemory = V4L2_MEMORY_DMABUF;
+        }
+        else
+        {
+            CAMHAL_LOGEB("DMABUF import not supported (%s), using USERPTR", strerror(errno));
+            mVideoInfo->rb.count = num;
+        }
+    }
+#endif
+
+    if ( V4L2_MEMORY_USERPTR == mPreviewMemory )
+    {
+        mVideoInfo->rb.memory = V4L2_MEMORY_USERPTR;
+        ret = ioctl(mCameraHandle, VIDIOC_REQBUFS, &mVideoInfo->rb);
+        if (ret < 0) {
+            CAMHAL_LOGEB("VIDIOC_REQBUFS failed: %s", strerror(errno));
+            return ret;
+        }
     }
 
 
@@ -253,13 +314,16 @@ status_t V4LCameraAdapter::UseBuffersPreview(void* bufArr, int num)
 
         mVideoInfo->buf.index = i;
         mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        mVideoInfo->buf.memory = V4L2_MEMORY_USERPTR;
+        mVideoInfo->buf.memory = mPreviewMemory;
 
         ret = ioctl (mCameraHandle, VIDIOC_QUERYBUF, &mVideoInfo->buf);
         if (ret < 0) {
             CAMHAL_LOGEB("Unable to query buffer (%s)", strerror(errno));
             return ret;
         }
+
+        //The size the driver needs, raised below to the imported buffer's
+        mPreviewLength[i] = mVideoInfo->buf.length;
     }
 
     if( mIonHandle.isEmpty() )
@@ -299,8 +363,27 @@ status_t V4LCameraAdapter::UseBuffersPreview(void* bufArr, int num)
             CAMHAL_LOGEB(" buff_t is %x ", buff_t);
 
             mIonHandle.add((void*)buff_t,i);
+
+            //mIonHandle is sorted by address, slot i is recorded here
+            mPreviewGralloc[i] = (int) ptr[i];
+            mPreviewVirt[i] = (char *) buff_t;
+            //The gralloc share fd, imported as is by the driver in DMABUF mode
+            mPreviewFd[i] = ((IMG_native_handle_t*) ptr[i])->fd[0];
+        }
+    }
+
+#ifdef VIDIOC_EXPBUF
+    //A dma-buf reports its size through lseek, queue it rather than the
+    //driver's minimum so the import covers the whole gralloc buffer
+    for (int i = 0; ( V4L2_MEMORY_DMABUF == mPreviewMemory ) && ( i < num ); i++)
+    {
+        off_t size = lseek(mPreviewFd[i], 0, SEEK_END);
+        if ( ( 0 < size ) && ( ( size_t ) size > mPreviewLength[i] ) )
+        {
+            mPreviewLength[i] = size;
         }
     }
+#endif
 
     // Update the preview buffer count
     mPreviewBufferCount = num;
@@ -357,6 +440,16 @@ status_t V4LCameraAdapter::takePicture()
     mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     mVideoInfo->buf.memory = V4L2_MEMORY_USERPTR;
 
+    /* The camera is non-blocking, wait for the shot first */
+    struct pollfd pfd;
+    pfd.fd = mCameraHandle;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if ( poll(&pfd, 1, CAMERA_ADAPTER_TIMEOUT / 1000) <= 0 ) {
+        CAMHAL_LOGEA("takePicture: timed out waiting for the frame");
+        return -ETIMEDOUT;
+    }
+
     /* DQ */
     ret = ioctl(mCameraHandle, VIDIOC_DQBUF, &mVideoInfo->buf);
     if (ret < 0) {
@@ -391,11 +484,7 @@ status_t V4LCameraAdapter::startPreview()
 
    for (int i = 0; i < mPreviewBufferCount; i++)
    {
-       mVideoInfo->buf.index = i;
-       mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-       mVideoInfo->buf.memory = V4L2_MEMORY_USERPTR;
-
-       mVideoInfo->buf.m.userptr = (unsigned long)mIonHandle.keyAt(i);
+       setPreviewBuffer(mVideoInfo->buf, i);
 
        ret = ioctl(mCameraHandle, VIDIOC_QBUF, &mVideoInfo->buf);
        if (ret < 0) {
@@ -468,24 +557,197 @@ status_t V4LCameraAdapter::stopPreview(bool check)
     return ret;
 }
 
+void V4LCameraAdapter::setPreviewBuffer(struct v4l2_buffer &buf, int index)
+{
+    buf.index = index;
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = mPreviewMemory;
+
+#ifdef VIDIOC_EXPBUF
+    if ( V4L2_MEMORY_DMABUF == mPreviewMemory )
+    {
+        buf.m.fd = mPreviewFd[index];
+        buf.length = mPreviewLength[index];
+        return;
+    }
+#endif
+
+    buf.m.userptr = (unsigned long) mPreviewVirt[index];
+}
+
 char* V4LCameraAdapter::GetFrame(int &index)
 {
-    int ret;
+    struct pollfd pfd;
+    char *frame = NULL;
 
-    mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    mVideoInfo->buf.memory = V4L2_MEMORY_USERPTR;
+    // Waits on the camera alone, the wakeup descriptor registered by the
+    // preview thread stays in mEpollFd for its next GetFrames()
+    pfd.fd = mCameraHandle;
+    pfd.events = POLLIN;
 
-    /* DQ */
-    ret = ioctl(mCameraHandle, VIDIOC_DQBUF, &mVideoInfo->buf);
-    if (ret < 0) {
-        CAMHAL_LOGEA("GetFrame: VIDIOC_DQBUF Failed");
-        return NULL;
-    }
-     nDequeued++;
+    while ( 0 == dequeueFrames(&index, &frame, 1) )
+        {
+        pfd.revents = 0;
+        if ( ( poll(&pfd, 1, -1) < 0 ) && ( EINTR != errno ) )
+            {
+            CAMHAL_LOGEB("GetFrame: poll failed: %s", strerror(errno));
+            return NULL;
+            }
+        }
+
+    return frame;
+}
+
+status_t V4LCameraAdapter::setWakeFd(int wakeFd)
+{
+    struct epoll_event ev;
+
+    if ( wakeFd == mEpollWakeFd )
+        {
+        return NO_ERROR;
+        }
 
-    index = mVideoInfo->buf.index;
+    if ( -1 != mEpollWakeFd )
+        {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, mEpollWakeFd, &ev);
+        mEpollWakeFd = -1;
+        }
+
+    if ( -1 != wakeFd )
+        {
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeFd;
+        if ( epoll_ctl(mEpollFd, EPOLL_CTL_ADD, wakeFd, &ev) < 0 )
+            {
+            CAMHAL_LOGEB("Unable to watch wakeup fd %d: %s", wakeFd, strerror(errno));
+            return -errno;
+            }
+        mEpollWakeFd = wakeFd;
+        }
+
+    return NO_ERROR;
+}
+
+int V4LCameraAdapter::dequeueFrames(int *indices, char **frames, int maxFrames)
+{
+    struct v4l2_buffer buf;
+    int count = 0;
+    int err;
+
+    while ( count < maxFrames )
+        {
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = mPreviewMemory;
+
+        if ( ioctl(mCameraHandle, VIDIOC_DQBUF, &buf) < 0 )
+            {
+            err = errno;
+            if ( ( EAGAIN != err ) && ( 0 == count ) )
+                {
+                CAMHAL_LOGEB("GetFrames: VIDIOC_DQBUF Failed: %s", strerror(err));
+                return -err;
+                }
+            break;
+            }
+
+        nDequeued++;
+
+        if ( buf.index >= ( uint32_t ) MAX_NO_BUFFERS )
+            {
+            CAMHAL_LOGEB("GetFrames: invalid buffer index %d", buf.index);
+            continue;
+            }
+
+        indices[count] = buf.index;
+        frames[count] = mPreviewVirt[buf.index];
+        count++;
+        }
+
+    return count;
+}
+
+int V4LCameraAdapter::GetFrames(int wakeFd, int timeout, int *indices, char **frames, int maxFrames)
+{
+    struct epoll_event events[2];
+    int count, ret;
+
+    if ( ( NULL == indices ) || ( NULL == frames ) || ( 0 >= maxFrames ) )
+        {
+        return -EINVAL;
+        }
+
+    ret = setWakeFd(wakeFd);
+    if ( NO_ERROR != ret )
+        {
+        return ret;
+        }
 
-    return (char *)mIonHandle.keyAt(index);
+    //Frames which piled up while the previous batch was being published
+    //are picked up without waiting
+    count = dequeueFrames(indices, frames, maxFrames);
+    if ( 0 < count )
+        {
+        return count;
+        }
+    else if ( 0 > count )
+        {
+        //The camera is failing, e.g. not streaming or a sensor error, retry
+        //no sooner than the next command or the timeout
+        waitForWake(wakeFd, timeout);
+        return count;
+        }
+
+    ret = epoll_wait(mEpollFd, events, ARRAY_SIZE(events), timeout);
+    if ( ret < 0 )
+        {
+        if ( EINTR == errno )
+            {
+            return 0;
+            }
+        CAMHAL_LOGEB("GetFrames: epoll_wait failed: %s", strerror(errno));
+        return -errno;
+        }
+
+    for ( int i = 0 ; i < ret ; i++ )
+        {
+        if ( mCameraHandle != events[i].data.fd )
+            {
+            continue;
+            }
+
+        if ( events[i].events & ( EPOLLERR | EPOLLHUP ) )
+            {
+            //The camera stays in error until it is reconfigured, epoll would
+            //keep reporting it at once
+            CAMHAL_LOGEB("GetFrames: camera error, events 0x%x", events[i].events);
+            waitForWake(wakeFd, timeout);
+            return -EIO;
+            }
+
+        return dequeueFrames(indices, frames, maxFrames);
+        }
+
+    return 0;
+}
+
+void V4LCameraAdapter::waitForWake(int wakeFd, int timeout)
+{
+    struct pollfd pfd;
+
+    if ( -1 == wakeFd )
+        {
+        if ( 0 < timeout )
+            {
+            usleep(timeout * 1000);
+            }
+        return;
+        }
+
+    pfd.fd = wakeFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    poll(&pfd, 1, timeout);
 }
 
 //API to get the frame size required to be allocated. This size is used to override the size passed
@@ -635,7 +897,15 @@ void V4LCameraAdapter::onOrientationEvent(uint32_t orientation, uint32_t tilt)
 V4LCameraAdapter::V4LCameraAdapter(size_t sensor_index)
 {
     LOG_FUNCTION_NAME;
-    // Nothing useful to do in the constructor
+
+    mEpollFd = -1;
+    mEpollWakeFd = -1;
+    mUseDmaBuf = false;
+    mPreviewMemory = V4L2_MEMORY_USERPTR;
+    memset(mPreviewLength, 0, sizeof(mPreviewLength));
+    memset(mPreviewFd, -1, sizeof(mPreviewFd));
+    memset(mPreviewGralloc, 0, sizeof(mPreviewGralloc));
+    memset(mPreviewVirt, 0, sizeof(mPreviewVirt));
 
     LOG_FUNCTION_NAME_EXIT;
 }
@@ -662,6 +932,12 @@ V4LCameraAdapter::~V4LCameraAdapter()
         mVideoInfo = NULL;
     }
 
+    if ( -1 != mEpollFd )
+    {
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
+
     LOG_FUNCTION_NAME_EXIT;
 }
 
@@ -670,7 +946,6 @@ int V4LCameraAdapter::queueToGralloc(int index, char* fp, int frameType)
     status_t ret = NO_ERROR;
     int width, height;
     CameraFrame frame;
-    int i;
     VideoInfo* buf;
     uint8_t* grallocPtr;
 
@@ -682,13 +957,9 @@ int V4LCameraAdapter::queueToGralloc(int index, char* fp, int frameType)
 
     mParams.getPreviewSize(&width, &height);
 
-    //Get index corresponding to key, to fetch correct Gralloc Ptr.
-    for ( i = 0; i < mPreviewBufs.size(); i++) {
-            if(mPreviewBufs.valueAt(i) == index) {
-                grallocPtr = (uint8_t*) mPreviewBufs.keyAt(i);
-               break;
-        }
-    }
+    //V4L2 buffer index -> gralloc handle
+    grallocPtr = ( ( index >= 0 ) && ( index < MAX_NO_BUFFERS ) ) ?
+                 ( uint8_t * ) mPreviewGralloc[index] : NULL;
 
     recalculateFPS();
 
@@ -734,6 +1005,14 @@ int V4LCameraAdapter::queueToGralloc(int index, char* fp, int frameType)
     frame.mYuv[0] = NULL;
     frame.mYuv[1] = NULL;
     frame.mTimestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    //V4L2 indices follow the order the buffers were handed to us
+    frame.mIndex = index;
+
+    //The driver wrote straight into the gralloc buffer, consumers can pass
+    //the handle along instead of the CPU mapping
+    if ( ( V4L2_MEMORY_USERPTR != mPreviewMemory ) && ( CameraFrame::IMAGE_FRAME != frameType ) ) {
+        frame.mQuirks |= CameraFrame::DMABUF_BACKED;
+    }
 
     ret = setInitFrameRefCount(frame.mBuffer, frame.mFrameMask);
     ret = sendFrameToSubscribers(&frame);
@@ -20,6 +20,7 @@
 #define BASE_CAMERA_ADAPTER_H
 
 #include "CameraHal.h"
+#include "FrameDescriptorTable.h"
 
 namespace android {
 
@@ -53,6 +54,7 @@ public:
     virtual int queueToGralloc(int index, char* fp, int frameType) = 0;
     virtual char** getVirtualAddress(int count) = 0;
     virtual char * GetFrame(int &index) = 0;
+    virtual int GetFrames(int wakeFd, int timeout, int *indices, char **frames, int maxFrames) = 0;
 
     virtual status_t registerImageReleaseCallback(release_image_buffers_callback callback, void *user_data);
 
@@ -166,7 +168,12 @@ protected:
 private:
     status_t __sendFrameToSubscribers(CameraFrame* frame,
                                       KeyedVector<int, frame_callback> *subscribers,
-                                      CameraFrame::FrameType frameType);
+                                      CameraFrame::FrameType frameType,
+                                      FrameDescriptorTable::Descriptor *desc);
+
+    //Maps a frame type to the table tracking its buffers and the reference slot used
+    FrameDescriptorTable* getFrameTable(CameraFrame::FrameType frameType,
+                                        FrameDescriptorTable::RefSlot &slot);
 
 // protected data types and variables
 protected:
@@ -198,6 +205,7 @@ protected:
 
 #endif
 
+    //Serializes fillThisBuffer() calls coming from returnFrame()
     mutable Mutex mReturnFrameLock;
 
     //Lock protecting the Adapter state
@@ -220,29 +228,26 @@ protected:
     int *mPreviewBuffers;
     int mPreviewBufferCount;
     size_t mPreviewBuffersLength;
-    KeyedVector<int, int> mPreviewBuffersAvailable;
-    mutable Mutex mPreviewBufferLock;
+    //Preview buffer refcounts, also carries the video refcounts while recording
+    FrameDescriptorTable mPreviewFrames;
 
     //Video buffer management data
     int *mVideoBuffers;
-    KeyedVector<int, int> mVideoBuffersAvailable;
     int mVideoBuffersCount;
     size_t mVideoBuffersLength;
     mutable Mutex mVideoBufferLock;
 
     //Image buffer management data
     int *mCaptureBuffers;
-    KeyedVector<int, bool> mCaptureBuffersAvailable;
+    FrameDescriptorTable mCaptureFrames;
     int mCaptureBuffersCount;
     size_t mCaptureBuffersLength;
-    mutable Mutex mCaptureBufferLock;
 
     //Metadata buffermanagement
     int *mPreviewDataBuffers;
-    KeyedVector<int, bool> mPreviewDataBuffersAvailable;
+    FrameDescriptorTable mPreviewDataFrames;
     int mPreviewDataBuffersCount;
     size_t mPreviewDataBuffersLength;
-    mutable Mutex mPreviewDataBufferLock;
 
     TIUTILS::MessageQueue mFrameQ;
     TIUTILS::MessageQueue mAdapterQ;
@@ -255,8 +260,8 @@ protected:
     bool mRecording;
 
     uint32_t mFramesWithDucati;
-    uint32_t mFramesWithDisplay;
-    uint32_t mFramesWithEncoder;
+    volatile int32_t mFramesWithDisplay;
+    volatile int32_t mFramesWithEncoder;
 
 #ifdef DEBUG_LOG
     KeyedVector<int, bool> mBuffersWithDucati;
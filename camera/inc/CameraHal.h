@@ -53,6 +53,7 @@
 #include <ui/GraphicBuffer.h>
 #include "JpegEncoder.h"
 #include "TICameraParameters.h"
+#include "PreviewSlotPool.h"
 
 #ifdef HARDWARE_OMX
 #include <JpegEncoderEXIF.h>
@@ -267,6 +268,8 @@ extern "C" {
 #define IMX046_VERTANGLE 24.8
 #define MIN_FPS 8
 #define MAX_FPS 30
+#define PREVIEW_FRAMES_PER_WAKEUP 4
+#define PREVIEW_WAIT_TIMEOUT 100 /* ms, also paces the AF status polling when the sensor stalls */
 #define FOCUS_DISTANCE_NEAR 0.500000
 #define FOCUS_DISTANCE_OPTIMAL 1.500000
 #define FOCUS_DISTANCE_BUFFER_SIZE  30
@@ -495,6 +498,7 @@ class CameraFrame
     {
         ENCODE_RAW_YUV422I_TO_JPEG = 0x1 << 0,
         HAS_EXIF_DATA = 0x1 << 1,
+        DMABUF_BACKED = 0x1 << 2, ///mBuffer is a gralloc handle the camera filled through its fd
     };
 
     //default contrustor
@@ -511,7 +515,8 @@ class CameraFrame
     mFd(0),
     mLength(0),
     mFrameMask(0),
-    mQuirks(0) {
+    mQuirks(0),
+    mIndex(-1) {
 
       mYuv[0] = NULL;
       mYuv[1] = NULL;
@@ -531,7 +536,8 @@ class CameraFrame
     mFd(frame.mFd),
     mLength(frame.mLength),
     mFrameMask(frame.mFrameMask),
-    mQuirks(frame.mQuirks) {
+    mQuirks(frame.mQuirks),
+    mIndex(frame.mIndex) {
 
       mYuv[0] = frame.mYuv[0];
       mYuv[1] = frame.mYuv[1];
@@ -550,6 +556,7 @@ class CameraFrame
     unsigned mFrameMask;
     unsigned int mQuirks;
     unsigned int mYuv[2];
+    int mIndex; ///Slot of mBuffer in the buffers given to the adapter, -1 if unknown
     ///@todo add other member vars like  stride etc
 };
 
@@ -745,7 +752,7 @@ public:
 
     ///Constants
     static const int NOTIFIER_TIMEOUT;
-    static const int32_t MAX_BUFFERS = 8;
+    static const int32_t MAX_BUFFERS = PreviewSlotPool::MAX_SLOTS;
 
     enum NotifierCommands
         {
@@ -891,7 +898,10 @@ private:
     bool mPreviewing;
     camera_memory_t* mPreviewMemory;
     unsigned char* mPreviewBufs[MAX_BUFFERS];
-    int mPreviewBufCount;
+    ///Users of each preview slice, a slice is only refilled once unused
+    PreviewSlotPool mPreviewSlots;
+    ///Last slice sent to the application, -1 if none yet
+    int mLastPreviewSlot;
     const char *mPreviewPixelFormat;
     KeyedVector<unsigned int, sp<MemoryHeapBase> > mSharedPreviewHeaps;
     KeyedVector<unsigned int, sp<MemoryBase> > mSharedPreviewBuffers;
@@ -923,7 +933,17 @@ private:
 class MemoryManager : public BufferProvider, public virtual RefBase
 {
 public:
-    MemoryManager():mIonFd(0){ }
+    ///Counters of the ION buffer cache
+    struct CacheStats
+        {
+        uint32_t mHits;
+        uint32_t mMisses;
+        size_t mResidentBytes;  ///Mapped bytes parked in the cache
+        size_t mBudgetBytes;
+        };
+
+    MemoryManager();
+    ~MemoryManager();
 
     ///Initializes the memory manager creates any resources required
     status_t initialize() { return NO_ERROR; }
@@ -934,13 +954,36 @@ public:
     virtual int getFd() ;
     virtual int freeBuffer(void* buf);
 
+    ///Unmaps and frees cached buffers, oldest first, until at most budget bytes remain
+    void trimCache(size_t budget);
+    void getCacheStats(CacheStats &stats);
+
 private:
 
+    ///A mapped ION allocation, either handed out or parked in the cache
+    struct IonBuffer
+        {
+        unsigned int mAddress;
+        unsigned int mHandle;
+        int mFd;
+        size_t mLength;
+        };
+
+    bool takeCachedBuffer(size_t length, IonBuffer &buffer);
+    void releaseIonBuffer(const IonBuffer &buffer);
+    void trimCacheLocked(size_t budget);
+
     sp<ErrorNotifier> mErrorNotifier;
+    Mutex mLock;
     int mIonFd;
-    KeyedVector<unsigned int, unsigned int> mIonHandleMap;
-    KeyedVector<unsigned int, unsigned int> mIonFdMap;
-    KeyedVector<unsigned int, unsigned int> mIonBufLength;
+    ///Buffers handed out, keyed by mapped address
+    KeyedVector<unsigned int, IonBuffer> mIonBuffers;
+    ///Freed buffers kept mapped for reuse, least recently freed first
+    Vector<IonBuffer> mIonCache;
+    size_t mCacheBudget;
+    size_t mCacheBytes;
+    uint32_t mCacheHits;
+    uint32_t mCacheMisses;
 };
 
 
@@ -1070,6 +1113,11 @@ public:
     virtual char** getVirtualAddress(int count) = 0;
     virtual char * GetFrame(int &index) = 0;
 
+    //Waits up to timeout ms for captured frames or for wakeFd (-1 for none) to become
+    //readable, then dequeues every frame already available. Returns the number of
+    //frames stored in indices/frames, 0 on timeout or wakeFd activity, < 0 on error
+    virtual int GetFrames(int wakeFd, int timeout, int *indices, char **frames, int maxFrames) = 0;
+
     virtual ~CameraAdapter() {};
 
     //Retrieves the current Adapter state
@@ -1319,7 +1367,7 @@ public:
 
     int CorrectPreview();
     int ZoomPerform(float zoom);
-    void nextPreview();
+    void nextPreview(int index, char *fp, bool recording);
     void queueToOverlay(int index);
     int dequeueFromOverlay();
     int dequeueFromCamera(nsecs_t *timestamp);
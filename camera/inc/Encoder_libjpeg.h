@@ -30,12 +30,20 @@
 extern "C" {
 #include "jhead.h"
 }
+
+struct jpeg_destination_mgr;
+
 namespace android {
 /**
  * libjpeg encoder class - uses libjpeg to encode yuv
  */
 
 #define MAX_EXIF_TAGS_SUPPORTED 30
+
+// Upper bound for the stripe workers used on a single main image
+#define MAX_ENCODER_THREADS 4
+
+struct yuv_format;
 typedef void (*encoder_libjpeg_callback_t) (void* main_jpeg,
                                             void* thumb_jpeg,
                                             CameraFrame::FrameType type,
@@ -66,13 +74,12 @@ class ExifElementsTable {
     public:
         ExifElementsTable() :
            gps_tag_count(0), exif_tag_count(0), position(0),
-           jpeg_opened(false) { }
+           exif_data(NULL), exif_size(0) { }
         ~ExifElementsTable();
 
         status_t insertElement(const char* tag, const char* value);
-        void insertExifToJpeg(unsigned char* jpeg, size_t jpeg_size);
-        status_t insertExifThumbnailImage(const char*, int);
-        void saveJpeg(unsigned char* picture, size_t jpeg_size);
+        status_t createExifSection(const char* thumb, int thumb_len);
+        const unsigned char* getExifSection(size_t* size) const;
         static const char* degreesToExifOrientation(const char*);
         static void stringToRational(const char*, unsigned int*, unsigned int*);
         static bool isAsciiTag(const char* tag);
@@ -81,7 +88,11 @@ class ExifElementsTable {
         unsigned int gps_tag_count;
         unsigned int exif_tag_count;
         unsigned int position;
-        bool jpeg_opened;
+        // APP1 payload, without marker and length
+        unsigned char* exif_data;
+        size_t exif_size;
+        // jhead keeps its section list in globals
+        static Mutex sJheadLock;
 };
 
 class Encoder_libjpeg : public Thread {
@@ -99,7 +110,17 @@ class Encoder_libjpeg : public Thread {
             int out_height;
             const char* format;
             size_t jpeg_size;
+            int threads; // 0: one stripe worker per online cpu, 1: no striping
+            ExifElementsTable* exif; // written as APP1 ahead of the scan, if set
          };
+        // one horizontal band of the main image, encoded as its own bitstream
+        struct stripe {
+            int first_row;
+            int num_rows;
+            uint8_t* buf;
+            size_t size;
+            bool done;
+        };
     /* public member functions */
     public:
         Encoder_libjpeg(params* main_jpeg,
@@ -122,10 +143,27 @@ class Encoder_libjpeg : public Thread {
         virtual bool threadLoop() {
             size_t size = 0;
             sp<Encoder_libjpeg> tn = NULL;
+            bool exif = mMainInput && mMainInput->exif;
+
             if (mThumbnailInput) {
-                // start thread to encode thumbnail
-                mThumb = new Encoder_libjpeg(mThumbnailInput, NULL, NULL, mType, NULL, NULL, NULL);
-                mThumb->run();
+                if (exif) {
+                    // thumbnail goes into the APP1 of the main image,
+                    // so it has to be ready before the main encode starts
+                    encode(mThumbnailInput);
+                } else {
+                    // start thread to encode thumbnail
+                    mThumb = new Encoder_libjpeg(mThumbnailInput, NULL, NULL, mType, NULL, NULL, NULL);
+                    mThumb->run();
+                }
+            }
+
+            if (exif) {
+                if (mThumbnailInput) {
+                    mMainInput->exif->createExifSection((const char*) mThumbnailInput->dst,
+                                                        mThumbnailInput->jpeg_size);
+                } else {
+                    mMainInput->exif->createExifSection(NULL, 0);
+                }
             }
 
             // encode our main image
@@ -156,6 +194,29 @@ class Encoder_libjpeg : public Thread {
         }
 
     private:
+        // shared by all workers encoding stripes of one image
+        struct stripe_job {
+            Encoder_libjpeg* encoder;
+            params* input;
+            uint8_t* src;
+            const yuv_format* format;
+            unsigned int restart_interval;
+            stripe* stripes;
+            int num_stripes;
+            volatile int32_t next;
+        };
+
+        class StripeWorker : public Thread {
+            public:
+                StripeWorker(stripe_job* job) : Thread(false), mJob(job) { }
+                virtual bool threadLoop() {
+                    Encoder_libjpeg::encodeStripes(mJob);
+                    return false;
+                }
+            private:
+                stripe_job* mJob;
+        };
+
         params* mMainInput;
         params* mThumbnailInput;
         encoder_libjpeg_callback_t mCb;
@@ -167,6 +228,10 @@ class Encoder_libjpeg : public Thread {
         sp<Encoder_libjpeg> mThumb;
 
         size_t encode(params*);
+        size_t encodeStriped(params*, uint8_t* src, const yuv_format* format, int threads);
+        bool encodeRows(params*, uint8_t* src, const yuv_format* format, int first_row, int num_rows,
+                        jpeg_destination_mgr* dest, unsigned int restart_interval);
+        static void encodeStripes(stripe_job* job);
 };
 
 }
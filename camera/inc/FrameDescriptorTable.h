@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef FRAME_DESCRIPTOR_TABLE_H
+#define FRAME_DESCRIPTOR_TABLE_H
+
+#include <stdint.h>
+#include <utils/Errors.h>
+#include <utils/threads.h>
+
+namespace android {
+
+/**
+  * Per-buffer bookkeeping for the frames a BaseCameraAdapter hands out.
+  *
+  * Descriptor i belongs to buffer slot i of the BuffersDescriptor the table
+  * was built from. Adapters that know the slot of a filled buffer look it up
+  * directly, returned frames only carry the buffer address and go through an
+  * open addressed hash to their slot. Storage is fixed for the life of the
+  * table, so lookups and refcount updates take no lock and a rebuild, done
+  * while the corresponding stream is idle, never frees memory under a reader.
+  * Some capture paths never announce their buffers; those get one of a few
+  * spare descriptors, which are searched linearly. Spares are claimed and
+  * recycled under the table lock, and only once they hold no reference.
+  */
+class FrameDescriptorTable
+{
+public:
+
+    enum RefSlot {
+        REF_FRAME = 0, ///Preview/snapshot, image/raw or frame data, depending on the table
+        REF_VIDEO,     ///Video references taken on preview buffers while recording
+        REF_SLOTS
+    };
+
+    struct Descriptor {
+        volatile int32_t mBuffer;
+        ///Refcount of each RefSlot, REF_BITS each, updated as one word so the
+        ///buffer goes back to the camera exactly when the whole word drops to 0
+        volatile int32_t mRefs;
+    };
+
+    FrameDescriptorTable();
+    ~FrameDescriptorTable();
+
+    ///Buffers [0, queueable) start with no references, the rest are still
+    ///held by the buffer provider and start with one REF_FRAME reference.
+    ///At most MAX_FRAME_BUFFERS buffers
+    status_t init(const int *buffers, uint32_t count, uint32_t queueable);
+
+    Descriptor* find(void *frameBuf) const;
+    ///Descriptor of buffer slot index, checked against frameBuf. Falls back
+    ///to find(frameBuf) if the index is unknown (-1) or stale
+    Descriptor* find(void *frameBuf, int index) const;
+    ///Sets the slot refcount of frameBuf, claiming a spare descriptor for an
+    ///unknown buffer. NULL if frameBuf is NULL or every spare is in use
+    Descriptor* findOrAdd(void *frameBuf, RefSlot slot, int refCount);
+
+    uint32_t size() const;
+    Descriptor* at(uint32_t index) const;
+
+    static int getRef(Descriptor *desc, RefSlot slot);
+    static void setRef(Descriptor *desc, RefSlot slot, int refCount);
+    ///Drops one reference, returns false if there was none to drop.
+    ///lastRef is set when this was the last reference on the buffer
+    static bool releaseRef(Descriptor *desc, RefSlot slot, bool &lastRef);
+
+private:
+
+    enum {
+        MAX_FRAME_BUFFERS = 32,
+        SPARE_DESCRIPTORS = 8,
+        ///Keeps the load factor under 1/2 so probe sequences stay short
+        BUCKETS = 2 * MAX_FRAME_BUFFERS,
+        REF_BITS = 16,
+        REF_MASK = ( 1 << REF_BITS ) - 1
+    };
+
+    ///Lookups are const but hand out descriptors for refcounting
+    mutable Descriptor mDescriptors[MAX_FRAME_BUFFERS + SPARE_DESCRIPTORS];
+    ///Index + 1 into mDescriptors, 0 marks an empty bucket
+    volatile int32_t mBuckets[BUCKETS];
+    ///Hashed descriptors, the spares follow them
+    uint32_t mCount;
+    volatile int32_t mSpareCount;
+    Mutex mLock;
+};
+
+};
+
+#endif //FRAME_DESCRIPTOR_TABLE_H
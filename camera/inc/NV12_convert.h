@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NV12_CONVERT_H_
+#define NV12_CONVERT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*==========================================================================
+* Kernel set used by the NV12 preview conversions.
+*
+* Every implementation (scalar, SSE2, AVX2, NEON) produces bit-identical
+* output; the best one available on the running CPU is picked once, on the
+* first call to NV12_convert_kernels().
+============================================================================*/
+typedef struct
+{
+    const char *name;
+
+    /* Copies n bytes of interleaved chroma, swapping each Cb/Cr pair */
+    void (*swapUV)(uint8_t *dst, const uint8_t *src, size_t n);
+
+    /* Splits n bytes of interleaved CbCr into separate Cb and Cr rows */
+    void (*splitUV)(uint8_t *dstU, uint8_t *dstV, const uint8_t *src, size_t n);
+} NV12_convert_kernels_t;
+
+const NV12_convert_kernels_t *NV12_convert_kernels(void);
+
+/* Kernel sets built into this binary; NV12_convertKernelSet() returns NULL
+ * for a set the running cpu cannot execute */
+int NV12_convertKernelCount(void);
+const NV12_convert_kernels_t *NV12_convertKernelSet(int kernel);
+
+/*==========================================================================
+* Function Name  : NV12_to_NV21 / NV12_to_YV12
+*
+* Description    : Convert a strided NV12 frame to a packed NV21 or YV12
+*                  buffer. Luma and chroma are converted in a single pass,
+*                  two luma rows per chroma row. The destination layout is
+*                  always that of a width x height frame; when the source
+*                  holds fewer rows, only the first rows of each plane are
+*                  written.
+*
+* Input(s)       : dst      -> packed destination buffer
+*                : srcY     -> first luma byte of the (cropped) source
+*                : srcUV    -> first chroma byte of the (cropped) source
+*                : width    -> width in pixels
+*                : height   -> height in pixels
+*                : rows     -> luma rows available in the source, at most
+*                              height
+*                : stride   -> source stride in bytes, shared by both planes
+============================================================================*/
+void NV12_to_NV21(uint8_t *dst, const uint8_t *srcY, const uint8_t *srcUV,
+                  int width, int height, int rows, size_t stride);
+
+void NV12_to_YV12(uint8_t *dst, const uint8_t *srcY, const uint8_t *srcUV,
+                  int width, int height, int rows, size_t stride);
+
+/* Same as above, with the kernel set given explicitly */
+void NV12_to_NV21_ex(const NV12_convert_kernels_t *k, uint8_t *dst,
+                     const uint8_t *srcY, const uint8_t *srcUV,
+                     int width, int height, int rows, size_t stride);
+
+void NV12_to_YV12_ex(const NV12_convert_kernels_t *k, uint8_t *dst,
+                     const uint8_t *srcY, const uint8_t *srcUV,
+                     int width, int height, int rows, size_t stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //#define NV12_CONVERT_H_
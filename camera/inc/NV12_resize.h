@@ -61,7 +61,7 @@ typedef struct
    #define NULL        0
 #endif
 
-const mmUint8 bWeights[8][8][4] = {
+static const mmUint8 bWeights[8][8][4] = {
   {{64, 0, 0, 0}, {56, 0, 0, 8}, {48, 0, 0,16}, {40, 0, 0,24},
    {32, 0, 0,32}, {24, 0, 0,40}, {16, 0, 0,48}, { 8, 0, 0,56}},
 
@@ -141,6 +141,34 @@ VT_resizeFrame_Video_opt2_lp
  mmUint16 dummy                         /* Transparent pixel value              */
  );
 
+/*==========================================================================
+* Function Name  : VT_resizeFrame_Video_opt2_lp_ex
+*
+* Description    : Same as VT_resizeFrame_Video_opt2_lp, with the kernel set
+*                  and number of threads chosen by the caller. Meant for
+*                  tests and benchmarks.
+*
+* Input(s)       : kernel               -> index of the kernel set, -1 picks
+*                                          the best one for this cpu
+*                : threads              -> row bands run in parallel, 0 picks
+*                                          one per online cpu
+*
+* Value Returned : mmBool               -> FALSE on error TRUE on success
+============================================================================*/
+mmBool
+VT_resizeFrame_Video_opt2_lp_ex
+(
+ structConvImage* i_img_ptr,
+ structConvImage* o_img_ptr,
+ IC_rect_type*  cropout,
+ mmInt32 kernel,
+ mmInt32 threads
+ );
+
+/* Kernel sets built into this binary and usable on this cpu */
+mmInt32 VT_resizeKernelCount(void);
+const char* VT_resizeKernelName(mmInt32 kernel);
+
 #ifdef __cplusplus
 }
 #endif
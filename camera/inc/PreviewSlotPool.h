@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef PREVIEW_SLOT_POOL_H
+#define PREVIEW_SLOT_POOL_H
+
+#include <stdint.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/**
+  * Reference counts of the preview callback slices of AppCallbackNotifier.
+  *
+  * HAL1 has no release call for callback data, the application reads a
+  * slice over binder after the data callback returns. A slice sent to the
+  * application is therefore held for at least the hold time before it can
+  * be refilled. If the camera delivers frames faster than the slices come
+  * free, acquire() fails and the frame is counted as dropped rather than
+  * overwriting a slice the application may still read.
+  *
+  * acquire(), hold() and releaseHeld() are called from one thread at a
+  * time, release() may be called from any thread.
+  */
+class PreviewSlotPool
+{
+public:
+
+    enum {
+        MAX_SLOTS = 8
+    };
+
+    PreviewSlotPool();
+
+    ///Starts a preview session with count slices, counters are cleared.
+    ///The held slices of the previous session must have been released
+    void reset(int count, nsecs_t holdTime);
+
+    ///A free slice with one reference, -1 and a dropped frame if none
+    int acquire(nsecs_t now);
+    ///Drops one reference, -1 is ignored
+    void release(int slot);
+    ///Keeps the caller's reference on a slice sent to the application
+    ///until holdTime after now
+    void hold(int slot, nsecs_t now);
+    ///Drops the references of every held slice, at the end of a session
+    void releaseHeld();
+
+    int refs(int slot) const;
+    uint32_t dropped() const;
+
+private:
+
+    ///Releases the held slices sent at least mHoldTime before now
+    void expire(nsecs_t now);
+
+    volatile int32_t mRefs[MAX_SLOTS];
+    int mCount;
+    ///Round-robin cursor for the next slice to try
+    int mNext;
+    nsecs_t mHoldTime;
+
+    ///Held slices in the order they were sent, oldest at mHeldFirst
+    struct Held {
+        int mSlot;
+        nsecs_t mSent;
+    } mHeld[MAX_SLOTS];
+    int mHeldFirst;
+    int mHeldCount;
+
+    uint32_t mDropped;
+};
+
+};
+
+#endif //PREVIEW_SLOT_POOL_H
@@ -87,6 +87,7 @@ public:
 
     int queueToGralloc(int index, char* fp, int frameType);
     char** getVirtualAddress(int count);
+    int GetFrames(int wakeFd, int timeout, int *indices, char **frames, int maxFrames);
 
 protected:
 
@@ -110,6 +111,15 @@ private:
 
     char * GetFrame(int &index);
 
+    //Fills index/memory and the USERPTR address or DMABUF fd of a preview buffer
+    void setPreviewBuffer(struct v4l2_buffer &buf, int index);
+
+    //Dequeues the frames the driver has ready without blocking
+    int dequeueFrames(int *indices, char **frames, int maxFrames);
+    status_t setWakeFd(int wakeFd);
+    //Sleeps until wakeFd is readable or timeout ms pass, paces camera errors
+    void waitForWake(int wakeFd, int timeout);
+
 public:
 
 private:
@@ -118,6 +128,20 @@ private:
     KeyedVector<void*, int> mIonHandle;
     mutable Mutex mPreviewBufsLock;
 
+    //V4L2 buffer index -> gralloc handle / capture address, filled by UseBuffersPreview
+    int mPreviewGralloc[MAX_NO_BUFFERS];
+    char *mPreviewVirt[MAX_NO_BUFFERS];
+    int mPreviewFd[MAX_NO_BUFFERS];
+    size_t mPreviewLength[MAX_NO_BUFFERS];
+
+    //V4L2_MEMORY_DMABUF when camera.v4l2.dmabuf is set and the driver accepts it
+    bool mUseDmaBuf;
+    enum v4l2_memory mPreviewMemory;
+
+    //Waits on the camera and on the client wakeup descriptor in GetFrames()
+    int mEpollFd;
+    int mEpollWakeFd;
+
     CameraParameters mParams;
 
     bool mPreviewing;
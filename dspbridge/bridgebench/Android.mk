@@ -0,0 +1,42 @@
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_SRC_FILES:= \
+	bridgebench.c
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../inc	
+
+LOCAL_SHARED_LIBRARIES := \
+	libbridge
+	
+LOCAL_CFLAGS += -Wall -g -O2 -finline-functions -DOMAP_3430
+
+LOCAL_MODULE:= bridgebench.out
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
+
+# host build against libbridge's emulator, run with -e
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	bridgebench.c
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../inc	
+
+LOCAL_STATIC_LIBRARIES := \
+	libbridge
+
+LOCAL_LDLIBS += -lpthread -lrt
+
+LOCAL_CFLAGS += -Wall -g -O2 -finline-functions -DOMAP_3430
+
+LOCAL_MODULE:= bridgebench
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,670 @@
+/*
+ *  Copyright 2001-2008 Texas Instruments - http://www.ti.com/
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  ======== bridgebench.c ========
+ *  Description:
+ *      Measures the Bridge IPC paths the codecs depend on, using the nodes
+ *      of the ping, strmcopy and zerocopymsg samples:
+ *
+ *       msg   - ping message round trip latency
+ *       strm  - strmcopy buffer round trip, by buffer size
+ *       dmm   - DSPProcessor_Map and DSPProcessor_UnMap cost, by size
+ *       zcmsg - zero-copy message round trip, and the message segments
+ *               mapped into the process (DSPNode_GetMapStats)
+ *
+ *  Usage:
+ *      bridgebench.out [-e] [-j] [-n <iterations>] [<scenario> ...]
+ *
+ *       -e  run against the in-process emulator instead of the driver
+ *       -j  print one JSON object per result line instead of a table
+ *       -n  iterations per measurement, default 1000
+ *
+ *  Notes:
+ *      Every operation is timed on its own with CLOCK_MONOTONIC, and the
+ *      results are reported as mean, 50th, 90th and 99th percentile and
+ *      maximum, in microseconds, plus the resulting rate. A scenario that
+ *      cannot run, e.g. because its node is not in the DSP image, is
+ *      reported as failed and the others still run.
+ */
+
+#include <stdio.h>
+#include <dbapi.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#define DEFAULTITERS    1000	/* Measured operations per result. */
+#define DEFAULTTIMEOUT  5000	/* Timeout of any one operation, ms. */
+#define WARMUPITERS     10	/* Operations run before measuring. */
+#define ARGSIZE         32
+#define PAGESIZE        0x1000
+
+#define PING            0x01	/* ping node command */
+#define ZCMSG_BUFDESC   0x20000000	/* zero-copy buffer descriptor */
+#define ZCMSG_BUFSIZE   1024
+#define ZCMSG_BUFSIZESTR "1024"
+
+/* PING_TI_UUID = 12A3C3C1_D015_11D4_9F69_00C04F3A59AE */
+static const struct DSP_UUID PING_TI_uuid = {
+	0x12a3c3c1, 0xd015, 0x11d4, 0x9f, 0x69,
+	{ 0x00, 0xc0, 0x4f, 0x3a, 0x59, 0xae } };
+
+/* {7EEB2C7E-785A-11d4-A650-00C04F0C04F3} */
+static const struct DSP_UUID STRMCOPY_TI_uuid = {
+	0x7eeb2c7e, 0x785a, 0x11d4, 0xa6, 0x50,
+	{ 0x00, 0xc0, 0x4f, 0x0c, 0x04, 0xf3 } };
+
+/* ZCMSG_TI_UUID = 30DBD781_F3FB_11D5_A8DD_00B0D055F6D1 */
+static const struct DSP_UUID ZCMSG_TI_uuid = {
+	0x30dbd781, 0xf3fb, 0x11d5, 0xa8, 0xdd,
+	{ 0x00, 0xb0, 0xd0, 0x55, 0xf6, 0xd1 } };
+
+/* Buffer sizes measured by the strm and dmm scenarios */
+static const ULONG aStrmSizes[] = { 256, 1024, 4096, 16384, 65536 };
+static const ULONG aDmmSizes[] = { 0x1000, 0x10000, 0x100000 };
+
+#define ARRAYSIZE(a)    (sizeof(a) / sizeof((a)[0]))
+
+/* Benchmark context data structure. */
+struct BENCH_TASK {
+	DSP_HPROCESSOR hProcessor;	/* Handle to processor. */
+	UINT nIters;		/* Measured operations per result. */
+	bool fJson;		/* Print JSON lines. */
+	const char *pTarget;	/* "bridge" or "emulator". */
+	unsigned long long *aNs;	/* One sample per operation. */
+	unsigned long long *aNs2;	/* Second operation timed per loop. */
+};
+
+/* Node argument block, as DSPNode_Allocate() wants it. */
+struct BENCH_NODEDATA {
+	ULONG cbData;
+	BYTE cData[ARGSIZE];
+};
+
+struct BENCH_SCENARIO {
+	const char *pName;
+	int (*pfnRun)(struct BENCH_TASK *benchTask);
+};
+
+static int RunMsg(struct BENCH_TASK *benchTask);
+static int RunStrm(struct BENCH_TASK *benchTask);
+static int RunDmm(struct BENCH_TASK *benchTask);
+static int RunZcmsg(struct BENCH_TASK *benchTask);
+
+static const struct BENCH_SCENARIO aScenarios[] = {
+	{ "msg", RunMsg },
+	{ "strm", RunStrm },
+	{ "dmm", RunDmm },
+	{ "zcmsg", RunZcmsg },
+};
+
+/* Forward declarations: */
+static int ProcessArgs(int argc, char **argv, struct BENCH_TASK *benchTask,
+															UINT *pMask);
+static int InitializeProcessor(struct BENCH_TASK *benchTask);
+static int CreateNode(struct BENCH_TASK *benchTask,
+				const struct DSP_UUID *pUuid, const char *pArgs,
+				struct DSP_STRMATTR *pConnect, DSP_HNODE *phNode);
+static void DeleteNode(DSP_HNODE hNode);
+static void Report(struct BENCH_TASK *benchTask, const char *pName,
+			ULONG ulParam, unsigned long long *aNs, UINT nSamples,
+			ULONG ulBytes, int status);
+
+/*
+ *  ======== NowNs ========
+ */
+static unsigned long long NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ *  ======== main ========
+ */
+int main(int argc, char **argv)
+{
+	struct BENCH_TASK benchTask;
+	UINT uMask = 0;		/* Scenarios to run, all if 0. */
+	UINT i;
+	int failed = 0;
+	int status;
+
+	memset(&benchTask, 0, sizeof(benchTask));
+	benchTask.nIters = DEFAULTITERS;
+
+	/* Process command line arguments, before the driver is opened: */
+	status = ProcessArgs(argc, argv, &benchTask, &uMask);
+	if (DSP_FAILED(status)) {
+		return -1;
+	}
+	benchTask.pTarget = getenv("DSPBRIDGE_EMULATOR") ? "emulator" : "bridge";
+	benchTask.aNs = malloc(benchTask.nIters * sizeof(*benchTask.aNs));
+	benchTask.aNs2 = malloc(benchTask.nIters * sizeof(*benchTask.aNs2));
+	if (!benchTask.aNs || !benchTask.aNs2) {
+		fprintf(stderr, "Out of memory.\n");
+		return -1;
+	}
+
+	DspManager_Open(argc, NULL);
+	status = InitializeProcessor(&benchTask);
+	if (DSP_SUCCEEDED(status)) {
+		if (!benchTask.fJson) {
+			fprintf(stdout, "%-10s %8s %7s %10s %10s %10s %10s %10s "
+					"%10s %8s\n", "scenario", "param", "n", "mean_us",
+					"p50_us", "p90_us", "p99_us", "max_us", "per_s",
+					"MB_s");
+		}
+		for (i = 0; i < ARRAYSIZE(aScenarios); i++) {
+			if (uMask && !(uMask & (1 << i))) {
+				continue;
+			}
+			if (DSP_FAILED(aScenarios[i].pfnRun(&benchTask))) {
+				failed++;
+			}
+		}
+		DSPProcessor_Detach(benchTask.hProcessor);
+	}
+	DspManager_Close(0, NULL);
+
+	free(benchTask.aNs);
+	free(benchTask.aNs2);
+	return (DSP_SUCCEEDED(status) && !failed ? 0 : -1);
+}
+
+/*
+ *  ======== RunMsg ========
+ *  Ping message round trip: DSPNode_PutMessage and the reply's
+ *  DSPNode_GetMessage.
+ */
+static int RunMsg(struct BENCH_TASK *benchTask)
+{
+	DSP_HNODE hNode = NULL;
+	struct DSP_MSG msg;
+	unsigned long long t0;
+	UINT i;
+	int status;
+
+	status = CreateNode(benchTask, &PING_TI_uuid, "0", NULL, &hNode);
+	for (i = 0; i < WARMUPITERS + benchTask->nIters &&
+						DSP_SUCCEEDED(status); i++) {
+		msg.dwCmd = PING;
+		msg.dwArg1 = i;
+		msg.dwArg2 = 0;
+		t0 = NowNs();
+		status = DSPNode_PutMessage(hNode, &msg, DEFAULTTIMEOUT);
+		if (DSP_SUCCEEDED(status)) {
+			status = DSPNode_GetMessage(hNode, &msg, DEFAULTTIMEOUT);
+		}
+		if (i >= WARMUPITERS) {
+			benchTask->aNs[i - WARMUPITERS] = NowNs() - t0;
+		}
+	}
+	Report(benchTask, "msg", 0, benchTask->aNs, benchTask->nIters, 0, status);
+	DeleteNode(hNode);
+	return (status);
+}
+
+/*
+ *  ======== RunStrmSize ========
+ *  One buffer of ulSize bytes to the strmcopy node and back: issue and
+ *  reclaim on the input stream, then on the output stream.
+ */
+static int RunStrmSize(struct BENCH_TASK *benchTask, ULONG ulSize)
+{
+	DSP_HNODE hNode = NULL;
+	DSP_HSTREAM hIn = NULL;
+	DSP_HSTREAM hOut = NULL;
+	BYTE *pInBuf = NULL;
+	BYTE *pOutBuf = NULL;
+	BYTE *pBuf;
+	ULONG ulBytes;
+	ULONG ulBufSize;
+	DWORD dwArg;
+	struct DSP_STRMATTR connect;
+	struct DSP_STREAMATTRIN attrs;
+	unsigned long long t0;
+	UINT uMask;
+	UINT i;
+	int status;
+
+	memset(&connect, 0, sizeof(connect));
+	connect.uBufsize = ulSize;
+	connect.uNumBufs = 1;
+	connect.uTimeout = DSP_FOREVER;
+	connect.lMode = STRMMODE_PROCCOPY;
+	status = CreateNode(benchTask, &STRMCOPY_TI_uuid, NULL, &connect, &hNode);
+
+	memset(&attrs, 0, sizeof(attrs));
+	attrs.cbStruct = sizeof(attrs);
+	attrs.uTimeout = DEFAULTTIMEOUT;
+	attrs.uNumBufs = 1;
+	attrs.lMode = STRMMODE_PROCCOPY;
+	if (DSP_SUCCEEDED(status)) {
+		status = DSPStream_Open(hNode, DSP_TONODE, 0, &attrs, &hIn);
+	}
+	if (DSP_SUCCEEDED(status)) {
+		status = DSPStream_Open(hNode, DSP_FROMNODE, 0, &attrs, &hOut);
+	}
+	if (DSP_SUCCEEDED(status)) {
+		status = DSPStream_AllocateBuffers(hIn, ulSize, &pInBuf, 1);
+	}
+	if (DSP_SUCCEEDED(status)) {
+		status = DSPStream_AllocateBuffers(hOut, ulSize, &pOutBuf, 1);
+	}
+	if (DSP_SUCCEEDED(status)) {
+		memset(pInBuf, 0x5a, ulSize);
+	}
+
+	for (i = 0; i < WARMUPITERS + benchTask->nIters &&
+						DSP_SUCCEEDED(status); i++) {
+		t0 = NowNs();
+		status = DSPStream_Issue(hIn, pInBuf, ulSize, ulSize, 0);
+		if (DSP_SUCCEEDED(status)) {
+			status = DSPStream_Reclaim(hIn, &pBuf, &ulBytes, &ulBufSize,
+																&dwArg);
+		}
+		if (DSP_SUCCEEDED(status)) {
+			status = DSPStream_Issue(hOut, pOutBuf, ulSize, ulSize, 0);
+		}
+		if (DSP_SUCCEEDED(status)) {
+			status = DSPStream_Reclaim(hOut, &pBuf, &ulBytes, &ulBufSize,
+																&dwArg);
+		}
+		if (i >= WARMUPITERS) {
+			benchTask->aNs[i - WARMUPITERS] = NowNs() - t0;
+		}
+	}
+	Report(benchTask, "strm", ulSize, benchTask->aNs, benchTask->nIters,
+															ulSize, status);
+
+	/* Reclaim what a failed iteration left in the streams */
+	if (hIn) {
+		DSPStream_Idle(hIn, true);
+		while (DSP_SUCCEEDED(DSPStream_Select(&hIn, 1, &uMask, 0)) &&
+																uMask) {
+			DSPStream_Reclaim(hIn, &pBuf, &ulBytes, &ulBufSize, &dwArg);
+		}
+		if (pInBuf) {
+			DSPStream_FreeBuffers(hIn, &pInBuf, 1);
+		}
+		DSPStream_Close(hIn);
+	}
+	if (hOut) {
+		DSPStream_Idle(hOut, true);
+		while (DSP_SUCCEEDED(DSPStream_Select(&hOut, 1, &uMask, 0)) &&
+																uMask) {
+			DSPStream_Reclaim(hOut, &pBuf, &ulBytes, &ulBufSize, &dwArg);
+		}
+		if (pOutBuf) {
+			DSPStream_FreeBuffers(hOut, &pOutBuf, 1);
+		}
+		DSPStream_Close(hOut);
+	}
+	DeleteNode(hNode);
+	return (status);
+}
+
+/*
+ *  ======== RunStrm ========
+ */
+static int RunStrm(struct BENCH_TASK *benchTask)
+{
+	int status = 0;
+	UINT i;
+
+	for (i = 0; i < ARRAYSIZE(aStrmSizes); i++) {
+		if (DSP_FAILED(RunStrmSize(benchTask, aStrmSizes[i]))) {
+			status = -EPERM;
+		}
+	}
+	return (status);
+}
+
+/*
+ *  ======== RunDmm ========
+ *  DSPProcessor_Map and DSPProcessor_UnMap of a page aligned buffer into
+ *  a reserved DSP virtual range, reported separately.
+ */
+static int RunDmm(struct BENCH_TASK *benchTask)
+{
+	PVOID pDspAddr;
+	PVOID pMapAddr;
+	void *pBuf = NULL;
+	unsigned long long t0;
+	ULONG ulSize;
+	UINT i, j;
+	int result = 0;
+	int status;
+
+	for (j = 0; j < ARRAYSIZE(aDmmSizes); j++) {
+		ulSize = aDmmSizes[j];
+		pDspAddr = NULL;
+		if (posix_memalign(&pBuf, PAGESIZE, ulSize)) {
+			pBuf = NULL;
+			status = -ENOMEM;
+		} else {
+			memset(pBuf, 0, ulSize);
+			status = DSPProcessor_ReserveMemory(benchTask->hProcessor,
+										ulSize + PAGESIZE, &pDspAddr);
+		}
+		for (i = 0; i < WARMUPITERS + benchTask->nIters &&
+						DSP_SUCCEEDED(status); i++) {
+			t0 = NowNs();
+			status = DSPProcessor_Map(benchTask->hProcessor, pBuf, ulSize,
+												pDspAddr, &pMapAddr, 0);
+			if (i >= WARMUPITERS) {
+				benchTask->aNs[i - WARMUPITERS] = NowNs() - t0;
+			}
+			if (DSP_FAILED(status)) {
+				break;
+			}
+			t0 = NowNs();
+			status = DSPProcessor_UnMap(benchTask->hProcessor, pMapAddr);
+			if (i >= WARMUPITERS) {
+				benchTask->aNs2[i - WARMUPITERS] = NowNs() - t0;
+			}
+		}
+		Report(benchTask, "dmm_map", ulSize, benchTask->aNs,
+									benchTask->nIters, ulSize, status);
+		Report(benchTask, "dmm_unmap", ulSize, benchTask->aNs2,
+									benchTask->nIters, ulSize, status);
+		if (pDspAddr) {
+			DSPProcessor_UnReserveMemory(benchTask->hProcessor, pDspAddr);
+		}
+		free(pBuf);
+		if (DSP_FAILED(status)) {
+			result = status;
+		}
+	}
+	return (result);
+}
+
+/*
+ *  ======== RunZcmsg ========
+ *  Zero-copy message round trip: the message carries a shared buffer
+ *  the node processes in place before replying.
+ */
+static int RunZcmsg(struct BENCH_TASK *benchTask)
+{
+	DSP_HNODE hNode = NULL;
+	BYTE *pSmBuf = NULL;
+	struct DSP_MSG msg;
+	unsigned long long t0;
+	ULONG ulSegments, ulBytes;
+	UINT i;
+	int status;
+
+	status = CreateNode(benchTask, &ZCMSG_TI_uuid, ZCMSG_BUFSIZESTR, NULL,
+																	&hNode);
+	if (DSP_SUCCEEDED(status)) {
+		status = DSPNode_AllocMsgBuf(hNode, ZCMSG_BUFSIZE, NULL, &pSmBuf);
+	}
+	if (DSP_SUCCEEDED(status)) {
+		memset(pSmBuf, 0, ZCMSG_BUFSIZE);
+	}
+	for (i = 0; i < WARMUPITERS + benchTask->nIters &&
+						DSP_SUCCEEDED(status); i++) {
+		msg.dwCmd = ZCMSG_BUFDESC;
+		msg.dwArg1 = (DWORD)pSmBuf;
+		msg.dwArg2 = ZCMSG_BUFSIZE / sizeof(UINT);
+		t0 = NowNs();
+		status = DSPNode_PutMessage(hNode, &msg, DEFAULTTIMEOUT);
+		if (DSP_SUCCEEDED(status)) {
+			status = DSPNode_GetMessage(hNode, &msg, DEFAULTTIMEOUT);
+		}
+		if (i >= WARMUPITERS) {
+			benchTask->aNs[i - WARMUPITERS] = NowNs() - t0;
+		}
+		if (DSP_SUCCEEDED(status) && msg.dwCmd != ZCMSG_BUFDESC) {
+			status = -EPERM;	/* not a zero-copy reply */
+		}
+	}
+	Report(benchTask, "zcmsg", ZCMSG_BUFSIZE, benchTask->aNs,
+							benchTask->nIters, ZCMSG_BUFSIZE, status);
+	/* The node's message segment is mapped into this process until the
+	 * node is deleted */
+	if (DSP_SUCCEEDED(status) &&
+			DSP_SUCCEEDED(DSPNode_GetMapStats(&ulSegments, &ulBytes))) {
+		if (benchTask->fJson) {
+			fprintf(stdout, "{\"scenario\":\"zcmsg\",\"target\":\"%s\","
+				"\"mapped_segments\":%lu,\"mapped_bytes\":%lu}\n",
+				benchTask->pTarget, ulSegments, ulBytes);
+		} else {
+			fprintf(stdout, "%-10s %lu message segments mapped, %lu "
+					"bytes\n", "zcmsg", ulSegments, ulBytes);
+		}
+	}
+	if (pSmBuf) {
+		DSPNode_FreeMsgBuf(hNode, pSmBuf, NULL);
+	}
+	DeleteNode(hNode);
+	return (status);
+}
+
+/*
+ *  ======== CompareNs ========
+ */
+static int CompareNs(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ *  ======== Percentile ========
+ *  Nearest rank percentile of nSamples sorted samples, in microseconds.
+ */
+static double Percentile(unsigned long long *aNs, UINT nSamples, UINT uPct)
+{
+	UINT uRank = (nSamples * uPct + 99) / 100;
+
+	return aNs[uRank ? uRank - 1 : 0] / 1000.0;
+}
+
+/*
+ *  ======== Report ========
+ *  Print one result line. ulBytes is the payload moved per operation,
+ *  0 if it is meaningless for the scenario.
+ */
+static void Report(struct BENCH_TASK *benchTask, const char *pName,
+			ULONG ulParam, unsigned long long *aNs, UINT nSamples,
+			ULONG ulBytes, int status)
+{
+	unsigned long long total = 0;
+	double mean, perS, mbS;
+	UINT i;
+
+	if (DSP_FAILED(status)) {
+		if (benchTask->fJson) {
+			fprintf(stdout, "{\"scenario\":\"%s\",\"param\":%lu,"
+				"\"target\":\"%s\",\"status\":%d}\n", pName,
+				ulParam, benchTask->pTarget, status);
+		} else {
+			fprintf(stdout, "%-10s %8lu failed, status = 0x%x\n", pName,
+				ulParam, (UINT)status);
+		}
+		return;
+	}
+
+	qsort(aNs, nSamples, sizeof(*aNs), CompareNs);
+	for (i = 0; i < nSamples; i++) {
+		total += aNs[i];
+	}
+	mean = total / 1000.0 / nSamples;
+	perS = total ? nSamples * 1e9 / total : 0;
+	mbS = perS * ulBytes / (1024.0 * 1024.0);
+
+	if (benchTask->fJson) {
+		fprintf(stdout, "{\"scenario\":\"%s\",\"param\":%lu,"
+			"\"target\":\"%s\",\"status\":0,\"n\":%u,"
+			"\"mean_us\":%.2f,\"p50_us\":%.2f,\"p90_us\":%.2f,"
+			"\"p99_us\":%.2f,\"max_us\":%.2f,\"per_s\":%.0f,"
+			"\"mb_s\":%.2f}\n", pName, ulParam, benchTask->pTarget,
+			nSamples, mean, Percentile(aNs, nSamples, 50),
+			Percentile(aNs, nSamples, 90),
+			Percentile(aNs, nSamples, 99),
+			Percentile(aNs, nSamples, 100), perS, mbS);
+	} else {
+		fprintf(stdout, "%-10s %8lu %7u %10.2f %10.2f %10.2f %10.2f "
+			"%10.2f %10.0f %8.2f\n", pName, ulParam, nSamples, mean,
+			Percentile(aNs, nSamples, 50),
+			Percentile(aNs, nSamples, 90),
+			Percentile(aNs, nSamples, 99),
+			Percentile(aNs, nSamples, 100), perS, mbS);
+	}
+}
+
+/*
+ *  ======== InitializeProcessor ========
+ *  Attach to the first C55 or C64 DSP.
+ */
+static int InitializeProcessor(struct BENCH_TASK *benchTask)
+{
+	int status = -EPERM;
+	struct DSP_PROCESSORINFO dspInfo;
+	UINT numProcs;
+	UINT index = 0;
+
+	while (DSP_SUCCEEDED(DSPManager_EnumProcessorInfo(index, &dspInfo,
+					(UINT)sizeof(struct DSP_PROCESSORINFO), &numProcs))) {
+		if ((dspInfo.uProcessorType == DSPTYPE_55) ||
+							(dspInfo.uProcessorType == DSPTYPE_64)) {
+			status = 0;
+			break;
+		}
+		index++;
+	}
+	if (DSP_SUCCEEDED(status)) {
+		status = DSPProcessor_Attach(index, NULL, &benchTask->hProcessor);
+	}
+	if (DSP_FAILED(status)) {
+		fprintf(stderr, "Unable to attach to a DSP. Status = 0x%x\n",
+																(UINT)status);
+	}
+	return (status);
+}
+
+/*
+ *  ======== CreateNode ========
+ *  Allocate, optionally connect to the GPP both ways, create and run a
+ *  node. pArgs is the node's create phase argument string, or NULL.
+ */
+static int CreateNode(struct BENCH_TASK *benchTask,
+				const struct DSP_UUID *pUuid, const char *pArgs,
+				struct DSP_STRMATTR *pConnect, DSP_HNODE *phNode)
+{
+	struct BENCH_NODEDATA argsBuf;
+	struct DSP_NODEATTRIN nodeAttrIn;
+	struct DSP_UUID uuid = *pUuid;
+	int status;
+
+	memset(&argsBuf, 0, sizeof(argsBuf));
+	if (pArgs) {
+		strncpy((char *)argsBuf.cData, pArgs, ARGSIZE - 1);
+		argsBuf.cbData = strlen((char *)argsBuf.cData) + 1;
+	} else {
+		argsBuf.cbData = ARGSIZE;
+	}
+	memset(&nodeAttrIn, 0, sizeof(nodeAttrIn));
+	nodeAttrIn.cbStruct = sizeof(nodeAttrIn);
+	nodeAttrIn.uTimeout = 10000;
+	nodeAttrIn.iPriority = 5;
+
+	*phNode = NULL;
+	status = DSPNode_Allocate(benchTask->hProcessor, &uuid,
+			(struct DSP_CBDATA *)&argsBuf, &nodeAttrIn, phNode);
+	if (DSP_SUCCEEDED(status) && pConnect) {
+		status = DSPNode_Connect((DSP_HNODE)DSP_HGPPNODE, 0, *phNode, 0,
+																pConnect);
+		if (DSP_SUCCEEDED(status)) {
+			status = DSPNode_Connect(*phNode, 0, (DSP_HNODE)DSP_HGPPNODE,
+															0, pConnect);
+		}
+	}
+	if (DSP_SUCCEEDED(status)) {
+		status = DSPNode_Create(*phNode);
+	}
+	if (DSP_SUCCEEDED(status)) {
+		status = DSPNode_Run(*phNode);
+	}
+	return (status);
+}
+
+/*
+ *  ======== DeleteNode ========
+ */
+static void DeleteNode(DSP_HNODE hNode)
+{
+	int exitStatus;
+
+	if (hNode) {
+		DSPNode_Terminate(hNode, &exitStatus);
+		DSPNode_Delete(hNode);
+	}
+}
+
+/*
+ *  ======== ProcessArgs ========
+ */
+static int ProcessArgs(int argc, char **argv, struct BENCH_TASK *benchTask,
+															UINT *pMask)
+{
+	UINT i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "ejn:")) != -1) {
+		switch (opt) {
+		case 'e':
+			setenv("DSPBRIDGE_EMULATOR", "1", 1);
+			break;
+		case 'j':
+			benchTask->fJson = true;
+			break;
+		case 'n':
+			benchTask->nIters = strtoul(optarg, NULL, 0);
+			if (benchTask->nIters) {
+				break;
+			}
+			/* fall through */
+		default:
+			fprintf(stdout, "Usage: %s [-e] [-j] [-n <iterations>] "
+						"[<scenario> ...]\n", argv[0]);
+			fprintf(stdout, " where <scenario> is msg, strm, dmm or "
+						"zcmsg, all by default\n");
+			return -EPERM;
+		}
+	}
+	for (; optind < argc; optind++) {
+		for (i = 0; i < ARRAYSIZE(aScenarios); i++) {
+			if (!strcmp(argv[optind], aScenarios[i].pName)) {
+				*pMask |= 1 << i;
+				break;
+			}
+		}
+		if (i == ARRAYSIZE(aScenarios)) {
+			fprintf(stdout, "Unknown scenario %s\n", argv[optind]);
+			return -EPERM;
+		}
+	}
+	return 0;
+}
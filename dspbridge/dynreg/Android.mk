@@ -6,6 +6,7 @@ LOCAL_ARM_MODE := arm
 
 LOCAL_SRC_FILES:= \
 	dynreg.c \
+	DLstream.c \
 	DLsymtab.c \
 	DLsymtab_support.c \
 	cload.c \
@@ -28,3 +29,69 @@ LOCAL_MODULE_TAGS:= optional
 
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_SRC_FILES:= \
+	dloadbench.c \
+	DLstream.c \
+	DLsymtab.c \
+	DLsymtab_support.c \
+	cload.c \
+	getsection.c \
+	reloc.c
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../inc \
+	$(LOCAL_PATH)
+
+LOCAL_CFLAGS += -MD -pipe  -fomit-frame-pointer -Wall  -Wno-trigraphs -Werror-implicit-function-declaration  -fno-strict-aliasing -mapcs -mno-sched-prolog -mabi=aapcs-linux -mno-thumb-interwork -msoft-float -Uarm -DMODULE -D__LINUX_ARM_ARCH__=7  -fno-common -DLINUX -DTMS32060 -D_DB_TIOMAP -DOMAP_3430
+
+LOCAL_MODULE:= dloadbench.out
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
+
+# the same benchmark for the build host, it needs neither a DSP nor the driver
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	dloadbench.c \
+	DLstream.c \
+	DLsymtab.c \
+	DLsymtab_support.c \
+	cload.c \
+	getsection.c \
+	reloc.c
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../inc \
+	$(LOCAL_PATH)
+
+LOCAL_CFLAGS += -MD -pipe -Wall  -Wno-trigraphs -Werror-implicit-function-declaration  -fno-strict-aliasing -fno-common -DLINUX -DTMS32060 -D_DB_TIOMAP -DOMAP_3430
+
+LOCAL_MODULE:= dloadbench
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_SRC_FILES:= \
+	symtabbench.c \
+	DLsymtab.c \
+	DLsymtab_support.c
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../inc \
+	$(LOCAL_PATH)
+
+LOCAL_CFLAGS += -MD -pipe  -fomit-frame-pointer -Wall  -Wno-trigraphs -Werror-implicit-function-declaration  -fno-strict-aliasing -mapcs -mno-sched-prolog -mabi=aapcs-linux -mno-thumb-interwork -msoft-float -Uarm -DMODULE -D__LINUX_ARM_ARCH__=7  -fno-common -DLINUX -DTMS32060 -D_DB_TIOMAP -DOMAP_3430
+
+LOCAL_MODULE:= symtabbench.out
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,229 @@
+/*
+ *  Copyright 2001-2008 Texas Instruments - http://www.ti.com/
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+/*****************************************************************************
+ *****************************************************************************
+ *
+ *							DLSTREAM.C
+ *
+ * A class used by the dynamic loader for input of the module image
+ *
+ * This implementation reads from a module image held in memory, normally
+ * a private mapping of the DOFF file, and hands out image packets in place
+ *****************************************************************************
+ *****************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+
+#include "DLstream.h"
+
+/* How DLstream_map obtained the image, kept in mowned */
+#define DLSTREAM_CALLER 0
+#define DLSTREAM_MAPPED 1
+#define DLSTREAM_ALLOCATED 2
+
+/******************************************************************************
+ * DLstream_read_buffer
+ *
+ * PARAMETERS :
+ *	buffer	Pointer to the buffer to fill
+ *	bufsiz	Amount of data desired in sizeof() units
+ *
+ * EFFECT :
+ *	Copies from the image at the current position and advances it.
+ *  Returns the amount copied, which is short at the end of the image.
+ *****************************************************************************/
+static int DLstream_read_buffer(struct DL_stream_t *thisptr, void *buffer,
+																unsigned bufsiz)
+{
+	uint32_t left = thisptr->msize - thisptr->mcur;
+
+	if (bufsiz > left)
+		bufsiz = left;
+	memcpy(buffer, thisptr->mbase + thisptr->mcur, bufsiz);
+	thisptr->mcur += bufsiz;
+
+	return bufsiz;
+}			/* DLstream_read_buffer */
+
+/******************************************************************************
+ * DLstream_set_file_posn
+ *
+ * PARAMETERS :
+ *	posn	Desired position relative to the start of the image
+ *
+ * EFFECT :
+ *	Moves the current position.  Returns 0 for success, non-zero if posn
+ *  lies beyond the end of the image.
+ *****************************************************************************/
+static int DLstream_set_file_posn(struct DL_stream_t *thisptr,
+																unsigned posn)
+{
+	if (posn > thisptr->msize)
+		return -1;
+	thisptr->mcur = posn;
+
+	return 0;
+}			/* DLstream_set_file_posn */
+
+/******************************************************************************
+ * DLstream_map_buffer
+ *
+ * PARAMETERS :
+ *	bufsiz	Amount of data desired in sizeof() units
+ *
+ * EFFECT :
+ *	Returns a pointer to the image at the current position and advances it,
+ *  or NULL if the position is not 32-bit aligned or the image is short.
+ *****************************************************************************/
+static void *DLstream_map_buffer(struct DL_stream_t *thisptr, unsigned bufsiz)
+{
+	unsigned char *data;
+
+	if ((thisptr->mcur & (sizeof(uint32_t) - 1)) ||
+									bufsiz > thisptr->msize - thisptr->mcur)
+		return NULL;
+	data = thisptr->mbase + thisptr->mcur;
+	thisptr->mcur += bufsiz;
+
+	return data;
+}			/* DLstream_map_buffer */
+
+/******************************************************************************
+ * DLstream_open
+ *
+ * PARAMETERS :
+ *	image		Image to be loaded
+ *	imagesize	Number of units to be loaded
+ *
+ * EFFECT :
+ *	Sets up the stream on an image owned by the caller.
+ *****************************************************************************/
+int DLstream_open(struct DL_stream_t *thisptr, void *image, uint32_t imagesize)
+{
+	if (image == NULL)
+		return -1;
+	thisptr->mbase = (unsigned char *)image;
+	thisptr->mcur = 0;
+	thisptr->msize = imagesize;
+	thisptr->mowned = DLSTREAM_CALLER;
+
+	return 0;
+}			/* DLstream_open */
+
+/******************************************************************************
+ * DLstream_map
+ *
+ * PARAMETERS :
+ *	path	Path of the DOFF file to be loaded
+ *
+ * EFFECT :
+ *	Sets up the stream on a private mapping of the file, or on a copy of
+ *  it read into memory if the file cannot be mapped.
+ *****************************************************************************/
+int DLstream_map(struct DL_stream_t *thisptr, const char *path)
+{
+	struct stat st;
+	void *image;
+	ssize_t got;
+	int fd;
+
+	thisptr->mbase = NULL;
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size > UINT32_MAX) {
+		close(fd);
+		return -1;
+	}
+	image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (image != MAP_FAILED) {
+		DLstream_open(thisptr, image, st.st_size);
+		thisptr->mowned = DLSTREAM_MAPPED;
+	} else if ((image = malloc(st.st_size)) != NULL) {
+		got = read(fd, image, st.st_size);
+		if (got != st.st_size) {
+			free(image);
+			image = NULL;
+		} else {
+			DLstream_open(thisptr, image, st.st_size);
+			thisptr->mowned = DLSTREAM_ALLOCATED;
+		}
+	}
+	close(fd);
+
+	return thisptr->mbase ? 0 : -1;
+}			/* DLstream_map */
+
+/******************************************************************************
+ * DLstream_close
+ *
+ * PARAMETERS :
+ *	None
+ *
+ * EFFECT :
+ *	Releases the image if DLstream_map obtained it.
+ *****************************************************************************/
+void DLstream_close(struct DL_stream_t *thisptr)
+{
+	if (thisptr->mowned == DLSTREAM_MAPPED)
+		munmap(thisptr->mbase, thisptr->msize);
+	else if (thisptr->mowned == DLSTREAM_ALLOCATED)
+		free(thisptr->mbase);
+	thisptr->mbase = NULL;
+	thisptr->mcur = 0;
+	thisptr->msize = 0;
+	thisptr->mowned = DLSTREAM_CALLER;
+}			/* DLstream_close */
+
+/******************************************************************************
+ * DLstream_init
+ *
+ * PARAMETERS :
+ *	None
+ *
+ * EFFECT :
+ *	Initializes the handlers for the DL APIs and an empty stream.
+ *****************************************************************************/
+void DLstream_init(struct DL_stream_t *thisptr)
+{
+	thisptr->dstrm.read_buffer = (int (*)(struct Dynamic_Loader_Stream *,
+											void *, unsigned))DLstream_read_buffer;
+	thisptr->dstrm.set_file_posn = (int (*)(struct Dynamic_Loader_Stream *,
+											unsigned))DLstream_set_file_posn;
+	thisptr->dstrm.map_buffer = (void *(*)(struct Dynamic_Loader_Stream *,
+											unsigned))DLstream_map_buffer;
+	thisptr->mbase = NULL;
+	thisptr->mcur = 0;
+	thisptr->msize = 0;
+	thisptr->mowned = DLSTREAM_CALLER;
+}			/* DLstream_init */
+
+#ifdef __cplusplus
+}
+#endif
@@ -44,6 +44,8 @@ struct DL_stream_t {
 	struct Dynamic_Loader_Stream dstrm;
 	unsigned char *mbase;
 	uint32_t mcur;
+	uint32_t msize;		/* size of the image at mbase */
+	int mowned;		/* how DLstream_map got mbase, 0 if caller owns it */
 } ;
 
 /******************************************************************************
@@ -58,7 +60,22 @@ struct DL_stream_t {
  *  and size also.
  * 
  *****************************************************************************/
-	int DLstream_open(struct DL_stream_t * thisptr, void *image);
+	int DLstream_open(struct DL_stream_t * thisptr, void *image,
+															uint32_t imagesize);
+
+/******************************************************************************
+ * DLstream_map
+ *
+ * PARAMETERS :
+ *  path		Path of the DOFF file to be loaded
+ *
+ * EFFECT :
+ *	Maps the file privately and sets up the stream on the mapping, so that
+ *  map_buffer hands out image packets in place.  Falls back to reading
+ *  the file into memory if it cannot be mapped.  Returns 0 for success.
+ *
+ *****************************************************************************/
+	int DLstream_map(struct DL_stream_t * thisptr, const char *path);
 
 /******************************************************************************
  * DLSTREAM_open
@@ -22,7 +22,8 @@
  *
  * A class used by the dynamic loader for symbol table support.
  *
- * This implementation uses a flat hash table, malloc/free, and printf
+ * This implementation uses an open addressed hash table, a string arena
+ * per module, malloc/free, and printf
  *****************************************************************************
  *****************************************************************************/
 
@@ -83,8 +84,7 @@ static struct dynload_symbol *DLsym_Find_Matching_Symbol
 									(struct DL_sym_t * thisptr,const char *name)
 {
 	struct my_symbol *fsym;
-	fsym = (struct my_symbol *)Find_Matching_Symbol(
-									(struct symtab *)&(thisptr->a_symtab),name);
+	fsym = (struct my_symbol *)Find_Matching_Symbol(&(thisptr->a_symtab),name);
 	if (!fsym)
 		return NULL; 
 	return &(fsym->lvalue);
@@ -105,22 +105,23 @@ static struct dynload_symbol *DLsym_Add_To_Symbol_Table
 {
 	struct my_symbol *newsym;
 	char *pname;
-	unsigned int slen = strlen(nname) + 1;
 	/* length of the symbol name */
-	slen = strlen(nname) + 1;
-	/* allocate all the memory we need at once, to save headers */
-	newsym = (struct my_symbol *)malloc(sizeof(struct my_symbol) + slen);
+	unsigned int slen = strlen(nname) + 1;
+	/* take the symbol and its name from the module's arena in one piece */
+	newsym = (struct my_symbol *)Alloc_Symbol_Space(&thisptr->a_symtab,
+										sizeof(struct my_symbol) + slen,moduleid);
 	if (!newsym) {
 		printf("*** Heap space exhausted in Add_Symbol %d\n", slen);
 		return NULL;
 	}
-	if (!newsym)
-		return NULL;
 	/* get a pointer for the name.  It follows the symbol*/
 	pname = (char *)(newsym + 1);
-	strcpy(pname, nname);
-	Add_To_Symbol_Table((struct symtab *)&(thisptr->a_symtab), &(newsym->sym), 
-																pname,moduleid);
+	memcpy(pname, nname, slen);
+	if (Add_To_Symbol_Table(&thisptr->a_symtab, &(newsym->sym), pname,
+																moduleid) != 0) {
+		printf("*** Heap space exhausted in Add_Symbol %d\n", slen);
+		return NULL;
+	}
 	return &(newsym->lvalue);
 }			/* DLsym_Add_To_Symbol_Table */
 
@@ -136,8 +137,9 @@ static struct dynload_symbol *DLsym_Add_To_Symbol_Table
  *****************************************************************************/
 static void DLsym_Purge_Symbol_Table(struct DL_sym_t *thisptr,unsigned moduleid)
 {
-	Iterate_Symbols((struct symbol **)&(thisptr->a_symtab.mytable),Purge_Symbol,
-															(void *)moduleid);
+	Iterate_Symbols(&thisptr->a_symtab, Purge_Symbol,
+												(void *)(uintptr_t)moduleid);
+	Free_Symbol_Space(&thisptr->a_symtab, moduleid);
 }			/* DLsym_Purge_Symbol_Table */
 
 /******************************************************************************
@@ -219,6 +221,101 @@ void DLsym_init(struct DL_sym_t *thisptr)
 	Init_Symbol_Table((struct symtab *) & (thisptr->a_symtab), LSYM_LOGTBLLEN);
 }			/* DLsym_init */
 
+/******************************************************************************
+ * DLsym_exit
+ *
+ * PARAMETERS :
+ *
+ *
+ * EFFECT :
+ *	The symbol table and all symbols in it are released
+ *****************************************************************************/
+void DLsym_exit(struct DL_sym_t *thisptr)
+{
+	Free_Symbol_Table(&thisptr->a_symtab);
+	Init_Symbol_Table(&thisptr->a_symtab, LSYM_LOGTBLLEN);
+}			/* DLsym_exit */
+
+/******************************************************************************
+ * DLsym_Add_Symbols
+ *
+ * PARAMETERS :
+ *	names		Names of the symbols to add
+ *	values		Their values
+ *	count		Number of symbols
+ *	moduleid	Unique id for the module the symbols reside in
+ *
+ * EFFECT :
+ *	Grows the table and the arena once for the whole batch, then adds
+ *  the symbols.
+ *****************************************************************************/
+unsigned DLsym_Add_Symbols(struct DL_sym_t *thisptr, const char *const *names,
+				const LDR_ADDR *values, unsigned count, unsigned moduleid)
+{
+	struct dynload_symbol *newsym;
+	unsigned added, space;
+
+	/* symbol, name and worst case alignment padding of each */
+	space = 0;
+	for (added = 0;added < count;added++)
+		space += sizeof(struct my_symbol) + strlen(names[added]) + 1 +
+															sizeof(void *);
+	if (Reserve_Symbol_Table(&thisptr->a_symtab, count) != 0 ||
+		Reserve_Symbol_Space(&thisptr->a_symtab, space, moduleid) != 0) {
+		printf("*** Heap space exhausted in Add_Symbols %d\n", count);
+		return 0;
+	}
+	for (added = 0;added < count;added++) {
+		newsym = DLsym_Add_To_Symbol_Table(thisptr, names[added], moduleid);
+		if (!newsym)
+			break;
+		newsym->value = values[added];
+	}
+	return added;
+}			/* DLsym_Add_Symbols */
+
+/******************************************************************************
+ * DLsym_Save
+ *
+ * PARAMETERS :
+ *	mark	Receives the current state of the table
+ *
+ * EFFECT :
+ *	Records the symbols now in the table
+ *****************************************************************************/
+void DLsym_Save(struct DL_sym_t *thisptr, struct DL_symmark *mark)
+{
+	Save_Symbol_Table(&thisptr->a_symtab, mark);
+}			/* DLsym_Save */
+
+/******************************************************************************
+ * DLsym_Restore
+ *
+ * PARAMETERS :
+ *	mark	State recorded by DLsym_Save
+ *
+ * EFFECT :
+ *	Removes every symbol added since mark was saved
+ *****************************************************************************/
+void DLsym_Restore(struct DL_sym_t *thisptr, const struct DL_symmark *mark)
+{
+	Restore_Symbol_Table(&thisptr->a_symtab, mark);
+}			/* DLsym_Restore */
+
+/******************************************************************************
+ * DLsym_Get_Stats
+ *
+ * PARAMETERS :
+ *	stats	Receives the lookup statistics
+ *
+ * EFFECT :
+ *	Copies out the lookup statistics
+ *****************************************************************************/
+void DLsym_Get_Stats(struct DL_sym_t *thisptr, struct DL_symstats *stats)
+{
+	*stats = thisptr->a_symtab.stats;
+}			/* DLsym_Get_Stats */
+
 #ifdef __cplusplus
 }
 #endif
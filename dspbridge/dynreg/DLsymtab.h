@@ -39,20 +39,60 @@ extern "C" {
 
 /* Symbol Table Entry */
 struct symbol {
-	struct symbol *link;	/* ptr to next symbol in the hash table */
+	struct symbol *link;	/* older symbol of the same name, shadowed by this */
 	const char *name;	/* symbol name                                      */
 	unsigned versn;	/* id of the module in which this       */
 	/* symbol resides                                           */
 	unsigned length;	/* length of the symbol name                */
+	uint32_t serial;	/* order of insertion, for Restore_Symbol_Table */
+} ;
+
+/* Hash table slot: the cached hash of the name, and its newest symbol */
+struct symslot {
+	uint32_t hash;
+	struct symbol *sym;	/* NULL if free, &symslot_deleted if deleted */
+} ;
+
+/* Chunk of the string arena.  Names and symbols of one module are packed */
+/* into its chunks, which are released together when the module is purged */
+struct symchunk {
+	struct symchunk *next;	/* next older chunk                 */
+	unsigned versn;	/* module whose symbols live here       */
+	uint32_t serial;	/* serial when the chunk was created   */
+	unsigned used;	/* bytes of data handed out                */
+	unsigned size;	/* bytes of data in the chunk              */
+} ;
+
+/* Lookup statistics, see DLsym_Get_Stats */
+struct DL_symstats {
+	unsigned lookups;	/* Find_Matching_Symbol calls               */
+	unsigned hits;	/* lookups that found a symbol                */
+	unsigned probes;	/* slots examined by all lookups             */
+	unsigned max_probes;	/* most slots examined by one lookup     */
+	unsigned symbols;	/* symbols currently in the table          */
+	unsigned slots;	/* size of the hash table                     */
+	unsigned rebuilds;	/* times the hash table was rebuilt         */
+	unsigned arena_bytes;	/* bytes held by the string arena        */
 } ;
 
 /* Symbol Table 'class' with support fields.*/
 struct symtab {
-	/* Symbol Table is a hash table of symbols; size is based on hash fcn   */
-	struct symbol *(mytable[(1 << (LSYM_LOGTBLLEN)) + 1]);
+	/* Open addressed hash table of 2**logsize slots, linearly probed.   */
+	/* It is allocated on the first insertion and grows as needed.       */
+	struct symslot *slots;
+	unsigned logsize;	/* log base 2 of the number of slots */
+	unsigned used;	/* slots holding a symbol              */
+	unsigned deleted;	/* slots marked deleted            */
+	struct symchunk *arena;	/* newest chunk first            */
+	uint32_t serial;	/* last serial handed out          */
+	struct DL_symstats stats;
+} ;
 
-	int hash_key;	/* remember hash lookup index from last lookup  */
-	unsigned last_length;	/* remember last length */
+/* A point to return the table to, see DLsym_Save */
+struct DL_symmark {
+	uint32_t serial;	/* last serial at the time of the save  */
+	uint32_t chunk_serial;	/* newest chunk at the time of the save */
+	unsigned chunk_used;	/* its bytes used at the time            */
 } ;
 
 /* Customized DL Symbol Manager 'class' */
@@ -79,6 +119,69 @@ struct DL_sym_t {
  *****************************************************************************/
 void DLsym_init(struct DL_sym_t * thisptr);
 
+/*****************************************************************************
+ * DLsym_exit
+ *
+ * PARAMETERS :
+ *	none
+ *
+ * EFFECT :
+ *	Releases the symbol table and every symbol in it
+ *****************************************************************************/
+void DLsym_exit(struct DL_sym_t * thisptr);
+
+/*****************************************************************************
+ * DLsym_Add_Symbols
+ *
+ * PARAMETERS :
+ *	names		Names of the symbols to add
+ *	values		Their values
+ *	count		Number of symbols
+ *	moduleid	Unique id for the module the symbols reside in
+ *
+ * EFFECT :
+ *	Adds a batch of symbols, e.g. the exports of the base image, sizing
+ *  the table and the string arena once for all of them.  Returns the
+ *  number of symbols added, which is less than count if memory ran out.
+ *****************************************************************************/
+unsigned DLsym_Add_Symbols(struct DL_sym_t * thisptr, const char *const *names,
+				const LDR_ADDR *values, unsigned count, unsigned moduleid);
+
+/*****************************************************************************
+ * DLsym_Save
+ *
+ * PARAMETERS :
+ *	mark	Receives the current state of the table
+ *
+ * EFFECT :
+ *	Records the symbols now in the table, typically those of the base
+ *  image, so that DLsym_Restore can later drop everything added since.
+ *****************************************************************************/
+void DLsym_Save(struct DL_sym_t * thisptr, struct DL_symmark * mark);
+
+/*****************************************************************************
+ * DLsym_Restore
+ *
+ * PARAMETERS :
+ *	mark	State recorded by DLsym_Save
+ *
+ * EFFECT :
+ *	Removes every symbol added since mark was saved and releases its
+ *  storage.  Symbols saved in mark and purged since are not brought back.
+ *****************************************************************************/
+void DLsym_Restore(struct DL_sym_t * thisptr, const struct DL_symmark * mark);
+
+/*****************************************************************************
+ * DLsym_Get_Stats
+ *
+ * PARAMETERS :
+ *	stats	Receives the lookup statistics
+ *
+ * EFFECT :
+ *	Copies out the lookup statistics gathered since DLsym_init
+ *****************************************************************************/
+void DLsym_Get_Stats(struct DL_sym_t * thisptr, struct DL_symstats * stats);
+
 #ifdef __cplusplus
 }
 #endif
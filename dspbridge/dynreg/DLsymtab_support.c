@@ -22,7 +22,7 @@
  *
  * Suuport functions used by the dynamic loader for the symbol table.
  *
- * This implementation uses a flat hash table
+ * This implementation uses an open addressed hash table and a string arena
  *****************************************************************************
  *****************************************************************************/
 
@@ -32,6 +32,7 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "DLsymtab.h"
 #include "DLsymtab_support.h"
@@ -42,18 +43,89 @@ extern "C" {
 #define SYMI_terminate	2	/* terminate iteration */
 
 /******************************************************************************
- * We are using multiplicative Fibonacci hashing;
- * these magic constants have been derived from Knuth.
+ * Names are hashed FNV-1a style, which mixes every character into all 32
+ * bits; slots are then picked by multiplicative Fibonacci hashing on that
+ * value.  These magic constants have been derived from Knuth and FNV.
  *****************************************************************************/
-#define AVALUE		UINT32_C(1315424652)
+#define AVALUE		UINT32_C(2654435769)
+#define FNV_BASIS	UINT32_C(2166136261)
+#define FNV_PRIME	UINT32_C(16777619)
 
-#define KEYSHIFT	4
+#define SLOT_INDEX(hash, logsize) \
+						((uint32_t)((hash) * AVALUE) >> (32 - (logsize)))
 
-#if defined(__TMS320C55X__) || defined(_TMS320C5XX)
-#define BITS_PER_AU 16
-#else
-#define BITS_PER_AU 8
-#endif
+/* Marks a deleted slot, so that probing carries on past it */
+static struct symbol symslot_deleted;
+
+/* Smallest arena chunk; larger requests get a chunk of their own size */
+#define CHUNK_SIZE	4096
+/* Arena allocations keep symbols aligned for any member */
+#define ARENA_ALIGN(x)	(((x) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+/******************************************************************************
+ * Hash_Name
+ *
+ * PARAMETERS :
+ *  name		A symbol name
+ *  length		Receives the length of the name
+ *
+ * EFFECT :
+ *	Returns the hash of the name.
+ *****************************************************************************/
+static uint32_t Hash_Name(const char *name, unsigned *length)
+{
+	const unsigned char *nam = (const unsigned char *)name;
+	uint32_t key = FNV_BASIS;
+
+	while (*nam)
+		key = (key ^ *nam++) * FNV_PRIME;
+	*length = (const char *)nam - name;
+
+	return key;
+}			/* Hash_Name */
+
+/******************************************************************************
+ * Rebuild_Symbol_Table
+ *
+ * PARAMETERS :
+ *  a_stable	A pointer to the symbol table object
+ *  logsize		Log base 2 of the new number of slots
+ *
+ * EFFECT :
+ *	Moves every symbol into a new table of 2**logsize slots, dropping the
+ *  deleted markers.  Returns 0 for success, or -1 if out of memory, in
+ *  which case the table is left as it was.
+ *****************************************************************************/
+static int Rebuild_Symbol_Table(struct symtab *a_stable, unsigned logsize)
+{
+	struct symslot *slots, *old;
+	unsigned i, j, mask, oldlen;
+
+	slots = (struct symslot *)calloc((size_t)1 << logsize,
+													sizeof(struct symslot));
+	if (!slots)
+		return -1;
+	mask = (1U << logsize) - 1;
+	old = a_stable->slots;
+	oldlen = old ? 1U << a_stable->logsize : 0;
+	for (i = 0;i < oldlen;i++) {
+		if (old[i].sym == NULL || old[i].sym == &symslot_deleted)
+			continue;
+		j = SLOT_INDEX(old[i].hash, logsize);
+		while (slots[j].sym)
+			j = (j + 1) & mask;
+		slots[j] = old[i];
+	}
+	free(old);
+	a_stable->slots = slots;
+	a_stable->logsize = logsize;
+	a_stable->deleted = 0;
+	a_stable->stats.slots = mask + 1;
+	if (old)
+		a_stable->stats.rebuilds += 1;
+
+	return 0;
+}			/* Rebuild_Symbol_Table */
 
 /******************************************************************************
  * Init_Symbol_Table
@@ -62,28 +134,182 @@ extern "C" {
  *
  * PARAMETERS :
  *  a_stable	A pointer to the symbol table object
- *  llen		Log base 2 of length of the hash index.
- *
- * INITIAL CONDITIONS :
- *	The symbol table must be an array of length 2**llen +1
+ *  llen		Log base 2 of the initial number of slots.
  *
  * POST CONDITIONS :
- *	The symbol table is appropriately initialized
+ *	The symbol table is empty.  Its slots are allocated on the first
+ *  insertion, so a table that is only searched costs no memory.
  *****************************************************************************/
 void Init_Symbol_Table(struct symtab *a_stable, int llen) 
 {
-	struct symbol **dst;
-	int length;
-
-	dst = (a_stable->mytable);
-	length = 1 << llen;
-	/* init the shift count */
-	*dst++ = (struct symbol *)(sizeof(uint32_t) * BITS_PER_AU - llen);
-	do
-		*dst++ = 0;
-	while ((length -= 1) > 0);	/* zap the pointers */
+	memset(a_stable, 0, sizeof(*a_stable));
+	a_stable->logsize = llen;
 }			/* Init_Symbol_Table */
 
+/******************************************************************************
+ * Free_Symbol_Table
+ *
+ * PARAMETERS :
+ *  a_stable	A pointer to the symbol table object
+ *
+ * EFFECT :
+ *	Releases the slots and the whole string arena.  The table must be
+ *  initialized again before it is used.
+ *****************************************************************************/
+void Free_Symbol_Table(struct symtab *a_stable)
+{
+	struct symchunk *chunk, *next;
+
+	for (chunk = a_stable->arena;chunk;chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	free(a_stable->slots);
+	a_stable->slots = NULL;
+	a_stable->arena = NULL;
+}			/* Free_Symbol_Table */
+
+/******************************************************************************
+ * Reserve_Symbol_Table
+ *
+ * PARAMETERS :
+ *  a_stable	A pointer to the symbol table object
+ *  count		Number of symbols about to be added
+ *
+ * EFFECT :
+ *	Grows the table once so that count more symbols fit without it being
+ *  rebuilt again.  Returns 0 for success, -1 if out of memory.
+ *****************************************************************************/
+int Reserve_Symbol_Table(struct symtab *a_stable, unsigned count)
+{
+	unsigned logsize = a_stable->logsize;
+	unsigned need = a_stable->used + count;
+
+	/* keep at most half the slots in use, deleted ones included, so */
+	/* that linear probing stays short for misses as well as hits     */
+	while ((need << 1) > (1U << logsize))
+		logsize += 1;
+	if (a_stable->slots && logsize == a_stable->logsize &&
+						((need + a_stable->deleted) << 1) <= (1U << logsize))
+		return 0;
+
+	return Rebuild_Symbol_Table(a_stable, logsize);
+}			/* Reserve_Symbol_Table */
+
+/******************************************************************************
+ * New_Chunk
+ *
+ * PARAMETERS :
+ *  a_stable	A pointer to the symbol table object
+ *  size		Bytes the chunk must hold at least
+ *  versn 		id for module the chunk is for
+ *
+ * EFFECT :
+ *	Starts a new newest chunk of the arena.  Returns NULL if out of memory.
+ *****************************************************************************/
+static struct symchunk *New_Chunk(struct symtab *a_stable, unsigned size,
+																unsigned versn)
+{
+	struct symchunk *chunk;
+	unsigned csize = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+
+	chunk = (struct symchunk *)malloc(ARENA_ALIGN(sizeof(struct symchunk))
+																	+ csize);
+	if (!chunk)
+		return NULL;
+	chunk->next = a_stable->arena;
+	chunk->versn = versn;
+	chunk->serial = ++a_stable->serial;
+	chunk->used = 0;
+	chunk->size = csize;
+	a_stable->arena = chunk;
+	a_stable->stats.arena_bytes += csize;
+
+	return chunk;
+}			/* New_Chunk */
+
+/******************************************************************************
+ * Reserve_Symbol_Space
+ *
+ * PARAMETERS :
+ *  a_stable	A pointer to the symbol table object
+ *  size		Bytes about to be allocated, alignment included
+ *  versn 		id for module the space is for
+ *
+ * EFFECT :
+ *	Makes sure the module's arena chunk has room for size bytes, so that
+ *  a batch of symbols lands in a single chunk.  Returns 0 for success, -1
+ *  if out of memory.
+ *****************************************************************************/
+int Reserve_Symbol_Space(struct symtab *a_stable, unsigned size,
+																unsigned versn)
+{
+	struct symchunk *chunk = a_stable->arena;
+
+	if (chunk && chunk->versn == versn && chunk->size - chunk->used >= size)
+		return 0;
+
+	return New_Chunk(a_stable, size, versn) ? 0 : -1;
+}			/* Reserve_Symbol_Space */
+
+/******************************************************************************
+ * Alloc_Symbol_Space
+ *
+ * PARAMETERS :
+ *  a_stable	A pointer to the symbol table object
+ *  size		Bytes needed for a symbol and its name
+ *  versn 		id for module symbol resides in
+ *
+ * EFFECT :
+ *	Hands out pointer-aligned space from the module's arena chunk, starting
+ *  a new chunk when the newest belongs to another module or is full.  The
+ *  space lives until the module is purged.  Returns NULL if out of memory.
+ *****************************************************************************/
+void *Alloc_Symbol_Space(struct symtab *a_stable, unsigned size,
+																unsigned versn)
+{
+	struct symchunk *chunk = a_stable->arena;
+	void *space;
+
+	size = ARENA_ALIGN(size);
+	if (!chunk || chunk->versn != versn || chunk->size - chunk->used < size) {
+		chunk = New_Chunk(a_stable, size, versn);
+		if (!chunk)
+			return NULL;
+	}
+	space = (char *)chunk + ARENA_ALIGN(sizeof(struct symchunk)) + chunk->used;
+	chunk->used += size;
+
+	return space;
+}			/* Alloc_Symbol_Space */
+
+/******************************************************************************
+ * Free_Symbol_Space
+ *
+ * PARAMETERS :
+ *  a_stable	A pointer to the symbol table object
+ *  versn 		id of the module whose space to release
+ *
+ * EFFECT :
+ *	Releases the module's arena chunks.  Its symbols must have been
+ *  removed from the table first.
+ *****************************************************************************/
+void Free_Symbol_Space(struct symtab *a_stable, unsigned versn)
+{
+	struct symchunk **link = &a_stable->arena;
+	struct symchunk *chunk;
+
+	while ((chunk = *link) != NULL) {
+		if (chunk->versn == versn) {
+			*link = chunk->next;
+			a_stable->stats.arena_bytes -= chunk->size;
+			free(chunk);
+		} else {
+			link = &chunk->next;
+		}
+	}
+}			/* Free_Symbol_Space */
+
 /******************************************************************************
  * Find_Matching_Symbol
  *     
@@ -94,45 +320,43 @@ void Init_Symbol_Table(struct symtab *a_stable, int llen)
  * EFFECT :
  *	Locates a symbol matching the name specified.  A pointer to the
  * symbol is returned if it exists; 0 is returned if no such symbol is
- * found.
+ * found.  The full name is compared only when the cached hash and the
+ * length already match.
  *
  *****************************************************************************/
 struct symbol *Find_Matching_Symbol(struct symtab *a_stable, const char *name)
 {
+	struct symslot *slot;
 	struct symbol *sptr;
-	char c;
-	const char *nam1, *nam2;
-	uint32_t key, length;
-	int len;
-	
-	/* get name length and hash key */
-	nam1 = name;
-	key = 0;
-	while ((c = *nam1++))
-		key = (key << KEYSHIFT) + c;
-	a_stable->last_length = length = nam1 - name - 1;
-	
-	/* Now compute the key from the hash key */
-	a_stable->hash_key = (uint32_t)(key * AVALUE) >> (int)*a_stable->mytable; 
-	
-	/*  Search the list related to this hash key */
-	sptr = a_stable->mytable[a_stable->hash_key + 1];
-	
-	while (sptr != 0) { 
-		if (sptr->length == length) {	/* quick check on length */
-			nam1 = name;
-			nam2 = sptr->name;
-			len = length;
-			do
-				if (*nam1++ != *nam2++)
-					goto next_symbol;
-			while ((len -= sizeof (char)) > 0) ;
-			return sptr;	/* names match !! */
+	uint32_t key;
+	unsigned length, mask, i, probes;
+
+	a_stable->stats.lookups += 1;
+	if (!a_stable->slots)
+		return 0;
+	key = Hash_Name(name, &length);
+	mask = (1U << a_stable->logsize) - 1;
+	i = SLOT_INDEX(key, a_stable->logsize);
+	probes = 0;
+	sptr = 0;
+	for (;;i = (i + 1) & mask) {
+		probes += 1;
+		slot = &a_stable->slots[i];
+		if (slot->sym == NULL)
+			break;	/* no match found */
+		if (slot->hash == key && slot->sym != &symslot_deleted &&
+									slot->sym->length == length &&
+									memcmp(slot->sym->name, name, length) == 0) {
+			sptr = slot->sym;	/* names match !! */
+			a_stable->stats.hits += 1;
+			break;
 		}
-next_symbol:
-		sptr = (struct symbol *) sptr->link;
 	}
-	return 0;	/* no match found */ 
+	a_stable->stats.probes += probes;
+	if (probes > a_stable->stats.max_probes)
+		a_stable->stats.max_probes = probes;
+
+	return sptr;
 }			/* Find_Matching_Symbol */
 
 
@@ -146,21 +370,53 @@ next_symbol:
  *  versn 		id for module symbol resides in
  *
  * EFFECT :
- *	The new symbol is added to the table.
+ *	The new symbol is added to the table.  If a symbol of that name is
+ *  already present, the new one shadows it until the new one is purged.
+ *  Returns 0 for success, -1 if the table could not grow.
  *****************************************************************************/
-void Add_To_Symbol_Table(struct symtab *a_stable, struct symbol *newsym,
+int Add_To_Symbol_Table(struct symtab *a_stable, struct symbol *newsym,
 											const char *nname, unsigned versn) 
 {
-	register struct symbol **sptr; 
-	
-	Find_Matching_Symbol(a_stable, nname); 
-	/*Insert newsym at the head of stable[thisptr->hash_key+1] list */
-	sptr = &a_stable->mytable[a_stable->hash_key + 1];
-	newsym->link = (struct symbol *)*sptr;
-	*sptr = newsym;
+	struct symslot *slot, *free_slot;
+	uint32_t key;
+	unsigned length, mask, i;
+
+	if (Reserve_Symbol_Table(a_stable, 1) != 0)
+		return -1;
+	key = Hash_Name(nname, &length);
 	newsym->name = nname;
-	newsym->length = a_stable->last_length;
+	newsym->length = length;
 	newsym->versn = versn;
+	newsym->serial = ++a_stable->serial;
+	newsym->link = 0;
+	mask = (1U << a_stable->logsize) - 1;
+	free_slot = NULL;
+	for (i = SLOT_INDEX(key, a_stable->logsize);;i = (i + 1) & mask) {
+		slot = &a_stable->slots[i];
+		if (slot->sym == NULL)
+			break;
+		if (slot->sym == &symslot_deleted) {
+			if (!free_slot)
+				free_slot = slot;
+		} else if (slot->hash == key && slot->sym->length == length &&
+								memcmp(slot->sym->name, nname, length) == 0) {
+			/* shadow the older definition */
+			newsym->link = slot->sym;
+			slot->sym = newsym;
+			a_stable->stats.symbols += 1;
+			return 0;
+		}
+	}
+	if (free_slot) {
+		slot = free_slot;
+		a_stable->deleted -= 1;
+	}
+	slot->hash = key;
+	slot->sym = newsym;
+	a_stable->used += 1;
+	a_stable->stats.symbols += 1;
+
+	return 0;
 }			/* Add_To_Symbol_Table */
 
 
@@ -168,44 +424,54 @@ void Add_To_Symbol_Table(struct symtab *a_stable, struct symbol *newsym,
  * Iterate_Symbols
  *     
  * PARAMETERS :
- *  stable	A pointer to the symbol table
+ *  a_stable	A pointer to the symbol table object
  *	action	Routine to call with each symbol
  *	arg		Uninterpreted argument passed to "action"
  *
  * EFFECT :
  *	The specified routine is called repeatedly, once for each symbol in
- * the symbol table.  The return value of the called routine is interpreted
- * as follows:
+ * the symbol table, shadowed ones included.  The return value of the
+ * called routine is interpreted as follows:
  *	SYMI_continue	// continue iteration
  *	SYMI_terminate	// terminate iteration
  *	SYMI_delete		// delete symbol
  *
  *****************************************************************************/
-void Iterate_Symbols(struct symbol **stable, Symbol_Action *action, void *arg) 
+void Iterate_Symbols(struct symtab *a_stable, Symbol_Action *action, void *arg) 
 {
+	struct symslot *slot;
+	struct symbol **prev, *sym;
 	unsigned cnt;
-	struct symbol *prev, *sym, *nxt;
-	
-	/* length of hash table */
-	cnt = (~UINT32_C(0) >> (unsigned)*stable++) + 1; /* length of hash table */
-	do {
-		prev = (struct symbol *)stable;
-		sym = *stable++; 
-		while (sym) {	/* process list */
-			int rslt; 
-			nxt = sym->link;
+	int rslt;
+
+	if (!a_stable->slots)
+		return;
+	slot = a_stable->slots;
+	for (cnt = 1U << a_stable->logsize;cnt > 0;cnt -= 1, slot += 1) {
+		if (slot->sym == NULL || slot->sym == &symslot_deleted)
+			continue;
+		prev = &slot->sym;
+		rslt = SYMI_continue;
+		while ((sym = *prev) != NULL) {	/* process shadow list */
 			rslt = action(sym, arg);
-			if (rslt) {
-				/* remove from list */
-				if (rslt & SYMI_delete)
-					prev->link = nxt;
-				if (rslt & SYMI_terminate)
-					return;
-			} else
-				prev = sym; 
-			sym = nxt;
-		}	/* process list */ 
-	} while ((cnt -= 1) > 0); 
+			if (rslt & SYMI_delete) {
+				*prev = sym->link;	/* remove from list */
+				a_stable->stats.symbols -= 1;
+			} else {
+				prev = &sym->link;
+			}
+			if (rslt & SYMI_terminate)
+				break;
+		}
+		if (slot->sym == NULL) {
+			/* last symbol of this name gone, keep probe chains intact */
+			slot->sym = &symslot_deleted;
+			a_stable->used -= 1;
+			a_stable->deleted += 1;
+		}
+		if (rslt & SYMI_terminate)
+			return;
+	}
 }			/* Iterate_Symbols */
 
 
@@ -218,18 +484,86 @@ void Iterate_Symbols(struct symbol **stable, Symbol_Action *action, void *arg)
  *
  * EFFECT :
  *	Purge this symbol from the symbol table if it meets the criteria
- *  specified in arg
+ *  specified in arg.  Its storage is released with the module's arena.
  *
  *****************************************************************************/
 int Purge_Symbol(struct symbol *thissym, void *arg) 
 {
-	if ((thissym->versn == (uint32_t)arg)) {
-		free(thissym);
+	if ((thissym->versn == (uintptr_t)arg)) {
 		return SYMI_delete;
 	}
 	return SYMI_continue;
 }			/* Purge_Symbol */
 
+/******************************************************************************
+ * Newer_Symbol
+ *
+ * PARAMETERS :
+ *  thissym		Symbol to check
+ *  arg			Pointer to the serial of a Save_Symbol_Table mark
+ *
+ * EFFECT :
+ *	Removes the symbol if it was added after the mark.
+ *
+ *****************************************************************************/
+static int Newer_Symbol(struct symbol *thissym, void *arg)
+{
+	return thissym->serial > *(uint32_t *)arg ? SYMI_delete : SYMI_continue;
+}			/* Newer_Symbol */
+
+/******************************************************************************
+ * Save_Symbol_Table
+ *
+ * PARAMETERS :
+ *  a_stable	A pointer to the symbol table object
+ *  mark		Receives the current state of the table
+ *
+ * EFFECT :
+ *	Records where the table and its arena stand now.
+ *****************************************************************************/
+void Save_Symbol_Table(struct symtab *a_stable, struct DL_symmark *mark)
+{
+	mark->serial = a_stable->serial;
+	mark->chunk_serial = a_stable->arena ? a_stable->arena->serial : 0;
+	mark->chunk_used = a_stable->arena ? a_stable->arena->used : 0;
+}			/* Save_Symbol_Table */
+
+/******************************************************************************
+ * Restore_Symbol_Table
+ *
+ * PARAMETERS :
+ *  a_stable	A pointer to the symbol table object
+ *  mark		State recorded by Save_Symbol_Table
+ *
+ * EFFECT :
+ *	Removes the symbols added since the mark and releases the arena they
+ *  used.  Only the newest chunk at the time of the mark can have been
+ *  extended since, so trimming it back and dropping newer chunks is enough.
+ *****************************************************************************/
+void Restore_Symbol_Table(struct symtab *a_stable,
+												const struct DL_symmark *mark)
+{
+	struct symchunk **link = &a_stable->arena;
+	struct symchunk *chunk;
+	uint32_t serial = mark->serial;
+
+	Iterate_Symbols(a_stable, Newer_Symbol, &serial);
+	while ((chunk = *link) != NULL) {
+		if (chunk->serial > mark->serial) {
+			*link = chunk->next;
+			a_stable->stats.arena_bytes -= chunk->size;
+			free(chunk);
+		} else {
+			if (chunk->serial == mark->chunk_serial)
+				chunk->used = mark->chunk_used;
+			link = &chunk->next;
+		}
+	}
+	/* many deleted slots make misses probe long; drop them */
+	if (a_stable->slots && (a_stable->deleted << 2) > (1U << a_stable->logsize))
+		Rebuild_Symbol_Table(a_stable, a_stable->logsize);
+}			/* Restore_Symbol_Table */
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,7 +25,7 @@
  *
  * Suuport functions used by the dynamic loader for the symbol table.
  *
- * This implementation uses a flat hash table, malloc/free, and printf
+ * This implementation uses an open addressed hash table and a string arena
  *****************************************************************************
  *****************************************************************************/
 #ifdef __cplusplus
@@ -38,14 +38,26 @@ extern "C" {
 typedef int Symbol_Action(struct symbol *thissym, void *arg);
 
 void Init_Symbol_Table(struct symtab *a_stable, int llen);
+void Free_Symbol_Table(struct symtab *a_stable);
+int Reserve_Symbol_Table(struct symtab *a_stable, unsigned count);
+
+int Reserve_Symbol_Space(struct symtab *a_stable, unsigned size,
+																unsigned versn);
+void *Alloc_Symbol_Space(struct symtab *a_stable, unsigned size,
+																unsigned versn);
+void Free_Symbol_Space(struct symtab *a_stable, unsigned versn);
 
 struct symbol *Find_Matching_Symbol(struct symtab *a_table, const char *name);
 
-void Add_To_Symbol_Table(struct symtab *a_stable, struct symbol * newsym,
+int Add_To_Symbol_Table(struct symtab *a_stable, struct symbol * newsym,
 											const char *nname, unsigned versn);
-void Iterate_Symbols(struct symbol **stable, Symbol_Action *action,void *arg);
+void Iterate_Symbols(struct symtab *a_stable, Symbol_Action *action,void *arg);
 int Purge_Symbol(struct symbol *thissym, void *arg);
 
+void Save_Symbol_Table(struct symtab *a_stable, struct DL_symmark *mark);
+void Restore_Symbol_Table(struct symtab *a_stable,
+												const struct DL_symmark *mark);
+
 #ifdef __cplusplus
 }
 #endif
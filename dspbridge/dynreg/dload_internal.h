@@ -207,6 +207,7 @@ extern void dload_strings(struct dload_state * dlthis, boolean sec_names_only);
 extern void dload_sections(struct dload_state * dlthis);
 extern void dload_reorder(void *data, int dsiz, uint_least32_t map);
 extern uint32_t dload_checksum(void *data, unsigned siz);
+extern uint32_t dload_checksum_copy(void *dest, void *data, unsigned siz);
 #if HOST_ENDIANNESS
 extern uint32_t dload_reverse_checksum(void *data, unsigned siz);
 #if (TARGET_AU_BITS > 8) && (TARGET_AU_BITS < 32)
@@ -0,0 +1,305 @@
+/*
+ *  Copyright 2001-2008 Texas Instruments - http://www.ti.com/
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+/*
+ *  ======== dloadbench.c ========
+ *  "dloadbench" is a console utility that times how long the GPP side
+ *  dynamic loader takes to read a DOFF image, and checks that the mapped
+ *  stream of DLstream.c produces exactly the data of the reference stream.
+ *
+ *  Each pass opens the image, parses its headers and reads every section
+ *  with DLOAD_GetSection, the way dynreg does.  The reference passes read
+ *  the file with stdio into the loader's buffers; the mapped passes map
+ *  the file and copy and checksum the image packets in place.  No DSP or
+ *  Bridge driver is needed.
+ *
+ *  Usage:
+ *      dloadbench [optional args] <DOFF file>
+ *
+ *  Options:
+ *      -v: verbose mode, lists the sections and loader errors.
+ *      -n <count>: number of timed passes per stream, default 100.
+ *      -?: displays "dloadbench" usage.
+ *
+ *  Notes:
+ *      Sections that carry relocation entries cannot be read through
+ *      DLOAD_GetSection and are reported as skipped, for both streams.
+ *      The exit status is 0 only if both streams agree on every section.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <getsection.h>
+#include "dlclasses_hdr.h"
+
+#define DEFAULTPASSES	100	/* Timed passes per stream */
+#define MAXSECTIONS	256	/* Sections compared per image */
+#define MAXNAMELEN	32	/* Section name characters kept for reports */
+
+/* The reference stream: the stdio callbacks dynreg used to install */
+struct FILE_stream_t {
+	struct Dynamic_Loader_Stream dstrm;
+	FILE *fp;
+};
+
+/* What one stream read for a section */
+struct SECTDATA {
+	char szName[MAXNAMELEN];
+	size_t uSize;
+	unsigned char *pData;
+	int fRead;
+};
+
+/* Usable functions */
+static void DisplayUsage(void);
+static int LoadImage(const char *szPath, int fMapped, struct SECTDATA *aSect,
+													unsigned *pcSections);
+static unsigned long long TimeNs(void);
+
+/* global variables. */
+static int g_fVerbose = 0;
+
+/*
+ *  ======== main ========
+ */
+int main(int argc, char *argv[])
+{
+	static struct SECTDATA aRef[MAXSECTIONS];
+	static struct SECTDATA aMap[MAXSECTIONS];
+	unsigned long long ulStart, ulNs, ulMin[2], ulTotal[2];
+	unsigned cRef = 0, cMap = 0, cSkipped = 0, cDiffer = 0;
+	unsigned long ulBytes = 0;
+	const char *szPath = NULL;
+	int nPasses = DEFAULTPASSES;
+	int i, iStream;
+
+	for (i = 1;i < argc;i++) {
+		if (strcmp(argv[i], "-v") == 0) {
+			g_fVerbose = 1;
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			nPasses = atoi(argv[++i]);
+		} else if (argv[i][0] != '-' && szPath == NULL) {
+			szPath = argv[i];
+		} else {
+			DisplayUsage();
+			return 1;
+		}
+	}
+	if (szPath == NULL || nPasses <= 0) {
+		DisplayUsage();
+		return 1;
+	}
+	/* First pass of each stream allocates the section buffers */
+	if (LoadImage(szPath, 0, aRef, &cRef) != 0) {
+		fprintf(stdout, "dloadbench: reference stream failed on %s\n",
+																	szPath);
+		return 1;
+	}
+	if (LoadImage(szPath, 1, aMap, &cMap) != 0) {
+		fprintf(stdout, "dloadbench: mapped stream failed on %s\n", szPath);
+		return 1;
+	}
+	/* Alternate the streams so that both see the same cache state */
+	ulMin[0] = ulMin[1] = ~0ULL;
+	ulTotal[0] = ulTotal[1] = 0;
+	for (i = 0;i < nPasses;i++) {
+		for (iStream = 0;iStream < 2;iStream++) {
+			ulStart = TimeNs();
+			if (LoadImage(szPath, iStream, iStream ? aMap : aRef,
+									iStream ? &cMap : &cRef) != 0) {
+				fprintf(stdout, "dloadbench: pass %d failed\n", i);
+				return 1;
+			}
+			ulNs = TimeNs() - ulStart;
+			ulTotal[iStream] += ulNs;
+			if (ulNs < ulMin[iStream]) {
+				ulMin[iStream] = ulNs;
+			}
+		}
+	}
+	/* Compare what the last pass of each stream read */
+	if (cRef != cMap) {
+		fprintf(stdout, "dloadbench: %u sections by reference, %u mapped\n",
+																cRef, cMap);
+		cDiffer++;
+	}
+	for (i = 0;i < (int)cRef && i < (int)cMap;i++) {
+		if (aRef[i].fRead != aMap[i].fRead || aRef[i].uSize != aMap[i].uSize
+					|| (aRef[i].fRead && memcmp(aRef[i].pData, aMap[i].pData,
+														aRef[i].uSize) != 0)) {
+			fprintf(stdout, "dloadbench: section %d (%s) differs\n", i,
+															aRef[i].szName);
+			cDiffer++;
+		} else if (!aRef[i].fRead) {
+			cSkipped++;
+		} else {
+			ulBytes += aRef[i].uSize;
+		}
+		if (g_fVerbose) {
+			fprintf(stdout, "  %3d %-24s %8lu bytes %s\n", i, aRef[i].szName,
+						(unsigned long)aRef[i].uSize,
+						aRef[i].fRead ? "read" : "skipped");
+		}
+	}
+	fprintf(stdout, "%s: %u sections, %u skipped, %lu bytes read\n", szPath,
+													cRef, cSkipped, ulBytes);
+	fprintf(stdout, "reference: mean %llu us, min %llu us\n",
+				ulTotal[0] / nPasses / 1000, ulMin[0] / 1000);
+	fprintf(stdout, "mapped:    mean %llu us, min %llu us\n",
+				ulTotal[1] / nPasses / 1000, ulMin[1] / 1000);
+	fprintf(stdout, "%s\n", cDiffer ? "MISMATCH" : "identical");
+
+	for (i = 0;i < MAXSECTIONS;i++) {
+		free(aRef[i].pData);
+		free(aMap[i].pData);
+	}
+	return cDiffer ? 1 : 0;
+}
+
+/*
+ *  ======== ReadFile ========
+ *  read_buffer method of the reference stream
+ */
+static int ReadFile(struct Dynamic_Loader_Stream *this, void *buffer,
+															unsigned bufsize)
+{
+	return fread(buffer, 1, bufsize, ((struct FILE_stream_t *)this)->fp);
+}
+
+/*
+ *  ======== SeekFile ========
+ *  set_file_posn method of the reference stream
+ */
+static int SeekFile(struct Dynamic_Loader_Stream *this, unsigned int pos)
+{
+	return fseek(((struct FILE_stream_t *)this)->fp, (long)pos, SEEK_SET);
+}
+
+/*
+ *  ======== QuietReport ========
+ *  Error_Report method used unless verbose: skipped sections are expected
+ */
+static void QuietReport(struct Dynamic_Loader_Sym *this, const char *errstr,
+																va_list args)
+{
+}
+
+/*
+ *  ======== LoadImage ========
+ *  Open the image through the reference or the mapped stream and read
+ *  every section into aSect, allocating the buffers on the first call.
+ */
+static int LoadImage(const char *szPath, int fMapped, struct SECTDATA *aSect,
+														unsigned *pcSections)
+{
+	struct DL_sym_t inputSymbols;
+	struct DL_stream_t mappedStream;
+	struct FILE_stream_t fileStream;
+	struct Dynamic_Loader_Stream *strm;
+	const struct LDR_SECTION_INFO *sect;
+	DLOAD_module_info desc;
+	size_t uSize;
+	unsigned i;
+	int status = 0;
+
+	DLsym_init(&inputSymbols);
+	if (!g_fVerbose) {
+		inputSymbols.sym.Error_Report = QuietReport;
+	}
+	if (fMapped) {
+		DLstream_init(&mappedStream);
+		if (DLstream_map(&mappedStream, szPath) != 0) {
+			return -1;
+		}
+		strm = &mappedStream.dstrm;
+	} else {
+		fileStream.fp = fopen(szPath, "rb");
+		if (!fileStream.fp) {
+			return -1;
+		}
+		fileStream.dstrm.read_buffer = ReadFile;
+		fileStream.dstrm.set_file_posn = SeekFile;
+		fileStream.dstrm.map_buffer = NULL;
+		strm = &fileStream.dstrm;
+	}
+	desc = DLOAD_module_open(strm, &inputSymbols.sym);
+	if (!desc) {
+		status = -1;
+	}
+	for (i = 0;desc && DLOAD_GetSectionNum(desc, i, &sect);i++) {
+		if (i == MAXSECTIONS) {
+			status = -1;
+			break;
+		}
+		uSize = DLOAD_RoundUpSectionSize(sect->size);
+		if (!aSect[i].pData) {
+			aSect[i].pData = malloc(uSize ? uSize : sizeof(uint32_t));
+			if (!aSect[i].pData) {
+				status = -1;
+				break;
+			}
+			aSect[i].uSize = uSize;
+			strncpy(aSect[i].szName, sect->name, MAXNAMELEN - 1);
+		} else if (aSect[i].uSize != uSize) {
+			status = -1;
+			break;
+		}
+		/* as dynreg does, start each section from a cleared buffer */
+		memset(aSect[i].pData, 0, uSize);
+		aSect[i].fRead = DLOAD_GetSection(desc, sect, aSect[i].pData);
+	}
+	*pcSections = i;
+	if (desc) {
+		DLOAD_module_close(desc);
+	}
+	if (fMapped) {
+		DLstream_close(&mappedStream);
+	} else {
+		fclose(fileStream.fp);
+	}
+	DLsym_exit(&inputSymbols);
+	return status;
+}
+
+/*
+ *  ======== TimeNs ========
+ */
+static unsigned long long TimeNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ *  ======== DisplayUsage ========
+ *  Display usage of dloadbench utility
+ */
+static void DisplayUsage(void)
+{
+	fprintf(stdout, "Usage: dloadbench [optional args] <DOFF file>\n");
+	fprintf(stdout, "[optional args]:\n");
+	fprintf(stdout, "-v: verbose mode.\n");
+	fprintf(stdout, "-n <count>: timed passes per stream, default %d.\n",
+																DEFAULTPASSES);
+	fprintf(stdout, "-?: displays \"dloadbench\" usage. \n");
+	fprintf(stdout, "\nExample: dloadbench -n 50 /system/lib/dsp/mp3dec_sn.dll64P\n\n");
+}
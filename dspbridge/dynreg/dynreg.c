@@ -103,15 +103,10 @@ static int getSectDataFromLib(IN CHAR *szLibPath, IN CHAR *szSection,
 														OUT NLDR_PHASE *phase);
 static int ProcessArgs(INT argc, CHAR *argv[], DYNREG_COMMAND *cmd,
 														      CHAR *szLibPath);
-static int readBuffer(struct Dynamic_Loader_Stream *this, void *buffer,
-															unsigned bufsize);
-static int setFilePosn(struct Dynamic_Loader_Stream *this, uint_least32_t pos);
 
 /* global variables. */
 bool g_fVerbose = false;
 
-FILE *filePointer = NULL;
-
 /*
  *  ======== main ========
  */
@@ -534,12 +529,13 @@ static int getSectDataFromLib(IN CHAR *szLibPath, IN CHAR *szSection,
 	}
 
 	DLsym_init(&inputSymbols);
+	DLstream_init(&inputStream);
 
-	inputStream.dstrm.read_buffer = readBuffer;
-	inputStream.dstrm.set_file_posn = setFilePosn;
-	/* Open DOFF file */
-	filePointer = fopen(szLibPath, "rb");
-	desc = DLOAD_module_open(&(inputStream.dstrm), &(inputSymbols.sym));
+	/* Map DOFF file */
+	desc = NULL;
+	if (DLstream_map(&inputStream, szLibPath) == 0) {
+		desc = DLOAD_module_open(&(inputStream.dstrm), &(inputSymbols.sym));
+	}
 	if (!desc) {
 		/* Error */
 		status = -EBADF;
@@ -623,11 +619,9 @@ static int getSectDataFromLib(IN CHAR *szLibPath, IN CHAR *szSection,
 			DLOAD_module_close(desc);
 			desc = NULL;
 		}
-		if (filePointer) {
-			fclose(filePointer);
-			filePointer = NULL;
-		}
 	}
+	DLstream_close(&inputStream);
+	DLsym_exit(&inputSymbols);
 	return status;
 }
 
@@ -674,23 +668,3 @@ VOID PrintVerbose(PSTR pstrFmt, ...)
 		fflush(stdout);
 	}
 }
-
-static int readBuffer(struct Dynamic_Loader_Stream *this,void *buffer,
-															unsigned bufsize)
-{
-	int bytesRead = 0;
-        *this = *this ;
-	bytesRead = fread(buffer, 1, bufsize, filePointer);
-
-	return bytesRead;
-}
-
-static int setFilePosn(struct Dynamic_Loader_Stream *this, uint_least32_t pos)
-{
-	int status = 0;
-        *this = *this ;
-	status = fseek(filePointer, (long) pos, SEEK_SET);
-
-	return status;
-}
-
@@ -325,6 +325,7 @@ int DLOAD_GetSection(DLOAD_module_info minfo,
 	int_least32_t ipsize;
 	uint32_t checks;
 	int_least8_t *dest = (int_least8_t *)sectionData;
+	void *src;
 
 	dlthis = (struct dload_state *)minfo;
 	if (!dlthis)
@@ -358,17 +359,26 @@ int DLOAD_GetSection(DLOAD_module_info minfo,
 			dload_error(dlthis, E_ISIZ, ipsize);
 			return false;
 		}
-		if (dlthis->strm->read_buffer(dlthis->strm, dest, ipsize) != ipsize) {
-			dload_error(dlthis, E_READSTRM, "image packet");
-			return false;
-		}
-		/* reorder the bytes if need be */
+		/* copy and checksum in one pass if the stream can map the packet */
+		src = NULL;
+		if (!dlthis->reorder_map && dlthis->strm->map_buffer)
+			src = dlthis->strm->map_buffer(dlthis->strm, ipsize);
+		if (src) {
+			checks = dload_checksum_copy(dest, src, ipsize);
+		} else {
+			if (dlthis->strm->read_buffer(dlthis->strm, dest, ipsize) !=
+																	ipsize) {
+				dload_error(dlthis, E_READSTRM, "image packet");
+				return false;
+			}
+			/* reorder the bytes if need be */
 /* _BIG_ENDIAN Not defined by bridge driver */
 /* #if !defined(_BIG_ENDIAN) || (TARGET_AU_BITS > 16) */
-		if (dlthis->reorder_map) {
-			dload_reorder(dest, ipsize, dlthis->reorder_map);
+			if (dlthis->reorder_map) {
+				dload_reorder(dest, ipsize, dlthis->reorder_map);
+			}
+			checks = dload_checksum(dest, ipsize);
 		}
-		checks = dload_checksum(dest, ipsize);
 /* Not defined by bridge driver */
 /* #else
 		if (dlthis->dfile_hdr.df_byte_reshuffle !=
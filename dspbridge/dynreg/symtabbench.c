@@ -0,0 +1,286 @@
+/*
+ *  Copyright 2001-2008 Texas Instruments - http://www.ti.com/
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+/*
+ *  ======== symtabbench.c ========
+ *  "symtabbench" is a console utility that checks and times the symbol
+ *  table of DLsymtab.c the way a node loader uses it.
+ *
+ *  A base image exports a batch of symbols through DLsym_Add_Symbols and
+ *  the table is saved with DLsym_Save.  Each pass then loads two node
+ *  modules on top through Add_To_Symbol_Table, one of them shadowing some
+ *  base symbols, purges that one, and drops the other with DLsym_Restore.
+ *  Every lookup is checked against the value the newest visible module
+ *  gave the symbol.  Lookup time is measured on the base symbols, and the
+ *  DLsym_Get_Stats counters are reported at the end.  No DSP or Bridge
+ *  driver is needed.
+ *
+ *  Usage:
+ *      symtabbench [optional args]
+ *
+ *  Options:
+ *      -v: verbose mode, reports each failed check.
+ *      -n <count>: number of node load passes, default 20.
+ *      -s <count>: number of base image symbols, default 5000.
+ *      -?: displays "symtabbench" usage.
+ *
+ *  Notes:
+ *      The exit status is 0 only if every check passed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "DLsymtab.h"
+
+#define DEFAULTPASSES	20	/* Node load passes */
+#define DEFAULTSYMBOLS	5000	/* Base image symbols */
+#define NODESYMBOLS	500	/* Symbols of each node module */
+#define SHADOWED	100	/* Base symbols a node module redefines */
+#define NAMELEN		32	/* Characters per generated name */
+#define LOOKUPROUNDS	100	/* Timed lookups of every base symbol */
+
+#define BASEMODULE	1	/* Module ids */
+#define NODEMODULE	2
+#define SHADOWMODULE	3
+
+/* Usable functions */
+static void DisplayUsage(void);
+static unsigned Check(struct DL_sym_t *pTable, const char *szName,
+								int fExpected, LDR_ADDR value);
+static unsigned AddModule(struct DL_sym_t *pTable, char *aszNames,
+				unsigned uFirst, unsigned cSymbols, unsigned uModule,
+				LDR_ADDR base);
+static unsigned long long TimeNs(void);
+
+/* global variables. */
+static int g_fVerbose = 0;
+
+/*
+ *  ======== main ========
+ */
+int main(int argc, char *argv[])
+{
+	struct DL_sym_t table;
+	struct DL_symmark mark;
+	struct DL_symstats stats;
+	struct dynload_symbol *sym;
+	unsigned long long ulStart, ulNs;
+	unsigned long ulSum = 0;
+	unsigned cBase = DEFAULTSYMBOLS, cNames, cFailed = 0;
+	int nPasses = DEFAULTPASSES;
+	const char **apszNames;
+	LDR_ADDR *aValues;
+	char *aszNames;
+	unsigned i;
+	int pass, round;
+
+	for (i = 1;i < (unsigned)argc;i++) {
+		if (strcmp(argv[i], "-v") == 0) {
+			g_fVerbose = 1;
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < (unsigned)argc) {
+			nPasses = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < (unsigned)argc) {
+			cBase = atoi(argv[++i]);
+		} else {
+			DisplayUsage();
+			return 1;
+		}
+	}
+	if (nPasses <= 0 || cBase < SHADOWED) {
+		DisplayUsage();
+		return 1;
+	}
+	/* Base image symbols, then those of the node module */
+	cNames = cBase + NODESYMBOLS;
+	aszNames = malloc(cNames * NAMELEN);
+	apszNames = malloc(cBase * sizeof(*apszNames));
+	aValues = malloc(cBase * sizeof(*aValues));
+	if (!aszNames || !apszNames || !aValues) {
+		fprintf(stdout, "symtabbench: out of memory\n");
+		return 1;
+	}
+	for (i = 0;i < cNames;i++) {
+		snprintf(aszNames + i * NAMELEN, NAMELEN, "_%s_fxn%u",
+									i < cBase ? "BASE" : "NODE", i);
+	}
+	for (i = 0;i < cBase;i++) {
+		apszNames[i] = aszNames + i * NAMELEN;
+		aValues[i] = 0x11000000 + i * 4;
+	}
+
+	DLsym_init(&table);
+	if (DLsym_Add_Symbols(&table, apszNames, aValues, cBase, BASEMODULE)
+																!= cBase) {
+		fprintf(stdout, "symtabbench: base image symbols not added\n");
+		return 1;
+	}
+	DLsym_Save(&table, &mark);
+
+	for (pass = 0;pass < nPasses;pass++) {
+		/* A node module, and one that redefines some base symbols */
+		cFailed += AddModule(&table, aszNames, cBase, NODESYMBOLS,
+										NODEMODULE, 0x20000000 + pass);
+		cFailed += AddModule(&table, aszNames, 0, SHADOWED, SHADOWMODULE,
+															0x30000000);
+		for (i = 0;i < cBase;i++) {
+			cFailed += Check(&table, apszNames[i], 1, i < SHADOWED ?
+									0x30000000 + i * 4 : aValues[i]);
+		}
+		for (i = cBase;i < cNames;i++) {
+			cFailed += Check(&table, aszNames + i * NAMELEN, 1,
+						0x20000000 + pass + (i - cBase) * 4);
+		}
+		cFailed += Check(&table, "_NODE_missing", 0, 0);
+
+		/* Purging the redefinitions brings the base symbols back */
+		table.sym.Purge_Symbol_Table(&table.sym, SHADOWMODULE);
+		for (i = 0;i < SHADOWED;i++) {
+			cFailed += Check(&table, apszNames[i], 1, aValues[i]);
+		}
+
+		/* Restoring drops the node module and keeps the base image */
+		DLsym_Restore(&table, &mark);
+		for (i = cBase;i < cNames;i++) {
+			cFailed += Check(&table, aszNames + i * NAMELEN, 0, 0);
+		}
+		DLsym_Get_Stats(&table, &stats);
+		if (stats.symbols != cBase) {
+			if (g_fVerbose) {
+				fprintf(stdout, "  pass %d: %u symbols after restore\n",
+														pass, stats.symbols);
+			}
+			cFailed++;
+		}
+	}
+
+	/* Time the lookups of the base symbols */
+	ulStart = TimeNs();
+	for (round = 0;round < LOOKUPROUNDS;round++) {
+		for (i = 0;i < cBase;i++) {
+			sym = table.sym.Find_Matching_Symbol(&table.sym, apszNames[i]);
+			ulSum += sym ? sym->value : 0;
+		}
+	}
+	ulNs = TimeNs() - ulStart;
+
+	DLsym_Get_Stats(&table, &stats);
+	fprintf(stdout, "%u base symbols, %d node load passes\n", cBase, nPasses);
+	fprintf(stdout, "lookup: %llu ns (checksum %lx)\n",
+				ulNs / ((unsigned long long)LOOKUPROUNDS * cBase), ulSum);
+	fprintf(stdout, "lookups %u, hits %u, probes %u, longest probe %u\n",
+				stats.lookups, stats.hits, stats.probes, stats.max_probes);
+	fprintf(stdout, "symbols %u, slots %u, rebuilds %u, arena %u bytes\n",
+				stats.symbols, stats.slots, stats.rebuilds, stats.arena_bytes);
+
+	/* Purging the base image empties the table */
+	table.sym.Purge_Symbol_Table(&table.sym, BASEMODULE);
+	for (i = 0;i < cBase;i++) {
+		cFailed += Check(&table, apszNames[i], 0, 0);
+	}
+	DLsym_exit(&table);
+
+	fprintf(stdout, "%u checks failed\n%s\n", cFailed,
+											cFailed ? "FAILED" : "PASSED");
+	free(aszNames);
+	free(apszNames);
+	free(aValues);
+	return cFailed ? 1 : 0;
+}
+
+/*
+ *  ======== Check ========
+ *  Look szName up, returns 1 if it is not found with the expected value.
+ */
+static unsigned Check(struct DL_sym_t *pTable, const char *szName,
+								int fExpected, LDR_ADDR value)
+{
+	struct dynload_symbol *sym;
+
+	sym = pTable->sym.Find_Matching_Symbol(&pTable->sym, szName);
+	if (fExpected ? (sym && sym->value == value) : !sym) {
+		return 0;
+	}
+	if (g_fVerbose) {
+		if (sym) {
+			fprintf(stdout, "  %s: 0x%lx, expected %s0x%lx\n", szName,
+								(unsigned long)sym->value,
+								fExpected ? "" : "none, not ",
+								(unsigned long)value);
+		} else {
+			fprintf(stdout, "  %s: not found\n", szName);
+		}
+	}
+	return 1;
+}
+
+/*
+ *  ======== AddModule ========
+ *  Add cSymbols names from uFirst on, symbol n of the module getting
+ *  base + 4 * n, as the loader does for each symbol it relocates.
+ */
+static unsigned AddModule(struct DL_sym_t *pTable, char *aszNames,
+				unsigned uFirst, unsigned cSymbols, unsigned uModule,
+				LDR_ADDR base)
+{
+	struct dynload_symbol *sym;
+	unsigned i;
+
+	for (i = 0;i < cSymbols;i++) {
+		sym = pTable->sym.Add_To_Symbol_Table(&pTable->sym,
+							aszNames + (uFirst + i) * NAMELEN, uModule);
+		if (!sym) {
+			if (g_fVerbose) {
+				fprintf(stdout, "  module %u: symbol %u not added\n",
+																uModule, i);
+			}
+			return 1;
+		}
+		sym->value = base + i * 4;
+	}
+	return 0;
+}
+
+/*
+ *  ======== TimeNs ========
+ */
+static unsigned long long TimeNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ *  ======== DisplayUsage ========
+ *  Display usage of symtabbench utility
+ */
+static void DisplayUsage(void)
+{
+	fprintf(stdout, "Usage: symtabbench [optional args]\n");
+	fprintf(stdout, "[optional args]:\n");
+	fprintf(stdout, "-v: verbose mode.\n");
+	fprintf(stdout, "-n <count>: node load passes, default %d.\n",
+																DEFAULTPASSES);
+	fprintf(stdout, "-s <count>: base image symbols, default %d.\n",
+																DEFAULTSYMBOLS);
+	fprintf(stdout, "-?: displays \"symtabbench\" usage. \n");
+	fprintf(stdout, "\nExample: symtabbench -s 20000\n\n");
+}
@@ -30,6 +30,7 @@
  *      DSPNode_Delete
  *      DSPNode_FreeMsgBuf
  *      DSPNode_GetAttr
+ *      DSPNode_GetMapStats
  *      DSPNode_GetMessage
  *      DSPNode_Pause
  *      DSPNode_PutMessage
@@ -292,6 +293,21 @@ DSPNode_Allocate(DSP_HPROCESSOR hProcessor,
 	extern DBAPI DSPNode_GetAttr(DSP_HNODE hNode,
 				     OUT struct DSP_NODEATTR * pAttr, UINT uAttrSize);
 
+/*
+ *  ======== DSPNode_GetMapStats ========
+ *  Purpose:
+ *      Report the message segments DSPNode_Allocate has mapped into this
+ *      process and not yet unmapped.
+ *  Parameters:
+ *      pulSegments:        Location to store the number of segments.
+ *      pulBytes:           Location to store their total size in bytes.
+ *  Returns:
+ *      0:                  Success.
+ *      -EFAULT:            pulSegments or pulBytes is not valid.
+ */
+	extern DBAPI DSPNode_GetMapStats(OUT ULONG * pulSegments,
+					 OUT ULONG * pulBytes);
+
 /*
  *  ======== DSPNode_GetMessage ========
  *  Purpose:
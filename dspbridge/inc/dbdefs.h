@@ -556,6 +556,17 @@ extern "C" {
 	} ;
 	/*DSP_STREAMINFO, *DSP_HSTREAMINFO;*/
 
+/*
+ *  The DSP_STREAMBUF structure describes one of the buffers moved by
+ *  DSPStream_IssueV() and DSPStream_ReclaimV().
+ */
+	struct DSP_STREAMBUF {
+		BYTE *pBuffer;
+		ULONG ulDataSize;
+		ULONG ulBufSize;
+		DWORD dwArg;
+	} ;
+
 /* DMM MAP attributes 
 It is a bit mask with each bit value indicating a specific attribute
 bit 0 - GPP address type (user virtual=0, physical=1)
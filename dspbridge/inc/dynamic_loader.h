@@ -212,6 +212,23 @@ extern "C" {			/* C-only version */
 		int (*set_file_posn) (struct Dynamic_Loader_Stream * thisptr, 	
 					unsigned int posn);	/* to be eliminated in release 2*/
 
+    /*************************************************************************
+     * map_buffer (optional, may be NULL)
+     *
+     * PARAMETERS :
+     *  bufsiz  Amount of data desired in sizeof() units
+     *
+     * EFFECT :
+     *  Returns a 32-bit aligned pointer to the next bufsiz units of the
+     * module image in place, and advances the file position as read_buffer
+     * would.  The caller must not modify the data.  Returns NULL if the
+     * stream cannot do so, in which case the caller falls back to
+     * read_buffer.
+     *
+     *************************************************************************/
+		void *(*map_buffer) (struct Dynamic_Loader_Stream * thisptr,
+				     unsigned bufsiz);
+
 	};
 
 /*****************************************************************************
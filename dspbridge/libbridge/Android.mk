@@ -12,7 +12,8 @@ LOCAL_SRC_FILES:= \
 	DSPNode.c \
 	DSPStrm.c \
 	perfutils.c \
-	dsptrap.c
+	dsptrap.c \
+	dspemu.c
 
 LOCAL_C_INCLUDES += \
 	$(LOCAL_PATH)/inc	
@@ -23,3 +24,26 @@ LOCAL_MODULE:= libbridge
 LOCAL_MODULE_TAGS := optional
 include $(BUILD_SHARED_LIBRARY)
 
+
+# the same library for the build host, DSPBRIDGE_EMULATOR selects dspemu.c
+# there since there is no /dev/DspBridge
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	DSPManager.c \
+	DSPProcessor.c \
+	DSPProcessor_OEM.c \
+	DSPNode.c \
+	DSPStrm.c \
+	perfutils.c \
+	dsptrap.c \
+	dspemu.c
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/inc	
+
+LOCAL_CFLAGS += -pipe -Wall  -Wno-trigraphs -Werror-implicit-function-declaration  -fno-strict-aliasing -fno-common -fgnu89-inline -DLINUX -DOMAP_3430
+
+LOCAL_MODULE:= libbridge
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_STATIC_LIBRARY)
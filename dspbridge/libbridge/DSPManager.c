@@ -63,6 +63,7 @@
 
 /*  ----------------------------------- Others */
 #include <dsptrap.h>
+#include <dspemu.h>
 
 /*  ----------------------------------- This */
 #include "_dbdebug.h"
@@ -120,7 +121,10 @@ DBAPI DspManager_Open(UINT argc, PVOID argp)
 
 	sem_wait(&semOpenClose);
 	if (usage_count == 0) {	/* try opening handle to Bridge driver */
-		status = open(BRIDGE_DRIVER_NAME, O_RDWR);
+		if (getenv(DSPEMU_ENV))
+			status = DSPEMU_Open();
+		else
+			status = open(BRIDGE_DRIVER_NAME, O_RDWR);
 		if (status >= 0)
 			hMediaFile = status;
 	}
@@ -153,6 +157,8 @@ DBAPI DspManager_Close(UINT argc, PVOID argp)
 
 	if (usage_count == 1) {
 		munmap_all();
+		if (DSPEMU_Enabled())
+			DSPEMU_Close();
 		status = close(hMediaFile);
 		if (status >= 0)
 			hMediaFile = -1;
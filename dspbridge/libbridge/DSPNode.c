@@ -33,6 +33,7 @@
  *      DSPNode_Delete
  *      DSPNode_FreeMsgBuf
  *      DSPNode_GetAttr
+ *      DSPNode_GetMapStats
  *      DSPNode_GetMessage
  *      DSPNode_Pause
  *      DSPNode_PutMessage
@@ -97,7 +98,17 @@
 #include <perfutils.h>
 #endif
 
-static struct mmap_element *mmaplist;
+/*
+ * Message segments mapped by DSPNode_Allocate, hashed on their page aligned
+ * virtual base so DSPNode_Delete finds its segment without walking every
+ * mapping of the process. Guarded by sem_mmap, as are the totals.
+ */
+#define MMAP_BUCKETS	64	/* power of two */
+#define MMAP_HASH(vb)	((((ULONG)(vb)) / PG_SIZE_4K) & (MMAP_BUCKETS - 1))
+
+static struct mmap_element *mmaplist[MMAP_BUCKETS];
+static ULONG mmap_count;
+static ULONG mmap_bytes;
 static sem_t sem_mmap;
 /*  ----------------------------------- Globals */
 extern int hMediaFile;		/* class driver handle */
@@ -276,7 +287,7 @@ DBAPI DSPNode_Allocate(DSP_HPROCESSOR hProcessor,
 			} else {
 				pelement->virt_base = (BYTE *)pVirtBase;
 				pelement->seg_size = pInfo.segInfo[0].ulTotalSegSize;
-				insert_mmapelement(pelement, &mmaplist);
+				insert_mmapelement(pelement, mmaplist);
 			}
 		}
 	}
@@ -290,9 +301,13 @@ func_end:
 
 int insert_mmapelement(struct mmap_element *elem, struct mmap_element **mmaplist)
 {
+	struct mmap_element **bucket = &mmaplist[MMAP_HASH(elem->virt_base)];
+
 	sem_wait(&sem_mmap);
-	elem->next = *mmaplist;
-	*mmaplist = elem;
+	elem->next = *bucket;
+	*bucket = elem;
+	mmap_count++;
+	mmap_bytes += elem->seg_size;
 	sem_post(&sem_mmap);
 
 	return 0;
@@ -302,9 +317,10 @@ int delete_mmapelement(BYTE *vb, struct mmap_element **mmaplist)
 {
 	int ret = 0;
 	struct mmap_element *tmp = NULL, *tmp2 = NULL;
+	struct mmap_element **bucket = &mmaplist[MMAP_HASH(vb)];
 
 	sem_wait(&sem_mmap);
-	tmp = *mmaplist;
+	tmp = *bucket;
 	for (; tmp && tmp->virt_base != vb; tmp = tmp->next)
 		tmp2 = tmp;
 
@@ -312,10 +328,12 @@ int delete_mmapelement(BYTE *vb, struct mmap_element **mmaplist)
 		ret = -1;
 		goto func_end;
 	} else if (!tmp2)
-		*mmaplist = tmp->next;
+		*bucket = tmp->next;
 	else
 		tmp2->next = tmp->next;
 
+	mmap_count--;
+	mmap_bytes -= tmp->seg_size;
 	free(tmp);
 
 func_end:
@@ -324,19 +342,54 @@ func_end:
 	return ret;
 }
 
+/*
+ *  ======== DSPNode_GetMapStats ========
+ *  Purpose:
+ *      Number and total size of the message segments DSPNode_Allocate has
+ *      mapped into this process.
+ */
+DBAPI DSPNode_GetMapStats(OUT ULONG *pulSegments, OUT ULONG *pulBytes)
+{
+	DEBUGMSG(DSPAPI_ZONE_FUNCTION, (TEXT("NODE: DSPNode_GetMapStats:\r\n")));
+
+	if (!pulSegments || !pulBytes) {
+		DEBUGMSG(DSPAPI_ZONE_ERROR, (TEXT("NODE: DSPNode_GetMapStats: "
+						"Invalid pointer in the Input\r\n")));
+		return -EFAULT;
+	}
+	sem_wait(&sem_mmap);
+	*pulSegments = mmap_count;
+	*pulBytes = mmap_bytes;
+	sem_post(&sem_mmap);
+
+	return 0;
+}
+
 void munmap_all(void)
 {
-	struct mmap_element *tmp;
+	struct mmap_element *list = NULL, *tmp;
+	int i;
 
+	/* Take every segment out at once, then unmap without the lock */
 	sem_wait(&sem_mmap);
+	for (i = 0; i < MMAP_BUCKETS; i++) {
+		while (mmaplist[i]) {
+			tmp = mmaplist[i];
+			mmaplist[i] = tmp->next;
+			tmp->next = list;
+			list = tmp;
+		}
+	}
+	mmap_count = 0;
+	mmap_bytes = 0;
+	sem_post(&sem_mmap);
 
-	while (mmaplist) {
-		munmap(mmaplist->virt_base, mmaplist->seg_size);
-		tmp = mmaplist;
-		mmaplist = mmaplist->next;
+	while (list) {
+		munmap(list->virt_base, list->seg_size);
+		tmp = list;
+		list = list->next;
 		free(tmp);
 	}
-	sem_post(&sem_mmap);
 }
 /*
  *  ======== DSPNode_AllocMsgBuf ========
@@ -601,7 +654,7 @@ DBAPI DSPNode_Delete(DSP_HNODE hNode)
 				status = -EPERM;
 			}
 
-			delete_mmapelement(pVirtBase, &mmaplist);
+			delete_mmapelement(pVirtBase, mmaplist);
 		}
 	}
 loop_end:
@@ -29,8 +29,10 @@
  *      DSPStream_GetInfo
  *      DSPStream_Idle
  *      DSPStream_Issue
+ *      DSPStream_IssueV
  *      DSPStream_Open
  *      DSPStream_Reclaim
+ *      DSPStream_ReclaimV
  *      DSPStream_RegisterNotify
  *      DSPStream_Select
  *
@@ -97,9 +99,13 @@
 /*  ----------------------------------- Globals */
 extern int hMediaFile;		/* class driver handle */
 
+/* Driver support for CMD_STRM_[ISSUE][RECLAIM]V: 0 unknown, 1 yes, -1 no */
+static int iStrmVectored;
+
 /*  ----------------------------------- Function Prototypes */
 static int GetStrmInfo(DSP_HSTREAM hStream, struct STRM_INFO *pStrmInfo,
 			      UINT uStreamInfoSize);
+static bool VectoredTrap(Trapped_Args *args, int cmd, int *pStatus);
 
 /*
  *  ======== DSPStream_AllocateBuffers ========
@@ -435,6 +441,59 @@ DBAPI DSPStream_Issue(DSP_HSTREAM hStream, IN BYTE *pBuffer,
 	return status;
 }
 
+/*
+ *  ======== DSPStream_IssueV ========
+ *  Purpose:
+ *      Send several buffers of data to a stream.
+ */
+DBAPI DSPStream_IssueV(DSP_HSTREAM hStream, IN struct DSP_STREAMBUF *aBufs,
+		UINT uNumBufs, OUT UINT *puIssued)
+{
+	int status = 0;
+	Trapped_Args tempStruct;
+	UINT i;
+
+	DEBUGMSG(DSPAPI_ZONE_FUNCTION, (TEXT("NODE: DSPStream_IssueV:\r\n")));
+
+	if (!hStream || !aBufs || !puIssued) {
+		DEBUGMSG(DSPAPI_ZONE_ERROR, (TEXT("NODE: DSPStream_IssueV: "
+					"Invalid pointer in the Input\r\n")));
+		return -EFAULT;
+	}
+	*puIssued = 0;
+
+	/* Check every buffer first, the driver stops at the first error */
+	for (i = 0; i < uNumBufs; i++) {
+		if (!aBufs[i].pBuffer)
+			return -EFAULT;
+		if (aBufs[i].ulDataSize > aBufs[i].ulBufSize) {
+			DEBUGMSG(DSPAPI_ZONE_ERROR,
+				(TEXT("NODE: DSPStream_IssueV: "
+				"Invalid argument in the Input\r\n")));
+			return -EINVAL;
+		}
+	}
+	if (!uNumBufs)
+		return 0;
+
+	tempStruct.ARGS_STRM_ISSUEV.hStream = hStream;
+	tempStruct.ARGS_STRM_ISSUEV.aBufs = aBufs;
+	tempStruct.ARGS_STRM_ISSUEV.uNumBufs = uNumBufs;
+	tempStruct.ARGS_STRM_ISSUEV.puIssued = puIssued;
+	if (VectoredTrap(&tempStruct, CMD_STRM_ISSUEV_OFFSET, &status))
+		return status;
+
+	for (i = 0; i < uNumBufs && DSP_SUCCEEDED(status); i++) {
+		status = DSPStream_Issue(hStream, aBufs[i].pBuffer,
+				aBufs[i].ulDataSize, aBufs[i].ulBufSize,
+				aBufs[i].dwArg);
+		if (DSP_SUCCEEDED(status))
+			(*puIssued)++;
+	}
+
+	return status;
+}
+
 /*
  *  ======== DSPStream_Open ========
  *  Purpose:
@@ -680,6 +739,61 @@ DBAPI DSPStream_Reclaim(DSP_HSTREAM hStream, OUT BYTE **pBufPtr,
 	return status;
 }
 
+/*
+ *  ======== DSPStream_ReclaimV ========
+ *  Purpose:
+ *      Request several completed buffers back from a stream.
+ */
+DBAPI DSPStream_ReclaimV(DSP_HSTREAM hStream, OUT struct DSP_STREAMBUF *aBufs,
+		UINT uMaxBufs, UINT uTimeout, OUT UINT *puReclaimed)
+{
+	int status = 0;
+	Trapped_Args tempStruct;
+	struct DSP_STREAMBUF *pBuf;
+	UINT uMask;
+
+	DEBUGMSG(DSPAPI_ZONE_FUNCTION,
+			(TEXT("NODE: DSPStream_ReclaimV:\r\n")));
+
+	if (!hStream || !aBufs || !puReclaimed) {
+		DEBUGMSG(DSPAPI_ZONE_ERROR, (TEXT("NODE: DSPStream_ReclaimV: "
+					"Invalid pointer in the Input\r\n")));
+		return -EFAULT;
+	}
+	*puReclaimed = 0;
+	if (!uMaxBufs)
+		return 0;
+
+	tempStruct.ARGS_STRM_RECLAIMV.hStream = hStream;
+	tempStruct.ARGS_STRM_RECLAIMV.aBufs = aBufs;
+	tempStruct.ARGS_STRM_RECLAIMV.uMaxBufs = uMaxBufs;
+	tempStruct.ARGS_STRM_RECLAIMV.uTimeout = uTimeout;
+	tempStruct.ARGS_STRM_RECLAIMV.puReclaimed = puReclaimed;
+	if (VectoredTrap(&tempStruct, CMD_STRM_RECLAIMV_OFFSET, &status))
+		return status;
+
+	/* Select tells whether a Reclaim would block */
+	while (*puReclaimed < uMaxBufs) {
+		status = DSPStream_Select(&hStream, 1, &uMask,
+					*puReclaimed ? 0 : uTimeout);
+		if (status == -ETIME || (DSP_SUCCEEDED(status) && !uMask)) {
+			status = (*puReclaimed || !uTimeout) ? 0 : -ETIME;
+			break;
+		}
+		if (DSP_FAILED(status))
+			break;
+
+		pBuf = &aBufs[*puReclaimed];
+		status = DSPStream_Reclaim(hStream, &pBuf->pBuffer,
+				&pBuf->ulDataSize, &pBuf->ulBufSize, &pBuf->dwArg);
+		if (DSP_FAILED(status))
+			break;
+		(*puReclaimed)++;
+	}
+
+	return status;
+}
+
 /*
  *  ======== DSPStream_RegisterNotify ========
  *  Purpose:
@@ -853,3 +967,36 @@ static int GetStrmInfo(DSP_HSTREAM hStream, struct STRM_INFO *pStrmInfo,
 	return status;
 }
 
+/*
+ *  ======== VectoredTrap ========
+ *  Calls into the driver with a vectored STRM command. Returns false,
+ *  without setting *pStatus, if the driver does not implement it and the
+ *  caller has to fall back to one trap per buffer.
+ */
+static bool VectoredTrap(Trapped_Args *args, int cmd, int *pStatus)
+{
+	int status;
+
+	if (iStrmVectored < 0)
+		return false;
+
+	status = DSPTRAP_Trap(args, cmd);
+	if (iStrmVectored == 0) {
+		/*
+		 * The arguments were checked, so until the driver has once
+		 * accepted a vectored command these mean it does not know it.
+		 */
+		if (status == -ENOTTY || status == -ENOSYS ||
+							status == -EINVAL) {
+			DEBUGMSG(DSPAPI_ZONE_WARNING, (TEXT("NODE: no vectored "
+				"stream commands in the driver\r\n")));
+			iStrmVectored = -1;
+			return false;
+		}
+		if (DSP_SUCCEEDED(status))
+			iStrmVectored = 1;
+	}
+
+	*pStatus = status;
+	return true;
+}
@@ -0,0 +1,1262 @@
+/*
+ * dspbridge/src/api/linux/dspemu.c
+ *
+ * DSP-BIOS Bridge driver support functions for TI OMAP processors.
+ *
+ * Copyright (C) 2007 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 of the License.
+ *
+ * This program is distributed .as is. WITHOUT ANY WARRANTY of any kind,
+ * whether express or implied; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+
+/*
+ *  ======== dspemu.c ========
+ *  Description:
+ *      Userspace stand-in for the Bridge driver, so the API, LCML and the
+ *      sample applications run without an OMAP DSP. See dspemu.h.
+ *
+ *      All emulator state is guarded by one mutex. Anything that can make
+ *      a waiter progress (message, buffer, event, node state) broadcasts
+ *      the one condition variable; waiters re-check their own predicate.
+ *
+ *  Public Functions:
+ *      DSPEMU_Close
+ *      DSPEMU_Enabled
+ *      DSPEMU_Open
+ *      DSPEMU_Trap
+ */
+
+/*  ----------------------------------- Host OS */
+#include <host_os.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+/*  ----------------------------------- DSP/BIOS Bridge */
+#include <dbdefs.h>
+#include <errno.h>
+
+/*  ----------------------------------- Trace & Debug */
+#include <dbg.h>
+#include <dbg_zones.h>
+
+/*  ----------------------------------- This */
+#include <dspemu.h>
+#include "_dbdebug.h"
+
+/*  ----------------------------------- Defines */
+#define EMU_NODESIGNATURE	0x454f4e45	/* "ENOE" */
+#define EMU_STRMSIGNATURE	0x53525445	/* "ETRS" */
+#define EMU_MSGDEPTH		32	/* messages queued each way */
+#define EMU_MAXBUFS		32	/* buffers queued per stream */
+#define EMU_MAXSTREAMS		8	/* stream indexes per direction */
+#define EMU_DMMBASE		0x20000000	/* first DSP virtual address */
+#define EMU_DMMSIZE		0x10000000
+
+/* Messages understood by the dmmcopy sample node */
+#define DMM_SETUPBUFFERS	0xABCD
+#define DMM_WRITEREADY		0xADDD
+
+/* Message understood by the zerocopymsg sample node */
+#define ZCMSG_BUFDESC		0x20000000
+
+/* What an emulated node does besides looping data back */
+#define EMU_LOOPBACK		0
+#define EMU_DMMCOPY		1
+#define EMU_ZCMSG		2
+
+/*  ----------------------------------- Types */
+struct EMU_EVENT {
+	bool fSignaled;			/* auto reset by MGR_WAIT */
+};
+
+struct EMU_MSGQ {
+	struct DSP_MSG aMsg[EMU_MSGDEPTH];
+	UINT uHead;
+	UINT uCount;
+};
+
+struct EMU_BUF {
+	BYTE *pBuffer;
+	ULONG dwBytes;
+	ULONG dwBufSize;
+	DWORD dwArg;
+};
+
+struct EMU_BUFQ {
+	struct EMU_BUF aBuf[EMU_MAXBUFS];
+	UINT uHead;
+	UINT uCount;
+};
+
+/* Data a copy node has consumed but not yet produced */
+struct EMU_CHUNK {
+	struct EMU_CHUNK *pNext;
+	ULONG ulSize;
+	ULONG ulOffset;
+	BYTE aData[1];
+};
+
+struct EMU_NODE;
+
+struct EMU_STREAM {
+	DWORD dwSignature;
+	struct EMU_NODE *pNode;
+	UINT uDirection;
+	UINT uIndex;
+	UINT uTimeout;
+	UINT uNumBufs;
+	UINT lMode;
+	ULONG ulBytes;			/* moved through the stream so far */
+	struct EMU_BUFQ pending;	/* issued, not yet processed */
+	struct EMU_BUFQ done;		/* processed, to be reclaimed */
+	struct EMU_EVENT doneEvent;
+};
+
+struct EMU_NODE {
+	DWORD dwSignature;
+	struct EMU_NODE *pNext;
+	struct DSP_UUID uuid;
+	struct DSP_NODEATTRIN attrIn;
+	DSP_NODESTATE state;
+	INT iPriority;
+	UINT uKind;			/* EMU_LOOPBACK, ... */
+	struct EMU_MSGQ toNode;
+	struct EMU_MSGQ fromNode;
+	struct EMU_EVENT msgEvent;
+	struct EMU_EVENT stateEvent;
+	struct EMU_STREAM *apIn[EMU_MAXSTREAMS];
+	struct EMU_STREAM *apOut[EMU_MAXSTREAMS];
+	struct EMU_CHUNK *apStaged[EMU_MAXSTREAMS];
+	ULONG ulDmmSrc;			/* dmmcopy buffers, DSP addresses */
+	ULONG ulDmmDst;
+	pthread_t thread;
+	bool fThread;
+	bool fStop;
+};
+
+/* A DSP virtual address range: reserved, or mapped to MPU memory */
+struct EMU_REGION {
+	struct EMU_REGION *pNext;
+	ULONG ulDspAddr;
+	ULONG ulSize;
+	BYTE *pMpuAddr;
+};
+
+struct EMU_STATE {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int fd;
+	DSP_PROCSTATE procState;
+	struct EMU_EVENT procEvent;
+	struct EMU_NODE *pNodes;
+	struct EMU_REGION *pRsv;
+	struct EMU_REGION *pMaps;
+	ULONG ulNextDspAddr;
+};
+
+/*  ----------------------------------- Globals */
+static struct EMU_STATE emu = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.fd = -1,
+};
+
+/* Node used by the dmmcopy sample, 28BA464F_9C3E_484E_990F_48305B183848 */
+static const struct DSP_UUID DMMCOPY_uuid = {
+	0x28ba464f, 0x9c3e, 0x484e, 0x99, 0x0f,
+	{ 0x48, 0x30, 0x5b, 0x18, 0x38, 0x48 }
+};
+
+/* Node used by the zerocopymsg sample, 30DBD781_F3FB_11D5_A8DD_00B0D055F6D1 */
+static const struct DSP_UUID ZCMSG_uuid = {
+	0x30dbd781, 0xf3fb, 0x11d5, 0xa8, 0xdd,
+	{ 0x00, 0xb0, 0xd0, 0x55, 0xf6, 0xd1 }
+};
+
+/*
+ *  ======== helpers ========
+ *  Called with emu.lock held.
+ */
+static void Signal(struct EMU_EVENT *pEvent)
+{
+	pEvent->fSignaled = true;
+	pthread_cond_broadcast(&emu.cond);
+}
+
+static struct timespec *Deadline(UINT uTimeout, struct timespec *ts)
+{
+	ULONG ns;
+
+	if (uTimeout == (UINT)DSP_FOREVER)
+		return NULL;
+
+	clock_gettime(CLOCK_REALTIME, ts);
+	ns = ts->tv_nsec + (uTimeout % 1000) * 1000000;
+	ts->tv_sec += uTimeout / 1000 + ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+	return ts;
+}
+
+/* Returns -ETIME once the deadline has passed */
+static int Wait(struct timespec *pDeadline)
+{
+	if (!pDeadline)
+		return pthread_cond_wait(&emu.cond, &emu.lock) ? -EPERM : 0;
+	return pthread_cond_timedwait(&emu.cond, &emu.lock, pDeadline) ==
+							ETIMEDOUT ? -ETIME : 0;
+}
+
+static void PutMsg(struct EMU_MSGQ *q, struct DSP_MSG *pMsg)
+{
+	q->aMsg[(q->uHead + q->uCount++) % EMU_MSGDEPTH] = *pMsg;
+}
+
+static void GetMsg(struct EMU_MSGQ *q, struct DSP_MSG *pMsg)
+{
+	*pMsg = q->aMsg[q->uHead];
+	q->uHead = (q->uHead + 1) % EMU_MSGDEPTH;
+	q->uCount--;
+}
+
+static void PutBuf(struct EMU_BUFQ *q, struct EMU_BUF *pBuf)
+{
+	q->aBuf[(q->uHead + q->uCount++) % EMU_MAXBUFS] = *pBuf;
+}
+
+static void GetBuf(struct EMU_BUFQ *q, struct EMU_BUF *pBuf)
+{
+	*pBuf = q->aBuf[q->uHead];
+	q->uHead = (q->uHead + 1) % EMU_MAXBUFS;
+	q->uCount--;
+}
+
+/* Field by field, the structure has tail padding */
+static bool IsEqualUuid(const struct DSP_UUID *a, const struct DSP_UUID *b)
+{
+	return a->ulData1 == b->ulData1 && a->usData2 == b->usData2 &&
+		a->usData3 == b->usData3 && a->ucData4 == b->ucData4 &&
+		a->ucData5 == b->ucData5 &&
+		!memcmp(a->ucData6, b->ucData6, sizeof(a->ucData6));
+}
+
+static struct EMU_NODE *ToNode(DSP_HNODE hNode)
+{
+	struct EMU_NODE *pNode = (struct EMU_NODE *)hNode;
+
+	if (!pNode || hNode == (DSP_HNODE)DSP_HGPPNODE ||
+			pNode->dwSignature != EMU_NODESIGNATURE)
+		return NULL;
+	return pNode;
+}
+
+static struct EMU_STREAM *ToStream(DSP_HSTREAM hStream)
+{
+	struct EMU_STREAM *pStrm = (struct EMU_STREAM *)hStream;
+
+	if (!pStrm || pStrm->dwSignature != EMU_STRMSIGNATURE)
+		return NULL;
+	return pStrm;
+}
+
+/* MPU address of len bytes at a mapped DSP address, NULL if not mapped */
+static BYTE *DspToMpu(ULONG ulDspAddr, ULONG len)
+{
+	struct EMU_REGION *pMap;
+
+	for (pMap = emu.pMaps; pMap; pMap = pMap->pNext) {
+		if (ulDspAddr >= pMap->ulDspAddr &&
+			ulDspAddr + len <= pMap->ulDspAddr + pMap->ulSize)
+			return pMap->pMpuAddr + (ulDspAddr - pMap->ulDspAddr);
+	}
+	return NULL;
+}
+
+static void FreeRegions(struct EMU_REGION **ppList)
+{
+	struct EMU_REGION *pRegion;
+
+	while ((pRegion = *ppList)) {
+		*ppList = pRegion->pNext;
+		free(pRegion);
+	}
+}
+
+/*
+ *  ======== node execution ========
+ */
+
+/* Returns true if pMsg is to be sent back to the GPP */
+static bool RunMessage(struct EMU_NODE *pNode, struct DSP_MSG *pMsg)
+{
+	BYTE *pSrc, *pDst;
+	UINT *pWord;
+	ULONG i;
+
+	if (pNode->uKind == EMU_ZCMSG) {
+		/* doubles the words of the buffer in place */
+		pWord = (UINT *)pMsg->dwArg1;
+		if (pMsg->dwCmd == ZCMSG_BUFDESC && pWord) {
+			for (i = 0; i < pMsg->dwArg2; i++)
+				pWord[i] *= 2;
+		}
+		return true;
+	}
+	if (pNode->uKind != EMU_DMMCOPY)
+		return true;		/* echo */
+
+	switch (pMsg->dwCmd) {
+	case DMM_SETUPBUFFERS:
+		/* word addresses, the emulated DSP has byte words */
+		pNode->ulDmmSrc = pMsg->dwArg1;
+		pNode->ulDmmDst = pMsg->dwArg2;
+		return false;
+	case DMM_WRITEREADY:
+		pSrc = DspToMpu(pNode->ulDmmSrc, pMsg->dwArg1);
+		pDst = DspToMpu(pNode->ulDmmDst, pMsg->dwArg1);
+		if (pSrc && pDst)
+			memcpy(pDst, pSrc, pMsg->dwArg1);
+		else
+			DEBUGMSG(DSPAPI_ZONE_ERROR, (TEXT("EMU: dmmcopy "
+				"buffers are not mapped\r\n")));
+		return true;
+	default:
+		return true;
+	}
+}
+
+/* Consumes an input buffer of stream uIndex into the staged data */
+static bool RunInput(struct EMU_NODE *pNode, UINT uIndex)
+{
+	struct EMU_STREAM *pStrm = pNode->apIn[uIndex];
+	struct EMU_CHUNK *pChunk, **ppLast;
+	struct EMU_BUF buf;
+
+	if (!pStrm || !pStrm->pending.uCount)
+		return false;
+
+	GetBuf(&pStrm->pending, &buf);
+	if (buf.dwBytes) {
+		pChunk = malloc(sizeof(*pChunk) + buf.dwBytes);
+		if (pChunk) {
+			memcpy(pChunk->aData, buf.pBuffer, buf.dwBytes);
+			pChunk->ulSize = buf.dwBytes;
+			pChunk->ulOffset = 0;
+			pChunk->pNext = NULL;
+			for (ppLast = &pNode->apStaged[uIndex]; *ppLast;
+						ppLast = &(*ppLast)->pNext)
+				;
+			*ppLast = pChunk;
+		}
+	}
+	pStrm->ulBytes += buf.dwBytes;
+	PutBuf(&pStrm->done, &buf);
+	Signal(&pStrm->doneEvent);
+	return true;
+}
+
+/* Fills an output buffer of stream uIndex from the staged data */
+static bool RunOutput(struct EMU_NODE *pNode, UINT uIndex)
+{
+	struct EMU_STREAM *pStrm = pNode->apOut[uIndex];
+	struct EMU_CHUNK *pChunk;
+	struct EMU_BUF buf;
+	ULONG len;
+
+	if (!pStrm || !pStrm->pending.uCount || !pNode->apStaged[uIndex])
+		return false;
+
+	GetBuf(&pStrm->pending, &buf);
+	buf.dwBytes = 0;
+	while ((pChunk = pNode->apStaged[uIndex]) &&
+					buf.dwBytes < buf.dwBufSize) {
+		len = pChunk->ulSize - pChunk->ulOffset;
+		if (len > buf.dwBufSize - buf.dwBytes)
+			len = buf.dwBufSize - buf.dwBytes;
+		memcpy(buf.pBuffer + buf.dwBytes,
+				pChunk->aData + pChunk->ulOffset, len);
+		buf.dwBytes += len;
+		pChunk->ulOffset += len;
+		if (pChunk->ulOffset == pChunk->ulSize) {
+			pNode->apStaged[uIndex] = pChunk->pNext;
+			free(pChunk);
+		}
+	}
+	pStrm->ulBytes += buf.dwBytes;
+	PutBuf(&pStrm->done, &buf);
+	Signal(&pStrm->doneEvent);
+	return true;
+}
+
+/* One unit of node work, returns false if there was nothing to do */
+static bool RunNode(struct EMU_NODE *pNode)
+{
+	struct DSP_MSG msg;
+	bool fWork = false;
+	UINT i;
+
+	if (pNode->toNode.uCount && pNode->fromNode.uCount < EMU_MSGDEPTH) {
+		GetMsg(&pNode->toNode, &msg);
+		if (RunMessage(pNode, &msg)) {
+			PutMsg(&pNode->fromNode, &msg);
+			Signal(&pNode->msgEvent);
+		}
+		/* the GPP may wait for room in toNode */
+		pthread_cond_broadcast(&emu.cond);
+		fWork = true;
+	}
+	for (i = 0; i < EMU_MAXSTREAMS; i++) {
+		fWork |= RunInput(pNode, i);
+		fWork |= RunOutput(pNode, i);
+	}
+	return fWork;
+}
+
+static void *NodeThread(void *arg)
+{
+	struct EMU_NODE *pNode = arg;
+
+	pthread_mutex_lock(&emu.lock);
+	while (!pNode->fStop) {
+		if (pNode->state == NODE_RUNNING && RunNode(pNode))
+			continue;
+		pthread_cond_wait(&emu.cond, &emu.lock);
+	}
+	pthread_mutex_unlock(&emu.lock);
+	return NULL;
+}
+
+/* Stops the worker of a node, drops and retakes emu.lock */
+static void StopNode(struct EMU_NODE *pNode)
+{
+	if (!pNode->fThread)
+		return;
+	pNode->fStop = true;
+	pthread_cond_broadcast(&emu.cond);
+	pthread_mutex_unlock(&emu.lock);
+	pthread_join(pNode->thread, NULL);
+	pthread_mutex_lock(&emu.lock);
+	pNode->fThread = false;
+}
+
+static void SetNodeState(struct EMU_NODE *pNode, DSP_NODESTATE state)
+{
+	pNode->state = state;
+	Signal(&pNode->stateEvent);
+}
+
+static void FreeStream(struct EMU_STREAM *pStrm)
+{
+	struct EMU_STREAM **ppSlot = pStrm->uDirection == DSP_TONODE ?
+			&pStrm->pNode->apIn[pStrm->uIndex] :
+			&pStrm->pNode->apOut[pStrm->uIndex];
+
+	*ppSlot = NULL;
+	pStrm->dwSignature = 0;
+	free(pStrm);
+}
+
+static void FreeNode(struct EMU_NODE *pNode)
+{
+	struct EMU_NODE **ppNode;
+	struct EMU_CHUNK *pChunk;
+	UINT i;
+
+	StopNode(pNode);
+	for (ppNode = &emu.pNodes; *ppNode; ppNode = &(*ppNode)->pNext) {
+		if (*ppNode == pNode) {
+			*ppNode = pNode->pNext;
+			break;
+		}
+	}
+	for (i = 0; i < EMU_MAXSTREAMS; i++) {
+		if (pNode->apIn[i])
+			FreeStream(pNode->apIn[i]);
+		if (pNode->apOut[i])
+			FreeStream(pNode->apOut[i]);
+		while ((pChunk = pNode->apStaged[i])) {
+			pNode->apStaged[i] = pChunk->pNext;
+			free(pChunk);
+		}
+	}
+	pNode->dwSignature = 0;
+	free(pNode);
+}
+
+/*
+ *  ======== MGR and PROC commands ========
+ */
+static int MgrWait(Trapped_Args *args)
+{
+	struct DSP_NOTIFICATION **aNotify = args->ARGS_MGR_WAIT.aNotifications;
+	UINT uCount = args->ARGS_MGR_WAIT.uCount;
+	struct timespec ts, *pDeadline;
+	struct EMU_EVENT *pEvent;
+	int status = 0;
+	UINT i;
+
+	pDeadline = Deadline(args->ARGS_MGR_WAIT.uTimeout, &ts);
+	while (1) {
+		for (i = 0; i < uCount; i++) {
+			pEvent = aNotify[i] ? aNotify[i]->handle : NULL;
+			if (pEvent && pEvent->fSignaled) {
+				pEvent->fSignaled = false;
+				*args->ARGS_MGR_WAIT.puIndex = i;
+				return 0;
+			}
+		}
+		if (status)
+			return status;
+		status = Wait(pDeadline);
+	}
+}
+
+static int ProcRsvMem(Trapped_Args *args)
+{
+	ULONG ulSize = args->ARGS_PROC_RSVMEM.ulSize;
+	struct EMU_REGION *pRsv;
+
+	if (emu.ulNextDspAddr + ulSize > EMU_DMMBASE + EMU_DMMSIZE)
+		return -ENOMEM;
+	pRsv = malloc(sizeof(*pRsv));
+	if (!pRsv)
+		return -ENOMEM;
+
+	/* DSP virtual space is never reused, EMU_DMMSIZE is plenty */
+	pRsv->ulDspAddr = emu.ulNextDspAddr;
+	pRsv->ulSize = ulSize;
+	pRsv->pMpuAddr = NULL;
+	pRsv->pNext = emu.pRsv;
+	emu.pRsv = pRsv;
+	emu.ulNextDspAddr += PG_ALIGN_HIGH(ulSize, PG_SIZE_4K);
+
+	*args->ARGS_PROC_RSVMEM.ppRsvAddr = (PVOID)pRsv->ulDspAddr;
+	return 0;
+}
+
+static int ProcUnRsvMem(Trapped_Args *args)
+{
+	ULONG ulAddr = (ULONG)args->ARGS_PROC_UNRSVMEM.pRsvAddr;
+	struct EMU_REGION **ppRsv, *pRsv;
+
+	for (ppRsv = &emu.pRsv; (pRsv = *ppRsv); ppRsv = &pRsv->pNext) {
+		if (pRsv->ulDspAddr == ulAddr) {
+			*ppRsv = pRsv->pNext;
+			free(pRsv);
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
+static int ProcMapMem(Trapped_Args *args)
+{
+	BYTE *pMpuAddr = args->ARGS_PROC_MAPMEM.pMpuAddr;
+	ULONG ulSize = args->ARGS_PROC_MAPMEM.ulSize;
+	ULONG ulAddr = (ULONG)args->ARGS_PROC_MAPMEM.pReqAddr +
+				((ULONG)pMpuAddr & (PG_SIZE_4K - 1));
+	struct EMU_REGION *pRegion;
+
+	/* must lie in a reservation and not overlap another mapping */
+	for (pRegion = emu.pRsv; pRegion; pRegion = pRegion->pNext) {
+		if (ulAddr >= pRegion->ulDspAddr && ulAddr + ulSize <=
+					pRegion->ulDspAddr + pRegion->ulSize)
+			break;
+	}
+	if (!pRegion)
+		return -EINVAL;
+	for (pRegion = emu.pMaps; pRegion; pRegion = pRegion->pNext) {
+		if (ulAddr < pRegion->ulDspAddr + pRegion->ulSize &&
+				pRegion->ulDspAddr < ulAddr + ulSize)
+			return -EPERM;
+	}
+
+	pRegion = malloc(sizeof(*pRegion));
+	if (!pRegion)
+		return -ENOMEM;
+	pRegion->ulDspAddr = ulAddr;
+	pRegion->ulSize = ulSize;
+	pRegion->pMpuAddr = pMpuAddr;
+	pRegion->pNext = emu.pMaps;
+	emu.pMaps = pRegion;
+
+	*args->ARGS_PROC_MAPMEM.ppMapAddr = (PVOID)ulAddr;
+	return 0;
+}
+
+static int ProcUnMapMem(Trapped_Args *args)
+{
+	ULONG ulAddr = (ULONG)args->ARGS_PROC_UNMAPMEM.pMapAddr;
+	struct EMU_REGION **ppMap, *pMap;
+
+	for (ppMap = &emu.pMaps; (pMap = *ppMap); ppMap = &pMap->pNext) {
+		if (ulAddr >= pMap->ulDspAddr &&
+				ulAddr < pMap->ulDspAddr + pMap->ulSize) {
+			*ppMap = pMap->pNext;
+			free(pMap);
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
+/*
+ *  ======== NODE commands ========
+ */
+static int NodeAllocate(Trapped_Args *args)
+{
+	struct EMU_NODE *pNode;
+
+	if (!args->ARGS_NODE_ALLOCATE.hProcessor)
+		return -EFAULT;
+
+	pNode = calloc(1, sizeof(*pNode));
+	if (!pNode)
+		return -ENOMEM;
+	pNode->dwSignature = EMU_NODESIGNATURE;
+	pNode->uuid = *args->ARGS_NODE_ALLOCATE.pNodeID;
+	if (args->ARGS_NODE_ALLOCATE.pAttrIn) {
+		pNode->attrIn = *args->ARGS_NODE_ALLOCATE.pAttrIn;
+		pNode->iPriority = pNode->attrIn.iPriority;
+	}
+	pNode->state = NODE_ALLOCATED;
+	if (IsEqualUuid(&pNode->uuid, &DMMCOPY_uuid))
+		pNode->uKind = EMU_DMMCOPY;
+	else if (IsEqualUuid(&pNode->uuid, &ZCMSG_uuid))
+		pNode->uKind = EMU_ZCMSG;
+	pNode->pNext = emu.pNodes;
+	emu.pNodes = pNode;
+
+	*args->ARGS_NODE_ALLOCATE.phNode = (DSP_HNODE)pNode;
+	return 0;
+}
+
+static int NodeGetAttr(Trapped_Args *args, struct EMU_NODE *pNode)
+{
+	struct DSP_NODEATTR *pAttr = args->ARGS_NODE_GETATTR.pAttr;
+	struct DSP_NODEINFO *pInfo = &pAttr->iNodeInfo;
+	UINT i;
+
+	memset(pAttr, 0, sizeof(*pAttr));
+	pAttr->cbStruct = sizeof(*pAttr);
+	pAttr->inNodeAttrIn = pNode->attrIn;
+	for (i = 0; i < EMU_MAXSTREAMS; i++) {
+		pAttr->uInputs += pNode->apIn[i] != NULL;
+		pAttr->uOutputs += pNode->apOut[i] != NULL;
+	}
+	pInfo->cbStruct = sizeof(*pInfo);
+	pInfo->nbNodeDatabaseProps.cbStruct =
+				sizeof(pInfo->nbNodeDatabaseProps);
+	pInfo->nbNodeDatabaseProps.uiNodeID = pNode->uuid;
+	pInfo->nbNodeDatabaseProps.uNodeType = NODE_TASK;
+	pInfo->nbNodeDatabaseProps.uMessageDepth = EMU_MSGDEPTH;
+	pInfo->uExecutionPriority = pNode->iPriority;
+	pInfo->nsExecutionState = pNode->state;
+	return 0;
+}
+
+static int NodePutMessage(Trapped_Args *args, struct EMU_NODE *pNode)
+{
+	struct timespec ts, *pDeadline;
+	int status = 0;
+
+	pDeadline = Deadline(args->ARGS_NODE_PUTMESSAGE.uTimeout, &ts);
+	while (pNode->toNode.uCount == EMU_MSGDEPTH && !status)
+		status = Wait(pDeadline);
+	if (pNode->toNode.uCount == EMU_MSGDEPTH)
+		return status ? status : -ETIME;
+
+	PutMsg(&pNode->toNode, args->ARGS_NODE_PUTMESSAGE.pMessage);
+	pthread_cond_broadcast(&emu.cond);
+	return 0;
+}
+
+static int NodeGetMessage(Trapped_Args *args, struct EMU_NODE *pNode)
+{
+	struct timespec ts, *pDeadline;
+	int status = 0;
+
+	pDeadline = Deadline(args->ARGS_NODE_GETMESSAGE.uTimeout, &ts);
+	while (!pNode->fromNode.uCount && !status)
+		status = Wait(pDeadline);
+	if (!pNode->fromNode.uCount)
+		return status ? status : -ETIME;
+
+	GetMsg(&pNode->fromNode, args->ARGS_NODE_GETMESSAGE.pMessage);
+	/* the node may be waiting for room in fromNode */
+	pthread_cond_broadcast(&emu.cond);
+	return 0;
+}
+
+static int NodeRegisterNotify(Trapped_Args *args, struct EMU_NODE *pNode)
+{
+	struct DSP_NOTIFICATION *hNotify =
+				args->ARGS_NODE_REGISTERNOTIFY.hNotification;
+	UINT uEventMask = args->ARGS_NODE_REGISTERNOTIFY.uEventMask;
+
+	if (uEventMask & DSP_NODEMESSAGEREADY) {
+		hNotify->handle = &pNode->msgEvent;
+		/* messages may already be waiting */
+		pNode->msgEvent.fSignaled = pNode->fromNode.uCount != 0;
+	} else if (uEventMask & DSP_NODESTATECHANGE) {
+		hNotify->handle = &pNode->stateEvent;
+	}
+	return 0;
+}
+
+static int NodeRun(struct EMU_NODE *pNode)
+{
+	if (pNode->state != NODE_CREATED && pNode->state != NODE_PAUSED)
+		return -EPERM;
+
+	if (!pNode->fThread) {
+		pNode->fStop = false;
+		if (pthread_create(&pNode->thread, NULL, NodeThread, pNode))
+			return -ENOMEM;
+		pNode->fThread = true;
+	}
+	SetNodeState(pNode, NODE_RUNNING);
+	return 0;
+}
+
+static int NodeTerminate(Trapped_Args *args, struct EMU_NODE *pNode)
+{
+	if (pNode->state != NODE_RUNNING && pNode->state != NODE_PAUSED)
+		return -EPERM;
+
+	StopNode(pNode);
+	SetNodeState(pNode, NODE_DONE);
+	if (args->ARGS_NODE_TERMINATE.pStatus)
+		*args->ARGS_NODE_TERMINATE.pStatus = 0;
+	return 0;
+}
+
+static int NodeCommand(Trapped_Args *args, int cmd)
+{
+	struct EMU_NODE *pNode;
+
+	if (cmd == CMD_NODE_ALLOCATE_OFFSET)
+		return NodeAllocate(args);
+
+	if (cmd == CMD_NODE_GETUUIDPROPS_OFFSET) {
+		struct DSP_NDBPROPS *pProps =
+				args->ARGS_NODE_GETUUIDPROPS.pNodeProps;
+
+		memset(pProps, 0, sizeof(*pProps));
+		pProps->cbStruct = sizeof(*pProps);
+		pProps->uiNodeID = *args->ARGS_NODE_GETUUIDPROPS.pNodeID;
+		pProps->uNodeType = NODE_TASK;
+		pProps->uMessageDepth = EMU_MSGDEPTH;
+		return 0;
+	}
+
+	if (cmd == CMD_NODE_CONNECT_OFFSET) {
+		/* either end may be the GPP, loopback nodes need no wiring */
+		if (!ToNode(args->ARGS_NODE_CONNECT.hNode) &&
+			!ToNode(args->ARGS_NODE_CONNECT.hOtherNode))
+			return -EFAULT;
+		return 0;
+	}
+
+	/* every other NODE command takes the node first */
+	pNode = ToNode(args->ARGS_NODE_DELETE.hNode);
+	if (!pNode)
+		return -EFAULT;
+
+	switch (cmd) {
+	case CMD_NODE_ALLOCMSGBUF_OFFSET:
+		/* there is no SM segment, buffers are plain memory */
+		if (args->ARGS_NODE_ALLOCMSGBUF.pAttr &&
+			(args->ARGS_NODE_ALLOCMSGBUF.pAttr->uSegment &
+			(MEM_SETVIRTUALSEGID | MEM_GETVIRTUALSEGID))) {
+			*args->ARGS_NODE_ALLOCMSGBUF.pBuffer = NULL;
+			return 0;
+		}
+		*args->ARGS_NODE_ALLOCMSGBUF.pBuffer =
+				malloc(args->ARGS_NODE_ALLOCMSGBUF.uSize);
+		return *args->ARGS_NODE_ALLOCMSGBUF.pBuffer ? 0 : -ENOMEM;
+	case CMD_NODE_FREEMSGBUF_OFFSET:
+		free(args->ARGS_NODE_FREEMSGBUF.pBuffer);
+		return 0;
+	case CMD_NODE_CHANGEPRIORITY_OFFSET:
+		pNode->iPriority = args->ARGS_NODE_CHANGEPRIORITY.iPriority;
+		return 0;
+	case CMD_NODE_CREATE_OFFSET:
+		if (pNode->state != NODE_ALLOCATED)
+			return -EPERM;
+		SetNodeState(pNode, NODE_CREATED);
+		return 0;
+	case CMD_NODE_DELETE_OFFSET:
+		FreeNode(pNode);
+		return 0;
+	case CMD_NODE_GETATTR_OFFSET:
+		return NodeGetAttr(args, pNode);
+	case CMD_NODE_GETMESSAGE_OFFSET:
+		return NodeGetMessage(args, pNode);
+	case CMD_NODE_PAUSE_OFFSET:
+		if (pNode->state != NODE_RUNNING)
+			return -EPERM;
+		SetNodeState(pNode, NODE_PAUSED);
+		return 0;
+	case CMD_NODE_PUTMESSAGE_OFFSET:
+		return NodePutMessage(args, pNode);
+	case CMD_NODE_REGISTERNOTIFY_OFFSET:
+		return NodeRegisterNotify(args, pNode);
+	case CMD_NODE_RUN_OFFSET:
+		return NodeRun(pNode);
+	case CMD_NODE_TERMINATE_OFFSET:
+		return NodeTerminate(args, pNode);
+	default:
+		return -ENOSYS;
+	}
+}
+
+/*
+ *  ======== STRM commands ========
+ */
+static int StrmOpen(Trapped_Args *args)
+{
+	struct EMU_NODE *pNode = ToNode(args->ARGS_STRM_OPEN.hNode);
+	struct DSP_STREAMATTRIN *pAttrIn =
+			args->ARGS_STRM_OPEN.pAttrIn->pStreamAttrIn;
+	UINT uIndex = args->ARGS_STRM_OPEN.uIndex;
+	struct EMU_STREAM **ppSlot, *pStrm;
+
+	if (!pNode)
+		return -EFAULT;
+	if (uIndex >= EMU_MAXSTREAMS)
+		return -EINVAL;
+	ppSlot = args->ARGS_STRM_OPEN.uDirection == DSP_TONODE ?
+			&pNode->apIn[uIndex] : &pNode->apOut[uIndex];
+	if (*ppSlot)
+		return -EPERM;
+
+	pStrm = calloc(1, sizeof(*pStrm));
+	if (!pStrm)
+		return -ENOMEM;
+	pStrm->dwSignature = EMU_STRMSIGNATURE;
+	pStrm->pNode = pNode;
+	pStrm->uDirection = args->ARGS_STRM_OPEN.uDirection;
+	pStrm->uIndex = uIndex;
+	pStrm->uTimeout = pAttrIn ? pAttrIn->uTimeout : (UINT)DSP_FOREVER;
+	pStrm->uNumBufs = pAttrIn && pAttrIn->uNumBufs &&
+			pAttrIn->uNumBufs < EMU_MAXBUFS ?
+				pAttrIn->uNumBufs : EMU_MAXBUFS;
+	pStrm->lMode = pAttrIn ? pAttrIn->lMode : STRMMODE_PROCCOPY;
+	*ppSlot = pStrm;
+
+	*args->ARGS_STRM_OPEN.phStream = (DSP_HSTREAM)pStrm;
+	return 0;
+}
+
+static int IssueBuf(struct EMU_STREAM *pStrm, BYTE *pBuffer, ULONG dwBytes,
+						ULONG dwBufSize, DWORD dwArg)
+{
+	struct EMU_BUF buf;
+
+	if (pStrm->pending.uCount + pStrm->done.uCount >= pStrm->uNumBufs)
+		return -ENOSR;
+
+	buf.pBuffer = pBuffer;
+	buf.dwBytes = dwBytes;
+	buf.dwBufSize = dwBufSize;
+	buf.dwArg = dwArg;
+	PutBuf(&pStrm->pending, &buf);
+	pthread_cond_broadcast(&emu.cond);
+	return 0;
+}
+
+/* Waits up to uTimeout for a completed buffer */
+static int WaitDone(struct EMU_STREAM *pStrm, UINT uTimeout)
+{
+	struct timespec ts, *pDeadline;
+	int status = 0;
+
+	pDeadline = Deadline(uTimeout, &ts);
+	while (!pStrm->done.uCount && !status)
+		status = Wait(pDeadline);
+	if (!pStrm->done.uCount)
+		return status ? status : -ETIME;
+	return 0;
+}
+
+static void ReclaimBuf(struct EMU_STREAM *pStrm, struct EMU_BUF *pBuf)
+{
+	GetBuf(&pStrm->done, pBuf);
+	if (!pStrm->done.uCount)
+		pStrm->doneEvent.fSignaled = false;
+}
+
+static int StrmIssue(Trapped_Args *args, struct EMU_STREAM *pStrm)
+{
+	return IssueBuf(pStrm, args->ARGS_STRM_ISSUE.pBuffer,
+			args->ARGS_STRM_ISSUE.dwBytes,
+			args->ARGS_STRM_ISSUE.dwBufSize,
+			args->ARGS_STRM_ISSUE.dwArg);
+}
+
+static int StrmIssueV(Trapped_Args *args, struct EMU_STREAM *pStrm)
+{
+	struct DSP_STREAMBUF *aBufs = args->ARGS_STRM_ISSUEV.aBufs;
+	UINT *puIssued = args->ARGS_STRM_ISSUEV.puIssued;
+	int status = 0;
+
+	for (*puIssued = 0; *puIssued < args->ARGS_STRM_ISSUEV.uNumBufs;
+							(*puIssued)++) {
+		status = IssueBuf(pStrm, aBufs[*puIssued].pBuffer,
+				aBufs[*puIssued].ulDataSize,
+				aBufs[*puIssued].ulBufSize,
+				aBufs[*puIssued].dwArg);
+		if (status)
+			break;
+	}
+	return status;
+}
+
+static int StrmReclaim(Trapped_Args *args, struct EMU_STREAM *pStrm)
+{
+	struct EMU_BUF buf;
+	int status;
+
+	status = WaitDone(pStrm, pStrm->uTimeout);
+	if (status)
+		return status;
+
+	ReclaimBuf(pStrm, &buf);
+	*args->ARGS_STRM_RECLAIM.pBufPtr = buf.pBuffer;
+	if (args->ARGS_STRM_RECLAIM.pBytes)
+		*args->ARGS_STRM_RECLAIM.pBytes = buf.dwBytes;
+	if (args->ARGS_STRM_RECLAIM.pBufSize)
+		*args->ARGS_STRM_RECLAIM.pBufSize = buf.dwBufSize;
+	if (args->ARGS_STRM_RECLAIM.pdwArg)
+		*args->ARGS_STRM_RECLAIM.pdwArg = buf.dwArg;
+	return 0;
+}
+
+static int StrmReclaimV(Trapped_Args *args, struct EMU_STREAM *pStrm)
+{
+	struct DSP_STREAMBUF *pOut = args->ARGS_STRM_RECLAIMV.aBufs;
+	UINT uTimeout = args->ARGS_STRM_RECLAIMV.uTimeout;
+	UINT *puReclaimed = args->ARGS_STRM_RECLAIMV.puReclaimed;
+	struct EMU_BUF buf;
+	int status;
+
+	*puReclaimed = 0;
+	if (!pStrm->done.uCount && !uTimeout)
+		return 0;
+	status = WaitDone(pStrm, uTimeout);
+	if (status)
+		return status;
+
+	while (pStrm->done.uCount &&
+			*puReclaimed < args->ARGS_STRM_RECLAIMV.uMaxBufs) {
+		ReclaimBuf(pStrm, &buf);
+		pOut->pBuffer = buf.pBuffer;
+		pOut->ulDataSize = buf.dwBytes;
+		pOut->ulBufSize = buf.dwBufSize;
+		pOut->dwArg = buf.dwArg;
+		pOut++;
+		(*puReclaimed)++;
+	}
+	return 0;
+}
+
+static int StrmIdle(Trapped_Args *args, struct EMU_STREAM *pStrm)
+{
+	struct timespec ts, *pDeadline;
+	struct EMU_BUF buf;
+	int status = 0;
+
+	/* let the node drain what was sent to it unless asked to flush */
+	if (pStrm->uDirection == DSP_TONODE && !args->ARGS_STRM_IDLE.bFlush) {
+		pDeadline = Deadline(pStrm->uTimeout, &ts);
+		while (pStrm->pending.uCount && !status)
+			status = Wait(pDeadline);
+		if (pStrm->pending.uCount)
+			return status ? status : -ETIME;
+	}
+
+	/* what is left comes back empty */
+	while (pStrm->pending.uCount) {
+		GetBuf(&pStrm->pending, &buf);
+		if (pStrm->uDirection == DSP_FROMNODE)
+			buf.dwBytes = 0;
+		PutBuf(&pStrm->done, &buf);
+	}
+	if (pStrm->done.uCount)
+		Signal(&pStrm->doneEvent);
+	return 0;
+}
+
+static int StrmSelect(Trapped_Args *args)
+{
+	DSP_HSTREAM *aStrmTab = args->ARGS_STRM_SELECT.aStreamTab;
+	UINT nStreams = args->ARGS_STRM_SELECT.nStreams;
+	struct timespec ts, *pDeadline;
+	struct EMU_STREAM *pStrm;
+	UINT i, uMask;
+	int status = 0;
+
+	for (i = 0; i < nStreams; i++)
+		if (!ToStream(aStrmTab[i]))
+			return -EFAULT;
+
+	pDeadline = Deadline(args->ARGS_STRM_SELECT.uTimeout, &ts);
+	while (1) {
+		uMask = 0;
+		for (i = 0; i < nStreams; i++) {
+			pStrm = (struct EMU_STREAM *)aStrmTab[i];
+			if (pStrm->done.uCount)
+				uMask |= 1 << i;
+		}
+		if (uMask || status)
+			break;
+		status = Wait(pDeadline);
+	}
+	*args->ARGS_STRM_SELECT.pMask = uMask;
+	return uMask ? 0 : status;
+}
+
+static int StrmGetInfo(Trapped_Args *args, struct EMU_STREAM *pStrm)
+{
+	struct STRM_INFO *pInfo = args->ARGS_STRM_GETINFO.pStreamInfo;
+	struct DSP_STREAMINFO *pUser = pInfo->pUser;
+
+	pInfo->lMode = pStrm->lMode;
+	pInfo->uSegment = 0;
+	pInfo->pVirtBase = NULL;
+	pUser->cbStruct = sizeof(*pUser);
+	pUser->uNumberBufsAllowed = pStrm->uNumBufs;
+	pUser->uNumberBufsInStream = pStrm->pending.uCount +
+							pStrm->done.uCount;
+	pUser->ulNumberBytes = pStrm->ulBytes;
+	pUser->hSyncObjectHandle = &pStrm->doneEvent;
+	pUser->ssStreamState = pStrm->done.uCount ? STREAM_DONE :
+			pStrm->pending.uCount ? STREAM_PENDING : STREAM_IDLE;
+	return 0;
+}
+
+static int StrmCommand(Trapped_Args *args, int cmd)
+{
+	struct EMU_STREAM *pStrm;
+
+	if (cmd == CMD_STRM_OPEN_OFFSET)
+		return StrmOpen(args);
+	if (cmd == CMD_STRM_SELECT_OFFSET)
+		return StrmSelect(args);
+
+	/* every other STRM command takes the stream first */
+	pStrm = ToStream(args->ARGS_STRM_CLOSE.hStream);
+	if (!pStrm)
+		return -EFAULT;
+
+	switch (cmd) {
+	case CMD_STRM_CLOSE_OFFSET:
+		if (pStrm->pending.uCount || pStrm->done.uCount)
+			return -EPIPE;	/* buffers still outstanding */
+		FreeStream(pStrm);
+		return 0;
+	case CMD_STRM_GETINFO_OFFSET:
+		return StrmGetInfo(args, pStrm);
+	case CMD_STRM_IDLE_OFFSET:
+		return StrmIdle(args, pStrm);
+	case CMD_STRM_ISSUE_OFFSET:
+		return StrmIssue(args, pStrm);
+	case CMD_STRM_RECLAIM_OFFSET:
+		return StrmReclaim(args, pStrm);
+	case CMD_STRM_ISSUEV_OFFSET:
+		return StrmIssueV(args, pStrm);
+	case CMD_STRM_RECLAIMV_OFFSET:
+		return StrmReclaimV(args, pStrm);
+	case CMD_STRM_REGISTERNOTIFY_OFFSET:
+		args->ARGS_STRM_REGISTERNOTIFY.hNotification->handle =
+							&pStrm->doneEvent;
+		return 0;
+	default:
+		/* SM buffers and kernel event handles do not exist here */
+		return -ENOSYS;
+	}
+}
+
+/*
+ *  ======== DSPEMU_Trap ========
+ */
+int DSPEMU_Trap(Trapped_Args *args, int cmd)
+{
+	int status = 0;
+
+	pthread_mutex_lock(&emu.lock);
+
+	switch (cmd) {
+	case CMD_MGR_ENUMPROC_INFO_OFFSET: {
+		struct DSP_PROCESSORINFO *pInfo =
+				args->ARGS_MGR_ENUMPROC_INFO.pProcessorInfo;
+
+		*args->ARGS_MGR_ENUMPROC_INFO.puNumProcs = 1;
+		if (args->ARGS_MGR_ENUMPROC_INFO.uProcessor > 0) {
+			status = -EINVAL;
+			break;
+		}
+		memset(pInfo, 0, sizeof(*pInfo));
+		pInfo->cbStruct = sizeof(*pInfo);
+		pInfo->uProcessorType = DSPTYPE_64;
+		pInfo->nNodeMinPriority = 1;
+		pInfo->nNodeMaxPriority = 15;
+		break;
+	}
+	case CMD_MGR_ENUMNODE_INFO_OFFSET:
+		/* no node database */
+		*args->ARGS_MGR_ENUMNODE_INFO.puNumNodes = 0;
+		status = -EINVAL;
+		break;
+	case CMD_MGR_REGISTEROBJECT_OFFSET:
+	case CMD_MGR_UNREGISTEROBJECT_OFFSET:
+	case CMD_MGR_RESOUCES_OFFSET:
+		break;
+	case CMD_MGR_WAIT_OFFSET:
+		status = MgrWait(args);
+		break;
+
+	case CMD_PROC_ATTACH_OFFSET:
+		if (args->ARGS_PROC_ATTACH.uProcessor > 0) {
+			status = -EINVAL;
+			break;
+		}
+		*args->ARGS_PROC_ATTACH.phProcessor = (DSP_HPROCESSOR)&emu;
+		break;
+	case CMD_PROC_DETACH_OFFSET:
+	case CMD_PROC_CTRL_OFFSET:
+	case CMD_PROC_FLUSHMEMORY_OFFSET:
+	case CMD_PROC_INVALIDATEMEMORY_OFFSET:
+		/* the emulated DSP shares the MPU caches */
+		break;
+	case CMD_PROC_LOAD_OFFSET:
+		emu.procState = PROC_LOADED;
+		Signal(&emu.procEvent);
+		break;
+	case CMD_PROC_START_OFFSET:
+		emu.procState = PROC_RUNNING;
+		Signal(&emu.procEvent);
+		break;
+	case CMD_PROC_STOP_OFFSET:
+		emu.procState = PROC_STOPPED;
+		Signal(&emu.procEvent);
+		break;
+	case CMD_PROC_GETSTATE_OFFSET:
+		memset(args->ARGS_PROC_GETSTATE.pProcStatus, 0,
+				sizeof(struct DSP_PROCESSORSTATE));
+		args->ARGS_PROC_GETSTATE.pProcStatus->cbStruct =
+				sizeof(struct DSP_PROCESSORSTATE);
+		args->ARGS_PROC_GETSTATE.pProcStatus->iState = emu.procState;
+		break;
+	case CMD_PROC_REGISTERNOTIFY_OFFSET:
+		args->ARGS_PROC_REGISTER_NOTIFY.hNotification->handle =
+							&emu.procEvent;
+		break;
+	case CMD_PROC_ENUMNODE_OFFSET: {
+		struct EMU_NODE *pNode;
+		UINT n = 0;
+
+		for (pNode = emu.pNodes; pNode; pNode = pNode->pNext) {
+			if (n < args->ARGS_PROC_ENUMNODE_INFO.uNodeTabSize)
+				args->ARGS_PROC_ENUMNODE_INFO.aNodeTab[n] =
+							(DSP_HNODE)pNode;
+			n++;
+		}
+		*args->ARGS_PROC_ENUMNODE_INFO.puNumNodes = n;
+		*args->ARGS_PROC_ENUMNODE_INFO.puAllocated = n;
+		if (n > args->ARGS_PROC_ENUMNODE_INFO.uNodeTabSize)
+			status = -EINVAL;
+		break;
+	}
+	case CMD_PROC_RSVMEM_OFFSET:
+		status = ProcRsvMem(args);
+		break;
+	case CMD_PROC_UNRSVMEM_OFFSET:
+		status = ProcUnRsvMem(args);
+		break;
+	case CMD_PROC_MAPMEM_OFFSET:
+		status = ProcMapMem(args);
+		break;
+	case CMD_PROC_UNMAPMEM_OFFSET:
+		status = ProcUnMapMem(args);
+		break;
+
+	case CMD_CMM_GETHANDLE_OFFSET:
+		*args->ARGS_CMM_GETHANDLE.phCmmMgr = (struct CMM_OBJECT *)&emu;
+		break;
+	case CMD_CMM_GETINFO_OFFSET:
+		/* no shared memory segments */
+		memset(args->ARGS_CMM_GETINFO.pCmmInfo, 0,
+					sizeof(struct CMM_INFO));
+		break;
+
+	default:
+		if (cmd >= CMD_NODE_ALLOCATE_OFFSET &&
+				cmd <= CMD_NODE_GETUUIDPROPS_OFFSET)
+			status = NodeCommand(args, cmd);
+		else if (cmd >= CMD_STRM_ALLOCATEBUFFER_OFFSET &&
+				cmd <= CMD_STRM_RECLAIMV_OFFSET)
+			status = StrmCommand(args, cmd);
+		else
+			status = -ENOSYS;
+		break;
+	}
+
+	pthread_mutex_unlock(&emu.lock);
+
+	if (status == -ENOSYS)
+		DEBUGMSG(DSPAPI_ZONE_ERROR, (TEXT("EMU: command is not "
+			"emulated\r\n")));
+	return status;
+}
+
+/*
+ *  ======== DSPEMU_Enabled ========
+ */
+int DSPEMU_Enabled(void)
+{
+	return emu.fd >= 0;
+}
+
+/*
+ *  ======== DSPEMU_Open ========
+ *  Returns a descriptor standing for the driver handle, so the callers
+ *  can keep treating hMediaFile as an open file.
+ */
+int DSPEMU_Open(void)
+{
+	pthread_mutex_lock(&emu.lock);
+	if (emu.fd < 0) {
+		emu.fd = open("/dev/null", O_RDWR);
+		emu.procState = PROC_RUNNING;
+		emu.ulNextDspAddr = EMU_DMMBASE;
+	}
+	pthread_mutex_unlock(&emu.lock);
+
+	return emu.fd;
+}
+
+/*
+ *  ======== DSPEMU_Close ========
+ *  Deletes what the application left behind. The caller closes the
+ *  descriptor.
+ */
+void DSPEMU_Close(void)
+{
+	pthread_mutex_lock(&emu.lock);
+	while (emu.pNodes)
+		FreeNode(emu.pNodes);
+	FreeRegions(&emu.pMaps);
+	FreeRegions(&emu.pRsv);
+	emu.fd = -1;
+	pthread_mutex_unlock(&emu.lock);
+}
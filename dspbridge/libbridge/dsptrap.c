@@ -42,6 +42,7 @@
 
 /*  ----------------------------------- This */
 #include <dsptrap.h>
+#include <dspemu.h>
 #include <_dbdebug.h>
 
 /*  ----------------------------------- Globals */
@@ -54,6 +55,9 @@ int DSPTRAP_Trap(Trapped_Args *args, int cmd)
 {
 	int dwResult = -EFAULT;/* returned from call into class driver */
 
+	if (DSPEMU_Enabled())
+		return DSPEMU_Trap(args, cmd);
+
 	if (hMediaFile >= 0)
 		dwResult = ioctl(hMediaFile, cmd, args);
 	else
@@ -28,8 +28,10 @@
  *      DSPStream_GetInfo
  *      DSPStream_Idle
  *      DSPStream_Issue
+ *      DSPStream_IssueV
  *      DSPStream_Open
  *      DSPStream_Reclaim
+ *      DSPStream_ReclaimV
  *      DSPStream_RegisterNotify
  *      DSPStream_Select
  *
@@ -184,6 +186,31 @@ extern "C" {
 				     ULONG dwDataSize, ULONG dwBufSize,
 				     IN DWORD dwArg);
 
+/*
+ *  ======== DSPStream_IssueV ========
+ *  Purpose:
+ *      Send several buffers of data to a stream in one call.
+ *  Parameters:
+ *      hStream:            The stream handle.
+ *      aBufs:              Buffers to send, in order.
+ *      uNumBufs:           Number of buffers in aBufs.
+ *      puIssued:           Ptr to location to store the number of buffers
+ *                          issued.
+ *  Returns:
+ *      0:                  Success, all uNumBufs buffers were issued.
+ *      -EFAULT:            Invalid Stream handle.
+ *      -EFAULT:            Invalid aBufs, puIssued or buffer pointer.
+ *      -EINVAL:            A buffer is smaller than its data size.
+ *      -ENOSR:             The stream is full; only *puIssued buffers,
+ *                          the first ones in aBufs, were issued.
+ *      -EPERM:             Unable to issue the buffers.
+ *  Details:
+ *      Drivers without vectored stream commands get one trap per buffer.
+ */
+	extern DBAPI DSPStream_IssueV(DSP_HSTREAM hStream,
+				      IN struct DSP_STREAMBUF * aBufs,
+				      UINT uNumBufs, OUT UINT * puIssued);
+
 /*
  *  ======== DSPStream_Open ========
  *  Purpose:
@@ -260,6 +287,35 @@ extern "C" {
 				       OUT ULONG * pBufSize,
 				       OUT DWORD * pdwArg);
 
+/*
+ *  ======== DSPStream_ReclaimV ========
+ *  Purpose:
+ *      Request several completed buffers back from a stream.
+ *  Parameters:
+ *      hStream:            The stream handle.
+ *      aBufs:              Ptr to location to store the buffers.
+ *      uMaxBufs:           Number of entries in aBufs.
+ *      uTimeout:           Time to wait for the first buffer, in
+ *                          milliseconds. 0 returns only what is ready.
+ *      puReclaimed:        Ptr to location to store the number of buffers
+ *                          reclaimed.
+ *  Returns:
+ *      0:                  Success; *puReclaimed may be 0 if uTimeout is 0.
+ *      -EFAULT:            Invalid Stream handle.
+ *      -EFAULT:            Invalid aBufs or puReclaimed pointer.
+ *      -ETIME:             No buffer completed within uTimeout.
+ *      DSP_ERESTART:       A critical error has occurred and
+ *                          the DSP is being restarted.
+ *      -EPERM:             Unable to Reclaim buffers.
+ *  Details:
+ *      Once one buffer is back, the others already completed are
+ *      returned with it without waiting for more.
+ */
+	extern DBAPI DSPStream_ReclaimV(DSP_HSTREAM hStream,
+					OUT struct DSP_STREAMBUF * aBufs,
+					UINT uMaxBufs, UINT uTimeout,
+					OUT UINT * puReclaimed);
+
 /*
  *  ======== DSPStream_RegisterNotify ========
  *  Purpose:
@@ -0,0 +1,46 @@
+/*
+ * dspbridge/mpu_api/inc/dspemu.h
+ *
+ * DSP-BIOS Bridge driver support functions for TI OMAP processors.
+ *
+ * Copyright (C) 2007 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 of the License.
+ *
+ * This program is distributed .as is. WITHOUT ANY WARRANTY of any kind,
+ * whether express or implied; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+/*
+ *  ======== dspemu.h ========
+ *  Purpose:
+ *      In-process emulation of the Bridge driver. When DSPEMU_ENV is set
+ *      in the environment, DspManager_Open() selects it and DSPTRAP_Trap()
+ *      hands every command to DSPEMU_Trap() instead of the driver.
+ *
+ *      Emulated nodes are loopback nodes run by one worker thread each:
+ *      messages are echoed back and data issued on input stream n is
+ *      copied to the buffers issued on output stream n. The dmmcopy
+ *      sample node also copies between its DMM mapped buffers, and the
+ *      zerocopymsg node doubles the words of the buffer it is sent.
+ *      There is no shared memory segment, streams use STRMMODE_PROCCOPY.
+ */
+
+#ifndef DSPEMU_
+#define DSPEMU_
+
+#include <wcdioctl.h>
+
+#define DSPEMU_ENV	"DSPBRIDGE_EMULATOR"
+
+/* Function Prototypes */
+extern int DSPEMU_Enabled(void);
+extern int DSPEMU_Open(void);
+extern void DSPEMU_Close(void);
+extern int DSPEMU_Trap(Trapped_Args *args, int cmd);
+
+#endif				/* DSPEMU_ */
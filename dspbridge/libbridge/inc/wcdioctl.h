@@ -378,6 +378,21 @@ typedef union {
 		UINT uTimeout;
 	} ARGS_STRM_SELECT;
 
+	struct {
+		DSP_HSTREAM hStream;
+		struct DSP_STREAMBUF *aBufs;
+		UINT uNumBufs;
+		UINT *puIssued;
+	} ARGS_STRM_ISSUEV;
+
+	struct {
+		DSP_HSTREAM hStream;
+		struct DSP_STREAMBUF *aBufs;
+		UINT uMaxBufs;
+		UINT uTimeout;
+		UINT *puReclaimed;
+	} ARGS_STRM_RECLAIMV;
+
 	/* CMM Module */
 	struct {
 		struct CMM_OBJECT* hCmmMgr;
@@ -494,6 +509,8 @@ typedef union {
 #define CMD_STRM_RECLAIM_OFFSET         0xDB68
 #define CMD_STRM_REGISTERNOTIFY_OFFSET  0xDB69
 #define CMD_STRM_SELECT_OFFSET          0xDB6A
+#define CMD_STRM_ISSUEV_OFFSET          0xDB6B
+#define CMD_STRM_RECLAIMV_OFFSET        0xDB6C
 
 /* Communication Memory Manager (UCMM) */
 #define CMD_CMM_ALLOCBUF_OFFSET         0xDB80
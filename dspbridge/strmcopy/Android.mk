@@ -20,6 +20,27 @@ LOCAL_MODULE_TAGS:= optional
 
 include $(BUILD_EXECUTABLE)
 
+# host build against libbridge's emulator, run with DSPBRIDGE_EMULATOR set
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	strmcopy.c
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../inc	
+
+LOCAL_STATIC_LIBRARIES := \
+	libbridge
+
+LOCAL_LDLIBS += -lpthread -lrt
+
+LOCAL_CFLAGS += -Wall -g -O2 -finline-functions -DOMAP_3430
+
+LOCAL_MODULE:= strmcopy
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
 include $(CLEAR_VARS)
 
 LOCAL_ARM_MODE := arm
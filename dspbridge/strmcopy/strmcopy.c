@@ -23,12 +23,17 @@
  *
  *  Usage:
  *      strmcopy.out <streaming transport id> <input-filename> <output-filename>
+ *                   [<batch sizes>]
  *
  *   where streaming transport id is:
  *       0 - proc-copy
  *       1 - dsp-dma
  *       2 - zero-copy
  *
+ *   and batch sizes is a comma separated list, e.g. 1,4,16. For each size
+ *   the file is copied again moving that many buffers per
+ *   DSPStream_IssueV/DSPStream_ReclaimV call, and the rate is reported.
+ *
  *  Notes:
  *      Data is read from an input file, sent to the input stream of a DSP
  *      task which sends each buffer into it's output stream back to the
@@ -41,6 +46,8 @@
 #include <stdio.h>
 #include <dbapi.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
 
 /* Default stream attributes */
 #define DEFAULTALIGNMENT   0
@@ -50,6 +57,8 @@
 #define DEFAULTDSPUNIT  0	/* Default unit number for the board. */
 #define DEFAULTDSPEXEC  "./strmcopy_tiomap24xx.dof55L"
 #define DEFAULTNBUFS    1	/* Default # of buffers. */
+#define MAXBATCH        32	/* Most buffers per IssueV/ReclaimV. */
+#define MAXPASSES       8	/* Most batch sizes on the command line. */
 
 #define ARGSIZE         32
 
@@ -64,6 +73,7 @@ struct STRMCOPY_TASK {
 	BYTE **ppOutBufs;	/* Output stream buffers. */
 	struct DSP_NOTIFICATION hNotification;	/* DSP notification object. */
 	INT nStrmMode;		/* stream mode */
+	UINT uNumBufs;		/* Buffers per stream. */
 };
 
 /*
@@ -75,7 +85,7 @@ static const struct DSP_UUID nodeuuid = { 0x7eeb2c7e, 0x785a, 0x11d4, 0xa6, 0x50
 
 /* Forward declarations: */
 static int ProcessArgs(int argc,char **argv,FILE **inFile,FILE **outFile,
-																INT *pStrmMode);
+									INT *pStrmMode, UINT *aBatch, UINT *pPasses);
 
 /* Initialization and cleanup routines. */
 static int InitializeProcessor(struct STRMCOPY_TASK *copyTask);
@@ -86,6 +96,9 @@ static int CleanupNode(struct STRMCOPY_TASK *copyTask);
 static int CleanupStreams(struct STRMCOPY_TASK *copyTask);
 static int RunTask(struct STRMCOPY_TASK *copyTask, FILE *inFile,
 																FILE *outFile);
+static int RunBatched(struct STRMCOPY_TASK *copyTask, UINT uBatch,
+								FILE *inFile, FILE *outFile, ULONG *pNumBufs);
+static ULONG ElapsedUs(struct timeval *pStart);
 
 /*
  *  ======== main ========
@@ -96,12 +109,19 @@ int main(int argc, char **argv)
 	FILE *inFile = NULL;	/* Input file handle. */
 	FILE *outFile = NULL;	/* Output file handle. */
 	struct STRMCOPY_TASK strmcopyTask;
+	UINT aBatch[MAXPASSES];	/* Batch sizes to measure. */
+	UINT nPasses = 0;
+	UINT i;
+	ULONG nBufs;
+	ULONG ulUs;
+	struct timeval start;
 	int status = 0;
 
 	DspManager_Open(argc, NULL);
 
 	/* Process command line arguments, open data files: */
-	status = ProcessArgs(argc, argv, &inFile, &outFile, &nStrmMode);
+	status = ProcessArgs(argc, argv, &inFile, &outFile, &nStrmMode, aBatch,
+																	&nPasses);
 	strmcopyTask.hProcessor = NULL;
 	strmcopyTask.hNode = NULL;
 	strmcopyTask.hInStream = NULL;
@@ -109,6 +129,12 @@ int main(int argc, char **argv)
 	strmcopyTask.ppInBufs = NULL;
 	strmcopyTask.ppOutBufs = NULL;
 	strmcopyTask.nStrmMode = nStrmMode;
+	strmcopyTask.uNumBufs = DEFAULTNBUFS;
+	for (i = 0; i < nPasses; i++) {
+		if (aBatch[i] > strmcopyTask.uNumBufs) {
+			strmcopyTask.uNumBufs = aBatch[i];
+		}
+	}
 	if (DSP_SUCCEEDED(status)) {
 		/* Perform processor level initialization. */
 		status = InitializeProcessor(&strmcopyTask);
@@ -119,7 +145,7 @@ int main(int argc, char **argv)
 		if (DSP_SUCCEEDED(status)) {
 			/* Perform stream level initialization. */
 			status = InitializeStreams(&strmcopyTask);
-			if (DSP_SUCCEEDED(status)) {
+			if (DSP_SUCCEEDED(status) && !nPasses) {
 				/* Run task. */
 				status = RunTask(&strmcopyTask, inFile, outFile);
 				if (DSP_SUCCEEDED(status)) {
@@ -128,6 +154,24 @@ int main(int argc, char **argv)
 					fprintf(stdout, "RunTask failed.\n");
 				}
 			}
+			/* Copy the file again at each batch size. */
+			for (i = 0; i < nPasses && DSP_SUCCEEDED(status); i++) {
+				rewind(inFile);
+				rewind(outFile);
+				nBufs = 0;
+				gettimeofday(&start, NULL);
+				status = RunBatched(&strmcopyTask, aBatch[i], inFile, outFile,
+																	&nBufs);
+				ulUs = ElapsedUs(&start);
+				if (DSP_SUCCEEDED(status)) {
+					fprintf(stdout, "Batch %2u: %lu buffers in %lu us, "
+								"%lu buffers/s\n", aBatch[i], nBufs, ulUs,
+								ulUs ? (ULONG)(nBufs * 1000000ULL / ulUs) : 0);
+				} else {
+					fprintf(stdout, "Batch %u failed. Status = 0x%x\n",
+												aBatch[i], (UINT)status);
+				}
+			}
 		}
 	}
 	/* Close opened files. */
@@ -215,7 +259,7 @@ static int InitializeNode(struct STRMCOPY_TASK *copyTask)
 
 	uuid = nodeuuid;
 	attrs.uBufsize = DEFAULTBUFSIZE;
-	attrs.uNumBufs = DEFAULTNBUFS;
+	attrs.uNumBufs = copyTask->uNumBufs;
 	attrs.uAlignment = 0;
 	attrs.uTimeout = DSP_FOREVER;
 	attrs.lMode = copyTask->nStrmMode;
@@ -293,7 +337,7 @@ static int InitializeStreams(struct STRMCOPY_TASK *copyTask)
 	attrs.cbStruct = sizeof(struct DSP_STREAMATTRIN);
 	attrs.uTimeout = DEFAULTTIMEOUT;
 	attrs.uAlignment = DEFAULTALIGNMENT;
-	attrs.uNumBufs = DEFAULTNBUFS;
+	attrs.uNumBufs = copyTask->uNumBufs;
 	attrs.lMode = copyTask->nStrmMode;
 	if (copyTask->nStrmMode == STRMMODE_PROCCOPY) {
 		attrs.uSegment = DEFAULTSEGMENT;
@@ -324,9 +368,10 @@ static int InitializeStreams(struct STRMCOPY_TASK *copyTask)
 	}
 	/* Allocate and issue buffer to input data stream. */
 	if (DSP_SUCCEEDED(status)) {
-		copyTask->ppInBufs = (BYTE **)malloc(sizeof(BYTE *)*DEFAULTNBUFS);
+		copyTask->ppInBufs = (BYTE **)malloc(sizeof(BYTE *) *
+														copyTask->uNumBufs);
 		status = DSPStream_AllocateBuffers(copyTask->hInStream, DEFAULTBUFSIZE,
-											copyTask->ppInBufs, DEFAULTNBUFS);
+										copyTask->ppInBufs, copyTask->uNumBufs);
 		if (DSP_SUCCEEDED(status)) {
 			fprintf(stdout, "DSPStream_AllocateBuffers for input "
 														"stream succeeded.\n");
@@ -337,9 +382,10 @@ static int InitializeStreams(struct STRMCOPY_TASK *copyTask)
 	}
 	/* Allocate and issue buffer to output data stream. */
 	if (DSP_SUCCEEDED(status)) {
-		copyTask->ppOutBufs = (BYTE **)malloc(sizeof(BYTE *)*DEFAULTNBUFS);
+		copyTask->ppOutBufs = (BYTE **)malloc(sizeof(BYTE *) *
+														copyTask->uNumBufs);
 		status = DSPStream_AllocateBuffers(copyTask->hOutStream, DEFAULTBUFSIZE,
-											copyTask->ppOutBufs, DEFAULTNBUFS);
+										copyTask->ppOutBufs, copyTask->uNumBufs);
 		if (DSP_SUCCEEDED(status)) {
 			fprintf(stdout, "DSPStream_AllocateBuffers for output "
 														"stream succeeded.\n");
@@ -421,6 +467,115 @@ static int RunTask(struct STRMCOPY_TASK *copyTask, FILE *inFile,
 	return (status);
 }
 
+/*
+ *  ======== ReclaimAll ========
+ *  Reclaim nBufs buffers, in issue order, into aBufs.
+ */
+static int ReclaimAll(DSP_HSTREAM hStream, struct DSP_STREAMBUF *aBufs,
+																UINT nBufs)
+{
+	UINT nDone = 0;
+	UINT nReclaimed;
+	int status = 0;
+
+	while (nDone < nBufs && DSP_SUCCEEDED(status)) {
+		status = DSPStream_ReclaimV(hStream, aBufs + nDone, nBufs - nDone,
+											DEFAULTTIMEOUT, &nReclaimed);
+		nDone += nReclaimed;
+	}
+	return (status);
+}
+
+/*
+ *  ======== RunBatched ========
+ *  Run strmcopy task moving up to uBatch buffers per call, and count the
+ *  buffers sent in *pNumBufs.  The output buffers are issued before the
+ *  input buffers are reclaimed, so the node never has to hold a whole
+ *  batch of input while it waits for room to write.
+ */
+static int RunBatched(struct STRMCOPY_TASK *copyTask, UINT uBatch,
+								FILE *inFile, FILE *outFile, ULONG *pNumBufs)
+{
+	struct DSP_STREAMBUF aInBufs[MAXBATCH];
+	struct DSP_STREAMBUF aOutBufs[MAXBATCH];
+	UINT nBufs;
+	UINT nIssued;
+	UINT i;
+	int cBytesRead;
+	int status = 0;
+
+	do {
+		/* Read up to uBatch blocks of data from the input file: */
+		for (nBufs = 0; nBufs < uBatch; nBufs++) {
+			cBytesRead = fread(copyTask->ppInBufs[nBufs], sizeof(BYTE),
+													DEFAULTBUFSIZE, inFile);
+			if (cBytesRead <= 0) {
+				break;
+			}
+			aInBufs[nBufs].pBuffer = copyTask->ppInBufs[nBufs];
+			aInBufs[nBufs].ulDataSize = cBytesRead;
+			aInBufs[nBufs].ulBufSize = DEFAULTBUFSIZE;
+			aInBufs[nBufs].dwArg = 0;
+		}
+		if (nBufs == 0) {
+			break;
+		}
+		for (i = 0; i < nBufs; i++) {
+			aOutBufs[i].pBuffer = copyTask->ppOutBufs[i];
+			aOutBufs[i].ulDataSize = DEFAULTBUFSIZE;
+			aOutBufs[i].ulBufSize = DEFAULTBUFSIZE;
+			aOutBufs[i].dwArg = 0;
+		}
+		/* Send them all to the DSP, with as many buffers to fill. */
+		status = DSPStream_IssueV(copyTask->hInStream, aInBufs, nBufs,
+																	&nIssued);
+		if (DSP_FAILED(status)) {
+			fprintf(stdout, "Sending to DSP failed, 0x%x.\n", (UINT)status);
+			break;
+		}
+		status = DSPStream_IssueV(copyTask->hOutStream, aOutBufs, nBufs,
+																	&nIssued);
+		if (DSP_FAILED(status)) {
+			fprintf(stdout, "Receiving from DSP failed, 0x%x.\n",
+																(UINT)status);
+			break;
+		}
+		/* Wait for the input to be consumed and the output to come back. */
+		status = ReclaimAll(copyTask->hInStream, aInBufs, nBufs);
+		if (DSP_FAILED(status)) {
+			fprintf(stdout, "Sending to DSP failed, 0x%x.\n", (UINT)status);
+			break;
+		}
+		status = ReclaimAll(copyTask->hOutStream, aOutBufs, nBufs);
+		if (DSP_FAILED(status)) {
+			fprintf(stdout, "Receiving from DSP failed, 0x%x.\n",
+																(UINT)status);
+			break;
+		}
+		/* Copy the blocks of data from the DSP into the output file: */
+		for (i = 0; i < nBufs; i++) {
+			fwrite(aOutBufs[i].pBuffer, sizeof(BYTE), aOutBufs[i].ulDataSize,
+																	outFile);
+		}
+		*pNumBufs += nBufs;
+	} while (nBufs == uBatch);
+
+	return (status);
+}
+
+/*
+ *  ======== ElapsedUs ========
+ *  Microseconds since *pStart.
+ */
+static ULONG ElapsedUs(struct timeval *pStart)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (ULONG)((now.tv_sec - pStart->tv_sec) * 1000000 +
+											(now.tv_usec - pStart->tv_usec));
+}
+
 /*
  *  ======== CleanupStreams ========
  *  Perform stream related cleanup.
@@ -439,13 +594,13 @@ static int CleanupStreams(struct STRMCOPY_TASK *copyTask)
 		status = DSPStream_GetInfo(copyTask->hInStream, &streamInfo,
 															sizeof(streamInfo));
 		if (copyTask->ppInBufs) {
-			/* Reclaim the buffer if it's still in the stream */
-			if (streamInfo.uNumberBufsInStream) {
+			/* Reclaim the buffers still in the stream */
+			while (streamInfo.uNumberBufsInStream--) {
 				status = DSPStream_Reclaim(copyTask->hInStream, &pBuf,
 													&dwBufsize, NULL, &dwArg);
 			}
 			status = DSPStream_FreeBuffers(copyTask->hInStream, 
-											copyTask->ppInBufs, DEFAULTNBUFS);
+										copyTask->ppInBufs, copyTask->uNumBufs);
 			if (DSP_FAILED(status)) {
 				fprintf(stdout, "DSPStream_FreeBuffer of input buffer failed. "
 											"Status = 0x%x\n", (UINT)status);
@@ -467,13 +622,13 @@ static int CleanupStreams(struct STRMCOPY_TASK *copyTask)
 		status = DSPStream_GetInfo(copyTask->hOutStream, &streamInfo,
 															sizeof(streamInfo));
 		if (copyTask->ppOutBufs) {
-			if (streamInfo.uNumberBufsInStream) {
+			while (streamInfo.uNumberBufsInStream--) {
 				status = DSPStream_Reclaim(copyTask->hOutStream, &pBuf, 
 														&dwBufsize,NULL,&dwArg);
 			}
 			/* Free buffer. */
 			status = DSPStream_FreeBuffers(copyTask->hOutStream, 
-											copyTask->ppOutBufs, DEFAULTNBUFS);
+										copyTask->ppOutBufs, copyTask->uNumBufs);
 			if (DSP_FAILED(status)) {
 				fprintf(stdout, "DSPStream_FreeBuffer of output buffer failed."
 											" Status = 0x%x\n", (UINT)status);
@@ -546,15 +701,32 @@ static int CleanupProcessor(struct STRMCOPY_TASK *copyTask)
  *  output file handles.
  */
 static int ProcessArgs(int argc, char **argv, FILE **inFile,
-												FILE **outFile, INT *pStrmMode)
+				FILE **outFile, INT *pStrmMode, UINT *aBatch, UINT *pPasses)
 {
 	int status = -EPERM;
 	INT nModeVal;
-	if (argc != 4) {
+	char *pNext;
+	if (argc == 5) {
+		/* comma separated batch sizes */
+		pNext = argv[4];
+		while (*pPasses < MAXPASSES && *pNext) {
+			aBatch[*pPasses] = strtoul(pNext, &pNext, 0);
+			if (aBatch[*pPasses] == 0 || aBatch[*pPasses] > MAXBATCH) {
+				fprintf(stdout, "Batch sizes are 1 to %d.\n", MAXBATCH);
+				return (status);
+			}
+			(*pPasses)++;
+			if (*pNext == ',') {
+				pNext++;
+			}
+		}
+	}
+	if (argc != 4 && argc != 5) {
 		fprintf(stdout, "Usage: %s <stream transport id> <input-filename>"
-											"<output-filename> \n", argv[0]);
+							"<output-filename> [<batch sizes>]\n", argv[0]);
 		fprintf(stdout, " where <stream transport id> is :\n");
 		fprintf(stdout, "  0 - proc-copy, 1 - dsp-dma, 2 - zero-copy\n");
+		fprintf(stdout, " and <batch sizes> is a list like 1,4,16\n");
 	} else {
 		/* set stream mode */
 		nModeVal = atoi(argv[1]);
@@ -19,6 +19,11 @@
 #include <pthread.h>
 #include <time.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <sched.h>
+#include <fcntl.h>
 
 #include "mapinfo.h"
 
@@ -29,6 +34,7 @@ extern void *__real_calloc(int nmemb, int size);
 extern void __real_free(void *ptr);
 
 static mapinfo *milist;
+static mapinfo_table *mitable;
 
 #define MAX_BACKTRACE_DEPTH 15
 #define ALLOCATION_TAG      0x1ee7d00d
@@ -39,7 +45,18 @@ static mapinfo *milist;
 #define FRONT_GUARD_LEN     (1<<4)
 #define REAR_GUARD          0xbb
 #define REAR_GUARD_LEN      (1<<4)
-#define SCANNER_SLEEP_S     3
+#define SCANNER_SLEEP_S     3       /* shortest period of a scan round */
+#define SCAN_STEP           64      /* blocks checked per lock hold */
+#define SCAN_RATE           8192    /* default blocks checked per second */
+#define SCAN_IDLE_ROUNDS    4       /* default rounds per check of an unchanged shard */
+#define NUM_SHARDS          16      /* power of two */
+#define CACHE_LINE          64
+#define NUM_CALLSITES       4096    /* power of two */
+#define CALLSITE_PROBES     32
+#define PROFILE_TOP         20      /* call sites logged by a profile dump */
+#define PROFILE_SIGNAL      SIGUSR2
+
+struct callsite;
 
 struct hdr {
     uint32_t tag;
@@ -49,6 +66,7 @@ struct hdr {
     int bt_depth;
     intptr_t freed_bt[MAX_BACKTRACE_DEPTH];
     int freed_bt_depth;
+    struct callsite *site;
     size_t size;
     char front_guard[FRONT_GUARD_LEN];
 } __attribute__((packed));
@@ -86,34 +104,185 @@ void (*malloc_log)(const char *fmt, ...) = default_log;
 /* Call this ad dlclose() to get leaked memory */
 void free_leaked_memory(void);
 
-static unsigned num;
-static struct hdr *first;
-static struct hdr *last;
-static pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
+/*
+ * Live allocations are spread over shards picked by the header address,
+ * so threads allocating at the same time rarely meet on a lock and free
+ * finds the shard without a lookup.
+ *
+ * The scanner walks a shard a few blocks at a time from a cursor, which
+ * del() moves past the block it unlinks. gen counts the adds and dels, a
+ * shard still at the generation of its last complete scan is only checked
+ * every scan_idle_rounds rounds.
+ *
+ * That skip only pays off in a mostly idle process, under load every shard
+ * changes between rounds and is checked each time. It also delays reports:
+ * an overflow of a block in an unchanged shard shows up only after up to
+ * scan_idle_rounds rounds, each at least SCANNER_SLEEP_S long (12 s with
+ * the defaults). HEAPTRACKER_SCAN_IDLE_ROUNDS=1 checks every shard every
+ * round.
+ */
+struct shard {
+    pthread_rwlock_t lock;
+    unsigned num;
+    struct hdr *first;
+    struct hdr *last;
+    unsigned gen;
+    /* owned by the scanner */
+    struct hdr *cursor;
+    int scanning;
+    unsigned scan_gen;
+    unsigned scanned_gen;
+    unsigned idle_rounds;
+} __attribute__((aligned(CACHE_LINE)));
+
+static struct shard shards[NUM_SHARDS] = {
+    [0 ... NUM_SHARDS - 1] = { .lock = PTHREAD_RWLOCK_INITIALIZER },
+};
+
+/*
+ * Freed blocks wait in a ring before they are really freed, so use after
+ * free can be caught. A slot is claimed by exchanging a pointer into it;
+ * whoever gets a block out of a slot owns it.
+ */
+static struct hdr *volatile backlog[BACKLOG_MAX];
+static volatile unsigned backlog_head;
+
+/* HEAPTRACKER_SAMPLE=N in the environment unwinds 1 in N allocations only */
+static unsigned sample_rate = 1;
+static unsigned sample_tick;
+
+/*
+ * HEAPTRACKER_PROFILE=<prefix> aggregates the sampled allocations by
+ * backtrace. The table is dumped on PROFILE_SIGNAL and at exit, to the log
+ * and to <prefix>.<pid>.<n>.heap (pprof) and <prefix>.<pid>.<n>.folded (flame
+ * graph), n counting the dumps.
+ * Slots are claimed once and never reused; backtraces that do not fit are
+ * counted in callsite_overflow.
+ */
+enum { SITE_FREE, SITE_CLAIMED, SITE_READY };
+
+struct callsite {
+    volatile int state;
+    uint32_t hash;
+    int depth;
+    intptr_t bt[MAX_BACKTRACE_DEPTH];
+    volatile int live_count;
+    volatile size_t live_bytes;
+    volatile size_t peak_bytes;
+    volatile unsigned total_count;
+    volatile size_t total_bytes;    /* wraps after 4 GiB on 32 bit */
+};
+
+static struct callsite callsites[NUM_CALLSITES];
+static struct callsite callsite_overflow = { .state = SITE_READY };
+static const char *profile_path;
+static unsigned profile_seq;
+static volatile sig_atomic_t profile_requested;
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* HEAPTRACKER_SCAN_RATE=N in the environment checks N blocks per second */
+static unsigned scan_rate = SCAN_RATE;
+/* HEAPTRACKER_SCAN_IDLE_ROUNDS=N checks an unchanged shard every N rounds */
+static unsigned scan_idle_rounds = SCAN_IDLE_ROUNDS;
+
+static struct {
+    unsigned rounds;
+    unsigned long long checked;
+    unsigned long long skipped;     /* blocks of unchanged shards */
+    unsigned invalid;
+    unsigned last_round_ms;
+    unsigned shard;                 /* position in the current round */
+} scan_stats;
+
+static inline struct shard *to_shard(struct hdr *hdr)
+{
+    uintptr_t a = (uintptr_t)hdr;
+    return &shards[((a >> 4) ^ (a >> 12)) & (NUM_SHARDS - 1)];
+}
+
+static inline int sample(void)
+{
+    /* racy on purpose, a lost tick only moves the next sample */
+    return sample_rate == 1 || !(sample_tick++ % sample_rate);
+}
 
-static unsigned backlog_num;
-static struct hdr *backlog_first;
-static struct hdr *backlog_last;
-static pthread_rwlock_t backlog_lock = PTHREAD_RWLOCK_INITIALIZER;
+static void __print_backtrace(const mapinfo_table *table,
+                              const intptr_t *bt, int depth)
+{
+    const mapinfo *mi;
+    int cnt;
+    unsigned rel_pc;
+
+    malloc_log("*** *** *** *** *** *** *** *** *** *** *** *** *** *** *** ***\n");
+    if (!depth)
+        malloc_log("\t(not sampled, see HEAPTRACKER_SAMPLE)\n");
+    for (cnt = 0; cnt < depth && cnt < MAX_BACKTRACE_DEPTH; cnt++) {
+        mi = table_pc_to_mapinfo(table, bt[cnt], &rel_pc);
+        malloc_log("\t#%02d  pc %08x  %s\n", cnt,
+                   mi ? rel_pc : (unsigned)bt[cnt],
+                   mi ? mi->name : "(unknown)");
+    }
+}
 
 void print_backtrace(const intptr_t *bt, int depth)
 {
-    mapinfo *mi;
-    int cnt, rel_pc;
     intptr_t self_bt[MAX_BACKTRACE_DEPTH];
 
     if (!bt) {
         depth = heaptracker_stacktrace(self_bt, MAX_BACKTRACE_DEPTH);
         bt = self_bt;
     }
+    __print_backtrace(mitable, bt, depth);
+}
 
-    malloc_log("*** *** *** *** *** *** *** *** *** *** *** *** *** *** *** ***\n");
-    for (cnt = 0; cnt < depth && cnt < MAX_BACKTRACE_DEPTH; cnt++) {
-        mi = pc_to_mapinfo(milist, bt[cnt], &rel_pc);
-        malloc_log("\t#%02d  pc %08x  %s\n", cnt,
-                   mi ? rel_pc : bt[cnt],
-                   mi ? mi->name : "(unknown)");
+/* finds or claims the call site of a backtrace */
+static struct callsite *to_callsite(const intptr_t *bt, int depth)
+{
+    uint32_t hash = 2166136261u;
+    unsigned i;
+
+    for (i = 0; i < (unsigned)depth; i++)
+        hash = (hash ^ (uint32_t)bt[i]) * 16777619u;
+
+    for (i = 0; i < CALLSITE_PROBES; i++) {
+        struct callsite *site = &callsites[(hash + i) & (NUM_CALLSITES - 1)];
+
+        if (site->state == SITE_FREE &&
+            __sync_bool_compare_and_swap(&site->state, SITE_FREE, SITE_CLAIMED)) {
+            site->hash = hash;
+            site->depth = depth;
+            memcpy(site->bt, bt, depth * sizeof(intptr_t));
+            __sync_synchronize();
+            site->state = SITE_READY;
+            return site;
+        }
+        /* another thread is filling the slot in, it may be our site */
+        while (site->state == SITE_CLAIMED)
+            sched_yield();
+        if (site->hash == hash && site->depth == depth &&
+            !memcmp(site->bt, bt, depth * sizeof(intptr_t)))
+            return site;
     }
+    return &callsite_overflow;
+}
+
+static inline void account(struct callsite *site, size_t size)
+{
+    size_t live, peak;
+
+    live = __sync_add_and_fetch(&site->live_bytes, size);
+    __sync_fetch_and_add(&site->live_count, 1);
+    __sync_fetch_and_add(&site->total_count, 1);
+    __sync_fetch_and_add(&site->total_bytes, size);
+    while ((peak = site->peak_bytes) < live &&
+           !__sync_bool_compare_and_swap(&site->peak_bytes, peak, live))
+        ;
+}
+
+static inline void unaccount(struct callsite *site, size_t size)
+{
+    __sync_fetch_and_sub(&site->live_bytes, size);
+    __sync_fetch_and_sub(&site->live_count, 1);
 }
 
 static inline void init_front_guard(struct hdr *hdr)
@@ -185,28 +354,58 @@ static inline int __del(struct hdr *hdr, struct hdr **first, struct hdr **last)
 
 static inline void add(struct hdr *hdr, size_t size)
 {
-    pthread_rwlock_wrlock(&lock);
+    struct shard *shard = to_shard(hdr);
+
     hdr->tag = ALLOCATION_TAG;
     hdr->size = size;
+    hdr->freed_bt_depth = 0;
     init_front_guard(hdr);
     init_rear_guard(hdr);
-    num++;
-    __add(hdr, &first, &last);
-    pthread_rwlock_unlock(&lock);
+
+    if (hdr->site)
+        account(hdr->site, size);
+
+    pthread_rwlock_wrlock(&shard->lock);
+    shard->num++;
+    shard->gen++;
+    __add(hdr, &shard->first, &shard->last);
+    pthread_rwlock_unlock(&shard->lock);
+}
+
+/* called with the shard write locked before unlinking hdr */
+static inline void __unlink(struct shard *shard, struct hdr *hdr)
+{
+    if (shard->cursor == hdr)
+        shard->cursor = hdr->next;
+    shard->gen++;
 }
 
 static inline int del(struct hdr *hdr)
 {
+    struct shard *shard = to_shard(hdr);
+
     if (hdr->tag != ALLOCATION_TAG)
         return -1;
 
-    pthread_rwlock_wrlock(&lock);
-    __del(hdr, &first, &last);
-    num--;
-    pthread_rwlock_unlock(&lock);
+    pthread_rwlock_wrlock(&shard->lock);
+    __unlink(shard, hdr);
+    __del(hdr, &shard->first, &shard->last);
+    shard->num--;
+    pthread_rwlock_unlock(&shard->lock);
+
+    if (hdr->site)
+        unaccount(hdr->site, hdr->size);
     return 0;
 }
 
+static inline void record_backtrace(struct hdr *hdr)
+{
+    hdr->bt_depth = sample() ?
+                    heaptracker_stacktrace(hdr->bt, MAX_BACKTRACE_DEPTH) : 0;
+    hdr->site = profile_path && hdr->bt_depth ?
+                to_callsite(hdr->bt, hdr->bt_depth) : NULL;
+}
+
 static inline void poison(struct hdr *hdr)
 {
     memset(user(hdr), FREE_POISON, hdr->size);
@@ -301,47 +500,59 @@ static inline int __del_and_check(struct hdr *hdr,
     return valid;
 }
 
-static inline void __del_from_backlog(struct hdr *hdr)
+/* checks a block that left the backlog and really frees it */
+static inline void release_backlogged(struct hdr *hdr)
 {
-        int safe;
-        (void)__del_and_check(hdr,
-                              &backlog_first, &backlog_last, &backlog_num,
-                              &safe);
-        hdr->tag = 0; /* clear the tag */
+    int safe;
+
+    (void)__check_allocation(hdr, &safe);
+    hdr->tag = 0; /* clear the tag */
+    __real_free(hdr);
 }
 
-static inline void del_from_backlog(struct hdr *hdr)
+/* takes hdr back out of the backlog, returns 0 if it is not there */
+static int del_from_backlog(struct hdr *hdr)
 {
-    pthread_rwlock_wrlock(&backlog_lock);
-    __del_from_backlog(hdr);
-    pthread_rwlock_unlock(&backlog_lock);
+    unsigned i;
+    int safe;
+
+    for (i = 0; i < BACKLOG_MAX; i++) {
+        if (__sync_bool_compare_and_swap(&backlog[i], hdr, NULL)) {
+            (void)__check_allocation(hdr, &safe);
+            hdr->tag = 0; /* clear the tag */
+            return 1;
+        }
+    }
+    return 0;
 }
 
 static inline int del_leak(struct hdr *hdr, int *safe)
 {
+    struct shard *shard = to_shard(hdr);
     int valid;
-    pthread_rwlock_wrlock(&lock);
+
+    pthread_rwlock_wrlock(&shard->lock);
+    __unlink(shard, hdr);
     valid = __del_and_check(hdr,
-                            &first, &last, &num,
+                            &shard->first, &shard->last, &shard->num,
                             safe);
-    pthread_rwlock_unlock(&lock);
+    pthread_rwlock_unlock(&shard->lock);
     return valid;
 }
 
 static inline void add_to_backlog(struct hdr *hdr)
 {
-    pthread_rwlock_wrlock(&backlog_lock);
+    struct hdr *gone;
+    unsigned slot;
+
     hdr->tag = BACKLOG_TAG;
-    backlog_num++;
-    __add(hdr, &backlog_first, &backlog_last);
     poison(hdr);
-    /* If we've exceeded the maximum backlog, clear it up */
-    while (backlog_num > BACKLOG_MAX) {
-        struct hdr *gone = backlog_first;
-        __del_from_backlog(gone);
-        __real_free(gone);
-    }
-    pthread_rwlock_unlock(&backlog_lock);
+
+    /* the block freed BACKLOG_MAX frees ago makes room */
+    slot = __sync_fetch_and_add(&backlog_head, 1) % BACKLOG_MAX;
+    gone = __sync_lock_test_and_set(&backlog[slot], hdr);
+    if (gone)
+        release_backlogged(gone);
 }
 
 void* __wrap_malloc(size_t size)
@@ -350,8 +561,7 @@ void* __wrap_malloc(size_t size)
     struct hdr *hdr = __real_malloc(sizeof(struct hdr) + size +
                                     sizeof(struct ftr));
     if (hdr) {
-        hdr->bt_depth = heaptracker_stacktrace(
-                            hdr->bt, MAX_BACKTRACE_DEPTH);
+        record_backtrace(hdr);
         add(hdr, size);
         return user(hdr);
     }
@@ -393,8 +603,9 @@ void __wrap_free(void *ptr)
         }
     }
     else {
-        hdr->freed_bt_depth = heaptracker_stacktrace(hdr->freed_bt,
-                                      MAX_BACKTRACE_DEPTH);
+        /* only sampled allocations are worth a second unwind */
+        hdr->freed_bt_depth = hdr->bt_depth ?
+                              heaptracker_stacktrace(hdr->freed_bt, MAX_BACKTRACE_DEPTH) : 0;
         add_to_backlog(hdr);
     }
 }
@@ -436,7 +647,10 @@ void *__wrap_realloc(void *ptr, size_t size)
 	     * reallocation below succeeds.  Since we didn't really free it, we
 	     * can default to this behavior.
              */
-            del_from_backlog(hdr);
+            if (!del_from_backlog(hdr)) {
+                /* the backlog let go of it meanwhile, it may already be gone */
+                return __wrap_malloc(size);
+            }
         }
         else {
             malloc_log("+++ REALLOCATION %p SIZE %d IS CORRUPTED OR NOT ALLOCATED VIA TRACKER!\n",
@@ -450,7 +664,7 @@ void *__wrap_realloc(void *ptr, size_t size)
  
     hdr = __real_realloc(hdr, sizeof(struct hdr) + size + sizeof(struct ftr));
     if (hdr) {
-        hdr->bt_depth = heaptracker_stacktrace(hdr->bt, MAX_BACKTRACE_DEPTH);
+        record_backtrace(hdr);
         add(hdr, size);
         return user(hdr);
     }
@@ -465,8 +679,7 @@ void *__wrap_calloc(int nmemb, size_t size)
     size_t __size = nmemb * size;
     hdr = __real_calloc(1, sizeof(struct hdr) + __size + sizeof(struct ftr));
     if (hdr) {
-        hdr->bt_depth = heaptracker_stacktrace(
-                            hdr->bt, MAX_BACKTRACE_DEPTH);
+        record_backtrace(hdr);
         add(hdr, __size);
         return user(hdr);
     }
@@ -476,79 +689,384 @@ void *__wrap_calloc(int nmemb, size_t size)
 void heaptracker_free_leaked_memory(void)
 {
     struct hdr *del; int cnt;
+    unsigned i, num = 0;
 
+    for (i = 0; i < NUM_SHARDS; i++)
+        num += shards[i].num;
     if (num)
         malloc_log("+++ THERE ARE %d LEAKED ALLOCATIONS\n", num);
 
-    while (last) {
-        int safe;
-        del = last;
-        malloc_log("+++ DELETING %d BYTES OF LEAKED MEMORY AT %p (%d REMAINING)\n",
-                del->size, user(del), num);
-        if (del_leak(del, &safe)) {
-            /* safe == 1, because the allocation is valid */
-            malloc_log("+++ ALLOCATION %p SIZE %d ALLOCATED HERE:\n",
-                        user(del), del->size);
-            print_backtrace(del->bt, del->bt_depth);
+    for (i = 0; i < NUM_SHARDS; i++) {
+        struct shard *shard = &shards[i];
+
+        while (shard->last) {
+            int safe;
+            del = shard->last;
+            malloc_log("+++ DELETING %d BYTES OF LEAKED MEMORY AT %p (%d REMAINING)\n",
+                    del->size, user(del), num--);
+            if (del_leak(del, &safe)) {
+                /* safe == 1, because the allocation is valid */
+                malloc_log("+++ ALLOCATION %p SIZE %d ALLOCATED HERE:\n",
+                            user(del), del->size);
+                print_backtrace(del->bt, del->bt_depth);
+            }
+            __real_free(del);
+        }
+    }
+
+//  malloc_log("+++ DELETING BACKLOGGED ALLOCATIONS\n");
+    for (i = 0; i < BACKLOG_MAX; i++) {
+        del = __sync_lock_test_and_set(&backlog[i], NULL);
+        if (del)
+            release_backlogged(del);
+    }
+}
+
+/* checks up to *budget blocks of a shard, returns 1 once the shard is done */
+static int check_shard(struct shard *shard, unsigned *budget)
+{
+    int safe, done = 0;
+
+    pthread_rwlock_rdlock(&shard->lock);
+    if (!shard->scanning) {
+        if (shard->gen == shard->scanned_gen &&
+            ++shard->idle_rounds < scan_idle_rounds) {
+            scan_stats.skipped += shard->num;
+            pthread_rwlock_unlock(&shard->lock);
+            return 1;
         }
-        __real_free(del);
+        shard->idle_rounds = 0;
+        shard->scanning = 1;
+        shard->scan_gen = shard->gen;
+        shard->cursor = shard->last;
+    }
+
+    while (shard->cursor && *budget) {
+        if (!__check_allocation(shard->cursor, &safe))
+            scan_stats.invalid++;
+        shard->cursor = shard->cursor->next;
+        scan_stats.checked++;
+        (*budget)--;
     }
 
-//  malloc_log("+++ DELETING %d BACKLOGGED ALLOCATIONS\n", backlog_num);
-    while (backlog_last) {
-	del = backlog_first;
-        del_from_backlog(del);
-        __real_free(del);
+    if (!shard->cursor) {
+        shard->scanning = 0;
+        shard->scanned_gen = shard->scan_gen;
+        done = 1;
     }
+    pthread_rwlock_unlock(&shard->lock);
+
+    return done;
 }
 
-static int check_list(struct hdr *list, pthread_rwlock_t *rwlock)
+static int check_backlog(void)
 {
     struct hdr *hdr;
-    int safe, num_checked;
-
-    pthread_rwlock_rdlock(rwlock);
-    num_checked = 0;
-    hdr = list;
-    while (hdr) {
-        (void)__check_allocation(hdr, &safe);
-        hdr = hdr->next;
+    int safe, num_checked = 0;
+    unsigned i;
+
+    for (i = 0; i < BACKLOG_MAX; i++) {
+        /* own the block while checking it */
+        hdr = __sync_lock_test_and_set(&backlog[i], NULL);
+        if (!hdr)
+            continue;
+        if (!__check_allocation(hdr, &safe))
+            scan_stats.invalid++;
         num_checked++;
+        /* a free reused the slot meanwhile, this block is the oldest anyway */
+        if (!__sync_bool_compare_and_swap(&backlog[i], NULL, hdr)) {
+            hdr->tag = 0;
+            __real_free(hdr);
+        }
     }
-    pthread_rwlock_unlock(rwlock);
 
     return num_checked;
 }
 
+/* buffered output for the profile files, stdio would allocate */
+struct profile_file {
+    int fd;
+    size_t len;
+    char buf[4096];
+};
+
+static void profile_flush(struct profile_file *f)
+{
+    if (f->len)
+        (void)write(f->fd, f->buf, f->len);
+    f->len = 0;
+}
+
+static void profile_printf(struct profile_file *f, const char *fmt, ...)
+{
+    va_list lst;
+    int n;
+
+    va_start(lst, fmt);
+    n = vsnprintf(f->buf + f->len, sizeof(f->buf) - f->len, fmt, lst);
+    va_end(lst);
+    if (n >= 0 && f->len + n >= sizeof(f->buf) && f->len) {
+        /* retry into an empty buffer, longer lines are cut */
+        profile_flush(f);
+        va_start(lst, fmt);
+        n = vsnprintf(f->buf, sizeof(f->buf), fmt, lst);
+        va_end(lst);
+    }
+    if (n > 0)
+        f->len += (size_t)n < sizeof(f->buf) - f->len ?
+                  (size_t)n : sizeof(f->buf) - f->len - 1;
+}
+
+static int profile_open(struct profile_file *f, const char *suffix)
+{
+    char path[256];
+
+    snprintf(path, sizeof(path), "%s.%d.%u.%s", profile_path, getpid(),
+             profile_seq, suffix);
+    f->len = 0;
+    f->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (f->fd < 0)
+        malloc_log("+++ CANNOT WRITE HEAP PROFILE %s\n", path);
+    return f->fd;
+}
+
+static void profile_close(struct profile_file *f)
+{
+    profile_flush(f);
+    close(f->fd);
+}
+
+/* legacy text format of the gperftools heap profiler, read by pprof */
+static void write_pprof(struct callsite **sites, unsigned num,
+                        int live_count, size_t live_bytes,
+                        unsigned total_count, size_t total_bytes)
+{
+    struct profile_file f;
+    unsigned i;
+    int j, fd;
+    ssize_t n;
+
+    if (profile_open(&f, "heap") < 0)
+        return;
+
+    profile_printf(&f, "heap profile: %6d: %8u [%6u: %8u] @ heapprofile\n",
+                   live_count, live_bytes, total_count, total_bytes);
+    for (i = 0; i < num; i++) {
+        if (sites[i] == &callsite_overflow)
+            continue;
+        profile_printf(&f, "%6d: %8u [%6u: %8u] @",
+                       sites[i]->live_count, sites[i]->live_bytes,
+                       sites[i]->total_count, sites[i]->total_bytes);
+        for (j = 0; j < sites[i]->depth; j++)
+            profile_printf(&f, " 0x%08x", (unsigned)sites[i]->bt[j]);
+        profile_printf(&f, "\n");
+    }
+
+    profile_printf(&f, "\nMAPPED_LIBRARIES:\n");
+    profile_flush(&f);
+    fd = open("/proc/self/maps", O_RDONLY);
+    if (fd >= 0) {
+        while ((n = read(fd, f.buf, sizeof(f.buf))) > 0)
+            (void)write(f.fd, f.buf, n);
+        close(fd);
+    }
+    profile_close(&f);
+}
+
+/* one line per call site with live memory, outermost frame first */
+static void write_folded(struct callsite **sites, unsigned num,
+                         const mapinfo_table *table)
+{
+    struct profile_file f;
+    const mapinfo *mi;
+    const char *name;
+    unsigned i, rel_pc;
+    int j;
+
+    if (profile_open(&f, "folded") < 0)
+        return;
+
+    for (i = 0; i < num; i++) {
+        if (sites[i] == &callsite_overflow || !sites[i]->live_bytes)
+            continue;
+        for (j = sites[i]->depth - 1; j >= 0; j--) {
+            mi = table_pc_to_mapinfo(table, sites[i]->bt[j], &rel_pc);
+            if (mi) {
+                name = strrchr(mi->name, '/');
+                profile_printf(&f, "%s+0x%x;", name ? name + 1 : mi->name, rel_pc);
+            } else
+                profile_printf(&f, "0x%08x;", rel_pc);
+        }
+        if (f.len)
+            f.len--; /* the last separator */
+        profile_printf(&f, " %u\n", sites[i]->live_bytes);
+    }
+    profile_close(&f);
+}
+
+static int compare_live_bytes(const void *a, const void *b)
+{
+    size_t la = (*(struct callsite * const *)a)->live_bytes;
+    size_t lb = (*(struct callsite * const *)b)->live_bytes;
+    return la > lb ? -1 : la < lb;
+}
+
+/* Call this to dump the call site profile, see HEAPTRACKER_PROFILE */
+void heaptracker_dump_profile(void)
+{
+    struct callsite **sorted;
+    mapinfo *mi;
+    mapinfo_table *table;
+    unsigned i, num = 0, total_count = 0;
+    size_t live_bytes = 0, total_bytes = 0;
+    int live_count = 0;
+
+    if (!profile_path)
+        return;
+
+    sorted = __real_malloc((NUM_CALLSITES + 1) * sizeof(*sorted));
+    if (!sorted)
+        return;
+
+    pthread_mutex_lock(&profile_lock);
+
+    /* the counters keep moving, the report is only as exact as a sample */
+    for (i = 0; i < NUM_CALLSITES; i++)
+        if (callsites[i].state == SITE_READY)
+            sorted[num++] = &callsites[i];
+    if (callsite_overflow.total_count)
+        sorted[num++] = &callsite_overflow;
+    qsort(sorted, num, sizeof(*sorted), compare_live_bytes);
+
+    for (i = 0; i < num; i++) {
+        live_count += sorted[i]->live_count;
+        live_bytes += sorted[i]->live_bytes;
+        total_count += sorted[i]->total_count;
+        total_bytes += sorted[i]->total_bytes;
+    }
+
+    /* libraries may have been loaded since init */
+    mi = init_mapinfo(getpid());
+    table = init_mapinfo_table(mi);
+
+    malloc_log("+++ HEAP PROFILE: %d BYTES IN %d LIVE ALLOCATIONS FROM %u CALL SITES "\
+               "(1 IN %u ALLOCATIONS SAMPLED)\n",
+               live_bytes, live_count, num, sample_rate);
+    for (i = 0; i < num && i < PROFILE_TOP && sorted[i]->live_bytes; i++) {
+        struct callsite *site = sorted[i];
+
+        malloc_log("+++ %d BYTES IN %d LIVE ALLOCATIONS (PEAK %d BYTES, %u TOTAL) %s\n",
+                   site->live_bytes, site->live_count, site->peak_bytes,
+                   site->total_count,
+                   site == &callsite_overflow ? "FROM CALL SITES NOT TRACKED (TABLE FULL)" :
+                                                "ALLOCATED HERE:");
+        if (site != &callsite_overflow)
+            __print_backtrace(table, site->bt, site->depth);
+    }
+
+    write_pprof(sorted, num, live_count, live_bytes, total_count, total_bytes);
+    write_folded(sorted, num, table);
+    profile_seq++;
+
+    deinit_mapinfo_table(table);
+    deinit_mapinfo(mi);
+    pthread_mutex_unlock(&profile_lock);
+    __real_free(sorted);
+}
+
+static void profile_signal(int sig __attribute__((unused)))
+{
+    /* the scanner dumps, nothing here may allocate */
+    profile_requested = 1;
+}
+
+/* Call this to log how far the scanner got */
+void heaptracker_dump_scan_stats(void)
+{
+    malloc_log("+++ SCANNER: %u ROUNDS, %llu BLOCKS CHECKED, %llu SKIPPED UNCHANGED, "\
+               "%u INVALID, LAST ROUND %u MS, AT SHARD %u/%d, %u BLOCKS/S, "\
+               "IDLE SHARDS EVERY %u ROUNDS\n",
+               scan_stats.rounds, scan_stats.checked, scan_stats.skipped,
+               scan_stats.invalid, scan_stats.last_round_ms,
+               scan_stats.shard, NUM_SHARDS, scan_rate, scan_idle_rounds);
+}
+
 static pthread_t scanner_thread;
 static pthread_cond_t scanner_cond = PTHREAD_COND_INITIALIZER;
 static int scanner_stop;
 static pthread_mutex_t scanner_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static void* scanner(void *data __attribute__((unused)))
+static inline long long now_ms(void)
 {
     struct timespec ts;
-    int num_checked, num_checked_backlog;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* returns 1 if the scanner was asked to stop */
+static int scanner_wait(long long ns)
+{
+    struct timespec ts;
+    int stop;
+
+    pthread_mutex_lock(&scanner_lock);
+    if (!scanner_stop && ns > 0) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ns += ts.tv_nsec;
+        ts.tv_sec += ns / 1000000000LL;
+        ts.tv_nsec = ns % 1000000000LL;
+        pthread_cond_timedwait(&scanner_cond, &scanner_lock, &ts);
+    }
+    stop = scanner_stop;
+    pthread_mutex_unlock(&scanner_lock);
+    return stop;
+}
+
+/*
+ * Checks SCAN_STEP blocks at a time and sleeps in between so that no more
+ * than scan_rate blocks are checked per second. A round covers the shards
+ * then the backlog and lasts at least SCANNER_SLEEP_S.
+ */
+static void* scanner(void *data __attribute__((unused)))
+{
+    long long round_start = now_ms(), wait_ns, left_ns;
+    unsigned budget, checked;
+    int round_done;
 
     while (1) {
-        num_checked = check_list(last, &lock);
-        num_checked_backlog = check_list(backlog_last, &backlog_lock);
-
-//      malloc_log("@@@ scanned %d/%d allocs and %d/%d freed\n",
-//                 num_checked, num,
-//                 num_checked_backlog, backlog_num);
-
-        pthread_mutex_lock(&scanner_lock);
-        if (!scanner_stop) {
-            clock_gettime(CLOCK_REALTIME, &ts);
-            ts.tv_sec += SCANNER_SLEEP_S;
-            pthread_cond_timedwait(&scanner_cond, &scanner_lock, &ts);
+        budget = SCAN_STEP;
+        round_done = 0;
+
+        while (budget && !round_done) {
+            if (!check_shard(&shards[scan_stats.shard], &budget))
+                continue;
+            if (++scan_stats.shard < NUM_SHARDS)
+                continue;
+
+            checked = check_backlog();
+            budget = checked < budget ? budget - checked : 0;
+            scan_stats.shard = 0;
+            scan_stats.rounds++;
+            scan_stats.last_round_ms = now_ms() - round_start;
+            round_done = 1;
         }
-        if (scanner_stop) {
-            pthread_mutex_unlock(&scanner_lock);
-            break;
+
+        if (profile_requested) {
+            profile_requested = 0;
+            heaptracker_dump_scan_stats();
+            heaptracker_dump_profile();
         }
-        pthread_mutex_unlock(&scanner_lock);
+
+        wait_ns = (SCAN_STEP - budget) * 1000000000LL / scan_rate;
+        if (round_done) {
+            left_ns = (round_start + SCANNER_SLEEP_S * 1000LL - now_ms()) * 1000000LL;
+            if (left_ns > wait_ns)
+                wait_ns = left_ns;
+        }
+        if (scanner_wait(wait_ns))
+            break;
+        if (round_done)
+            round_start = now_ms();
     }
 
 //  malloc_log("@@@ scanner thread exiting");
@@ -558,8 +1076,32 @@ static void* scanner(void *data __attribute__((unused)))
 static void init(void) __attribute__((constructor));
 static void init(void)
 {
+    const char *rate = getenv("HEAPTRACKER_SAMPLE");
+
+    if (rate && atoi(rate) > 1)
+        sample_rate = atoi(rate);
+
+    rate = getenv("HEAPTRACKER_SCAN_RATE");
+    if (rate && atoi(rate) > 0)
+        scan_rate = atoi(rate);
+
+    rate = getenv("HEAPTRACKER_SCAN_IDLE_ROUNDS");
+    if (rate && atoi(rate) > 0)
+        scan_idle_rounds = atoi(rate);
+
+    profile_path = getenv("HEAPTRACKER_PROFILE");
+    if (profile_path) {
+        struct sigaction sa;
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = profile_signal;
+        sa.sa_flags = SA_RESTART;
+        sigaction(PROFILE_SIGNAL, &sa, NULL);
+    }
+
 //  malloc_log("@@@ start scanner thread");
     milist = init_mapinfo(getpid());
+    mitable = init_mapinfo_table(milist);
     pthread_create(&scanner_thread,
                    NULL,
                    scanner,
@@ -578,6 +1120,8 @@ static void deinit(void)
     pthread_join(scanner_thread, NULL);
 //  malloc_log("@@@ scanner thread stopped");
 
+    heaptracker_dump_profile();
     heaptracker_free_leaked_memory();
+    deinit_mapinfo_table(mitable);
     deinit_mapinfo(milist);
 }
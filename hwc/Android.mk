@@ -8,7 +8,7 @@ LOCAL_PRELINK_MODULE := false
 LOCAL_ARM_MODE := arm
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/../vendor/lib/hw
 LOCAL_SHARED_LIBRARIES := liblog libEGL libcutils libutils libhardware libhardware_legacy
-LOCAL_SRC_FILES := hwc.c
+LOCAL_SRC_FILES := hwc.c hwc_trace.c
 
 LOCAL_MODULE_TAGS := optional
 
@@ -19,3 +19,25 @@ LOCAL_CFLAGS := -DLOG_TAG=\"ti_hwc\"
 # LOCAL_CFLAGS += -DLOG_NDEBUG=0
 
 include $(BUILD_SHARED_LIBRARY)
+
+# decoder for traces saved through debug.hwc.trace_file
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := hwctrace.c hwc_trace.c
+LOCAL_MODULE := hwctrace
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# host simulator replaying layer lists through hwc.c, see hwcsim.c
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := hwcsim.c hwc_trace.c
+LOCAL_C_INCLUDES := \
+	$(TOP)/hardware/libhardware/include \
+	$(TOP)/hardware/libhardware_legacy/include \
+	$(TOP)/frameworks/native/opengl/include \
+	$(TOP)/bionic/libc/kernel/common
+LOCAL_CFLAGS := -DLOG_TAG=\"ti_hwc\"
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := hwcsim
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
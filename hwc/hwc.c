@@ -48,8 +48,10 @@
 #include <video/dsscomp.h>
 
 #include "hal_public.h"
+#include "hwc_trace.h"
 
 #define MAX_HW_OVERLAYS 3
+#define MAX_PLANNED_LAYERS 16
 #define NUM_NONSCALING_OVERLAYS 1
 #define HAL_PIXEL_FORMAT_BGRX_8888		0x1FF
 #define HAL_PIXEL_FORMAT_TI_NV12 0x100
@@ -105,6 +107,47 @@ enum {
     EXT_HFLIP       = (1 << 2), /* flip l-r on output (after rotation) */
 };
 
+/* what prepare looks at in a layer, apart from the buffer itself */
+struct omap3_hwc_layer_sig {
+    int format;
+    int width;
+    int height;
+    int usage;                          /* protected and external display bits */
+    hwc_rect_t crop;
+    hwc_rect_t frame;
+    uint32_t transform;
+    int32_t blending;
+    uint32_t flags;
+};
+
+/* composition plan of the last prepare, reused while the layer list keeps its geometry */
+struct omap3_hwc_plan {
+    int valid;
+    unsigned int num_layers;
+    struct omap3_hwc_layer_sig sig[MAX_PLANNED_LAYERS];
+
+    /* device state the plan was made in */
+    int last_ext_ovls;
+    int last_int_ovls;
+    int hdmi_enabled;
+    int tv_enabled;
+
+    /* results besides dsscomp_data, which set() leaves untouched */
+    int composition_type[MAX_PLANNED_LAYERS];
+    int clear_fb[MAX_PLANNED_LAYERS];
+    int buffer_layer[MAX_HW_OVERLAYS];  /* layer posted in buffers[i], -1 for the fb */
+    int use_sgx;
+    int swap_rb;
+    int force_sgx;
+    int ovls_blending;
+    int ext_ovls;
+    int ext_ovls_wanted;
+    unsigned int post2_layers;
+
+    unsigned int hits;
+    unsigned int misses;
+};
+
 struct omap3_hwc_module {
     hwc_module_t base;
 
@@ -143,6 +186,11 @@ struct omap3_hwc_device {
     int ovls_blending;
 
     int force_sgx;
+
+    int plan_cache;
+    struct omap3_hwc_plan plan;
+
+    struct hwc_trace_ring trace;
 };
 typedef struct omap3_hwc_device omap3_hwc_device_t;
 
@@ -929,6 +977,185 @@ static inline int display_area(struct dss2_ovl_info *o)
     return o->cfg.win.w * o->cfg.win.h;
 }
 
+static int omap3_hwc_plan_cacheable(omap3_hwc_device_t *hwc_dev, hwc_layer_list_t *list)
+{
+    omap3_hwc_ext_t *ext = &hwc_dev->ext;
+
+    /* cloning sets up HDMI modes and matrices while planning, always redo it */
+    return hwc_dev->plan_cache && list &&
+           list->numHwLayers <= MAX_PLANNED_LAYERS &&
+           !ext->mirror.enabled && !ext->dock.enabled && !ext->current.enabled;
+}
+
+static void omap3_hwc_layer_signature(hwc_layer_list_t *list, struct omap3_hwc_layer_sig *sig)
+{
+    unsigned int i;
+
+    /* compared with memcmp, clear the padding too */
+    memset(sig, 0, list->numHwLayers * sizeof(*sig));
+
+    for (i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_t *layer = &list->hwLayers[i];
+        IMG_native_handle_t *handle = (IMG_native_handle_t *)layer->handle;
+
+        if (handle) {
+            sig[i].format = handle->iFormat;
+            sig[i].width = handle->iWidth;
+            sig[i].height = handle->iHeight;
+            sig[i].usage = handle->usage & (GRALLOC_USAGE_PROTECTED | GRALLOC_USAGE_EXTERNAL_DISP);
+        } else {
+            sig[i].format = -1;
+        }
+        sig[i].crop = layer->sourceCrop;
+        sig[i].frame = layer->displayFrame;
+        sig[i].transform = layer->transform;
+        sig[i].blending = layer->blending;
+        sig[i].flags = layer->flags;
+    }
+}
+
+/* called with the device lock held */
+static int omap3_hwc_reuse_plan(omap3_hwc_device_t *hwc_dev, hwc_layer_list_t *list)
+{
+    struct omap3_hwc_plan *plan = &hwc_dev->plan;
+    struct omap3_hwc_layer_sig sig[MAX_PLANNED_LAYERS];
+    unsigned int i;
+
+    if (!plan->valid ||
+        plan->num_layers != list->numHwLayers ||
+        plan->last_ext_ovls != hwc_dev->last_ext_ovls ||
+        plan->last_int_ovls != hwc_dev->last_int_ovls ||
+        plan->hdmi_enabled != hdmi_enabled ||
+        plan->tv_enabled != tv_enabled)
+        return 0;
+
+    omap3_hwc_layer_signature(list, sig);
+    if (memcmp(sig, plan->sig, list->numHwLayers * sizeof(*sig)))
+        return 0;
+
+    /* same geometry: keep the overlay configs, only the buffers changed */
+    for (i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_t *layer = &list->hwLayers[i];
+
+        layer->compositionType = plan->composition_type[i];
+        if (plan->clear_fb[i])
+            layer->hints |= HWC_HINT_CLEAR_FB;
+    }
+
+    for (i = 0; i < plan->post2_layers; i++)
+        hwc_dev->buffers[i] = plan->buffer_layer[i] < 0 ? NULL :
+                              list->hwLayers[plan->buffer_layer[i]].handle;
+
+    hwc_dev->use_sgx = plan->use_sgx;
+    hwc_dev->swap_rb = plan->swap_rb;
+    hwc_dev->force_sgx = plan->force_sgx;
+    hwc_dev->ovls_blending = plan->ovls_blending;
+    hwc_dev->ext_ovls = plan->ext_ovls;
+    hwc_dev->ext_ovls_wanted = plan->ext_ovls_wanted;
+    hwc_dev->post2_layers = plan->post2_layers;
+
+    return 1;
+}
+
+/* called with the device lock held, after a full prepare */
+static void omap3_hwc_save_plan(omap3_hwc_device_t *hwc_dev, hwc_layer_list_t *list)
+{
+    struct omap3_hwc_plan *plan = &hwc_dev->plan;
+    unsigned int i;
+
+    plan->num_layers = list->numHwLayers;
+    omap3_hwc_layer_signature(list, plan->sig);
+
+    plan->last_ext_ovls = hwc_dev->last_ext_ovls;
+    plan->last_int_ovls = hwc_dev->last_int_ovls;
+    plan->hdmi_enabled = hdmi_enabled;
+    plan->tv_enabled = tv_enabled;
+
+    for (i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_t *layer = &list->hwLayers[i];
+
+        plan->composition_type[i] = layer->compositionType;
+        plan->clear_fb[i] = layer->compositionType == HWC_OVERLAY &&
+                            (layer->hints & HWC_HINT_CLEAR_FB);
+    }
+
+    plan->use_sgx = hwc_dev->use_sgx;
+    plan->swap_rb = hwc_dev->swap_rb;
+    plan->force_sgx = hwc_dev->force_sgx;
+    plan->ovls_blending = hwc_dev->ovls_blending;
+    plan->ext_ovls = hwc_dev->ext_ovls;
+    plan->ext_ovls_wanted = hwc_dev->ext_ovls_wanted;
+    plan->post2_layers = hwc_dev->post2_layers;
+    plan->valid = 1;
+}
+
+static inline struct hwc_trace_rect trace_rect(hwc_rect_t r)
+{
+    struct hwc_trace_rect t = { r.left, r.top, r.right, r.bottom };
+    return t;
+}
+
+/* records prepare or set into the trace ring, called with the lock held */
+static void omap3_hwc_trace(omap3_hwc_device_t *hwc_dev, int type, hwc_layer_list_t *list,
+                            nsecs_t start, int flags)
+{
+    struct dsscomp_setup_dispc_data *dsscomp = &hwc_dev->dsscomp_data;
+    struct hwc_trace_event *ev = hwc_trace_begin(&hwc_dev->trace, type);
+    unsigned int i;
+
+    ev->flags = flags;
+    if (hwc_dev->use_sgx)
+        ev->flags |= HWC_TRACE_SGX;
+    if (hwc_dev->swap_rb)
+        ev->flags |= HWC_TRACE_SWAP_RB;
+    ev->sync_id = dsscomp->sync_id;
+    ev->timestamp_ns = start;
+    ev->num_layers = list ? min(list->numHwLayers, 255u) : 0;
+    for (i = 0; i < ev->num_layers && i < HWC_TRACE_LAYERS; i++) {
+        hwc_layer_t *layer = &list->hwLayers[i];
+        IMG_native_handle_t *handle = (IMG_native_handle_t *)layer->handle;
+        struct hwc_trace_layer *l = &ev->layers[i];
+
+        memset(l, 0, sizeof(*l));
+        l->composition = layer->compositionType;
+        l->hints = layer->hints;
+        l->flags = layer->flags;
+        l->transform = layer->transform;
+        l->blending = layer->blending;
+        l->crop = trace_rect(layer->sourceCrop);
+        l->frame = trace_rect(layer->displayFrame);
+        if ((layer->flags & HWC_SKIP_LAYER) || !handle)
+            continue;
+        l->handle = (uint32_t)(uintptr_t)handle;
+        l->format = handle->iFormat;
+        l->usage = handle->usage;
+        l->width = handle->iWidth;
+        l->height = handle->iHeight;
+    }
+    ev->num_ovls = min(dsscomp->num_ovls, (__u8)HWC_TRACE_OVLS);
+    for (i = 0; i < ev->num_ovls; i++) {
+        struct dss2_ovl_info *oi = &dsscomp->ovls[i];
+        struct hwc_trace_ovl *o = &ev->ovls[i];
+
+        o->ix = oi->cfg.ix;
+        o->zorder = oi->cfg.zorder;
+        o->enabled = oi->cfg.enabled;
+        o->mgr_ix = oi->cfg.mgr_ix;
+        o->color_mode = oi->cfg.color_mode;
+        o->ba = oi->ba;
+        o->width = oi->cfg.width;
+        o->height = oi->cfg.height;
+    }
+    ev->duration_ns = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    hwc_trace_commit(&hwc_dev->trace, ev);
+
+    if (debug) {
+        char buf[1024];
+        hwc_trace_format_event(buf, sizeof(buf), ev);
+        ALOGD("%s", buf);
+    }
+}
+
 static int omap3_hwc_prepare(struct hwc_composer_device *dev, hwc_layer_list_t* list)
 {
     omap3_hwc_device_t *hwc_dev = (omap3_hwc_device_t *)dev;
@@ -936,8 +1163,22 @@ static int omap3_hwc_prepare(struct hwc_composer_device *dev, hwc_layer_list_t*
     struct counts num = { .composited_layers = list ? list->numHwLayers : 0 };
     unsigned int i, ix;
     int num_fb = 0;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
 
     pthread_mutex_lock(&hwc_dev->lock);
+
+    if (omap3_hwc_plan_cacheable(hwc_dev, list)) {
+        if (omap3_hwc_reuse_plan(hwc_dev, list)) {
+            hwc_dev->plan.hits++;
+            dsscomp->sync_id = sync_id++;
+            omap3_hwc_trace(hwc_dev, HWC_TRACE_PREPARE, list, start, HWC_TRACE_PLAN_REUSED);
+            pthread_mutex_unlock(&hwc_dev->lock);
+            return 0;
+        }
+        hwc_dev->plan.misses++;
+    }
+    hwc_dev->plan.valid = 0;
+
     memset(dsscomp, 0x0, sizeof(*dsscomp));
     dsscomp->sync_id = sync_id++;
 	hwc_dev->force_sgx = 1; //Always all UI layers have to go to SGX for composition in OMAP3.
@@ -1058,6 +1299,7 @@ static int omap3_hwc_prepare(struct hwc_composer_device *dev, hwc_layer_list_t*
                 hwc_dev->ovls_blending = 1;
 
             hwc_dev->buffers[dsscomp->num_ovls] = handle;
+            hwc_dev->plan.buffer_layer[dsscomp->num_ovls] = i;
 
             omap3_hwc_setup_layer(hwc_dev,
                                   &dsscomp->ovls[dsscomp->num_ovls],
@@ -1120,6 +1362,7 @@ static int omap3_hwc_prepare(struct hwc_composer_device *dev, hwc_layer_list_t*
         }
 
         hwc_dev->buffers[0] = NULL;
+        hwc_dev->plan.buffer_layer[0] = -1;
         omap3_hwc_setup_layer_base(&dsscomp->ovls[0].cfg, fb_z,
                                    hwc_dev->fb_dev->base.format,
                                    1,   /* FB is always premultiplied */
@@ -1236,6 +1479,12 @@ static int omap3_hwc_prepare(struct hwc_composer_device *dev, hwc_layer_list_t*
         dsscomp->mgrs[1].ix = 1;
         dsscomp->num_mgrs++;
     }
+
+    if (omap3_hwc_plan_cacheable(hwc_dev, list))
+        omap3_hwc_save_plan(hwc_dev, list);
+
+    omap3_hwc_trace(hwc_dev, HWC_TRACE_PREPARE, list, start, 0);
+
     pthread_mutex_unlock(&hwc_dev->lock);
     return 0;
 }
@@ -1274,8 +1523,8 @@ static int omap3_hwc_set(struct hwc_composer_device *dev, hwc_display_t dpy,
     omap3_hwc_device_t *hwc_dev = (omap3_hwc_device_t *)dev;
     struct dsscomp_setup_dispc_data *dsscomp = &hwc_dev->dsscomp_data;
     int err = 0;
-    unsigned int i;
     int invalidate;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
 
     pthread_mutex_lock(&hwc_dev->lock);
 
@@ -1283,63 +1532,6 @@ static int omap3_hwc_set(struct hwc_composer_device *dev, hwc_display_t dpy,
 
     invalidate = hwc_dev->ext_ovls_wanted && !hwc_dev->ext_ovls;
 
-    char big_log[1024];
-    int e = sizeof(big_log);
-    char *end = big_log + e;
-    e -= snprintf(end - e, e, "set H{");
-    for (i = 0; list && i < list->numHwLayers; i++) {
-        if (i)
-            e -= snprintf(end - e, e, " ");
-        hwc_layer_t *layer = &list->hwLayers[i];
-        IMG_native_handle_t *handle = (IMG_native_handle_t *)layer->handle;
-        e -= snprintf(end - e, e, "%p:%s,", handle, layer->compositionType == HWC_OVERLAY ? "DSS" : "SGX");
-        if ((layer->flags & HWC_SKIP_LAYER) || !handle) {
-            e -= snprintf(end - e, e, "SKIP");
-            continue;
-        }
-        if (layer->flags & HWC_HINT_CLEAR_FB)
-            e -= snprintf(end - e, e, "CLR,");
-#define FMT(f) ((f) == HAL_PIXEL_FORMAT_TI_NV12 ? "NV12" : \
-                (f) == HAL_PIXEL_FORMAT_BGRX_8888 ? "xRGB32" : \
-                (f) == HAL_PIXEL_FORMAT_RGBX_8888 ? "xBGR32" : \
-                (f) == HAL_PIXEL_FORMAT_BGRA_8888 ? "ARGB32" : \
-                (f) == HAL_PIXEL_FORMAT_RGBA_8888 ? "ABGR32" : \
-                (f) == HAL_PIXEL_FORMAT_RGB_565 ? "RGB565" : "??")
-        e -= snprintf(end - e, e, "%d*%d(%s)", handle->iWidth, handle->iHeight, FMT(handle->iFormat));
-        if (layer->transform)
-            e -= snprintf(end - e, e, "~%d", layer->transform);
-#undef FMT
-    }
-    e -= snprintf(end - e, e, "} D{");
-    for (i = 0; i < dsscomp->num_ovls; i++) {
-        if (i)
-            e -= snprintf(end - e, e, " ");
-        e -= snprintf(end - e, e, "%d=", dsscomp->ovls[i].cfg.ix);
-#define FMT(f) ((f) == OMAP_DSS_COLOR_NV12 ? "NV12" : \
-                (f) == OMAP_DSS_COLOR_RGB24U ? "xRGB32" : \
-                (f) == OMAP_DSS_COLOR_ARGB32 ? "ARGB32" : \
-                (f) == OMAP_DSS_COLOR_RGB16 ? "RGB565" : "??")
-        if (dsscomp->ovls[i].cfg.enabled)
-            e -= snprintf(end - e, e, "%08x:%d*%d,%s",
-                          dsscomp->ovls[i].ba,
-                          dsscomp->ovls[i].cfg.width,
-                          dsscomp->ovls[i].cfg.height,
-                          FMT(dsscomp->ovls[i].cfg.color_mode));
-#undef FMT
-        else
-            e -= snprintf(end - e, e, "-");
-    }
-    e -= snprintf(end - e, e, "} L{");
-    for (i = 0; i < hwc_dev->post2_layers; i++) {
-        if (i)
-            e -= snprintf(end - e, e, " ");
-        e -= snprintf(end - e, e, "%p", hwc_dev->buffers[i]);
-    }
-    e -= snprintf(end - e, e, "}%s\n", hwc_dev->use_sgx ? " swap" : "");
-    if (debug) {
-        ALOGD("%s", big_log);
-    }
-
     // ALOGD("set %d layers (sgx=%d)\n", dsscomp->num_ovls, hwc_dev->use_sgx);
 
     if (dpy && sur) {
@@ -1383,6 +1575,7 @@ static int omap3_hwc_set(struct hwc_composer_device *dev, hwc_display_t dpy,
         ALOGE("Post2 error");
 
 err_out:
+    omap3_hwc_trace(hwc_dev, HWC_TRACE_SET, list, start, err ? HWC_TRACE_ERROR : 0);
     pthread_mutex_unlock(&hwc_dev->lock);
 
     if (invalidate && hwc_dev->procs && hwc_dev->procs->invalidate)
@@ -1397,6 +1590,10 @@ static int dump_printf(char *buff, int buff_len, int len, const char *fmt, ...)
 
     int print_len;
 
+    /* nothing more fits once the buffer is full */
+    if (len >= buff_len)
+        return len;
+
     va_start(ap, fmt);
 
     print_len = vsnprintf(buff + len, buff_len - len, fmt, ap);
@@ -1406,6 +1603,64 @@ static int dump_printf(char *buff, int buff_len, int len, const char *fmt, ...)
     return len + print_len;
 }
 
+/* saves the trace ring for hwctrace, if debug.hwc.trace_file names a file */
+static void omap3_hwc_save_trace(struct hwc_trace_event *events, unsigned int count,
+                                 const uint32_t hist[2][HWC_TRACE_BUCKETS])
+{
+    struct hwc_trace_file_header hdr = {
+        .magic = HWC_TRACE_MAGIC,
+        .version = HWC_TRACE_VERSION,
+        .event_size = sizeof(*events),
+        .num_events = count,
+    };
+    char path[PROPERTY_VALUE_MAX];
+    int fd;
+
+    property_get("debug.hwc.trace_file", path, "");
+    if (!path[0])
+        return;
+
+    memcpy(hdr.hist, hist, sizeof(hdr.hist));
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ALOGW("failed to open %s (%d)", path, errno);
+        return;
+    }
+    if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        write(fd, events, count * sizeof(*events)) != (ssize_t)(count * sizeof(*events)))
+        ALOGW("failed to write %s (%d)", path, errno);
+    close(fd);
+}
+
+#define DUMP_TRACE_EVENTS 16
+
+static int omap3_hwc_dump_trace(omap3_hwc_device_t *hwc_dev, char *buff, int buff_len, int len)
+{
+    struct hwc_trace_event *events = malloc(HWC_TRACE_EVENTS * sizeof(*events));
+    uint32_t hist[2][HWC_TRACE_BUCKETS];
+    unsigned int i, count;
+
+    if (!events)
+        return len;
+
+    memcpy(hist, hwc_dev->trace.hist, sizeof(hist));
+    count = hwc_trace_snapshot(&hwc_dev->trace, events, HWC_TRACE_EVENTS);
+    omap3_hwc_save_trace(events, count, hist);
+
+    len = dump_printf(buff, buff_len, len, "  trace: %u events\n", hwc_dev->trace.head);
+    if (len < buff_len)
+        len += hwc_trace_format_hist(buff + len, buff_len - len, hist);
+    for (i = count > DUMP_TRACE_EVENTS ? count - DUMP_TRACE_EVENTS : 0; i < count && len < buff_len; i++) {
+        len = dump_printf(buff, buff_len, len, "    ");
+        if (len < buff_len)
+            len += hwc_trace_format_event(buff + len, buff_len - len, &events[i]);
+        len = dump_printf(buff, buff_len, len, "\n");
+    }
+
+    free(events);
+    return len;
+}
+
 static void omap3_hwc_dump(struct hwc_composer_device *dev, char *buff, int buff_len)
 {
     omap3_hwc_device_t *hwc_dev = (omap3_hwc_device_t *)dev;
@@ -1415,6 +1670,9 @@ static void omap3_hwc_dump(struct hwc_composer_device *dev, char *buff, int buff
 
     len = dump_printf(buff, buff_len, len, "omap3_hwc %d:\n", dsscomp->num_ovls);
     len = dump_printf(buff, buff_len, len, "  idle timeout: %dms\n", hwc_dev->idle);
+    len = dump_printf(buff, buff_len, len, "  plan cache: %s, %u reused, %u replanned\n",
+                      hwc_dev->plan_cache ? "on" : "off",
+                      hwc_dev->plan.hits, hwc_dev->plan.misses);
 
     for (i = 0; i < dsscomp->num_ovls; i++) {
         struct dss2_ovl_cfg *cfg = &dsscomp->ovls[i].cfg;
@@ -1431,6 +1689,8 @@ static void omap3_hwc_dump(struct hwc_composer_device *dev, char *buff, int buff
         len = dump_printf(buff, buff_len, len, "     ix: %d\n", cfg->ix);
         len = dump_printf(buff, buff_len, len, "     zorder: %d\n\n", cfg->zorder);
     }
+
+    omap3_hwc_dump_trace(hwc_dev, buff, buff_len, len);
 }
 
 
@@ -1487,6 +1747,7 @@ static void handle_hotplug(omap3_hwc_device_t *hwc_dev, int state)
 
     pthread_mutex_lock(&hwc_dev->lock);
     ext->dock.enabled = ext->mirror.enabled = 0;
+    hwc_dev->plan.valid = 0;
 
     if (state == 1) { /* hdmi panel enable */
 	hdmi_enabled = 1;
@@ -1729,6 +1990,8 @@ static int omap3_hwc_device_open(const hw_module_t* module, const char* name,
     hwc_dev->flags_nv12_only = atoi(value);
     property_get("debug.hwc.idle", value, "250");
     hwc_dev->idle = atoi(value);
+    property_get("debug.hwc.plan_cache", value, "1");
+    hwc_dev->plan_cache = atoi(value);
 
     /* get the board specific clone properties */
     /* 0:0:1280:720 */
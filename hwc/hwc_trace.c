@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hwc_trace.h"
+
+/* values of the gralloc and DSS formats, kept here so hwctrace builds on the host */
+#define FMT_RGBA_8888       1
+#define FMT_RGBX_8888       2
+#define FMT_RGB_565         4
+#define FMT_BGRA_8888       5
+#define FMT_YUV_420         19
+#define FMT_YUV_422         27
+#define FMT_TI_NV12         0x100
+#define FMT_TI_NV12_PADDED  0x101
+#define FMT_BGRX_8888       0x1FF
+
+#define DSS_COLOR_RGB16     (1 << 4)
+#define DSS_COLOR_RGB24U    (1 << 5)
+#define DSS_COLOR_UYVY      (1 << 11)
+#define DSS_COLOR_ARGB32    (1 << 12)
+#define DSS_COLOR_NV12      (1 << 14)
+
+/* from hwcomposer.h */
+#define COMP_OVERLAY        1
+#define HINT_CLEAR_FB       0x2
+
+/* from gralloc.h */
+#define USAGE_EXTERNAL_DISP 0x00002000
+#define USAGE_PROTECTED     0x00004000
+
+struct hwc_trace_event *hwc_trace_begin(struct hwc_trace_ring *ring, int type)
+{
+    uint32_t n = __sync_fetch_and_add(&ring->head, 1);
+    struct hwc_trace_event *ev = &ring->events[n & (HWC_TRACE_EVENTS - 1)];
+
+    ev->seq = 2 * n + 1;
+    __sync_synchronize();
+    ev->type = type;
+    return ev;
+}
+
+void hwc_trace_commit(struct hwc_trace_ring *ring, struct hwc_trace_event *ev)
+{
+    int bucket = hwc_trace_bucket(ev->duration_ns);
+
+    if (ev->type == HWC_TRACE_PREPARE || ev->type == HWC_TRACE_SET)
+        ring->hist[ev->type - HWC_TRACE_PREPARE][bucket]++;
+
+    __sync_synchronize();
+    ev->seq++;
+}
+
+unsigned int hwc_trace_snapshot(struct hwc_trace_ring *ring,
+                                struct hwc_trace_event *out, unsigned int max)
+{
+    uint32_t head = ring->head;
+    uint32_t first = head > HWC_TRACE_EVENTS ? head - HWC_TRACE_EVENTS : 0;
+    unsigned int count = 0;
+    uint32_t n;
+
+    if (head - first > max)
+        first = head - max;
+
+    for (n = first; n != head; n++) {
+        struct hwc_trace_event *ev = &ring->events[n & (HWC_TRACE_EVENTS - 1)];
+        uint32_t seq = ev->seq;
+
+        __sync_synchronize();
+        memcpy(&out[count], ev, sizeof(*ev));
+        __sync_synchronize();
+
+        /* skip events being written or already overwritten */
+        if (seq != 2 * n + 2 || ev->seq != seq)
+            continue;
+        count++;
+    }
+
+    return count;
+}
+
+int hwc_trace_bucket(uint32_t duration_ns)
+{
+    uint32_t us = duration_ns / 1000;
+    int bucket = 0;
+
+    while (us && bucket < HWC_TRACE_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static const char *format_name(int format)
+{
+    switch (format) {
+    case FMT_TI_NV12:
+    case FMT_TI_NV12_PADDED:
+        return "NV12";
+    case FMT_BGRX_8888:     return "xRGB32";
+    case FMT_RGBX_8888:     return "xBGR32";
+    case FMT_BGRA_8888:     return "ARGB32";
+    case FMT_RGBA_8888:     return "ABGR32";
+    case FMT_RGB_565:       return "RGB565";
+    case FMT_YUV_422:
+    case FMT_YUV_420:
+        return "UYVY";
+    default:                return "??";
+    }
+}
+
+static const char *color_mode_name(uint32_t mode)
+{
+    switch (mode) {
+    case DSS_COLOR_NV12:    return "NV12";
+    case DSS_COLOR_RGB24U:  return "xRGB32";
+    case DSS_COLOR_ARGB32:  return "ARGB32";
+    case DSS_COLOR_RGB16:   return "RGB565";
+    case DSS_COLOR_UYVY:    return "UYVY";
+    default:                return "??";
+    }
+}
+
+#define APPEND(...) \
+    do { \
+        int __n = snprintf(buf + (pos < len ? pos : len), pos < len ? len - pos : 0, __VA_ARGS__); \
+        if (__n > 0) \
+            pos += __n; \
+    } while (0)
+
+int hwc_trace_format_event(char *buf, size_t len, const struct hwc_trace_event *ev)
+{
+    size_t pos = 0;
+    unsigned int i, layers = ev->num_layers;
+
+    if (layers > HWC_TRACE_LAYERS)
+        layers = HWC_TRACE_LAYERS;
+
+    APPEND("%lld.%06lld [%08x] %s %u.%03uus%s%s%s H{",
+           (long long) (ev->timestamp_ns / 1000000000LL),
+           (long long) (ev->timestamp_ns % 1000000000LL) / 1000,
+           ev->sync_id, ev->type == HWC_TRACE_PREPARE ? "prepare" : "set",
+           ev->duration_ns / 1000, ev->duration_ns % 1000,
+           ev->flags & HWC_TRACE_PLAN_REUSED ? " reused" : "",
+           ev->flags & HWC_TRACE_SWAP_RB ? " swap_rb" : "",
+           ev->flags & HWC_TRACE_ERROR ? " ERROR" : "");
+
+    for (i = 0; i < layers; i++) {
+        const struct hwc_trace_layer *l = &ev->layers[i];
+
+        APPEND("%s%08x:%s,", i ? " " : "", l->handle,
+               l->composition == COMP_OVERLAY ? "DSS" : "SGX");
+        if (!l->handle) {
+            APPEND("SKIP");
+            continue;
+        }
+        if (l->hints & HINT_CLEAR_FB)
+            APPEND("CLR,");
+        if (l->usage & USAGE_PROTECTED)
+            APPEND("PROT,");
+        if (l->usage & USAGE_EXTERNAL_DISP)
+            APPEND("EXT,");
+        APPEND("%d*%d(%s)", l->width, l->height, format_name(l->format));
+        if (l->transform)
+            APPEND("~%d", l->transform);
+        APPEND(" [%d,%d,%d,%d]=>[%d,%d,%d,%d]",
+               l->crop.left, l->crop.top, l->crop.right, l->crop.bottom,
+               l->frame.left, l->frame.top, l->frame.right, l->frame.bottom);
+    }
+    if (ev->num_layers > layers)
+        APPEND(" +%d", ev->num_layers - layers);
+
+    APPEND("} D{");
+    for (i = 0; i < ev->num_ovls && i < HWC_TRACE_OVLS; i++) {
+        const struct hwc_trace_ovl *o = &ev->ovls[i];
+
+        APPEND("%s%d=", i ? " " : "", o->ix);
+        if (o->enabled)
+            APPEND("%08x:%d*%d,%s,z%d", o->ba, o->width, o->height,
+                   color_mode_name(o->color_mode), o->zorder);
+        else
+            APPEND("-");
+    }
+    APPEND("}%s", ev->flags & HWC_TRACE_SGX ? " SGX" : "");
+
+    return pos;
+}
+
+int hwc_trace_format_hist(char *buf, size_t len,
+                          const uint32_t hist[2][HWC_TRACE_BUCKETS])
+{
+    static const char *names[2] = { "prepare", "set" };
+    size_t pos = 0;
+    int t, b;
+
+    for (t = 0; t < 2; t++) {
+        APPEND("  %s latency:", names[t]);
+        for (b = 0; b < HWC_TRACE_BUCKETS; b++) {
+            if (!hist[t][b])
+                continue;
+            if (b)
+                APPEND(" <%uus:%u", 1u << b, hist[t][b]);
+            else
+                APPEND(" <1us:%u", hist[t][b]);
+        }
+        APPEND("\n");
+    }
+
+    return pos;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HWC_TRACE_H
+#define HWC_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary trace of the composer. prepare() and set() each record one fixed
+ * size event into a ring; text is only produced when the ring is dumped,
+ * either by the HAL's dump() or by hwctrace from a saved trace file.
+ */
+
+#define HWC_TRACE_MAGIC     0x54435748      /* "HWCT" */
+#define HWC_TRACE_VERSION   2
+
+#define HWC_TRACE_EVENTS    128             /* power of two */
+#define HWC_TRACE_LAYERS    8               /* layers recorded per event */
+#define HWC_TRACE_OVLS      4
+#define HWC_TRACE_BUCKETS   16              /* log2 microsecond buckets */
+
+enum {
+    HWC_TRACE_PREPARE = 1,
+    HWC_TRACE_SET,
+};
+
+/* event flags */
+enum {
+    HWC_TRACE_SGX         = 1 << 0,         /* SGX composes part of the frame */
+    HWC_TRACE_PLAN_REUSED = 1 << 1,         /* prepare kept the previous plan */
+    HWC_TRACE_SWAP_RB     = 1 << 2,
+    HWC_TRACE_ERROR       = 1 << 3,         /* set failed */
+};
+
+struct hwc_trace_rect {
+    int16_t left, top, right, bottom;
+};
+
+struct hwc_trace_layer {
+    uint32_t handle;                        /* low bits of the buffer handle */
+    int32_t format;
+    uint16_t width;
+    uint16_t height;
+    struct hwc_trace_rect crop;
+    struct hwc_trace_rect frame;
+    uint32_t flags;
+    uint32_t usage;                         /* gralloc usage of the buffer */
+    uint16_t blending;
+    uint8_t transform;
+    uint8_t composition;                    /* HWC_FRAMEBUFFER or HWC_OVERLAY */
+    uint8_t hints;
+    uint8_t pad[3];
+};
+
+struct hwc_trace_ovl {
+    uint32_t color_mode;
+    uint32_t ba;
+    uint16_t width;
+    uint16_t height;
+    uint8_t ix;
+    uint8_t zorder;
+    uint8_t enabled;
+    uint8_t mgr_ix;
+};
+
+struct hwc_trace_event {
+    uint32_t seq;                           /* odd while the event is written */
+    uint8_t type;
+    uint8_t flags;
+    uint8_t num_layers;                     /* total, only the first HWC_TRACE_LAYERS are kept */
+    uint8_t num_ovls;
+    uint32_t sync_id;
+    uint32_t duration_ns;
+    int64_t timestamp_ns;                   /* monotonic, at entry */
+    struct hwc_trace_layer layers[HWC_TRACE_LAYERS];
+    struct hwc_trace_ovl ovls[HWC_TRACE_OVLS];
+};
+
+struct hwc_trace_ring {
+    volatile uint32_t head;                 /* events ever recorded */
+    uint32_t hist[2][HWC_TRACE_BUCKETS];    /* prepare, set latency */
+    struct hwc_trace_event events[HWC_TRACE_EVENTS];
+};
+
+/* layout of a saved trace: header, then num_events events oldest first */
+struct hwc_trace_file_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t event_size;
+    uint32_t num_events;
+    uint32_t hist[2][HWC_TRACE_BUCKETS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* claims the next slot, fill it then call hwc_trace_commit() */
+struct hwc_trace_event *hwc_trace_begin(struct hwc_trace_ring *ring, int type);
+void hwc_trace_commit(struct hwc_trace_ring *ring, struct hwc_trace_event *ev);
+
+/* copies out up to max consistent events, oldest first; returns the count */
+unsigned int hwc_trace_snapshot(struct hwc_trace_ring *ring,
+                                struct hwc_trace_event *out, unsigned int max);
+
+int hwc_trace_bucket(uint32_t duration_ns);
+
+/* text decoders, return the number of characters written like snprintf */
+int hwc_trace_format_event(char *buf, size_t len, const struct hwc_trace_event *ev);
+int hwc_trace_format_hist(char *buf, size_t len,
+                          const uint32_t hist[2][HWC_TRACE_BUCKETS]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HWC_TRACE_H */
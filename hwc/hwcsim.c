@@ -0,0 +1,789 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host simulator for hwcomposer.omap3.
+ *
+ * Builds hwc.c against a stubbed framebuffer HAL, dsscomp driver, EGL and
+ * uevent layer, then replays layer lists through prepare() and set(). It
+ * reports prepare/set throughput and which layers went to DSS or SGX, and
+ * fails when the routing differs from what the input expects.
+ *
+ * usage: hwcsim [options] <scenario file>
+ *        hwcsim [options] -t <trace file>
+ *
+ *   -t         input is a trace saved through debug.hwc.trace_file; the
+ *              recorded routing of each prepare is the expectation
+ *   -r N       replay the input N times
+ *   -p key=val set a property, e.g. -p debug.hwc.plan_cache=0
+ *   -v         print the routing of every frame
+ *   -d         print the composer's dump() at the end; with
+ *              -p debug.hwc.trace_file=<file> this also saves a trace
+ *
+ * Scenario files describe frames, one directive per line:
+ *
+ *   display 800 480                 LCD size, before the first frame
+ *   frame [count]                   start a frame, repeated count times
+ *   layer <format> <w>x<h> [options]
+ *       crop=l,t,r,b frame=l,t,r,b  default to the whole buffer
+ *       tr=N blend=none|premult|coverage skip protected clear
+ *   expect DSS|SGX ...              expected routing of the frame's layers
+ *   hotplug N                       switch state, as sent by the uevent
+ *
+ * Formats are NV12, NV12P, UYVY, YUV420, RGB565, RGBA, RGBX, BGRA and BGRX.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include <cutils/properties.h>
+#include <cutils/log.h>
+#include <hardware/hardware.h>
+#include <hardware/hwcomposer.h>
+#include <EGL/egl.h>
+#include <hardware_legacy/uevent.h>
+#include <video/dsscomp.h>
+
+#include "hal_public.h"
+
+/* route the composer's system interfaces to the simulator */
+static int sim_open(const char *path, int flags, ...);
+static int sim_ioctl(int fd, int req, ...);
+static int sim_pipe(int fds[2]);
+static int sim_system(const char *cmd);
+static int sim_pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                              void *(*fn)(void *), void *arg);
+static int sim_property_get(const char *key, char *value, const char *default_value);
+
+#define open(...) sim_open(__VA_ARGS__)
+#define ioctl(...) sim_ioctl(__VA_ARGS__)
+#define pipe(...) sim_pipe(__VA_ARGS__)
+#define system(...) sim_system(__VA_ARGS__)
+#define pthread_create(...) sim_pthread_create(__VA_ARGS__)
+#define property_get(...) sim_property_get(__VA_ARGS__)
+
+#include "hwc.c"
+
+#undef open
+#undef ioctl
+#undef pipe
+#undef system
+#undef pthread_create
+#undef property_get
+
+#define SIM_MAX_LAYERS      16
+#define SIM_MAX_PROPS       16
+#define SIM_BUFFERS         3           /* buffers cycled per layer */
+
+/* ---------------------------------------------------------------------------
+ * stubbed system
+ */
+
+static struct {
+    int dsscomp_fd;
+    int fb_fd;
+    unsigned int xres, yres;
+
+    unsigned int dispc_setups;
+    unsigned int posts;
+    unsigned int post_errors;
+    unsigned int swaps;
+    unsigned int ovls_posted;
+} sim = {
+    .dsscomp_fd = -1,
+    .fb_fd = -1,
+    .xres = 800,
+    .yres = 480,
+};
+
+static struct {
+    char key[PROPERTY_KEY_MAX];
+    char value[PROPERTY_VALUE_MAX];
+} props[SIM_MAX_PROPS];
+static int num_props;
+
+static int sim_property_get(const char *key, char *value, const char *default_value)
+{
+    int i;
+
+    for (i = 0; i < num_props; i++) {
+        if (!strcmp(props[i].key, key)) {
+            strcpy(value, props[i].value);
+            return strlen(value);
+        }
+    }
+
+    strcpy(value, default_value ? default_value : "");
+    return strlen(value);
+}
+
+static int sim_open(const char *path, int flags, ...)
+{
+    va_list ap;
+    int mode;
+
+    /* device nodes are backed by /dev/null, their ioctls are simulated */
+    if (!strcmp(path, "/dev/dsscomp"))
+        return sim.dsscomp_fd = open("/dev/null", O_RDWR);
+    if (!strcmp(path, "/dev/graphics/fb0"))
+        return sim.fb_fd = open("/dev/null", O_RDWR);
+    if (!strncmp(path, "/sys/", 5)) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    va_start(ap, flags);
+    mode = va_arg(ap, int);
+    va_end(ap);
+    return open(path, flags, mode);
+}
+
+static int sim_ioctl(int fd, int req, ...)
+{
+    va_list ap;
+    void *arg;
+
+    va_start(ap, req);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if (fd == sim.dsscomp_fd && req == (int)DSSCIOC_QUERY_DISPLAY) {
+        struct dsscomp_display_info *dis = arg;
+
+        /* only the LCD is connected, with a 24MHz pixel clock */
+        dis->timings.x_res = sim.xres;
+        dis->timings.y_res = sim.yres;
+        dis->timings.pixel_clock = 24000;
+        dis->width_in_mm = 154;
+        dis->height_in_mm = 86;
+        dis->modedb_len = 0;
+        return 0;
+    }
+    if (fd == sim.dsscomp_fd && req == (int)DSSCIOC_SETUP_DISPC) {
+        sim.dispc_setups++;
+        return 0;
+    }
+    if (fd == sim.dsscomp_fd || fd == sim.fb_fd)
+        return 0;
+
+    errno = ENOTTY;
+    return -1;
+}
+
+static int sim_pipe(int fds[2])
+{
+    /* nobody reads the event pipe, it must not block set() */
+    if (pipe(fds))
+        return -1;
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    return 0;
+}
+
+static int sim_system(const char *cmd)
+{
+    (void) cmd;
+    return 0;
+}
+
+static int sim_pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                              void *(*fn)(void *), void *arg)
+{
+    /* hotplug events come from the input, not from a uevent thread */
+    (void) thread; (void) attr; (void) fn; (void) arg;
+    return 0;
+}
+
+int uevent_init()
+{
+    return 1;
+}
+
+int uevent_get_fd()
+{
+    return -1;
+}
+
+int uevent_next_event(char *buffer, int buffer_length)
+{
+    (void) buffer; (void) buffer_length;
+    return 0;
+}
+
+EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
+{
+    (void) dpy; (void) surface;
+    sim.swaps++;
+    return EGL_TRUE;
+}
+
+static int sim_post2(framebuffer_device_t *fb, buffer_handle_t *buffers,
+                     int num_buffers, void *data, int data_length)
+{
+    struct dsscomp_setup_dispc_data *d = data;
+    unsigned int i;
+
+    (void) fb; (void) buffers;
+    sim.posts++;
+
+    if (data_length != sizeof(*d) || num_buffers > MAX_HW_OVERLAYS) {
+        sim.post_errors++;
+        return -EINVAL;
+    }
+
+    for (i = 0; i < d->num_ovls; i++) {
+        struct dss2_ovl_info *oi = &d->ovls[i];
+
+        if (!oi->cfg.enabled)
+            continue;
+        /* overlays reference the buffers by index, NULL is the framebuffer */
+        if (oi->addressing == OMAP_DSS_BUFADDR_LAYER_IX && oi->ba >= (__u32)num_buffers) {
+            sim.post_errors++;
+            return -EINVAL;
+        }
+        sim.ovls_posted++;
+    }
+    return 0;
+}
+
+static IMG_framebuffer_device_public_t sim_fb;
+static IMG_gralloc_module_public_t sim_gralloc;
+
+int hw_get_module(const char *id, const struct hw_module_t **module)
+{
+    if (strcmp(id, GRALLOC_HARDWARE_MODULE_ID))
+        return -ENOENT;
+
+    /* the gralloc HAL fills these in when it opens the framebuffer */
+    *(uint32_t *)&sim_fb.base.width = sim.xres;
+    *(uint32_t *)&sim_fb.base.height = sim.yres;
+    *(int *)&sim_fb.base.format = HAL_PIXEL_FORMAT_BGRA_8888;
+    sim_fb.Post2 = sim_post2;
+
+    sim_gralloc.base.common.author = "Imagination Technologies";
+    sim_gralloc.psFrameBufferDevice = &sim_fb;
+
+    *module = &sim_gralloc.base.common;
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * input
+ */
+
+enum {
+    ROUTE_ANY = 0,
+    ROUTE_DSS,
+    ROUTE_SGX,
+};
+
+struct sim_layer {
+    int format;
+    int width;
+    int height;
+    int usage;
+    hwc_rect_t crop;
+    hwc_rect_t frame;
+    uint32_t transform;
+    int32_t blending;
+    uint32_t flags;
+    uint32_t hints;
+    int expect;
+    IMG_native_handle_t *handles[SIM_BUFFERS];
+};
+
+struct sim_frame {
+    unsigned int count;
+    int hotplug;                        /* -1 if none */
+    unsigned int num_layers;
+    struct sim_layer layers[SIM_MAX_LAYERS];
+};
+
+static struct sim_frame *frames;
+static unsigned int num_frames;
+
+static const struct {
+    const char *name;
+    int format;
+} formats[] = {
+    { "NV12",   HAL_PIXEL_FORMAT_TI_NV12 },
+    { "NV12P",  HAL_PIXEL_FORMAT_TI_NV12_PADDED },
+    { "UYVY",   HAL_PIXEL_FORMAT_YUV_422 },
+    { "YUV420", HAL_PIXEL_FORMAT_YUV_420 },
+    { "RGB565", HAL_PIXEL_FORMAT_RGB_565 },
+    { "RGBA",   HAL_PIXEL_FORMAT_RGBA_8888 },
+    { "RGBX",   HAL_PIXEL_FORMAT_RGBX_8888 },
+    { "BGRA",   HAL_PIXEL_FORMAT_BGRA_8888 },
+    { "BGRX",   HAL_PIXEL_FORMAT_BGRX_8888 },
+};
+
+static int parse_format(const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(formats) / sizeof(*formats); i++)
+        if (!strcasecmp(formats[i].name, name))
+            return formats[i].format;
+    return -1;
+}
+
+static int parse_rect(const char *s, hwc_rect_t *r)
+{
+    return sscanf(s, "%d,%d,%d,%d", &r->left, &r->top, &r->right, &r->bottom) == 4 ? 0 : -1;
+}
+
+static struct sim_frame *new_frame(unsigned int count)
+{
+    struct sim_frame *f;
+
+    f = realloc(frames, (num_frames + 1) * sizeof(*frames));
+    if (!f) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    frames = f;
+    f = &frames[num_frames++];
+    memset(f, 0, sizeof(*f));
+    f->count = count;
+    f->hotplug = -1;
+    return f;
+}
+
+static int parse_layer(char *args, struct sim_layer *l)
+{
+    char *tok = strtok(args, " \t");
+
+    memset(l, 0, sizeof(*l));
+    l->blending = HWC_BLENDING_NONE;
+
+    if (!tok || (l->format = parse_format(tok)) < 0)
+        return -1;
+    tok = strtok(NULL, " \t");
+    if (!tok || sscanf(tok, "%dx%d", &l->width, &l->height) != 2)
+        return -1;
+
+    l->crop.right = l->frame.right = l->width;
+    l->crop.bottom = l->frame.bottom = l->height;
+
+    while ((tok = strtok(NULL, " \t"))) {
+        if (!strncmp(tok, "crop=", 5)) {
+            if (parse_rect(tok + 5, &l->crop))
+                return -1;
+        } else if (!strncmp(tok, "frame=", 6)) {
+            if (parse_rect(tok + 6, &l->frame))
+                return -1;
+        } else if (!strncmp(tok, "tr=", 3)) {
+            l->transform = atoi(tok + 3);
+        } else if (!strcmp(tok, "blend=none")) {
+            l->blending = HWC_BLENDING_NONE;
+        } else if (!strcmp(tok, "blend=premult")) {
+            l->blending = HWC_BLENDING_PREMULT;
+        } else if (!strcmp(tok, "blend=coverage")) {
+            l->blending = HWC_BLENDING_COVERAGE;
+        } else if (!strcmp(tok, "skip")) {
+            l->flags |= HWC_SKIP_LAYER;
+        } else if (!strcmp(tok, "protected")) {
+            l->usage |= GRALLOC_USAGE_PROTECTED;
+        } else if (!strcmp(tok, "clear")) {
+            l->hints |= HWC_HINT_CLEAR_FB;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int parse_expect(char *args, struct sim_frame *f)
+{
+    unsigned int i = 0;
+    char *tok;
+
+    for (tok = strtok(args, " \t"); tok; tok = strtok(NULL, " \t"), i++) {
+        if (i >= f->num_layers)
+            return -1;
+        if (!strcasecmp(tok, "DSS"))
+            f->layers[i].expect = ROUTE_DSS;
+        else if (!strcasecmp(tok, "SGX"))
+            f->layers[i].expect = ROUTE_SGX;
+        else if (strcmp(tok, "-"))
+            return -1;
+    }
+    return 0;
+}
+
+static int load_scenario(const char *path)
+{
+    struct sim_frame *f = NULL;
+    char line[512];
+    int lineno = 0;
+    FILE *fp;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        char *cmd, *args, *p;
+        int err = 0;
+
+        lineno++;
+        if ((p = strchr(line, '#')))
+            *p = '\0';
+        cmd = strtok(line, " \t\r\n");
+        if (!cmd)
+            continue;
+        args = strtok(NULL, "\r\n");
+        if (!args)
+            args = "";
+
+        if (!strcmp(cmd, "display")) {
+            err = num_frames || sscanf(args, "%u %u", &sim.xres, &sim.yres) != 2;
+        } else if (!strcmp(cmd, "frame")) {
+            int count = *args ? atoi(args) : 1;
+            f = new_frame(count > 0 ? count : 1);
+        } else if (!strcmp(cmd, "hotplug")) {
+            f = new_frame(0);
+            f->hotplug = atoi(args);
+            f = NULL;
+        } else if (!strcmp(cmd, "layer")) {
+            err = !f || f->num_layers >= SIM_MAX_LAYERS ||
+                  parse_layer(args, &f->layers[f->num_layers++]);
+        } else if (!strcmp(cmd, "expect")) {
+            err = !f || parse_expect(args, f);
+        } else {
+            err = 1;
+        }
+
+        if (err) {
+            fprintf(stderr, "%s:%d: cannot parse '%s'\n", path, lineno, cmd);
+            fclose(fp);
+            return -1;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static hwc_rect_t rect_from_trace(struct hwc_trace_rect r)
+{
+    hwc_rect_t rect = { r.left, r.top, r.right, r.bottom };
+    return rect;
+}
+
+/* replays the layer lists a device handed to prepare, expecting the routing it got */
+static int load_trace(const char *path)
+{
+    struct hwc_trace_file_header hdr;
+    struct hwc_trace_event ev;
+    unsigned int i, j;
+    FILE *fp;
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != HWC_TRACE_MAGIC ||
+        hdr.version != HWC_TRACE_VERSION || hdr.event_size != sizeof(ev)) {
+        fprintf(stderr, "%s: not a supported composer trace\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    for (i = 0; i < hdr.num_events && fread(&ev, sizeof(ev), 1, fp) == 1; i++) {
+        struct sim_frame *f;
+
+        /* frames with more layers than the trace keeps cannot be rebuilt */
+        if (ev.type != HWC_TRACE_PREPARE || ev.num_layers > HWC_TRACE_LAYERS)
+            continue;
+
+        f = new_frame(1);
+        f->num_layers = ev.num_layers;
+        for (j = 0; j < ev.num_layers; j++) {
+            struct hwc_trace_layer *t = &ev.layers[j];
+            struct sim_layer *l = &f->layers[j];
+
+            l->format = t->format;
+            l->width = t->width;
+            l->height = t->height;
+            l->crop = rect_from_trace(t->crop);
+            l->frame = rect_from_trace(t->frame);
+            l->transform = t->transform;
+            l->blending = t->blending;
+            l->flags = t->flags;
+            l->usage = t->usage;
+            if (!t->handle)
+                l->flags |= HWC_SKIP_LAYER;
+            l->expect = t->composition == HWC_OVERLAY ? ROUTE_DSS : ROUTE_SGX;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static IMG_native_handle_t *sim_handle(struct sim_layer *l, unsigned int n)
+{
+    IMG_native_handle_t **h = &l->handles[n % SIM_BUFFERS];
+
+    if (l->flags & HWC_SKIP_LAYER)
+        return NULL;
+
+    if (!*h) {
+        *h = calloc(1, sizeof(**h));
+        if (!*h) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        (*h)->base.version = sizeof(native_handle_t);
+        (*h)->base.numFds = IMG_NATIVE_HANDLE_NUMFDS;
+        (*h)->base.numInts = IMG_NATIVE_HANDLE_NUMINTS;
+        (*h)->iWidth = l->width;
+        (*h)->iHeight = l->height;
+        (*h)->iFormat = l->format;
+        (*h)->usage = l->usage;
+        (*h)->uiBpp = is_NV12(l->format) ? 8 : l->format == HAL_PIXEL_FORMAT_RGB_565 ? 16 : 32;
+    }
+    return *h;
+}
+
+/* ---------------------------------------------------------------------------
+ * replay
+ */
+
+static struct {
+    unsigned int frames;
+    unsigned int layers;
+    unsigned int dss_layers;
+    unsigned int sgx_layers;
+    unsigned int all_dss_frames;
+    unsigned int sgx_frames;
+    unsigned int mismatches;
+    int64_t prepare_ns, prepare_max_ns;
+    int64_t set_ns, set_max_ns;
+} stats;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int replay_frame(hwc_composer_device_t *dev, hwc_layer_list_t *list,
+                        struct sim_frame *f, unsigned int n, int verbose)
+{
+    omap3_hwc_device_t *hwc_dev = (omap3_hwc_device_t *)dev;
+    char routing[SIM_MAX_LAYERS * 5 + 1];
+    int64_t t0, t1, t2;
+    unsigned int i;
+    int mismatch = 0, err;
+
+    list->flags = HWC_GEOMETRY_CHANGED;
+    list->numHwLayers = f->num_layers;
+    for (i = 0; i < f->num_layers; i++) {
+        struct sim_layer *l = &f->layers[i];
+        hwc_layer_t *layer = &list->hwLayers[i];
+
+        memset(layer, 0, sizeof(*layer));
+        layer->compositionType = HWC_FRAMEBUFFER;
+        layer->hints = l->hints;
+        layer->flags = l->flags;
+        layer->handle = (buffer_handle_t)sim_handle(l, n);
+        layer->transform = l->transform;
+        layer->blending = l->blending;
+        layer->sourceCrop = l->crop;
+        layer->displayFrame = l->frame;
+        layer->visibleRegionScreen.numRects = 1;
+        layer->visibleRegionScreen.rects = &layer->displayFrame;
+    }
+
+    t0 = now_ns();
+    dev->prepare(dev, list);
+    t1 = now_ns();
+    err = dev->set(dev, (hwc_display_t)1, (hwc_surface_t)1, list);
+    t2 = now_ns();
+
+    stats.frames++;
+    stats.prepare_ns += t1 - t0;
+    stats.set_ns += t2 - t1;
+    if (t1 - t0 > stats.prepare_max_ns)
+        stats.prepare_max_ns = t1 - t0;
+    if (t2 - t1 > stats.set_max_ns)
+        stats.set_max_ns = t2 - t1;
+
+    routing[0] = '\0';
+    for (i = 0; i < f->num_layers; i++) {
+        int dss = list->hwLayers[i].compositionType == HWC_OVERLAY;
+
+        stats.layers++;
+        if (dss)
+            stats.dss_layers++;
+        else
+            stats.sgx_layers++;
+        if (f->layers[i].expect && f->layers[i].expect != (dss ? ROUTE_DSS : ROUTE_SGX))
+            mismatch = 1;
+        strcat(routing, dss ? " DSS" : " SGX");
+    }
+    if (hwc_dev->use_sgx)
+        stats.sgx_frames++;
+    else
+        stats.all_dss_frames++;
+
+    if (mismatch) {
+        stats.mismatches++;
+        printf("frame %u: routing%s does not match, expected", stats.frames - 1, routing);
+        for (i = 0; i < f->num_layers; i++)
+            printf(" %s", f->layers[i].expect == ROUTE_DSS ? "DSS" :
+                          f->layers[i].expect == ROUTE_SGX ? "SGX" : "-");
+        printf("\n");
+    } else if (verbose) {
+        printf("frame %u:%s -> %s, %d ovls%s\n", stats.frames - 1, routing,
+               hwc_dev->use_sgx ? "SGX+DSS" : "DSS", hwc_dev->dsscomp_data.num_ovls,
+               err ? " (set failed)" : "");
+    }
+
+    return err;
+}
+
+static void print_stats(hwc_composer_device_t *dev)
+{
+    omap3_hwc_device_t *hwc_dev = (omap3_hwc_device_t *)dev;
+    unsigned int frames = stats.frames ? stats.frames : 1;
+
+    printf("frames:    %u (%u all-DSS, %u with SGX), plan %u reused / %u replanned\n",
+           stats.frames, stats.all_dss_frames, stats.sgx_frames,
+           hwc_dev->plan.hits, hwc_dev->plan.misses);
+    printf("layers:    %u (%u DSS, %u SGX)\n",
+           stats.layers, stats.dss_layers, stats.sgx_layers);
+    printf("prepare:   avg %8.2f us  max %8.2f us  %10.0f frames/s\n",
+           stats.prepare_ns / 1000.0 / frames, stats.prepare_max_ns / 1000.0,
+           stats.prepare_ns ? stats.frames * 1e9 / stats.prepare_ns : 0.0);
+    printf("set:       avg %8.2f us  max %8.2f us  %10.0f frames/s\n",
+           stats.set_ns / 1000.0 / frames, stats.set_max_ns / 1000.0,
+           stats.set_ns ? stats.frames * 1e9 / stats.set_ns : 0.0);
+    printf("posts:     %u (%u rejected), %u overlays, %u SGX swaps, %u dispc setups\n",
+           sim.posts, sim.post_errors, sim.ovls_posted, sim.swaps, sim.dispc_setups);
+    printf("routing:   %u frames differ from the expectation\n", stats.mismatches);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-vd] [-r repeat] [-p key=value]... <scenario file>\n"
+                    "       %s [-vd] [-r repeat] [-p key=value]... -t <trace file>\n",
+            name, name);
+}
+
+int main(int argc, char **argv)
+{
+    hwc_composer_device_t *dev;
+    hwc_layer_list_t *list;
+    unsigned int repeat = 1, r, i, n;
+    int trace = 0, verbose = 0, dump = 0, opt, err;
+
+    while ((opt = getopt(argc, argv, "tr:p:vd")) != -1) {
+        switch (opt) {
+        case 't':
+            trace = 1;
+            break;
+        case 'r':
+            repeat = atoi(optarg) > 0 ? atoi(optarg) : 1;
+            break;
+        case 'p': {
+            char *eq = strchr(optarg, '=');
+
+            if (!eq || num_props >= SIM_MAX_PROPS) {
+                usage(argv[0]);
+                return 1;
+            }
+            *eq = '\0';
+            snprintf(props[num_props].key, sizeof(props[0].key), "%s", optarg);
+            snprintf(props[num_props].value, sizeof(props[0].value), "%s", eq + 1);
+            num_props++;
+            break;
+        }
+        case 'v':
+            verbose = 1;
+            break;
+        case 'd':
+            dump = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if ((trace ? load_trace : load_scenario)(argv[optind]))
+        return 1;
+    if (!num_frames) {
+        fprintf(stderr, "%s: no frames\n", argv[optind]);
+        return 1;
+    }
+
+    err = HAL_MODULE_INFO_SYM.base.common.methods->open(&HAL_MODULE_INFO_SYM.base.common,
+                                                        HWC_HARDWARE_COMPOSER,
+                                                        (hw_device_t **)&dev);
+    if (err) {
+        fprintf(stderr, "failed to open the composer (%d)\n", err);
+        return 1;
+    }
+
+    list = calloc(1, sizeof(*list) + SIM_MAX_LAYERS * sizeof(hwc_layer_t));
+    if (!list) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < num_frames; i++) {
+            if (frames[i].hotplug >= 0)
+                handle_hotplug((omap3_hwc_device_t *)dev, frames[i].hotplug);
+            for (n = 0; n < frames[i].count; n++)
+                replay_frame(dev, list, &frames[i], n, verbose);
+        }
+    }
+
+    print_stats(dev);
+
+    if (dump) {
+        char buff[16384];
+
+        dev->dump(dev, buff, sizeof(buff));
+        printf("%s", buff);
+    }
+
+    free(list);
+    dev->common.close(&dev->common);
+    return stats.mismatches || sim.post_errors ? 2 : 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Decodes a composer trace saved through debug.hwc.trace_file.
+ *
+ * usage: hwctrace <trace file>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hwc_trace.h"
+
+int main(int argc, char **argv)
+{
+    struct hwc_trace_file_header hdr;
+    struct hwc_trace_event ev;
+    char buf[2048];
+    unsigned int i;
+    FILE *f;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != HWC_TRACE_MAGIC) {
+        fprintf(stderr, "%s: not a composer trace\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+    if (hdr.version != HWC_TRACE_VERSION || hdr.event_size != sizeof(ev)) {
+        fprintf(stderr, "%s: trace version %u (event size %u) is not supported\n",
+                argv[1], hdr.version, hdr.event_size);
+        fclose(f);
+        return 1;
+    }
+
+    printf("%u events\n", hdr.num_events);
+    hwc_trace_format_hist(buf, sizeof(buf), (const uint32_t (*)[HWC_TRACE_BUCKETS])hdr.hist);
+    printf("%s", buf);
+
+    for (i = 0; i < hdr.num_events; i++) {
+        if (fread(&ev, sizeof(ev), 1, f) != 1) {
+            fprintf(stderr, "%s: truncated after %u events\n", argv[1], i);
+            break;
+        }
+        hwc_trace_format_event(buf, sizeof(buf), &ev);
+        printf("%s\n", buf);
+    }
+
+    fclose(f);
+    return 0;
+}
@@ -4,17 +4,35 @@ ifeq ($(TARGET_BOARD_PLATFORM),omap3)
 LOCAL_PATH:= $(call my-dir)
 
 include $(CLEAR_VARS)
-LOCAL_SRC_FILES := ion.c
+LOCAL_SRC_FILES := ion.c ion_memfd.c
 LOCAL_MODULE := libion
 LOCAL_MODULE_TAGS := optional
 LOCAL_SHARED_LIBRARIES := liblog
 include $(BUILD_HEAPTRACKED_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
-LOCAL_SRC_FILES := ion.c ion_test.c
+LOCAL_SRC_FILES := ion.c ion_memfd.c ion_test.c
 LOCAL_MODULE := iontest
 LOCAL_MODULE_TAGS := optional tests
 LOCAL_SHARED_LIBRARIES := liblog
 include $(BUILD_HEAPTRACKED_EXECUTABLE)
 
 endif
+
+# the same library and iontest for the build host, where only the memfd
+# backend works: ION_BACKEND=memfd iontest --bench
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := ion.c ion_memfd.c
+LOCAL_C_INCLUDES := $(TOP)/bionic/libc/kernel/common
+LOCAL_MODULE := libion
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := ion_test.c
+LOCAL_C_INCLUDES := $(TOP)/bionic/libc/kernel/common
+LOCAL_STATIC_LIBRARIES := libion liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := iontest
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
@@ -20,9 +20,12 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #define LOG_TAG "ion"
 #include <cutils/log.h>
@@ -30,10 +33,19 @@
 #include <linux/ion.h>
 #include <linux/omap_ion.h>
 #include "ion.h"
+#include "ion_memfd.h"
 
 int ion_open()
 {
-        int fd = open("/dev/ion", O_RDWR);
+        const char *backend = getenv(ION_BACKEND_ENV);
+        int fd;
+
+        if (backend && !strcmp(backend, "memfd"))
+                return ion_memfd_open();
+        if (backend && strcmp(backend, "kernel"))
+                ALOGW("unknown ion backend %s, using /dev/ion\n", backend);
+
+        fd = open("/dev/ion", O_RDWR);
         if (fd < 0)
                 ALOGE("open /dev/ion failed!\n");
         return fd;
@@ -41,12 +53,19 @@ int ion_open()
 
 int ion_close(int fd)
 {
+    if (ion_is_memfd(fd))
+        return ion_memfd_close(fd);
     return close(fd);
 }
 
 int ion_ioctl(int fd, int req, void *arg)
 {
-        int ret = ioctl(fd, req, arg);
+        int ret;
+
+        if (ion_is_memfd(fd))
+                return -ENOTTY;
+
+        ret = ioctl(fd, req, arg);
         if (ret < 0) {
                 ALOGE("ioctl %d failed with code %d: %s\n", req,
                        ret, strerror(errno));
@@ -65,6 +84,9 @@ int ion_alloc(int fd, size_t len, size_t align, unsigned int flags,
         .flags = flags,
     };
 
+        if (ion_is_memfd(fd))
+                return ion_memfd_alloc(fd, len, align, flags, handle);
+
         ret = ion_ioctl(fd, ION_IOC_ALLOC, &data);
         if (ret < 0)
                 return ret;
@@ -88,6 +110,9 @@ int ion_alloc_tiler(int fd, size_t w, size_t h, int fmt, unsigned int flags,
         .arg = (unsigned long)(&alloc_data),
     };
 
+    if (ion_is_memfd(fd))
+            return ion_memfd_alloc_tiler(fd, w, h, fmt, flags, handle, stride);
+
     ret = ion_ioctl(fd, ION_IOC_CUSTOM, &custom_data);
     if (ret < 0)
             return ret;
@@ -102,6 +127,9 @@ int ion_free(int fd, struct ion_handle *handle)
     struct ion_handle_data data = {
         .handle = handle,
     };
+
+    if (ion_is_memfd(fd))
+        return ion_memfd_free(fd, handle);
     return ion_ioctl(fd, ION_IOC_FREE, &data);
 }
 
@@ -111,7 +139,13 @@ int ion_map(int fd, struct ion_handle *handle, size_t length, int prot,
         struct ion_fd_data data = {
                 .handle = handle,
         };
-        int ret = ion_ioctl(fd, ION_IOC_MAP, &data);
+        int ret;
+
+        if (ion_is_memfd(fd))
+                return ion_memfd_map(fd, handle, length, prot, flags, offset,
+                                     ptr, map_fd);
+
+        ret = ion_ioctl(fd, ION_IOC_MAP, &data);
         if (ret < 0)
                 return ret;
         *map_fd = data.fd;
@@ -133,7 +167,12 @@ int ion_share(int fd, struct ion_handle *handle, int *share_fd)
         struct ion_fd_data data = {
                 .handle = handle,
         };
-        int ret = ion_ioctl(fd, ION_IOC_SHARE, &data);
+        int ret;
+
+        if (ion_is_memfd(fd))
+                return ion_memfd_share(fd, handle, share_fd);
+
+        ret = ion_ioctl(fd, ION_IOC_SHARE, &data);
         if (ret < 0)
                 return ret;
         *share_fd = data.fd;
@@ -149,9 +188,26 @@ int ion_import(int fd, int share_fd, struct ion_handle **handle)
         struct ion_fd_data data = {
                 .fd = share_fd,
         };
-        int ret = ion_ioctl(fd, ION_IOC_IMPORT, &data);
+        int ret;
+
+        if (ion_is_memfd(fd))
+                return ion_memfd_import(fd, share_fd, handle);
+
+        ret = ion_ioctl(fd, ION_IOC_IMPORT, &data);
         if (ret < 0)
                 return ret;
         *handle = data.handle;
         return ret;
 }
+
+const char *ion_backend_name(int fd)
+{
+        return ion_is_memfd(fd) ? "memfd" : "kernel";
+}
+
+int ion_get_stats(int fd, struct ion_stats *stats)
+{
+        if (ion_is_memfd(fd))
+                return ion_memfd_get_stats(fd, stats);
+        return -ENOSYS;
+}
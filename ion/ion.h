@@ -21,8 +21,29 @@
 #include <linux/ion.h>
 #include <linux/omap_ion.h>
 
+/*
+ * Environment variable picking the allocator behind ion_open():
+ *   "kernel" (default) - ioctls on /dev/ion
+ *   "memfd"            - anonymous memfd buffers, for hosts without ion
+ */
+#define ION_BACKEND_ENV "ION_BACKEND"
+
+/* Allocation statistics of one ion client, see ion_get_stats() */
+struct ion_stats {
+	unsigned int allocs;
+	unsigned int tiler_allocs;
+	unsigned int frees;
+	unsigned int maps;
+	unsigned int shares;
+	unsigned int imports;
+	unsigned int failures;
+	size_t bytes;		/* currently allocated */
+	size_t peak_bytes;
+};
+
 #ifdef __cplusplus
 extern "C" {
+#endif
 
 int ion_open();
 int ion_close(int fd);
@@ -36,5 +57,12 @@ int ion_map(int fd, struct ion_handle *handle, size_t length, int prot,
 int ion_share(int fd, struct ion_handle *handle, int *share_fd);
 int ion_import(int fd, int share_fd, struct ion_handle **handle);
 int ion_ioctl(int fd, int req, void *arg);
+
+/* Name of the backend serving the client fd */
+const char *ion_backend_name(int fd);
+/* Only the memfd backend keeps statistics, -ENOSYS otherwise */
+int ion_get_stats(int fd, struct ion_stats *stats);
+
+#ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,442 @@
+/*
+ *  ion_memfd.c
+ *
+ * memfd backed stand-in for /dev/ion. Buffers are anonymous shared memory
+ * files, so they can be mapped, shared and imported like ion buffers on
+ * machines without the driver. Tiler allocations get the stride and height
+ * alignment of the OMAP tiler containers.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define LOG_TAG "ion"
+#include <cutils/log.h>
+
+#include "ion.h"
+#include "ion_memfd.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#define ION_MEMFD_PAGE 4096
+#define ION_MEMFD_ALIGN(x, a) (((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+struct memfd_buffer {
+	struct memfd_buffer *next;
+	int fd;
+	size_t len;
+	int imported;		/* not counted in the client's bytes */
+};
+
+struct memfd_client {
+	struct memfd_client *next;
+	int fd;
+	struct memfd_buffer *buffers;
+	struct ion_stats stats;
+};
+
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct memfd_client *clients;
+/* lets the /dev/ion path skip the lookup while no memfd client exists */
+static volatile int client_count;
+
+static int memfd_new(const char *name)
+{
+#ifdef __NR_memfd_create
+	return syscall(__NR_memfd_create, name, MFD_CLOEXEC);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/* called with clients_lock held */
+static struct memfd_client *find_client(int fd)
+{
+	struct memfd_client *client;
+
+	for (client = clients; client; client = client->next)
+		if (client->fd == fd)
+			return client;
+	return NULL;
+}
+
+/* called with clients_lock held */
+static struct memfd_buffer *find_buffer(struct memfd_client *client,
+					struct ion_handle *handle)
+{
+	struct memfd_buffer *buffer;
+
+	for (buffer = client->buffers; buffer; buffer = buffer->next)
+		if (buffer == (struct memfd_buffer *)handle)
+			return buffer;
+	return NULL;
+}
+
+/* called with clients_lock held */
+static int add_buffer(struct memfd_client *client, int fd, size_t len,
+		      int imported, struct ion_handle **handle)
+{
+	struct memfd_buffer *buffer = malloc(sizeof(*buffer));
+
+	if (!buffer)
+		return -ENOMEM;
+
+	buffer->fd = fd;
+	buffer->len = len;
+	buffer->imported = imported;
+	buffer->next = client->buffers;
+	client->buffers = buffer;
+
+	if (!imported) {
+		client->stats.bytes += len;
+		if (client->stats.bytes > client->stats.peak_bytes)
+			client->stats.peak_bytes = client->stats.bytes;
+	}
+
+	*handle = (struct ion_handle *)buffer;
+	return 0;
+}
+
+/* called with clients_lock held */
+static void remove_buffer(struct memfd_client *client,
+			  struct memfd_buffer *buffer)
+{
+	struct memfd_buffer **pp;
+
+	for (pp = &client->buffers; *pp; pp = &(*pp)->next) {
+		if (*pp == buffer) {
+			*pp = buffer->next;
+			break;
+		}
+	}
+
+	if (!buffer->imported)
+		client->stats.bytes -= buffer->len;
+	close(buffer->fd);
+	free(buffer);
+}
+
+/* called with clients_lock held */
+static int alloc_locked(struct memfd_client *client, size_t len,
+			struct ion_handle **handle)
+{
+	int fd, ret;
+
+	if (!len)
+		return -EINVAL;
+
+	len = ION_MEMFD_ALIGN(len, ION_MEMFD_PAGE);
+
+	fd = memfd_new("ion-buffer");
+	if (fd < 0)
+		return -errno;
+
+	if (ftruncate(fd, len) < 0) {
+		ret = -errno;
+		close(fd);
+		return ret;
+	}
+
+	ret = add_buffer(client, fd, len, 0, handle);
+	if (ret < 0)
+		close(fd);
+	return ret;
+}
+
+int ion_is_memfd(int fd)
+{
+	int found;
+
+	if (!client_count)
+		return 0;
+
+	pthread_mutex_lock(&clients_lock);
+	found = find_client(fd) != NULL;
+	pthread_mutex_unlock(&clients_lock);
+	return found;
+}
+
+int ion_memfd_open(void)
+{
+	struct memfd_client *client = calloc(1, sizeof(*client));
+
+	if (!client) {
+		ALOGE("memfd ion client allocation failed\n");
+		return -1;
+	}
+
+	/* a real fd, so it can't collide with anything else the process opens */
+	client->fd = memfd_new("ion-client");
+	if (client->fd < 0) {
+		ALOGE("memfd_create failed: %s\n", strerror(errno));
+		free(client);
+		return -1;
+	}
+
+	pthread_mutex_lock(&clients_lock);
+	client->next = clients;
+	clients = client;
+	client_count++;
+	pthread_mutex_unlock(&clients_lock);
+
+	return client->fd;
+}
+
+int ion_memfd_close(int fd)
+{
+	struct memfd_client **pp, *client = NULL;
+
+	pthread_mutex_lock(&clients_lock);
+	for (pp = &clients; *pp; pp = &(*pp)->next) {
+		if ((*pp)->fd == fd) {
+			client = *pp;
+			*pp = client->next;
+			client_count--;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&clients_lock);
+
+	if (!client)
+		return -EINVAL;
+
+	/* like the driver, closing the client drops its handles */
+	while (client->buffers)
+		remove_buffer(client, client->buffers);
+
+	free(client);
+	return close(fd);
+}
+
+int ion_memfd_alloc(int fd, size_t len, size_t align, unsigned int flags,
+		    struct ion_handle **handle)
+{
+	struct memfd_client *client;
+	int ret = -EINVAL;
+
+	/* mappings are page aligned, heap flags have nothing to select */
+	if (align > ION_MEMFD_PAGE)
+		ALOGW("memfd ion ignores alignment %u\n", (unsigned int)align);
+
+	pthread_mutex_lock(&clients_lock);
+	client = find_client(fd);
+	if (client) {
+		ret = alloc_locked(client, len, handle);
+		if (ret < 0)
+			client->stats.failures++;
+		else
+			client->stats.allocs++;
+	}
+	pthread_mutex_unlock(&clients_lock);
+
+	return ret;
+}
+
+int ion_memfd_alloc_tiler(int fd, size_t w, size_t h, int fmt,
+			  unsigned int flags, struct ion_handle **handle,
+			  size_t *stride)
+{
+	struct memfd_client *client;
+	size_t bpp, slot_w, slot_h, row;
+	int ret = -EINVAL;
+
+	/*
+	 * 2D containers are built from 64x64, 32x64 and 32x32 pixel slots for
+	 * 8, 16 and 32 bit pixels. The mapped view of a block has page aligned
+	 * rows, that is the stride the driver reports.
+	 */
+	switch (fmt) {
+	case TILER_PIXEL_FMT_8BIT:
+		bpp = 1; slot_w = 64; slot_h = 64;
+		break;
+	case TILER_PIXEL_FMT_16BIT:
+		bpp = 2; slot_w = 32; slot_h = 64;
+		break;
+	case TILER_PIXEL_FMT_32BIT:
+		bpp = 4; slot_w = 32; slot_h = 32;
+		break;
+	case TILER_PIXEL_FMT_PAGE:
+		/* 1D block of w * h bytes */
+		bpp = 1; slot_w = 1; slot_h = 1;
+		w = w * h;
+		h = 1;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (!w || !h)
+		return -EINVAL;
+
+	row = ION_MEMFD_ALIGN(ION_MEMFD_ALIGN(w, slot_w) * bpp, ION_MEMFD_PAGE);
+	h = ION_MEMFD_ALIGN(h, slot_h);
+
+	pthread_mutex_lock(&clients_lock);
+	client = find_client(fd);
+	if (client) {
+		ret = alloc_locked(client, row * h, handle);
+		if (ret < 0) {
+			client->stats.failures++;
+		} else {
+			client->stats.tiler_allocs++;
+			*stride = row;
+		}
+	}
+	pthread_mutex_unlock(&clients_lock);
+
+	return ret;
+}
+
+int ion_memfd_free(int fd, struct ion_handle *handle)
+{
+	struct memfd_client *client;
+	struct memfd_buffer *buffer = NULL;
+	int ret = -EINVAL;
+
+	pthread_mutex_lock(&clients_lock);
+	client = find_client(fd);
+	if (client)
+		buffer = find_buffer(client, handle);
+	if (buffer) {
+		remove_buffer(client, buffer);
+		client->stats.frees++;
+		ret = 0;
+	} else if (client) {
+		client->stats.failures++;
+	}
+	pthread_mutex_unlock(&clients_lock);
+
+	return ret;
+}
+
+int ion_memfd_map(int fd, struct ion_handle *handle, size_t length, int prot,
+		  int flags, off_t offset, unsigned char **ptr, int *map_fd)
+{
+	struct memfd_client *client;
+	struct memfd_buffer *buffer = NULL;
+	int ret = -EINVAL;
+
+	pthread_mutex_lock(&clients_lock);
+	client = find_client(fd);
+	if (client)
+		buffer = find_buffer(client, handle);
+	if (buffer && (offset >= 0) && ((size_t)offset + length <= buffer->len)) {
+		/* the map ioctl hands out a new fd for the buffer */
+		*map_fd = dup(buffer->fd);
+		ret = (*map_fd < 0) ? -errno : 0;
+	}
+	if (client) {
+		if (ret < 0)
+			client->stats.failures++;
+		else
+			client->stats.maps++;
+	}
+	pthread_mutex_unlock(&clients_lock);
+
+	if (ret < 0)
+		return ret;
+
+	*ptr = mmap(NULL, length, prot, flags, *map_fd, offset);
+	if (*ptr == MAP_FAILED) {
+		ret = -errno;
+		ALOGE("mmap failed: %s\n", strerror(errno));
+		close(*map_fd);
+		return ret;
+	}
+	return 0;
+}
+
+int ion_memfd_share(int fd, struct ion_handle *handle, int *share_fd)
+{
+	struct memfd_client *client;
+	struct memfd_buffer *buffer = NULL;
+	int ret = -EINVAL;
+
+	pthread_mutex_lock(&clients_lock);
+	client = find_client(fd);
+	if (client)
+		buffer = find_buffer(client, handle);
+	if (buffer) {
+		*share_fd = dup(buffer->fd);
+		ret = (*share_fd < 0) ? -errno : 0;
+	}
+	if (client) {
+		if (ret < 0)
+			client->stats.failures++;
+		else
+			client->stats.shares++;
+	}
+	pthread_mutex_unlock(&clients_lock);
+
+	return ret;
+}
+
+int ion_memfd_import(int fd, int share_fd, struct ion_handle **handle)
+{
+	struct memfd_client *client;
+	struct stat st;
+	int buffer_fd, ret;
+
+	if (fstat(share_fd, &st) < 0)
+		return -errno;
+	if (st.st_size <= 0)
+		return -EINVAL;
+
+	buffer_fd = dup(share_fd);
+	if (buffer_fd < 0)
+		return -errno;
+
+	pthread_mutex_lock(&clients_lock);
+	client = find_client(fd);
+	ret = client ? add_buffer(client, buffer_fd, st.st_size, 1, handle)
+		     : -EINVAL;
+	if (client) {
+		if (ret < 0)
+			client->stats.failures++;
+		else
+			client->stats.imports++;
+	}
+	pthread_mutex_unlock(&clients_lock);
+
+	if (ret < 0)
+		close(buffer_fd);
+	return ret;
+}
+
+int ion_memfd_get_stats(int fd, struct ion_stats *stats)
+{
+	struct memfd_client *client;
+	int ret = -EINVAL;
+
+	pthread_mutex_lock(&clients_lock);
+	client = find_client(fd);
+	if (client) {
+		*stats = client->stats;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&clients_lock);
+
+	return ret;
+}
@@ -9,6 +9,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "ion.h"
@@ -24,6 +25,8 @@ size_t width = 1024*1024, height = 1024*1024;
 int fmt = TILER_PIXEL_FMT_32BIT;
 int tiler_test = 0;
 size_t stride;
+int len_set = 0;
+int bench_iters = 1000;
 
 int _ion_alloc_test(int *fd, struct ion_handle **handle)
 {
@@ -224,10 +227,130 @@ void ion_share_test()
 	}
 }
 
+static long long now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ns(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+	return (x > y) - (x < y);
+}
+
+static void bench_report(const char *op, size_t size, long long *samples,
+			 int n)
+{
+	long long total = 0;
+	int i;
+
+	if (n <= 0) {
+		printf("%-6s %9u: failed\n", op, size);
+		return;
+	}
+	for (i = 0; i < n; i++)
+		total += samples[i];
+	qsort(samples, n, sizeof(*samples), cmp_ns);
+	printf("%-6s %9u: %10.0f ops/s  p50 %8.2f us  p99 %8.2f us\n", op,
+	       size, total ? n * 1e9 / total : 0.0, samples[n / 2] / 1000.0,
+	       samples[(n * 99) / 100] / 1000.0);
+}
+
+static void _ion_bench_size(int fd, size_t size, long long *t_alloc,
+			    long long *t_free, long long *t_map,
+			    long long *t_share)
+{
+	struct ion_handle *handle;
+	unsigned char *ptr;
+	int map_fd, share_fd, ret;
+	int n_alloc = 0, n_map = 0, n_share = 0;
+	long long t0;
+	int i;
+
+	for (i = 0; i < bench_iters; i++) {
+		t0 = now_ns();
+		ret = ion_alloc(fd, size, align, alloc_flags, &handle);
+		if (ret)
+			break;
+		t_alloc[n_alloc] = now_ns() - t0;
+
+		/* map includes the first touch, that is where the pages fault in */
+		t0 = now_ns();
+		ret = ion_map(fd, handle, size, prot, map_flags, 0, &ptr,
+			      &map_fd);
+		if (!ret) {
+			ptr[0] = 1;
+			munmap(ptr, size);
+			close(map_fd);
+			t_map[n_map++] = now_ns() - t0;
+		}
+
+		t0 = now_ns();
+		ret = ion_share(fd, handle, &share_fd);
+		if (!ret) {
+			close(share_fd);
+			t_share[n_share++] = now_ns() - t0;
+		}
+
+		t0 = now_ns();
+		ion_free(fd, handle);
+		t_free[n_alloc++] = now_ns() - t0;
+	}
+
+	bench_report("alloc", size, t_alloc, n_alloc);
+	bench_report("free", size, t_free, n_alloc);
+	bench_report("map", size, t_map, n_map);
+	bench_report("share", size, t_share, n_share);
+}
+
+void ion_bench_test()
+{
+	static const size_t sizes[] = {
+		4096, 64 * 1024, 1024 * 1024, 4 * 1024 * 1024,
+	};
+	long long *samples;
+	struct ion_stats stats;
+	size_t i;
+	int fd;
+
+	fd = ion_open();
+	if (fd < 0)
+		return;
+
+	samples = malloc(4 * bench_iters * sizeof(*samples));
+	if (!samples) {
+		ion_close(fd);
+		return;
+	}
+
+	printf("ion bench: %s backend, %d iterations\n",
+	       ion_backend_name(fd), bench_iters);
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		size_t size = len_set ? len : sizes[i];
+		_ion_bench_size(fd, size, samples, samples + bench_iters,
+				samples + 2 * bench_iters,
+				samples + 3 * bench_iters);
+		if (len_set)
+			break;
+	}
+
+	if (!ion_get_stats(fd, &stats))
+		printf("stats: %u allocs %u frees %u maps %u shares "
+		       "%u failures, peak %u bytes\n", stats.allocs,
+		       stats.frees, stats.maps, stats.shares, stats.failures,
+		       stats.peak_bytes);
+
+	free(samples);
+	ion_close(fd);
+}
+
 int main(int argc, char* argv[]) {
 	int c;
 	enum tests {
-		ALLOC_TEST = 0, MAP_TEST, SHARE_TEST,
+		ALLOC_TEST = 0, MAP_TEST, SHARE_TEST, BENCH_TEST,
 	};
 
 	while (1) {
@@ -244,15 +367,20 @@ int main(int argc, char* argv[]) {
 			{"width", required_argument, 0, 'w'},
 			{"height", required_argument, 0, 'h'},
 			{"fmt", required_argument, 0, 'r'},
+			{"bench", no_argument, 0, 'b'},
+			{"iters", required_argument, 0, 'i'},
+			{"backend", required_argument, 0, 'k'},
+			{0, 0, 0, 0},
 		};
 		int i = 0;
-		c = getopt_long(argc, argv, "af:h:l:mr:stw:", opts, &i);
+		c = getopt_long(argc, argv, "abf:h:i:k:l:mr:stw:", opts, &i);
 		if (c == -1)
 			break;
 
 		switch (c) {
 		case 'l':
 			len = atol(optarg);
+			len_set = 1;
 			break;
 		case 'g':
 			align = atol(optarg);
@@ -299,6 +427,18 @@ int main(int argc, char* argv[]) {
 		case 't':
 			tiler_test = 1;
 			break;
+		case 'b':
+			test = BENCH_TEST;
+			break;
+		case 'i':
+			bench_iters = atoi(optarg);
+			if (bench_iters < 1)
+				bench_iters = 1;
+			break;
+		case 'k':
+			/* read by ion_open() */
+			setenv(ION_BACKEND_ENV, optarg, 1);
+			break;
 		}
 	}
 	printf("test %d, len %u, width %u, height %u fmt %u align %u, "
@@ -314,8 +454,11 @@ int main(int argc, char* argv[]) {
 		case SHARE_TEST:
 			ion_share_test();
 			break;
+		case BENCH_TEST:
+			ion_bench_test();
+			break;
 		default:
-			printf("must specify a test (alloc, map, share)\n");
+			printf("must specify a test (alloc, map, share, bench)\n");
 	}
 	return 0;
 }
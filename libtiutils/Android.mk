@@ -32,3 +32,25 @@ LOCAL_MODULE:= libtiutils
 LOCAL_MODULE_TAGS:= optional
 
 include $(BUILD_HEAPTRACKED_SHARED_LIBRARY)
+
+################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    MessageQueueBench.cpp
+
+LOCAL_SHARED_LIBRARIES:= \
+    libtiutils \
+    libutils \
+    libcutils
+
+LOCAL_C_INCLUDES += \
+	frameworks/native/include/utils
+
+LOCAL_CFLAGS += -fno-short-enums
+
+LOCAL_MODULE:= msgqbench
+LOCAL_MODULE_TAGS:= optional tests
+
+include $(BUILD_HEAPTRACKED_EXECUTABLE)
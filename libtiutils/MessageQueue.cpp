@@ -17,10 +17,13 @@
 
 #include <errno.h>
 #include <string.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
 #include <sys/poll.h>
 #include <unistd.h>
 #include <Errors.h>
+#include <cutils/atomic.h>
+#include <utils/Timers.h>
 
 
 
@@ -34,16 +37,34 @@ namespace TIUTILS {
 /**
    @brief Constructor for the message queue class
 
-   @param none
+   @param backend Transport used for the messages
+   @param depth Number of messages the ring can hold, rounded up to a power of two. Unused for pipes.
    @return none
  */
-MessageQueue::MessageQueue()
+MessageQueue::MessageQueue(Backend backend, unsigned int depth)
 {
     LOG_FUNCTION_NAME;
 
     int fds[2] = {-1,-1};
     android::status_t stat;
 
+    mHasMsg = false;
+    mBackend = BACKEND_PIPE;
+    mRing = NULL;
+    mRingMask = 0;
+    mTail = 0;
+    mHead = 0;
+    mWaiting = 0;
+    mFdExported = 0;
+    mSpaceFd = -1;
+    mProducerWaiting = 0;
+
+    if ( ( BACKEND_RING == backend ) && initRing(depth) )
+        {
+        LOG_FUNCTION_NAME_EXIT;
+        return;
+        }
+
     stat = pipe(fds);
 
     if ( 0 > stat )
@@ -64,6 +85,58 @@ MessageQueue::MessageQueue()
     LOG_FUNCTION_NAME_EXIT;
 }
 
+/**
+   @brief Set up the ring backend
+
+   @param depth Requested number of slots
+   @return true On success, the queue falls back to a pipe otherwise
+ */
+bool MessageQueue::initRing(unsigned int depth)
+{
+    unsigned int slots = 2;
+    int fd;
+
+    while ( ( slots < depth ) && ( slots < 0x40000000 ) )
+        {
+        slots <<= 1;
+        }
+
+    fd = eventfd(0, EFD_NONBLOCK);
+    if ( 0 > fd )
+        {
+        MSGQ_LOGEB("Error while creating eventfd: %s, using a pipe", strerror(errno));
+        return false;
+        }
+
+    mSpaceFd = eventfd(0, EFD_NONBLOCK);
+    if ( 0 > mSpaceFd )
+        {
+        MSGQ_LOGEB("Error while creating eventfd: %s, using a pipe", strerror(errno));
+        close(fd);
+        return false;
+        }
+
+    mRing = new Message[slots];
+    if ( NULL == mRing )
+        {
+        MSGQ_LOGEA("Not enough memory for the message ring, using a pipe");
+        close(fd);
+        close(mSpaceFd);
+        mSpaceFd = -1;
+        return false;
+        }
+
+    mRingMask = slots - 1;
+    mBackend = BACKEND_RING;
+
+    // the same eventfd serves both ends of the consumer wakeup, mSpaceFd
+    // wakes a producer waiting for a free slot
+    this->fd_read = fd;
+    this->fd_write = fd;
+
+    return true;
+}
+
 /**
    @brief Destructor for the semaphore class
 
@@ -79,11 +152,21 @@ MessageQueue::~MessageQueue()
         close(this->fd_read);
         }
 
-    if(this->fd_write >= 0)
+    if( ( this->fd_write >= 0 ) && ( this->fd_write != this->fd_read ) )
         {
         close(this->fd_write);
         }
 
+    if ( 0 <= mSpaceFd )
+        {
+        close(mSpaceFd);
+        }
+
+    if ( NULL != mRing )
+        {
+        delete [] mRing;
+        }
+
     LOG_FUNCTION_NAME_EXIT;
 }
 
@@ -114,6 +197,23 @@ android::status_t MessageQueue::get(Message* msg)
         return android::NO_INIT;
         }
 
+    if ( BACKEND_RING == mBackend )
+        {
+        // block like a pipe read would until the producer delivers
+        while ( !ringPop(msg) )
+            {
+            MessageQueue::waitForMsg(this, NULL, NULL, -1);
+            }
+
+        MSGQ_LOGDB("MQ.get(%d,%p,%p,%p,%p)", msg->command, msg->arg1,msg->arg2,msg->arg3,msg->arg4);
+
+        mHasMsg = false;
+
+        LOG_FUNCTION_NAME_EXIT;
+
+        return 0;
+        }
+
     char* p = (char*) msg;
     size_t read_bytes = 0;
 
@@ -150,6 +250,18 @@ android::status_t MessageQueue::get(Message* msg)
 
 int MessageQueue::getInFd()
 {
+    if ( BACKEND_RING == mBackend )
+        {
+        // somebody may poll the eventfd behind our back from now on,
+        // so producers can no longer skip the wakeup
+        android_atomic_release_store(1, &mFdExported);
+        android_memory_barrier();
+        if ( !ringEmpty() )
+            {
+            ringSignal();
+            }
+        }
+
     return this->fd_read;
 }
 
@@ -164,6 +276,13 @@ void MessageQueue::setInFd(int fd)
 {
     LOG_FUNCTION_NAME;
 
+    if ( BACKEND_RING == mBackend )
+        {
+        MSGQ_LOGEA("input descriptor of a ring message queue can't be replaced");
+        LOG_FUNCTION_NAME_EXIT;
+        return;
+        }
+
     if ( -1 != this->fd_read )
         {
         close(this->fd_read);
@@ -208,6 +327,14 @@ android::status_t MessageQueue::put(Message* msg)
 
     MSGQ_LOGDB("MQ.put(%d,%p,%p,%p,%p)", msg->command, msg->arg1,msg->arg2,msg->arg3,msg->arg4);
 
+    if ( BACKEND_RING == mBackend )
+        {
+        ringPush(msg);
+
+        LOG_FUNCTION_NAME_EXIT;
+        return 0;
+        }
+
     while( bytes  < sizeof(msg) )
         {
         int err = write(this->fd_write, p, sizeof(*msg) - bytes);
@@ -244,6 +371,13 @@ bool MessageQueue::isEmpty()
 
     struct pollfd pfd;
 
+    if ( BACKEND_RING == mBackend )
+        {
+        mHasMsg = !ringEmpty();
+        LOG_FUNCTION_NAME_EXIT;
+        return !mHasMsg;
+        }
+
     pfd.fd = this->fd_read;
     pfd.events = POLLIN;
     pfd.revents = 0;
@@ -294,17 +428,24 @@ void MessageQueue::setMsg(bool hasMsg)
    @param queue1 First queue. At least this should be set to a valid queue pointer
    @param queue2 Second queue. Optional.
    @param queue3 Third queue. Optional.
-   @param timeout The timeout value (in micro secs) to wait for a message in any of the queues
-   @return android::NO_ERROR On success
+   @param timeout The timeout value (in milli secs) to wait for a message in any of the queues
+   @return Number of queues with a message, 0 on timeout
    @return android::BAD_VALUE If queue1 is NULL
    @return android::NO_INIT If the file read descriptor of any of the provided queues is not set
+   @return android::UNKNOWN_ERROR If no queue has a message and a pipe was hung up or failed
  */
 android::status_t MessageQueue::waitForMsg(MessageQueue *queue1, MessageQueue *queue2, MessageQueue *queue3, int timeout)
     {
     LOG_FUNCTION_NAME;
 
-    int n =1;
+    int n = 0;
+    int ready;
+    int ret;
+    int wait = timeout;
+    nsecs_t deadline = 0;
+    bool failed = false;
     struct pollfd pfd[3];
+    MessageQueue *queues[3];
 
     if(!queue1)
         {
@@ -313,85 +454,301 @@ android::status_t MessageQueue::waitForMsg(MessageQueue *queue1, MessageQueue *q
         return android::BAD_VALUE;
         }
 
-    pfd[0].fd = queue1->getInFd();
-    if(!pfd[0].fd)
-        {
-        MSGQ_LOGEA("read descriptor not initialized for message queue1");
-        LOG_FUNCTION_NAME_EXIT;
-        return android::NO_INIT;
-        }
-    pfd[0].events = POLLIN;
-    pfd[0].revents = 0;
+    queues[n++] = queue1;
     if(queue2)
         {
         MSGQ_LOGDA("queue2 not-null");
-        pfd[1].fd = queue2->getInFd();
-        if(!pfd[1].fd)
+        queues[n++] = queue2;
+        }
+    if(queue3)
+        {
+        MSGQ_LOGDA("queue3 not-null");
+        queues[n++] = queue3;
+        }
+
+    for ( int i = 0 ; i < n ; i++ )
+        {
+        pfd[i].fd = queues[i]->fd_read;
+        if(!pfd[i].fd)
             {
-            MSGQ_LOGEA("read descriptor not initialized for message queue2");
+            MSGQ_LOGEB("read descriptor not initialized for message queue%d", i + 1);
             LOG_FUNCTION_NAME_EXIT;
             return android::NO_INIT;
             }
+        pfd[i].events = POLLIN;
+        pfd[i].revents = 0;
+        }
 
-        pfd[1].events = POLLIN;
-        pfd[1].revents = 0;
-        n++;
+    if ( 0 < timeout )
+        {
+        deadline = systemTime(SYSTEM_TIME_MONOTONIC) + milliseconds_to_nanoseconds(timeout);
         }
 
-    if(queue3)
+    do
         {
-        MSGQ_LOGDA("queue3 not-null");
-        pfd[2].fd = queue3->getInFd();
-        if(!pfd[2].fd)
+        ready = 0;
+
+        // rings have to announce the sleeping consumer before the final
+        // emptiness check, otherwise a put() in between would go unnoticed
+        for ( int i = 0 ; i < n ; i++ )
+            {
+            if ( BACKEND_RING == queues[i]->mBackend )
+                {
+                queues[i]->ringArm(true);
+                if ( !queues[i]->ringEmpty() )
+                    {
+                    ready++;
+                    }
+                }
+            }
+
+        if ( ready )
+            {
+            ret = ready;
+            }
+        else
+            {
+            ret = poll(pfd, n, wait);
+            }
+
+        for ( int i = 0 ; i < n ; i++ )
+            {
+            if ( BACKEND_RING == queues[i]->mBackend )
+                {
+                queues[i]->ringArm(false);
+                }
+            }
+
+        if(ret==0)
             {
-            MSGQ_LOGEA("read descriptor not initialized for message queue3");
             LOG_FUNCTION_NAME_EXIT;
-            return android::NO_INIT;
+            return ret;
             }
 
-        pfd[2].events = POLLIN;
-        pfd[2].revents = 0;
-        n++;
-        }
+        if(ret<android::NO_ERROR)
+            {
+            MSGQ_LOGEB("Message queue returned error %d", ret);
+            LOG_FUNCTION_NAME_EXIT;
+            return ret;
+            }
+
+        // a ring eventfd may carry a stale wakeup, only its indices count
+        ready = 0;
+        for ( int i = 0 ; i < n ; i++ )
+            {
+            bool hasMsg;
+
+            if ( BACKEND_RING == queues[i]->mBackend )
+                {
+                queues[i]->ringDrain();
+                hasMsg = !queues[i]->ringEmpty();
+                }
+            else
+                {
+                hasMsg = ( pfd[i].revents & POLLIN );
+
+                if ( !hasMsg && ( pfd[i].revents & ( POLLHUP | POLLERR | POLLNVAL ) ) )
+                    {
+                    MSGQ_LOGEB("message queue%d descriptor failed, revents 0x%x", i + 1, pfd[i].revents);
+                    failed = true;
+                    }
+                }
+
+            if ( hasMsg )
+                {
+                queues[i]->setMsg(true);
+                ready++;
+                }
+            }
+
+        // a hung up or broken pipe stays that way, polling again would spin
+        if ( ( 0 == ready ) && failed )
+            {
+            LOG_FUNCTION_NAME_EXIT;
+            return android::UNKNOWN_ERROR;
+            }
+
+        // a spurious ring wakeup waits again for the rest of the timeout
+        if ( ( 0 == ready ) && ( 0 < timeout ) )
+            {
+            wait = (int) nanoseconds_to_milliseconds(deadline - systemTime(SYSTEM_TIME_MONOTONIC));
+            if ( 0 >= wait )
+                {
+                break;
+                }
+            }
+        } while ( ( 0 == ready ) && ( 0 != timeout ) );
+
+    LOG_FUNCTION_NAME_EXIT;
+    return ready;
+    }
 
+/**
+   @brief Check the ring for messages, from either side
 
-    int ret = poll(pfd, n, timeout);
-    if(ret==0)
+   @param none
+   @return true If no message is pending
+ */
+bool MessageQueue::ringEmpty()
+    {
+    return android_atomic_acquire_load(&mTail) == android_atomic_acquire_load(&mHead);
+    }
+
+/**
+   @brief Take the oldest message out of the ring, consumer side only
+
+   @param msg Message structure to hold the message to be retrieved
+   @return false If the ring is empty
+ */
+bool MessageQueue::ringPop(Message* msg)
+    {
+    int32_t head = mHead;
+
+    if ( android_atomic_acquire_load(&mTail) == head )
         {
-        LOG_FUNCTION_NAME_EXIT;
-        return ret;
+        return false;
         }
 
-    if(ret<android::NO_ERROR)
+    *msg = mRing[head & mRingMask];
+    android_atomic_release_store(head + 1, &mHead);
+
+    // wake a waiting producer only once half of the ring is free, not for
+    // every slot. Pairs with the barrier in ringPush(): either the producer
+    // sees the free slots before sleeping, or we see it waiting.
+    if ( (uint32_t) ( android_atomic_acquire_load(&mTail) - ( head + 1 ) ) <= ( mRingMask >> 1 ) )
         {
-        MSGQ_LOGEB("Message queue returned error %d", ret);
-        LOG_FUNCTION_NAME_EXIT;
-        return ret;
+        android_memory_barrier();
+        if ( mProducerWaiting )
+            {
+            uint64_t one = 1;
+
+            if ( 0 > write(mSpaceFd, &one, sizeof(one)) )
+                {
+                MSGQ_LOGEB("eventfd write() error: %s", strerror(errno));
+                }
+            }
         }
 
-    if (pfd[0].revents & POLLIN)
+    // an outside poller must not see the eventfd readable for an empty ring
+    if ( mFdExported && ringEmpty() )
         {
-        queue1->setMsg(true);
+        ringDrain();
         }
 
-    if(queue2)
+    return true;
+    }
+
+/**
+   @brief Append a message to the ring, producer side only. Sleeps until the consumer frees a slot if the ring is full.
+
+   @param msg Message to queue
+   @return none
+ */
+void MessageQueue::ringPush(Message* msg)
+    {
+    int32_t tail = mTail;
+
+    while ( ringFull(tail) )
         {
-        if (pfd[1].revents & POLLIN)
+        struct pollfd pfd;
+        uint64_t count;
+
+        // same handshake as ringArm() in the other direction
+        android_atomic_release_store(1, &mProducerWaiting);
+        android_memory_barrier();
+
+        if ( ringFull(tail) )
             {
-            queue2->setMsg(true);
+            pfd.fd = mSpaceFd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if ( 0 > poll(&pfd, 1, -1) && ( EINTR != errno ) )
+                {
+                MSGQ_LOGEB("poll() error: %s", strerror(errno));
+                }
             }
+
+        android_atomic_release_store(0, &mProducerWaiting);
+
+        // reset the wakeup, stale or not it's the indices that count
+        read(mSpaceFd, &count, sizeof(count));
         }
 
-    if(queue3)
+    mRing[tail & mRingMask] = *msg;
+    android_atomic_release_store(tail + 1, &mTail);
+
+    // pairs with the barrier in ringArm(): either the consumer sees the
+    // new tail before sleeping, or we see it waiting and wake it up
+    android_memory_barrier();
+
+    if ( mWaiting || mFdExported )
         {
-        if (pfd[2].revents & POLLIN)
-            {
-            queue3->setMsg(true);
-            }
+        ringSignal();
         }
+    }
 
-    LOG_FUNCTION_NAME_EXIT;
-    return ret;
+/**
+   @brief Check whether the producer has to wait for a free slot, producer side only
+
+   @param tail Current tail index
+   @return true If every slot holds an unread message
+ */
+bool MessageQueue::ringFull(int32_t tail)
+    {
+    return (uint32_t) ( tail - android_atomic_acquire_load(&mHead) ) > mRingMask;
+    }
+
+/**
+   @brief Wake the consumer through the eventfd
+
+   @param none
+   @return none
+ */
+void MessageQueue::ringSignal()
+    {
+    uint64_t one = 1;
+
+    if ( 0 > write(this->fd_write, &one, sizeof(one)) )
+        {
+        MSGQ_LOGEB("eventfd write() error: %s", strerror(errno));
+        }
+    }
+
+/**
+   @brief Reset the eventfd of the ring, consumer side only
+
+   @param none
+   @return none
+ */
+void MessageQueue::ringDrain()
+    {
+    uint64_t count;
+
+    if ( 0 > read(this->fd_read, &count, sizeof(count)) )
+        {
+        // nothing pending
+        return;
+        }
+
+    // a put() may have landed between the last check and the read,
+    // keep the descriptor readable for it
+    android_memory_barrier();
+    if ( mFdExported && !ringEmpty() )
+        {
+        ringSignal();
+        }
+    }
+
+/**
+   @brief Announce whether the consumer is about to sleep on the eventfd
+
+   @param waiting true before polling, false once awake
+   @return none
+ */
+void MessageQueue::ringArm(bool waiting)
+    {
+    android_atomic_release_store(waiting ? 1 : 0, &mWaiting);
+    android_memory_barrier();
     }
 
 };
@@ -65,7 +65,20 @@ class MessageQueue
 {
 public:
 
-    MessageQueue();
+    ///Transport used to move messages from put() to get()
+    enum Backend
+        {
+        ///Kernel pipe, any number of producer threads
+        BACKEND_PIPE,
+        ///Lock-free ring in process memory, exactly one producer and one consumer thread.
+        ///The consumer is only woken through an eventfd when it is actually sleeping.
+        ///put() on a full ring sleeps on a second eventfd until half of the ring is free.
+        BACKEND_RING
+        };
+
+    static const unsigned int DEFAULT_RING_DEPTH = 256;
+
+    MessageQueue(Backend backend = BACKEND_PIPE, unsigned int depth = DEFAULT_RING_DEPTH);
     ~MessageQueue();
 
     ///Get a message from the queue
@@ -94,10 +107,45 @@ public:
       return mHasMsg;
     }
 
+    Backend getBackend()
+    {
+      return mBackend;
+    }
+
 private:
+    bool initRing(unsigned int depth);
+    bool ringEmpty();
+    bool ringFull(int32_t tail);
+    bool ringPop(Message* msg);
+    void ringPush(Message* msg);
+    void ringSignal();
+    void ringDrain();
+    void ringArm(bool waiting);
+
     int fd_read;
     int fd_write;
     bool mHasMsg;
+
+    Backend mBackend;
+    Message* mRing;
+    unsigned int mRingMask;
+
+    ///Indices run freely and are masked on access. Each one is written by
+    ///a single side only, keep them on separate cache lines.
+    volatile int32_t mTail;
+    int32_t mTailPad[15];
+    volatile int32_t mHead;
+    int32_t mHeadPad[15];
+
+    ///Set by the consumer while it sleeps on the eventfd
+    volatile int32_t mWaiting;
+    ///Set once the eventfd was handed out through getInFd(), every put() signals it from then on
+    volatile int32_t mFdExported;
+
+    ///Wakes the producer once the consumer frees a slot of a full ring
+    int mSpaceFd;
+    ///Set by the producer while it sleeps on mSpaceFd
+    volatile int32_t mProducerWaiting;
 };
 
 };
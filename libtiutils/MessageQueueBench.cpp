@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file MessageQueueBench.cpp
+*
+* Compares the pipe and ring backends of TIUTILS::MessageQueue:
+*   - streaming rate, one producer thread against one consumer thread
+*   - round trip latency, ping-pong over a command and an ack queue
+*
+* usage: msgqbench [messages]
+*
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+
+#define LOG_TAG "MessageQueueBench"
+#include <utils/Log.h>
+
+#include <Errors.h>
+#include "MessageQueue.h"
+
+using namespace TIUTILS;
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct BenchContext
+{
+    MessageQueue *cmdQ;
+    MessageQueue *ackQ;
+    unsigned int count;
+};
+
+static void* streamProducer(void *arg)
+{
+    BenchContext *ctx = (BenchContext *) arg;
+    Message msg;
+
+    for ( unsigned int i = 0 ; i < ctx->count ; i++ )
+        {
+        msg.command = i;
+        msg.id = nowNs();
+        ctx->cmdQ->put(&msg);
+        }
+
+    return NULL;
+}
+
+static void* echoThread(void *arg)
+{
+    BenchContext *ctx = (BenchContext *) arg;
+    Message msg;
+
+    for ( unsigned int i = 0 ; i < ctx->count ; i++ )
+        {
+        // same pattern as the HAL threads: wait first, then get
+        MessageQueue::waitForMsg(ctx->cmdQ, NULL, NULL, -1);
+        ctx->cmdQ->get(&msg);
+        ctx->ackQ->put(&msg);
+        }
+
+    return NULL;
+}
+
+static const char* backendName(MessageQueue::Backend backend)
+{
+    return ( MessageQueue::BACKEND_RING == backend ) ? "ring" : "pipe";
+}
+
+static void benchStream(MessageQueue::Backend backend, unsigned int count)
+{
+    MessageQueue queue(backend);
+    BenchContext ctx = { &queue, NULL, count };
+    pthread_t producer;
+    Message msg;
+    int64_t start, elapsed;
+    bool ordered = true;
+
+    start = nowNs();
+    pthread_create(&producer, NULL, streamProducer, &ctx);
+
+    for ( unsigned int i = 0 ; i < count ; i++ )
+        {
+        MessageQueue::waitForMsg(&queue, NULL, NULL, -1);
+        queue.get(&msg);
+        ordered = ordered && ( msg.command == i );
+        }
+
+    elapsed = nowNs() - start;
+    pthread_join(producer, NULL);
+
+    printf("%s stream:   %10.0f msg/s %s\n", backendName(queue.getBackend()),
+           (double) count * 1000000000.0 / (double) elapsed,
+           ordered ? "" : "(OUT OF ORDER)");
+}
+
+static void benchLatency(MessageQueue::Backend backend, unsigned int count)
+{
+    MessageQueue cmdQ(backend), ackQ(backend);
+    BenchContext ctx = { &cmdQ, &ackQ, count };
+    pthread_t echo;
+    Message msg;
+    int64_t *samples = new int64_t[count];
+
+    pthread_create(&echo, NULL, echoThread, &ctx);
+
+    for ( unsigned int i = 0 ; i < count ; i++ )
+        {
+        msg.command = i;
+        msg.id = nowNs();
+        cmdQ.put(&msg);
+        MessageQueue::waitForMsg(&ackQ, NULL, NULL, -1);
+        ackQ.get(&msg);
+        samples[i] = nowNs() - msg.id;
+        }
+
+    pthread_join(echo, NULL);
+
+    std::sort(samples, samples + count);
+    printf("%s latency:  p50 %6.2f us  p90 %6.2f us  p99 %6.2f us  max %8.2f us\n",
+           backendName(cmdQ.getBackend()),
+           samples[count / 2] / 1000.0,
+           samples[(count * 9) / 10] / 1000.0,
+           samples[(count * 99) / 100] / 1000.0,
+           samples[count - 1] / 1000.0);
+
+    delete [] samples;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int count = ( argc > 1 ) ? atoi(argv[1]) : 100000;
+
+    if ( count < 100 )
+        {
+        count = 100;
+        }
+
+    benchStream(MessageQueue::BACKEND_PIPE, count);
+    benchStream(MessageQueue::BACKEND_RING, count);
+    benchLatency(MessageQueue::BACKEND_PIPE, count / 10);
+    benchLatency(MessageQueue::BACKEND_RING, count / 10);
+
+    return 0;
+}
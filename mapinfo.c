@@ -88,19 +88,78 @@ const char *map_to_name(mapinfo *mi, unsigned pc, const char* def)
     return def;
 }
 
+static const mapinfo *found(const mapinfo *mi, unsigned pc, unsigned *rel_pc)
+{
+    *rel_pc = pc;
+    // Only calculate the relative offset for shared libraries
+    if (strstr(mi->name, ".so")) {
+        *rel_pc -= mi->start;
+    }
+    return mi;
+}
+
 /* Find the containing map info for the pc */
 const mapinfo *pc_to_mapinfo(mapinfo *mi, unsigned pc, unsigned *rel_pc)
 {
     *rel_pc = pc;
     while(mi) {
         if((pc >= mi->start) && (pc < mi->end)){
-            // Only calculate the relative offset for shared libraries
-            if (strstr(mi->name, ".so")) {
-                *rel_pc -= mi->start;
-            }
-            return mi;
+            return found(mi, pc, rel_pc);
         }
         mi = mi->next;
     }
     return NULL;
 }
+
+static int compare_start(const void *a, const void *b)
+{
+    const mapinfo *ma = *(const mapinfo * const *)a;
+    const mapinfo *mb = *(const mapinfo * const *)b;
+    return ma->start < mb->start ? -1 : ma->start > mb->start;
+}
+
+/* Index the maps of a list, the list must outlive the table */
+mapinfo_table *init_mapinfo_table(mapinfo *mi)
+{
+    mapinfo_table *table;
+    mapinfo *m;
+    unsigned num = 0;
+
+    for(m = mi; m; m = m->next)
+        num++;
+
+    table = __real_malloc(sizeof(mapinfo_table) + num * sizeof(mapinfo *));
+    if(table == 0) return 0;
+
+    table->num = 0;
+    for(m = mi; m; m = m->next)
+        table->maps[table->num++] = m;
+    qsort(table->maps, table->num, sizeof(mapinfo *), compare_start);
+
+    return table;
+}
+
+void deinit_mapinfo_table(mapinfo_table *table)
+{
+    __real_free(table);
+}
+
+/* Same as pc_to_mapinfo, in O(log n) */
+const mapinfo *table_pc_to_mapinfo(const mapinfo_table *table, unsigned pc,
+                                   unsigned *rel_pc)
+{
+    unsigned lo = 0, hi = table ? table->num : 0;
+
+    *rel_pc = pc;
+    /* find the last map starting at or below pc */
+    while(lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if(table->maps[mid]->start <= pc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo && pc < table->maps[lo - 1]->end)
+        return found(table->maps[lo - 1], pc, rel_pc);
+    return NULL;
+}
@@ -8,9 +8,20 @@ typedef struct mapinfo {
     char name[];
 } mapinfo;
 
+/* The maps of a list sorted by start address, looked up by binary search */
+typedef struct mapinfo_table {
+    unsigned num;
+    mapinfo *maps[];
+} mapinfo_table;
+
 mapinfo *init_mapinfo(int pid);
 void deinit_mapinfo(mapinfo *mi);
 const char *map_to_name(mapinfo *mi, unsigned pc, const char* def);
 const mapinfo *pc_to_mapinfo(mapinfo *mi, unsigned pc, unsigned *rel_pc);
 
+mapinfo_table *init_mapinfo_table(mapinfo *mi);
+void deinit_mapinfo_table(mapinfo_table *table);
+const mapinfo *table_pc_to_mapinfo(const mapinfo_table *table, unsigned pc,
+                                   unsigned *rel_pc);
+
 #endif
@@ -53,6 +53,8 @@
 #define DMM_PAGE_SIZE           4096
 #define QUEUE_SIZE              20
 #define ROUND_TO_PAGESIZE(n)    ((((n)+4095)/DMM_PAGE_SIZE)*DMM_PAGE_SIZE)
+/* At most QUEUE_SIZE buffers are queued per direction */
+#define LCML_COMMPOOL_MAX       (2*QUEUE_SIZE)
 
 #define __ERROR_PROPAGATION__
 
@@ -289,6 +291,20 @@ typedef struct
 OMX_ERRORTYPE GetHandle (OMX_HANDLETYPE* hInterface );
 
 void LCML_ReportDspError (void * arg);
+/**
+* Communication structures allocated and mapped to the DSP once per codec
+* instance, so that QueueBuffer does not allocate and map one per buffer
+*/
+typedef struct LCML_COMMPOOL
+{
+    char *pBase;                /* DSP aligned block holding all the slots */
+    DMM_BUFFER_OBJ DmmBuf;      /* single mapping of pBase */
+    OMX_U32 nSlotSize;
+    OMX_U32 nFree;
+    OMX_U32 FreeSlots[LCML_COMMPOOL_MAX];
+    LCML_COMMPOOL_STATS stats;
+} LCML_COMMPOOL;
+
 /**
 * Struct derives codec interface which have interface to implement for using
 * generic codec and also have pointer to DSP specific data and have queues for
@@ -331,6 +347,7 @@ typedef struct LCML_DSP_INTERFACE
     pthread_mutex_t m_isStopped_mutex;
     OMX_BOOL buf_invalidate_flag;
     OMX_BOOL buf_flush_flag;
+    LCML_COMMPOOL commPool;
 
 }LCML_DSP_INTERFACE;
 
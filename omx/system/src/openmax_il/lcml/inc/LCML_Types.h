@@ -243,6 +243,21 @@ typedef struct DMM_BUFFER_OBJ {
     int nSize;
 } DMM_BUFFER_OBJ;
 
+/* ======================================================================= */
+/**
+ * Counters of the communication structure pool, returned by
+ * EMMCodecControlCommPoolStats
+ */
+/*  ==================================================================== */
+
+typedef struct LCML_COMMPOOL_STATS {
+    OMX_U32 nSlots;     /* structures mapped to the DSP at init time */
+    OMX_U32 nHits;      /* QueueBuffer calls served from the pool */
+    OMX_U32 nMisses;    /* QueueBuffer calls that allocated and mapped */
+    OMX_U32 nInUse;     /* pool structures currently queued to the DSP */
+    OMX_U32 nMaxInUse;
+} LCML_COMMPOOL_STATS;
+
 /* ======================================================================= */
 /**
  * Structure used to pass in the callback function. LCML call back functions
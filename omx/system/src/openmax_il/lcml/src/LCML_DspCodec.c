@@ -134,6 +134,15 @@ static OMX_ERRORTYPE DmmUnMap(DSP_HPROCESSOR ProcHandle,
                               void *pMapPtr,
                               void *pResPtr,
                               struct OMX_TI_Debug dbg);
+static void InitCommPool(LCML_DSP_INTERFACE *phandle);
+static void FreeCommPool(LCML_DSP_INTERFACE *phandle);
+static TArmDspCommunicationStruct* GetCommStruct(LCML_DSP_INTERFACE *phandle);
+static OMX_ERRORTYPE MapCommStruct(LCML_DSP_INTERFACE *phandle,
+                                   TArmDspCommunicationStruct *pComm,
+                                   DMM_BUFFER_OBJ *pDmmBuf);
+static void ReleaseCommStruct(LCML_DSP_INTERFACE *phandle,
+                              TArmDspCommunicationStruct *pComm,
+                              DMM_BUFFER_OBJ *pDmmBuf);
 static OMX_ERRORTYPE DeleteDspResource(LCML_DSP_INTERFACE *hInterface);
 static OMX_ERRORTYPE FreeResources(LCML_DSP_INTERFACE *hInterface);
 
@@ -556,6 +565,7 @@ static OMX_ERRORTYPE InitMMCodecEx(OMX_HANDLETYPE hInt,
             phandle->algcntlmapped[i] = 0;
             phandle->strmcntlmapped[i] = 0;
         }
+        InitCommPool(phandle);
 #ifdef __PERF_INSTRUMENTATION__
         PERF_Boundary(phandle->pPERF,
                       PERF_BoundaryComplete | PERF_BoundarySetup);
@@ -896,6 +906,7 @@ static OMX_ERRORTYPE InitMMCodec(OMX_HANDLETYPE hInt,
         phandle->algcntlmapped[i] = 0;
         phandle->strmcntlmapped[i] = 0;
     }
+    InitCommPool(phandle);
 
 #ifdef __PERF_INSTRUMENTATION__
     PERF_Boundary(phandle->pPERF,
@@ -961,12 +972,13 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
     OMX_U32 streamId = 0;
     int status;
     OMX_ERRORTYPE eError = OMX_ErrorNone;
-    char * tmp2=NULL;
     DMM_BUFFER_OBJ* pDmmBuf=NULL;
     int commandId;
     struct DSP_MSG msg;
     OMX_U32 MapBufLen=0;
     OMX_BOOL mappedBufferFound = false;
+    TArmDspCommunicationStruct **ppStorage = NULL;
+    DMM_BUFFER_OBJ *pCommDmmBuf = NULL;
 
     if (hComponent == NULL )
     {
@@ -986,14 +998,12 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
                        PERF_ModuleSocketNode);
 #endif
     pthread_mutex_lock(&phandle->mutex);
-    LCML_MEMALIGN(tmp2,sizeof(TArmDspCommunicationStruct),char, eError);
-    if (eError)
+    phandle->commStruct = GetCommStruct(phandle);
+    if (phandle->commStruct == NULL)
     {
+        eError = OMX_ErrorInsufficientResources;
         goto MUTEX_UNLOCK;
     }
-
-    memset(tmp2,0,sizeof(TArmDspCommunicationStruct));
-    phandle->commStruct = (TArmDspCommunicationStruct *)(tmp2);
     phandle->commStruct->iBufferPtr = (OMX_U32) buffer;
     phandle->commStruct->iBufferSize = bufferLen;
     phandle->commStruct->iParamPtr = (OMX_U32) auxInfo;
@@ -1045,7 +1055,8 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
 
     if (bufType == EMMCodecInputBuffer || !(streamId % 2))
     {
-        phandle->Arminputstorage[phandle->iBufinputcount] = phandle->commStruct;
+        ppStorage = &phandle->Arminputstorage[phandle->iBufinputcount];
+        *ppStorage = phandle->commStruct;
         pDmmBuf = phandle->dspCodec->InDmmBuffer;
         pDmmBuf = pDmmBuf + phandle->iBufinputcount;
         phandle->iBufinputcount++;
@@ -1055,7 +1066,8 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
     }
     else if (bufType == EMMCodecOuputBuffer || streamId % 2)
     {
-        phandle->Armoutputstorage[phandle->iBufoutputcount] = phandle->commStruct;
+        ppStorage = &phandle->Armoutputstorage[phandle->iBufoutputcount];
+        *ppStorage = phandle->commStruct;
         pDmmBuf = phandle->dspCodec->OutDmmBuffer;
         pDmmBuf = pDmmBuf + phandle->iBufoutputcount;
         phandle->iBufoutputcount++;
@@ -1065,19 +1077,14 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
     {
         OMX_ERROR4 (((LCML_CODEC_INTERFACE *)hComponent)->dbg, "Unrecognized buffer type..");
         eError = OMX_ErrorBadParameter;
-        if(tmp2)
-        {
-            free(tmp2);
-            phandle->commStruct = NULL;
-        }
-        goto MUTEX_UNLOCK;
+        goto COMM_RELEASE;
     }
     commandId = USN_GPPMSG_SET_BUFF|streamId;
     OMX_PRINT1 (((LCML_CODEC_INTERFACE *)hComponent)->dbg, "Sending command ID 0x%x",commandId);
     if( pDmmBuf == NULL)
     {
         eError = OMX_ErrorInsufficientResources;
-        goto MUTEX_UNLOCK;
+        goto COMM_RELEASE;
     }
     OMX_PRINT1 (((LCML_CODEC_INTERFACE *)hComponent)->dbg, "buffer = 0x%p bufferlen = %ld auxInfo = 0x%p auxInfoLen %ld\n",
         buffer, bufferLen, auxInfo, auxInfoLen );
@@ -1112,7 +1119,7 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
                             if(DSP_FAILED(status))
                             {
                                 eError = OMX_ErrorHardware;
-                                goto MUTEX_UNLOCK;
+                                goto COMM_RELEASE;
                             }
                         }
 
@@ -1128,7 +1135,7 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
                             if(DSP_FAILED(status))
                             {
                                 eError = OMX_ErrorHardware;
-                                goto MUTEX_UNLOCK;
+                                goto COMM_RELEASE;
                             }
                         }
                         else
@@ -1142,7 +1149,7 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
                             if(DSP_FAILED(status))
                             {
                                 eError = OMX_ErrorHardware;
-                                goto MUTEX_UNLOCK;
+                                goto COMM_RELEASE;
                             }
                         }
                     }
@@ -1164,7 +1171,7 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
                 if (eError != OMX_ErrorNone)
                 {
                     eError = OMX_ErrorHardware;
-                    goto MUTEX_UNLOCK;
+                    goto COMM_RELEASE;
                 }
 
                 /*Reuse implementation */
@@ -1202,7 +1209,7 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
             }
             if (eError != OMX_ErrorNone)
             {
-                goto MUTEX_UNLOCK;
+                goto COMM_RELEASE;
             }
             phandle->commStruct->iBufferPtr = (OMX_U32) pDmmBuf->pMapped;
             pDmmBuf->bufReserved = pDmmBuf->pReserved;
@@ -1216,7 +1223,7 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
         eError = DmmMap(phandle->dspCodec->hProc, phandle->commStruct->iParamSize, (void*)phandle->commStruct->iParamPtr, (pDmmBuf), ((LCML_CODEC_INTERFACE *)hComponent)->dbg, ALIGNMENT_CHECK);
         if (eError != OMX_ErrorNone)
         {
-            goto MUTEX_UNLOCK;
+            goto COMM_RELEASE;
         }
 
         phandle->commStruct->iParamPtr = (OMX_U32 )pDmmBuf->pMapped ;
@@ -1224,11 +1231,12 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
         pDmmBuf->paramReserved = pDmmBuf->pReserved;
     }
 
-    eError = DmmMap(phandle->dspCodec->hProc, sizeof(TArmDspCommunicationStruct),(void *)phandle->commStruct, (pDmmBuf), ((LCML_CODEC_INTERFACE *)hComponent)->dbg, ALIGNMENT_CHECK);
+    eError = MapCommStruct(phandle, phandle->commStruct, pDmmBuf);
     if (eError != OMX_ErrorNone)
     {
-        goto MUTEX_UNLOCK;
+        goto COMM_RELEASE;
     }
+    pCommDmmBuf = pDmmBuf;
 
     OMX_PRINT2 (((LCML_CODEC_INTERFACE *)hComponent)->dbg, "sending SETBUFF \n");
     msg.dwCmd = commandId;
@@ -1237,7 +1245,17 @@ static OMX_ERRORTYPE QueueBuffer (OMX_HANDLETYPE hComponent,
 
     status = DSPNode_PutMessage (phandle->dspCodec->hNode, &msg, DSP_FOREVER);
     OMX_PRINT2 (((LCML_CODEC_INTERFACE *)hComponent)->dbg, "after SETBUFF \n");
-    DSP_ERROR_EXIT (status, "Send message to node", MUTEX_UNLOCK, hComponent);
+    DSP_ERROR_EXIT (status, "Send message to node", COMM_RELEASE, hComponent);
+    goto MUTEX_UNLOCK;
+
+COMM_RELEASE:
+    /* the DSP never saw this buffer, give its structure back to the pool */
+    if (ppStorage != NULL)
+    {
+        *ppStorage = NULL;
+    }
+    ReleaseCommStruct(phandle, phandle->commStruct, pCommDmmBuf);
+    phandle->commStruct = NULL;
 MUTEX_UNLOCK:
     pthread_mutex_unlock(&phandle->mutex);
 EXIT:
@@ -1374,7 +1392,6 @@ static OMX_ERRORTYPE ControlCodec(OMX_HANDLETYPE hComponent,
 
                 phandle->mapped_buffer_count = 0;
             }
-
             DeleteDspResource (phandle);
 
 #ifdef __PERF_INSTRUMENTATION__
@@ -1546,6 +1563,19 @@ static OMX_ERRORTYPE ControlCodec(OMX_HANDLETYPE hComponent,
             phandle->bUsnEos = OMX_TRUE;
             break;
         }
+        case EMMCodecControlCommPoolStats:
+        {
+            /* args[0]: LCML_COMMPOOL_STATS filled with the pool counters */
+            if (args == NULL || args[0] == NULL)
+            {
+                eError = OMX_ErrorBadParameter;
+                goto EXIT;
+            }
+            pthread_mutex_lock(&phandle->mutex);
+            *((LCML_COMMPOOL_STATS *)args[0]) = phandle->commPool.stats;
+            pthread_mutex_unlock(&phandle->mutex);
+            break;
+        }
 
     }
 
@@ -1673,6 +1703,223 @@ EXIT:
     return eError;
 }
 
+/** ========================================================================
+* InitCommPool () allocates one communication structure per port buffer and
+* maps them to the DSP as a single block, so that QueueBuffer neither
+* allocates nor maps a structure per buffer.  If the block cannot be
+* allocated or mapped the codec runs without a pool.
+*
+* @param phandle - LCML handle of the codec instance
+** ==========================================================================*/
+static void InitCommPool(LCML_DSP_INTERFACE *phandle)
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+    LCML_COMMPOOL *pPool = &phandle->commPool;
+    OMX_U32 nSlots;
+    OMX_U32 nSize;
+    OMX_U32 i;
+
+    memset(pPool, 0, sizeof(LCML_COMMPOOL));
+    nSlots = phandle->dspCodec->In_BufInfo.nBuffers + phandle->dspCodec->Out_BufInfo.nBuffers;
+    if (nSlots > LCML_COMMPOOL_MAX)
+    {
+        nSlots = LCML_COMMPOOL_MAX;
+    }
+    if (nSlots == 0)
+    {
+        goto EXIT;
+    }
+
+    /* each slot starts on a DSP cache line */
+    pPool->nSlotSize = OMX_GET_SIZE_DSPALIGN(sizeof(TArmDspCommunicationStruct));
+    nSize = nSlots * pPool->nSlotSize;
+    LCML_MEMALIGN(pPool->pBase, nSize, char, eError);
+    if (eError != OMX_ErrorNone)
+    {
+        goto EXIT;
+    }
+    memset(pPool->pBase, 0, nSize);
+
+    eError = DmmMap(phandle->dspCodec->hProc, nSize, pPool->pBase, &pPool->DmmBuf,
+                    ((LCML_CODEC_INTERFACE *)phandle->pCodecinterfacehandle)->dbg, ALIGNMENT_CHECK);
+    if (eError != OMX_ErrorNone)
+    {
+        LCML_MEMFREE(pPool->pBase, NULL);
+        pPool->pBase = NULL;
+        goto EXIT;
+    }
+
+    for (i = 0; i < nSlots; i++)
+    {
+        pPool->FreeSlots[i] = nSlots - 1 - i;
+    }
+    pPool->nFree = nSlots;
+    pPool->stats.nSlots = nSlots;
+
+EXIT:
+    OMX_PRBUFFER2 (((LCML_CODEC_INTERFACE *)phandle->pCodecinterfacehandle)->dbg,
+            "Communication structure pool: %lu slots\n", pPool->stats.nSlots);
+}
+
+/** ========================================================================
+* FreeCommPool () unmaps and frees the communication structure pool.
+*
+* @param phandle - LCML handle of the codec instance
+** ==========================================================================*/
+static void FreeCommPool(LCML_DSP_INTERFACE *phandle)
+{
+    LCML_COMMPOOL *pPool = &phandle->commPool;
+
+    OMX_PRBUFFER2 (((LCML_CODEC_INTERFACE *)phandle->pCodecinterfacehandle)->dbg,
+            "Communication structure pool: %lu slots, %lu hits, %lu misses, %lu in use (max %lu)\n",
+            pPool->stats.nSlots, pPool->stats.nHits, pPool->stats.nMisses,
+            pPool->stats.nInUse, pPool->stats.nMaxInUse);
+    if (pPool->pBase == NULL)
+    {
+        return;
+    }
+    DmmUnMap(phandle->dspCodec->hProc, pPool->DmmBuf.pMapped, pPool->DmmBuf.pReserved,
+             ((LCML_CODEC_INTERFACE *)phandle->pCodecinterfacehandle)->dbg);
+    LCML_MEMFREE(pPool->pBase, NULL);
+    memset(pPool, 0, sizeof(LCML_COMMPOOL));
+}
+
+/** ========================================================================
+* CommPoolSlot () returns the pool slot holding pComm, or -1 if pComm was
+* allocated on its own.
+** ==========================================================================*/
+static OMX_S32 CommPoolSlot(LCML_DSP_INTERFACE *phandle, TArmDspCommunicationStruct *pComm)
+{
+    LCML_COMMPOOL *pPool = &phandle->commPool;
+    char *p = (char *)pComm;
+
+    if (pPool->pBase == NULL || p < pPool->pBase ||
+        p >= pPool->pBase + pPool->stats.nSlots * pPool->nSlotSize)
+    {
+        return -1;
+    }
+    return (p - pPool->pBase) / pPool->nSlotSize;
+}
+
+/** ========================================================================
+* GetCommStruct () returns a cleared communication structure for a buffer,
+* from the pool if a slot is free.  Otherwise the structure is allocated and
+* will be mapped by MapCommStruct.  Called with phandle->mutex held.
+*
+* @param phandle - LCML handle of the codec instance
+*
+* @retval the structure, NULL if it could not be allocated
+** ==========================================================================*/
+static TArmDspCommunicationStruct* GetCommStruct(LCML_DSP_INTERFACE *phandle)
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+    LCML_COMMPOOL *pPool = &phandle->commPool;
+    char *tmp2 = NULL;
+
+    if (pPool->nFree > 0)
+    {
+        pPool->nFree--;
+        tmp2 = pPool->pBase + pPool->FreeSlots[pPool->nFree] * pPool->nSlotSize;
+        pPool->stats.nHits++;
+        pPool->stats.nInUse++;
+        if (pPool->stats.nInUse > pPool->stats.nMaxInUse)
+        {
+            pPool->stats.nMaxInUse = pPool->stats.nInUse;
+        }
+    }
+    else
+    {
+        pPool->stats.nMisses++;
+        LCML_MEMALIGN(tmp2, sizeof(TArmDspCommunicationStruct), char, eError);
+        if (eError != OMX_ErrorNone)
+        {
+            return NULL;
+        }
+    }
+    memset(tmp2, 0, sizeof(TArmDspCommunicationStruct));
+
+    return (TArmDspCommunicationStruct *)tmp2;
+}
+
+/** ========================================================================
+* MapCommStruct () makes pComm visible to the DSP and records its DSP
+* address in pDmmBuf->pMapped.  A pool slot is already mapped, so it is only
+* written back from the cache.
+*
+* @param phandle - LCML handle of the codec instance
+* @param pComm - structure returned by GetCommStruct
+* @param pDmmBuf - DMM object of the buffer the structure describes
+*
+* @retval OMX_ErrorNone  - Success
+*          OMX_ErrorHardware  -  Hardware Error
+** ==========================================================================*/
+static OMX_ERRORTYPE MapCommStruct(LCML_DSP_INTERFACE *phandle,
+                                   TArmDspCommunicationStruct *pComm,
+                                   DMM_BUFFER_OBJ *pDmmBuf)
+{
+    LCML_COMMPOOL *pPool = &phandle->commPool;
+    OMX_S32 slot = CommPoolSlot(phandle, pComm);
+    int status;
+
+    if (slot < 0)
+    {
+        return DmmMap(phandle->dspCodec->hProc, sizeof(TArmDspCommunicationStruct), (void *)pComm, pDmmBuf,
+                      ((LCML_CODEC_INTERFACE *)phandle->pCodecinterfacehandle)->dbg, ALIGNMENT_CHECK);
+    }
+
+    status = DSPProcessor_FlushMemory(phandle->dspCodec->hProc, (void *)pComm,
+                                      pPool->nSlotSize, DSPMSG_WRBK_INVALIDATE_MEM);
+    if (DSP_FAILED(status))
+    {
+        OMX_ERROR4 (((LCML_CODEC_INTERFACE *)phandle->pCodecinterfacehandle)->dbg,
+                "Flush Fail for communication structure %p \n", pComm);
+        return OMX_ErrorHardware;
+    }
+    pDmmBuf->pAllocated = (void *)pComm;
+    pDmmBuf->pReserved = NULL;
+    pDmmBuf->pMapped = (char *)pPool->DmmBuf.pMapped + slot * pPool->nSlotSize;
+    pDmmBuf->nSize = sizeof(TArmDspCommunicationStruct);
+
+    return OMX_ErrorNone;
+}
+
+/** ========================================================================
+* ReleaseCommStruct () returns a structure the DSP is done with to the pool,
+* or unmaps and frees it if it was allocated on its own.  Called with
+* phandle->mutex held.
+*
+* @param phandle - LCML handle of the codec instance
+* @param pComm - structure returned by GetCommStruct
+* @param pDmmBuf - DMM object passed to MapCommStruct, NULL if not mapped
+** ==========================================================================*/
+static void ReleaseCommStruct(LCML_DSP_INTERFACE *phandle,
+                              TArmDspCommunicationStruct *pComm,
+                              DMM_BUFFER_OBJ *pDmmBuf)
+{
+    LCML_COMMPOOL *pPool = &phandle->commPool;
+    OMX_S32 slot = CommPoolSlot(phandle, pComm);
+    char *tmp2 = (char *)pComm;
+
+    if (slot < 0)
+    {
+        if (pDmmBuf != NULL)
+        {
+            DmmUnMap(phandle->dspCodec->hProc, pDmmBuf->pMapped, pDmmBuf->pReserved,
+                     ((LCML_CODEC_INTERFACE *)phandle->pCodecinterfacehandle)->dbg);
+        }
+        LCML_MEMFREE(tmp2, NULL);
+    }
+    else
+    {
+        pPool->FreeSlots[pPool->nFree++] = slot;
+        pPool->stats.nInUse--;
+    }
+    if (pDmmBuf != NULL)
+    {
+        pDmmBuf->pMapped = 0;
+    }
+}
+
 /** ========================================================================
 * FreeResources () method is used to allocate the memory using DMM.
 *
@@ -1780,6 +2027,11 @@ OMX_ERRORTYPE DeleteDspResource(LCML_DSP_INTERFACE *hInterface)
     DSP_ERROR_EXIT (status, "DeInit: Codec Node Delete ", EXIT, hInterface->pCodecinterfacehandle);
     OMX_PRDSP2 (((LCML_CODEC_INTERFACE *)hInterface->pCodecinterfacehandle)->dbg, "%d :: Deleted the node Successfully\n",__LINE__);
 
+    /* the node can no longer write to the communication structures, unmap
+     * them while the processor handle is still open.  If a delete above
+     * failed the pool is left mapped rather than freed under the node. */
+    FreeCommPool(hInterface);
+
     OMX_PRINT1 (((LCML_CODEC_INTERFACE *)hInterface->pCodecinterfacehandle)->dbg, "%d :: Entering UnLoadDLLs \n", __LINE__);
     for(dllinfo=0;dllinfo < hInterface->dspCodec->NodeInfo.nNumOfDLLs ;dllinfo++)
     {
@@ -2067,10 +2319,8 @@ void* MessagingThread(void* arg)
 
                             OMX_PRINT2 (((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg, 
                                     "GOT MESSAGE EMMCodecBufferProcessed  and now unmapping  structure =0x%p\n",tmpDspStructAddress );
-                            DmmUnMap(hDSPInterface->dspCodec->hProc, pDmmBuf->pMapped, pDmmBuf->pReserved, ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
-                            pDmmBuf->pMapped = 0;
                             tmp2 = (char *)tmpDspStructAddress;
-                            LCML_MEMFREE(tmp2, NULL);
+                            ReleaseCommStruct(hDSPInterface, (TArmDspCommunicationStruct *)tmp2, pDmmBuf);
 
                             /* free(tmpDspStructAddress); */
                             tmpDspStructAddress = NULL;
@@ -2162,14 +2412,12 @@ void* MessagingThread(void* arg)
                                                  (void*)tmpDspStructAddress->iParamPtr,
                                                  pDmmBuf->paramReserved, ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
                                     }
-                                    DmmUnMap(hDSPInterface->dspCodec->hProc, pDmmBuf->pMapped, pDmmBuf->pReserved, ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
-                                    pDmmBuf->pMapped = 0;
 
                                     if (NULL != tmpDspStructAddress)
                                     {
                                         tmp2 = (char *) tmpDspStructAddress;
                                     }
-                                    LCML_MEMFREE(tmp2, NULL);
+                                    ReleaseCommStruct(hDSPInterface, (TArmDspCommunicationStruct *)tmp2, pDmmBuf);
 
                                     hDSPInterface->Arminputstorage[i] = NULL;
                                     tmpDspStructAddress     = NULL;
@@ -2243,14 +2491,12 @@ void* MessagingThread(void* arg)
                                                  (void*)tmpDspStructAddress->iParamPtr,
                                                  pDmmBuf->paramReserved, ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
                                     }
-                                    DmmUnMap(hDSPInterface->dspCodec->hProc, pDmmBuf->pMapped, pDmmBuf->pReserved, ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
-                                    pDmmBuf->pMapped = 0;
 
                                     tmp2 = (char *) tmpDspStructAddress;
 
                                     tmpDspStructAddress->iBufSizeUsed = 0;
                                     args[8] = (void *) tmpDspStructAddress->iBufSizeUsed ;
-                                    LCML_MEMFREE(tmp2, NULL);
+                                    ReleaseCommStruct(hDSPInterface, (TArmDspCommunicationStruct *)tmp2, pDmmBuf);
 
                                     hDSPInterface->Armoutputstorage[k] = NULL;
                                     tmpDspStructAddress = NULL;
@@ -2400,16 +2646,13 @@ void* MessagingThread(void* arg)
                                                  pDmmBuf->paramReserved, 
                                                  ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
                                     }
-                                    DmmUnMap(hDSPInterface->dspCodec->hProc, pDmmBuf->pMapped, pDmmBuf->pReserved, 
-                                            ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
-                                    pDmmBuf->pMapped = 0;
 
                                     if (NULL != tmpDspStructAddress)
                                     {
                                         tmp2 = (char*)tmpDspStructAddress;
                                     }
                                     hDSPInterface->Arminputstorage[i] = NULL;
-                                    LCML_MEMFREE(tmp2, NULL);
+                                    ReleaseCommStruct(hDSPInterface, (TArmDspCommunicationStruct *)tmp2, pDmmBuf);
                                     tmpDspStructAddress     = NULL;
 #ifdef __PERF_INSTRUMENTATION__
                                     PERF_XferingBuffer(hDSPInterface->pPERFcomp,
@@ -2512,16 +2755,13 @@ void* MessagingThread(void* arg)
                                                  pDmmBuf->paramReserved, 
                                                  ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
                                     }
-                                    DmmUnMap(hDSPInterface->dspCodec->hProc, pDmmBuf->pMapped, pDmmBuf->pReserved, 
-                                            ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
-                                    pDmmBuf->pMapped = 0;
 
                                     tmp2 = (char *) tmpDspStructAddress;
                                     tmpDspStructAddress->iBufSizeUsed = 0;
                                     args[8] = (void *) tmpDspStructAddress->iBufSizeUsed ;
 
                                     hDSPInterface->Armoutputstorage[i] = NULL;
-                                    LCML_MEMFREE(tmp2, NULL);
+                                    ReleaseCommStruct(hDSPInterface, (TArmDspCommunicationStruct *)tmp2, pDmmBuf);
                                     tmpDspStructAddress = NULL;
 #ifdef __PERF_INSTRUMENTATION__
                                     PERF_XferingBuffer(hDSPInterface->pPERFcomp,
@@ -2621,13 +2861,10 @@ void* MessagingThread(void* arg)
                                                  (void*)tmpDspStructAddress->iParamPtr,
                                                  pDmmBuf->paramReserved, ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
                                     }
-                                    DmmUnMap(hDSPInterface->dspCodec->hProc, pDmmBuf->pMapped, pDmmBuf->pReserved,
-                                            ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
-                                    pDmmBuf->pMapped = 0;
 
                                     tmp2 = (char*)tmpDspStructAddress;
                                     hDSPInterface->Arminputstorage[i] = NULL;
-                                    LCML_MEMFREE(tmp2, NULL);
+                                    ReleaseCommStruct(hDSPInterface, (TArmDspCommunicationStruct *)tmp2, pDmmBuf);
                                     tmpDspStructAddress     = NULL;
 #ifdef __PERF_INSTRUMENTATION__
                                     PERF_XferingBuffer(hDSPInterface->pPERFcomp,
@@ -2714,16 +2951,13 @@ void* MessagingThread(void* arg)
                                                  pDmmBuf->paramReserved,
                                                  ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
                                     }
-                                    DmmUnMap(hDSPInterface->dspCodec->hProc, pDmmBuf->pMapped, pDmmBuf->pReserved,
-                                            ((LCML_CODEC_INTERFACE *)((LCML_DSP_INTERFACE *)arg)->pCodecinterfacehandle)->dbg);
-                                    pDmmBuf->pMapped = 0;
 
                                     tmp2 = (char *)tmpDspStructAddress;
                                     tmpDspStructAddress->iBufSizeUsed = 0;
                                     args[8] = (void *) tmpDspStructAddress->iBufSizeUsed ;
 
                                     hDSPInterface->Armoutputstorage[i] = NULL;
-                                    LCML_MEMFREE(tmp2, NULL);
+                                    ReleaseCommStruct(hDSPInterface, (TArmDspCommunicationStruct *)tmp2, pDmmBuf);
                                     tmpDspStructAddress = NULL;
 #ifdef __PERF_INSTRUMENTATION__
                                     PERF_XferingBuffer(hDSPInterface->pPERFcomp,